@@ -24,13 +24,13 @@
 #else
 /* When DEBUG is not defined, no code gets generated for these */
 
-#define dbg_printf(...) sizeof(expr)
+#define dbg_printf(...) ((void) 0)
 
-#define dbg_requires(expr) sizeof(expr)
+#define dbg_requires(expr) ((void) sizeof(expr))
 
-#define dbg_assert(expr) sizeof(expr)
+#define dbg_assert(expr) ((void) sizeof(expr))
 
-#define dbg_ensures(expr) sizeof(expr)
+#define dbg_ensures(expr) ((void) sizeof(expr))
 
 #endif
 
@@ -1,3 +1,5 @@
+import random
+
 def row(square):
     return square // 8
 
@@ -49,9 +51,78 @@ def print_formatted_array(arr):
         i += 1
     print(result)
 
+DIAGONALS = [(-1, -1), (-1, 1), (1, -1), (1, 1)]
+STRAIGHTS = [(-1, 0), (0, -1), (0, 1), (1, 0)]
+
+def sliding_attacks(sq, occupied, directions):
+    attacks = 0
+    for dc, dr in directions:
+        r = row(sq)
+        c = col(sq)
+        while 0 <= r + dr < 8 and 0 <= c + dc < 8:
+            r += dr
+            c += dc
+            attacks |= 1 << square(r, c)
+            if occupied & (1 << square(r, c)):
+                break
+    return attacks
+
+def relevant_mask(sq, directions):
+    """Squares whose occupancy matters to a slider on sq (edges excluded)"""
+    mask = 0
+    for dc, dr in directions:
+        r = row(sq)
+        c = col(sq)
+        while 0 <= r + 2 * dr < 8 and 0 <= c + 2 * dc < 8:
+            r += dr
+            c += dc
+            mask |= 1 << square(r, c)
+    return mask
+
+def subsets(mask):
+    """Carry-Rippler enumeration of every subset of mask"""
+    subset = 0
+    while True:
+        yield subset
+        subset = (subset - mask) & mask
+        if subset == 0:
+            break
+
+def find_magic(sq, directions, rng):
+    mask = relevant_mask(sq, directions)
+    bits = bin(mask).count('1')
+    shift = 64 - bits
+    occupancies = list(subsets(mask))
+    attacks = [sliding_attacks(sq, occ, directions) for occ in occupancies]
+    full = (1 << 64) - 1
+    while True:
+        magic = rng.getrandbits(64) & rng.getrandbits(64) & rng.getrandbits(64)
+        if bin((mask * magic) & 0xFF00000000000000).count('1') < 6:
+            continue
+        table = [None] * (1 << bits)
+        for occ, attack in zip(occupancies, attacks):
+            index = ((occ * magic) & full) >> shift
+            if table[index] is None:
+                table[index] = attack
+            elif table[index] != attack:
+                break
+        else:
+            return magic
+
+def generate_magics(directions, seed):
+    rng = random.Random(seed)
+    return [find_magic(sq, directions, rng) for sq in range(64)]
+
 def main():
+    print("\nPRINTING RAYS (SOUTH)")
     print_formatted_array(generate_rays()[2])
-    
+
+    print("\nPRINTING BISHOP MAGICS")
+    print_formatted_array(generate_magics(DIAGONALS, 1))
+
+    print("\nPRINTING ROOK MAGICS")
+    print_formatted_array(generate_magics(STRAIGHTS, 2))
+
 
 if __name__ == '__main__':
     main()
\ No newline at end of file
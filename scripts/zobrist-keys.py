@@ -0,0 +1,85 @@
+"""
+Generates the Zobrist key tables of src/zobrist.c.
+
+The keys come from splitmix64 with a fixed seed, so they are the same on every
+run and every machine. Rerunning this script prints exactly the tables already
+in the source; change SEED only if the persisted hashes may all change too.
+"""
+
+SEED = 0x6d6f6e6b65000001      # "monke" followed by a version number
+MASK = (1 << 64) - 1
+
+NUM_COLORS = 2
+NUM_PIECES = 6                  # pawn, knight, bishop, rook, queen, king
+NUM_SQUARES = 64
+NUM_FILES = 8
+
+# The bit of each right in the white-relative castling word, by color and side
+CASTLING_BITS = [[0x8, 0x4], [0x2, 0x1]]
+
+def splitmix64(state):
+    state = (state + 0x9e3779b97f4a7c15) & MASK
+    z = state
+    z = ((z ^ (z >> 30)) * 0xbf58476d1ce4e5b9) & MASK
+    z = ((z ^ (z >> 27)) * 0x94d049bb133111eb) & MASK
+    return state, z ^ (z >> 31)
+
+def generate_keys():
+    state = SEED
+    def next_key():
+        nonlocal state
+        state, key = splitmix64(state)
+        return key
+
+    pieces = [[[next_key() for _ in range(NUM_SQUARES)]
+               for _ in range(NUM_PIECES)] for _ in range(NUM_COLORS)]
+
+    # One key per right, every set of rights is the XOR of its own
+    rights = [[next_key() for _ in range(2)] for _ in range(NUM_COLORS)]
+    castling = []
+    for word in range(16):
+        key = 0
+        for c in range(NUM_COLORS):
+            for o in range(2):
+                if word & CASTLING_BITS[c][o]:
+                    key ^= rights[c][o]
+        castling.append(key)
+
+    en_passant = [next_key() for _ in range(NUM_FILES)]
+    color = next_key()
+
+    return pieces, castling, en_passant, color
+
+def format_keys(keys, indent):
+    lines = []
+    for i in range(0, len(keys), 3):
+        lines.append(indent + ", ".join("{0:#018x}".format(k) 
+                                        for k in keys[i:i + 3]) + ",")
+    lines[-1] = lines[-1][:-1]
+    return "\n".join(lines)
+
+def main():
+    pieces, castling, en_passant, color = generate_keys()
+
+    print("const zhash PIECE_PRN[2][6][64] = {")
+    for c in range(NUM_COLORS):
+        print("    {")
+        for p in range(NUM_PIECES):
+            print("        {")
+            print(format_keys(pieces[c][p], " " * 12))
+            print("        }" + ("," if p < NUM_PIECES - 1 else ""))
+        print("    }" + ("," if c < NUM_COLORS - 1 else ""))
+    print("};\n")
+
+    print("const zhash CASTLING_PRN[16] = {")
+    print(format_keys(castling, " " * 4))
+    print("};\n")
+
+    print("const zhash EN_PASSANT_PRN[8] = {")
+    print(format_keys(en_passant, " " * 4))
+    print("};\n")
+
+    print("const zhash COLOR_PRN = {0:#018x};".format(color))
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,203 @@
+/**
+ * @file bitbase.c
+ * @brief Provides the implementation for endgame bitbases.
+ */
+
+#include "bits.h"
+#include "bitbase.h"
+
+#include "../lib/contracts.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/*
+ * ---------------------------------------------------------------------------
+ *                                    KPK
+ * ---------------------------------------------------------------------------
+ *
+ * The pawn is mirrored onto files a to d, which leaves 24 squares for it on
+ * ranks 2 to 7, so there are 2 * 64 * 64 * 24 positions. Each is indexed as
+ *
+ *     to_move + 2 * (weak_king + 64 * (strong_king + 64 * pawn_index))
+ *
+ * with to_move 0 when the stronger side is to move.
+ */
+
+#define KPK_PAWN_SQUARES 24
+#define KPK_SIZE (2 * 64 * 64 * KPK_PAWN_SQUARES)
+
+/** @brief Results of the positions while the bitbase is being built */
+enum { KPK_INVALID, KPK_UNKNOWN, KPK_DRAW, KPK_WIN };
+
+static uint32_t KPK_BITBASE[KPK_SIZE / 32];
+
+static bool KPK_READY = false;
+
+static int kpk_index(bool strong_to_move, square strong_king, square pawn,
+                     square weak_king) {
+    int pawn_index = (pawn / 8 - 1) * 4 + pawn % 8;
+    return !strong_to_move + 2 * (weak_king + 64 * (strong_king + 64 * pawn_index));
+}
+
+/** @brief Number of king moves between two squares */
+static int kpk_distance(square a, square b) {
+    int ranks = abs(a / 8 - b / 8), files = abs(a % 8 - b % 8);
+    return ranks > files ? ranks : files;
+}
+
+/** @brief Whether the pawn attacks a square */
+static bool kpk_pawn_attacks(square pawn, square s) {
+    return s / 8 == pawn / 8 + 1 && abs(s % 8 - pawn % 8) == 1;
+}
+
+/** @brief The result of a position worth knowing before any search */
+static uint8_t kpk_classify(bool strong_to_move, square strong_king,
+                            square pawn, square weak_king) {
+    if (strong_king == weak_king || strong_king == pawn || weak_king == pawn ||
+        kpk_distance(strong_king, weak_king) <= 1 ||
+        (strong_to_move && kpk_pawn_attacks(pawn, weak_king))) {
+        return KPK_INVALID;
+    }
+
+    if (strong_to_move) {
+        // Promotes to a queen that can't be taken
+        square queening = pawn + 8;
+        if (pawn / 8 == 6 && queening != strong_king && queening != weak_king &&
+            (kpk_distance(weak_king, queening) > 1 ||
+             kpk_distance(strong_king, queening) == 1)) {
+            return KPK_WIN;
+        }
+        return KPK_UNKNOWN;
+    }
+
+    // Takes the pawn
+    if (kpk_distance(weak_king, pawn) == 1 &&
+        kpk_distance(strong_king, pawn) > 1) {
+        return KPK_DRAW;
+    }
+    // Has no moves: mated, or stalemated
+    bool can_move = false;
+    for (int dr = -1; dr <= 1; dr++) {
+        for (int df = -1; df <= 1; df++) {
+            int r = weak_king / 8 + dr, f = weak_king % 8 + df;
+            if ((dr == 0 && df == 0) || r < 0 || r > 7 || f < 0 || f > 7)
+                continue;
+            square to = r * 8 + f;
+            if (to != pawn && kpk_distance(to, strong_king) > 1 &&
+                !kpk_pawn_attacks(pawn, to)) can_move = true;
+        }
+    }
+    if (!can_move) {
+        return kpk_pawn_attacks(pawn, weak_king) ? KPK_WIN : KPK_DRAW;
+    }
+    return KPK_UNKNOWN;
+}
+
+/**
+ * @brief Works a position out from the results of its children
+ *
+ * The side to move wins if any of its moves wins for it, and loses only if
+ * all of them lose, so a result stays unknown until enough children are.
+ */
+static uint8_t kpk_propagate(const uint8_t *results, bool strong_to_move,
+                             square strong_king, square pawn,
+                             square weak_king) {
+    // The result the side to move hopes for, and the one it fears
+    uint8_t good = strong_to_move ? KPK_WIN : KPK_DRAW;
+    uint8_t bad = strong_to_move ? KPK_DRAW : KPK_WIN;
+    bool all_bad = true;
+    square king = strong_to_move ? strong_king : weak_king;
+
+    for (int dr = -1; dr <= 1; dr++) {
+        for (int df = -1; df <= 1; df++) {
+            int r = king / 8 + dr, f = king % 8 + df;
+            if ((dr == 0 && df == 0) || r < 0 || r > 7 || f < 0 || f > 7)
+                continue;
+            square to = r * 8 + f;
+            uint8_t child = strong_to_move
+                ? results[kpk_index(false, to, pawn, weak_king)]
+                : results[kpk_index(true, strong_king, pawn, to)];
+            if (child == KPK_INVALID) continue;
+            if (child == good) return good;
+            if (child != bad) all_bad = false;
+        }
+    }
+
+    // Pawn pushes; pushes to the last rank were classified already
+    if (strong_to_move && pawn / 8 < 6) {
+        square push = pawn + 8;
+        if (push != strong_king && push != weak_king) {
+            uint8_t child = results[kpk_index(false, strong_king, push,
+                                              weak_king)];
+            if (child == good) return good;
+            if (child != bad) all_bad = false;
+
+            square dpp = pawn + 16;
+            if (pawn / 8 == 1 && dpp != strong_king && dpp != weak_king) {
+                child = results[kpk_index(false, strong_king, dpp, weak_king)];
+                if (child == good) return good;
+                if (child != bad) all_bad = false;
+            }
+        }
+    }
+
+    return all_bad ? bad : KPK_UNKNOWN;
+}
+
+void bitbase_init(void) {
+    uint8_t *results = malloc(KPK_SIZE);
+    if (results == NULL) {
+        perror("malloc error");
+        exit(1);
+    }
+
+    for (int index = 0; index < KPK_SIZE; index++) {
+        bool strong_to_move = index % 2 == 0;
+        square weak_king = (index / 2) % 64;
+        square strong_king = (index / 128) % 64;
+        int pawn_index = index / (128 * 64);
+        square pawn = (pawn_index / 4 + 1) * 8 + pawn_index % 4;
+        results[index] = kpk_classify(strong_to_move, strong_king, pawn,
+                                      weak_king);
+    }
+
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (int index = 0; index < KPK_SIZE; index++) {
+            if (results[index] != KPK_UNKNOWN) continue;
+            bool strong_to_move = index % 2 == 0;
+            square weak_king = (index / 2) % 64;
+            square strong_king = (index / 128) % 64;
+            int pawn_index = index / (128 * 64);
+            square pawn = (pawn_index / 4 + 1) * 8 + pawn_index % 4;
+            results[index] = kpk_propagate(results, strong_to_move,
+                                           strong_king, pawn, weak_king);
+            changed |= results[index] != KPK_UNKNOWN;
+        }
+    }
+
+    // Whatever is still unknown can't be forced to a win
+    for (int index = 0; index < KPK_SIZE; index++) {
+        if (results[index] == KPK_WIN)
+            KPK_BITBASE[index / 32] |= (uint32_t) 1 << (index % 32);
+    }
+    free(results);
+    KPK_READY = true;
+    return;
+}
+
+bool bitbase_kpk(square strong_king, square pawn, square weak_king,
+                 bool strong_to_move) {
+    dbg_requires(KPK_READY);
+    dbg_requires(1 <= pawn / 8 && pawn / 8 <= 6);
+    if (pawn % 8 > 3) {
+        strong_king ^= 7;
+        pawn ^= 7;
+        weak_king ^= 7;
+    }
+    int index = kpk_index(strong_to_move, strong_king, pawn, weak_king);
+    return KPK_BITBASE[index / 32] >> (index % 32) & 1;
+}
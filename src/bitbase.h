@@ -0,0 +1,38 @@
+/**
+ * @file bitbase.h
+ * @brief Provides an interface for endgame bitbases.
+ *
+ * A bitbase stores one bit per position of an endgame: whether the stronger
+ * side wins it. Positions are given in the stronger side's own orientation,
+ * the one it has when it is to move, so that its pawn moves up the board.
+ */
+
+#ifndef _BITBASE_H_
+#define _BITBASE_H_
+
+#include "bits.h"
+
+#include <stdbool.h>
+
+/**
+ * @brief Builds the bitbases by retrograde analysis, once before any probe
+ *
+ * Takes a few tens of milliseconds.
+ */
+void bitbase_init(void);
+
+/**
+ * @brief Whether king and pawn win against a bare king
+ *
+ * @param[in] strong_king
+ * @param[in] pawn
+ * @param[in] weak_king
+ * @param[in] strong_to_move
+ * @pre the position is legal: nothing shares a square, the kings aren't next
+ *      to each other, the side not to move isn't in check, and the pawn is
+ *      on ranks 2 to 7
+ */
+bool bitbase_kpk(square strong_king, square pawn, square weak_king,
+                 bool strong_to_move);
+
+#endif
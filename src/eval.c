@@ -0,0 +1,595 @@
+/**
+ * @file eval.c
+ * @brief Provides the implementation for evaluating positions.
+ */
+
+#include "bits.h"
+#include "position.h"
+#include "bitbase.h"
+#include "eval.h"
+#include "zobrist.h"
+
+#include "../lib/contracts.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/*
+ * Terms are worked out for each side in its own orientation: the board as it
+ * is when that side is to move, where its pawns move up from rank 1. A
+ * position's OURS pieces are already in it, THEIRS pieces are rotated into
+ * it (square 63 - s). Every table below is symmetric between the a- and
+ * h-files, so a rotation scores the same as a mirror.
+ */
+
+/** @brief Middlegame and endgame halves of a term */
+enum { MG, EG };
+
+/** @brief Material left at the start of a game, see PHASE */
+#define PHASE_MAX 24
+
+static const int MATERIAL[2][5] = {
+    { 100, 320, 330, 500, 950 },
+    { 110, 300, 320, 530, 980 }
+};
+
+/** @brief How much each piece counts towards the game still being a middlegame */
+static const int PHASE[5] = { 0, 1, 1, 2, 4 };
+
+static const int BISHOP_PAIR[2] = { 30, 50 };
+
+/** @brief Change in value of each knight and rook per pawn of its side over 5 */
+#define KNIGHT_PER_PAWN 6
+#define ROOK_PER_PAWN -12
+
+/**
+ * @brief Piece-square tables, drawn as seen from the side they are for
+ *
+ * The first row is rank 8, so a square s is looked up at s ^ 56. Kings have
+ * a table for each half of the game.
+ */
+static const int PIECE_SQUARE[5][64] = {
+    {   // PAWN
+          0,   0,   0,   0,   0,   0,   0,   0,
+         50,  50,  50,  50,  50,  50,  50,  50,
+         10,  10,  20,  30,  30,  20,  10,  10,
+          5,   5,  10,  25,  25,  10,   5,   5,
+          0,   0,   0,  20,  20,   0,   0,   0,
+          5,  -5, -10,   0,   0, -10,  -5,   5,
+          5,  10,  10, -20, -20,  10,  10,   5,
+          0,   0,   0,   0,   0,   0,   0,   0
+    },
+    {   // KNIGHT
+        -50, -40, -30, -30, -30, -30, -40, -50,
+        -40, -20,   0,   0,   0,   0, -20, -40,
+        -30,   0,  10,  15,  15,  10,   0, -30,
+        -30,   5,  15,  20,  20,  15,   5, -30,
+        -30,   0,  15,  20,  20,  15,   0, -30,
+        -30,   5,  10,  15,  15,  10,   5, -30,
+        -40, -20,   0,   5,   5,   0, -20, -40,
+        -50, -40, -30, -30, -30, -30, -40, -50
+    },
+    {   // BISHOP
+        -20, -10, -10, -10, -10, -10, -10, -20,
+        -10,   0,   0,   0,   0,   0,   0, -10,
+        -10,   0,   5,  10,  10,   5,   0, -10,
+        -10,   5,   5,  10,  10,   5,   5, -10,
+        -10,   0,  10,  10,  10,  10,   0, -10,
+        -10,  10,  10,  10,  10,  10,  10, -10,
+        -10,   5,   0,   0,   0,   0,   5, -10,
+        -20, -10, -10, -10, -10, -10, -10, -20
+    },
+    {   // ROOK
+          0,   0,   0,   0,   0,   0,   0,   0,
+          5,  10,  10,  10,  10,  10,  10,   5,
+         -5,   0,   0,   0,   0,   0,   0,  -5,
+         -5,   0,   0,   0,   0,   0,   0,  -5,
+         -5,   0,   0,   0,   0,   0,   0,  -5,
+         -5,   0,   0,   0,   0,   0,   0,  -5,
+         -5,   0,   0,   0,   0,   0,   0,  -5,
+          0,   0,   0,   5,   5,   0,   0,   0
+    },
+    {   // QUEEN
+        -20, -10, -10,  -5,  -5, -10, -10, -20,
+        -10,   0,   0,   0,   0,   0,   0, -10,
+        -10,   0,   5,   5,   5,   5,   0, -10,
+         -5,   0,   5,   5,   5,   5,   0,  -5,
+         -5,   0,   5,   5,   5,   5,   0,  -5,
+        -10,   0,   5,   5,   5,   5,   0, -10,
+        -10,   0,   0,   0,   0,   0,   0, -10,
+        -20, -10, -10,  -5,  -5, -10, -10, -20
+    }
+};
+
+static const int KING_SQUARE[2][64] = {
+    {   // MG: stay castled behind the pawns
+        -30, -40, -40, -50, -50, -40, -40, -30,
+        -30, -40, -40, -50, -50, -40, -40, -30,
+        -30, -40, -40, -50, -50, -40, -40, -30,
+        -30, -40, -40, -50, -50, -40, -40, -30,
+        -20, -30, -30, -40, -40, -30, -30, -20,
+        -10, -20, -20, -20, -20, -20, -20, -10,
+         20,  20,   0,   0,   0,   0,  20,  20,
+         20,  30,  10,   0,   0,  10,  30,  20
+    },
+    {   // EG: come to the centre
+        -50, -40, -30, -20, -20, -30, -40, -50,
+        -30, -20, -10,   0,   0, -10, -20, -30,
+        -30, -10,  20,  30,  30,  20, -10, -30,
+        -30, -10,  30,  40,  40,  30, -10, -30,
+        -30, -10,  30,  40,  40,  30, -10, -30,
+        -30, -10,  20,  30,  30,  20, -10, -30,
+        -30, -30,   0,   0,   0,   0, -30, -30,
+        -50, -30, -30, -30, -30, -30, -30, -50
+    }
+};
+
+/** @brief Pawn structure terms, passed pawns by rank */
+static const int PASSED[2][8] = {
+    { 0,  5, 10, 15, 30, 50,  80, 0 },
+    { 0, 10, 15, 25, 45, 75, 120, 0 }
+};
+static const int DOUBLED[2] = { -10, -20 };
+static const int ISOLATED[2] = { -10, -15 };
+static const int BACKWARD[2] = { -8, -10 };
+
+/** @brief Bonus for each pawn in front of a king on rank 1 or 2, by distance */
+static const int SHIELD[2] = { 12, 6 };
+
+static const bitboard FILE_A = 0x0101010101010101;
+
+/* --- PAWN STRUCTURE --- */
+
+/** @brief The pawn structure terms of one side, in its own orientation */
+typedef struct pawn_side {
+    int16_t mg;
+    int16_t eg;
+    int16_t shield[8];      // for a king on rank 1 or 2, by its file
+    bitboard passed;
+} pawn_side;
+
+typedef struct pawn_entry {
+    zhash key;
+    pawn_side sides[2];     // indexed by Color
+} pawn_entry;
+
+struct pawn_table {
+    pawn_entry *entries;
+    uint64_t mask;          // number of entries - 1
+    uint64_t probes;
+    uint64_t hits;
+};
+
+/** @brief The files on either side of file f */
+static bitboard adjacent_files(int f) {
+    return (f > 0 ? FILE_A << (f - 1) : 0) | (f < 7 ? FILE_A << (f + 1) : 0);
+}
+
+/** @brief The ranks above rank r */
+static bitboard ranks_above(int r) {
+    return r == 7 ? 0 : BITBOARD_FULL << (8 * (r + 1));
+}
+
+/** @brief Works out the terms of `ours` pawns against `theirs`, moving up */
+static void pawn_side_evaluate(pawn_side *S, bitboard ours, bitboard theirs) {
+    int mg = 0, eg = 0;
+    S->passed = BITBOARD_EMPTY;
+
+    square s;
+    bitboard bb = ours;
+    while ((s = bitboard_iter_first(&bb)) != INVALID_SQUARE) {
+        int r = s / 8, f = s % 8;
+        bitboard file = FILE_A << f;
+        bitboard neighbours = adjacent_files(f);
+
+        if (!(theirs & (file | neighbours) & ranks_above(r))) {
+            S->passed |= square_to_bitboard(s);
+            mg += PASSED[MG][r];
+            eg += PASSED[EG][r];
+        }
+        if (ours & file & ranks_above(r)) {     // counted once per extra pawn
+            mg += DOUBLED[MG];
+            eg += DOUBLED[EG];
+        }
+        if (!(ours & neighbours)) {
+            mg += ISOLATED[MG];
+            eg += ISOLATED[EG];
+        } else if (!(ours & neighbours & ~ranks_above(r)) && r < 6) {
+            // Every neighbour has gone past it, and it can't safely catch up
+            bitboard stop_attackers = neighbours & (0xFFULL << (8 * (r + 2)));
+            if (theirs & stop_attackers) {
+                mg += BACKWARD[MG];
+                eg += BACKWARD[EG];
+            }
+        }
+    }
+
+    for (int f = 0; f < 8; f++) {
+        bitboard front = (FILE_A << f) | adjacent_files(f);
+        S->shield[f] = SHIELD[0] * bitboard_count_bits(ours & front & 0xFF00)
+                     + SHIELD[1] * bitboard_count_bits(ours & front & 0xFF0000);
+    }
+    S->mg = mg;
+    S->eg = eg;
+    return;
+}
+
+/** @brief Works out the pawn structure terms of a position */
+static void pawn_entry_evaluate(pawn_entry *E, position *P) {
+    bitboard ours = P->whose[OURS] & P->pieces[PAWN] & PAWNS_MASK;
+    bitboard theirs = P->whose[THEIRS] & P->pieces[PAWN] & PAWNS_MASK;
+    E->key = P->pawn_hash;
+    pawn_side_evaluate(&E->sides[P->color], ours, theirs);
+    pawn_side_evaluate(&E->sides[!P->color], bitboard_rotate(theirs),
+                       bitboard_rotate(ours));
+    return;
+}
+
+pawn_table *pawn_table_new(size_t kilobytes) {
+    dbg_requires(kilobytes >= 1);
+    pawn_table *T = malloc(sizeof(pawn_table));
+    if (T == NULL) {
+        perror("malloc error");
+        exit(1);
+    }
+
+    uint64_t entries = 1;
+    while (entries * 2 * sizeof(pawn_entry) <= kilobytes << 10) {
+        entries *= 2;
+    }
+    T->entries = calloc(entries, sizeof(pawn_entry));
+    if (T->entries == NULL) {
+        perror("calloc error");
+        exit(1);
+    }
+    // An all-zero entry would pass for the position without pawns
+    for (uint64_t i = 0; i < entries; i++) T->entries[i].key = 1;
+    T->mask = entries - 1;
+    T->probes = 0;
+    T->hits = 0;
+
+    return T;
+}
+
+void pawn_table_free(pawn_table *T) {
+    free(T->entries);
+    free(T);
+    return;
+}
+
+uint64_t pawn_table_probes(pawn_table *T) {
+    return T->probes;
+}
+
+uint64_t pawn_table_hits(pawn_table *T) {
+    return T->hits;
+}
+
+/** @brief The pawn structure terms of a position, from T when they're there */
+static const pawn_entry *pawn_probe(pawn_table *T, position *P,
+                                    pawn_entry *scratch) {
+    if (T == NULL) {
+        pawn_entry_evaluate(scratch, P);
+        return scratch;
+    }
+
+    pawn_entry *E = &T->entries[P->pawn_hash & T->mask];
+    T->probes++;
+    if (E->key == P->pawn_hash) T->hits++;
+    else pawn_entry_evaluate(E, P);
+    return E;
+}
+
+/* --- MATERIAL --- */
+
+/** @brief Most pieces of a kind a material signature counts, by Piece */
+static const int MATERIAL_MAX[5] = { 8, 2, 2, 2, 1 };
+
+/** @brief Signatures of one side's material, and of both */
+#define MATERIAL_SIDES (9 * 3 * 3 * 3 * 2)
+#define MATERIAL_SIGNATURES (MATERIAL_SIDES * MATERIAL_SIDES)
+
+/** @brief eg scale factors are out of this */
+#define SCALE_NORMAL 64
+
+/** @brief Recognisers of specific endgames, see ENDGAMES */
+enum { ENDGAME_NONE, ENDGAME_KXK, ENDGAME_KBNK, ENDGAME_KPK };
+
+/** @brief Scalings worked out from more than material, see SCALINGS */
+enum { SCALING_NONE, SCALING_OPPOSITE_BISHOPS };
+
+/**
+ * @brief What a material signature alone says about a position
+ *
+ * Everything is from the point of view of the side whose pieces come first
+ * in the signature (OURS when looked up by material_probe).
+ */
+typedef struct material_entry {
+    int16_t mg;         // material and imbalance, ours minus theirs
+    int16_t eg;
+    uint8_t phase;      // 0 (bare kings and pawns) to PHASE_MAX
+    uint8_t scale[2];   // of eg when that side (Whose) is ahead
+    uint8_t endgame;    // ENDGAME_*
+    uint8_t strong;     // the Whose the endgame recogniser is for
+    uint8_t scaling;    // SCALING_*
+} material_entry;
+
+static material_entry MATERIAL_TABLE[MATERIAL_SIGNATURES];
+
+static bool MATERIAL_READY = false;
+
+/** @brief Index of one side's piece counts (pawn to queen) */
+static int material_side_index(const int counts[5]) {
+    int index = 0;
+    for (int p = QUEEN; p >= PAWN; p--) {
+        index = index * (MATERIAL_MAX[p] + 1) + counts[p];
+    }
+    return index;
+}
+
+/** @brief Whether a side could never mate, whatever the other side has */
+static bool material_cannot_win(const int counts[5]) {
+    return counts[PAWN] == 0 && counts[ROOK] == 0 && counts[QUEEN] == 0 &&
+           counts[KNIGHT] + counts[BISHOP] <= 1;
+}
+
+/** @brief Whether a side has no pieces but its king */
+static bool material_is_bare(const int counts[5]) {
+    for (int p = PAWN; p <= QUEEN; p++) {
+        if (counts[p] > 0) return false;
+    }
+    return true;
+}
+
+/** @brief Material, imbalance and phase terms of one side */
+static void material_side_evaluate(const int counts[5], int *mg, int *eg, 
+                                   int *phase) {
+    *mg = 0;
+    *eg = 0;
+    for (int p = PAWN; p <= QUEEN; p++) {
+        *mg += counts[p] * MATERIAL[MG][p];
+        *eg += counts[p] * MATERIAL[EG][p];
+        *phase += counts[p] * PHASE[p];
+    }
+    if (counts[BISHOP] >= 2) {
+        *mg += BISHOP_PAIR[MG];
+        *eg += BISHOP_PAIR[EG];
+    }
+    // Knights gain and rooks lose value with the pawns left on the board
+    int pawns_over_five = counts[PAWN] - 5;
+    *mg += pawns_over_five * (counts[KNIGHT] * KNIGHT_PER_PAWN 
+                              + counts[ROOK] * ROOK_PER_PAWN);
+    *eg += pawns_over_five * (counts[KNIGHT] * KNIGHT_PER_PAWN 
+                              + counts[ROOK] * ROOK_PER_PAWN);
+    return;
+}
+
+/** @brief Works out the entry of a material signature */
+static void material_entry_evaluate(material_entry *E, const int counts[2][5]) {
+    int mg[2], eg[2], phase = 0;
+    for (Whose w = OURS; w <= THEIRS; w++) {
+        material_side_evaluate(counts[w], &mg[w], &eg[w], &phase);
+    }
+    E->mg = mg[OURS] - mg[THEIRS];
+    E->eg = eg[OURS] - eg[THEIRS];
+    E->phase = phase < PHASE_MAX ? phase : PHASE_MAX;
+    E->endgame = ENDGAME_NONE;
+    E->strong = OURS;
+    E->scaling = SCALING_NONE;
+
+    for (Whose w = OURS; w <= THEIRS; w++) {
+        const int *strong = counts[w], *weak = counts[!w];
+        E->scale[w] = material_cannot_win(strong) ? 0 : SCALE_NORMAL;
+        if (!material_is_bare(weak)) continue;
+
+        if (strong[ROOK] + strong[QUEEN] > 0) {
+            E->endgame = ENDGAME_KXK;
+            E->strong = w;
+        } else if (strong[PAWN] == 0 && strong[ROOK] == 0 && 
+                   strong[QUEEN] == 0 && strong[KNIGHT] == 1 && 
+                   strong[BISHOP] == 1) {
+            E->endgame = ENDGAME_KBNK;
+            E->strong = w;
+        } else if (strong[PAWN] == 1 && strong[KNIGHT] == 0 && 
+                   strong[BISHOP] == 0 && strong[ROOK] == 0 && 
+                   strong[QUEEN] == 0) {
+            E->endgame = ENDGAME_KPK;
+            E->strong = w;
+        }
+    }
+
+    // A bishop and pawns each: drawish when the bishops are on opposite colors
+    bool only_bishops = true;
+    for (Whose w = OURS; w <= THEIRS; w++) {
+        only_bishops &= counts[w][BISHOP] == 1 && counts[w][KNIGHT] == 0 &&
+                        counts[w][ROOK] == 0 && counts[w][QUEEN] == 0;
+    }
+    if (only_bishops) E->scaling = SCALING_OPPOSITE_BISHOPS;
+    return;
+}
+
+void eval_init(void) {
+    bitbase_init();
+    int counts[2][5];
+    for (int ours = 0; ours < MATERIAL_SIDES; ours++) {
+        int index = ours;
+        for (int p = PAWN; p <= QUEEN; p++) {
+            counts[OURS][p] = index % (MATERIAL_MAX[p] + 1);
+            index /= MATERIAL_MAX[p] + 1;
+        }
+        for (int theirs = 0; theirs < MATERIAL_SIDES; theirs++) {
+            index = theirs;
+            for (int p = PAWN; p <= QUEEN; p++) {
+                counts[THEIRS][p] = index % (MATERIAL_MAX[p] + 1);
+                index /= MATERIAL_MAX[p] + 1;
+            }
+            material_entry_evaluate(
+                &MATERIAL_TABLE[ours * MATERIAL_SIDES + theirs], counts);
+        }
+    }
+    MATERIAL_READY = true;
+    return;
+}
+
+/** 
+ * @brief The entry of a position's material signature
+ * 
+ * Signatures with more pieces than a table index counts (three knights, two
+ * queens, ...) come from promotions and are rare enough to work out each time.
+ */
+static const material_entry *material_probe(position *P, 
+                                            material_entry *scratch) {
+    int counts[2][5];
+    bool in_table = true;
+    for (Whose w = OURS; w <= THEIRS; w++) {
+        for (Piece p = PAWN; p <= QUEEN; p++) {
+            bitboard bb = P->whose[w] & P->pieces[p];
+            if (p == PAWN) bb &= PAWNS_MASK;
+            counts[w][p] = bitboard_count_bits(bb);
+            in_table &= counts[w][p] <= MATERIAL_MAX[p];
+        }
+    }
+    if (!in_table) {
+        material_entry_evaluate(scratch, counts);
+        return scratch;
+    }
+    return &MATERIAL_TABLE[material_side_index(counts[OURS]) * MATERIAL_SIDES 
+                           + material_side_index(counts[THEIRS])];
+}
+
+/* --- ENDGAMES --- */
+
+/** @brief A square of `whose` seen in that side's own orientation */
+static square own_square(Whose whose, square s) {
+    return whose == OURS ? s : 63 - s;
+}
+
+/** @brief Number of king moves between two squares */
+static int square_distance(square a, square b) {
+    int ranks = abs(a / 8 - b / 8), files = abs(a % 8 - b % 8);
+    return ranks > files ? ranks : files;
+}
+
+/** @brief Number of king moves from a square to the nearest edge */
+static int edge_distance(square s) {
+    int r = s / 8, f = s % 8;
+    int ranks = r < 7 - r ? r : 7 - r, files = f < 7 - f ? f : 7 - f;
+    return ranks < files ? ranks : files;
+}
+
+/** @brief Flips a score of `strong` to the side to move's point of view */
+static int endgame_score(Whose strong, int score) {
+    return strong == OURS ? score : -score;
+}
+
+/** @brief Mating material against a bare king: drive it to the edge */
+static bool endgame_kxk(position *P, Whose strong, int *score) {
+    square winner = P->king[strong], loser = P->king[!strong];
+    int material = 0;
+    for (Piece p = PAWN; p <= QUEEN; p++) {
+        bitboard bb = P->whose[strong] & P->pieces[p];
+        if (p == PAWN) bb &= PAWNS_MASK;
+        material += bitboard_count_bits(bb) * MATERIAL[EG][p];
+    }
+    *score = endgame_score(strong, VALUE_KNOWN_WIN + material
+                                   - 20 * edge_distance(loser)
+                                   - 10 * square_distance(winner, loser));
+    return true;
+}
+
+/** 
+ * @brief Bishop and knight against a bare king: drive it to a corner the 
+ * bishop can cover
+ */
+static bool endgame_kbnk(position *P, Whose strong, int *score) {
+    square winner = P->king[strong], loser = P->king[!strong];
+    square bishop = bitboard_bsf(P->whose[strong] & P->pieces[BISHOP]);
+    // Squares of one color stay one color when the board is rotated
+    bool dark = (bishop / 8 + bishop % 8) % 2 == 0;
+    int corner = dark ? square_distance(loser, 0) < square_distance(loser, 63)
+                        ? square_distance(loser, 0) : square_distance(loser, 63)
+                      : square_distance(loser, 7) < square_distance(loser, 56)
+                        ? square_distance(loser, 7) : square_distance(loser, 56);
+    *score = endgame_score(strong, VALUE_KNOWN_WIN 
+                                   - 20 * corner 
+                                   - 10 * square_distance(winner, loser));
+    return true;
+}
+
+/**
+ * @brief King and pawn against king: looked up in the bitbase, which knows
+ * every position exactly, so draws are scored as such
+ */
+static bool endgame_kpk(position *P, Whose strong, int *score) {
+    square pawn = own_square(strong, 
+        bitboard_bsf(P->whose[strong] & P->pieces[PAWN] & PAWNS_MASK));
+    square winner = own_square(strong, P->king[strong]);
+    square loser = own_square(strong, P->king[!strong]);
+    if (!bitbase_kpk(winner, pawn, loser, strong == OURS)) {
+        *score = 0;
+        return true;
+    }
+    *score = endgame_score(strong, VALUE_KNOWN_WIN + MATERIAL[EG][PAWN] 
+                                   + 10 * (pawn / 8));
+    return true;
+}
+
+static bool (*const ENDGAMES[4])(position *, Whose, int *) = {
+    NULL, endgame_kxk, endgame_kbnk, endgame_kpk
+};
+
+/** @brief Scale of eg with one bishop each, by the colors of the bishops */
+static int scaling_opposite_bishops(position *P, int scale) {
+    square ours = bitboard_bsf(P->whose[OURS] & P->pieces[BISHOP]);
+    square theirs = bitboard_bsf(P->whose[THEIRS] & P->pieces[BISHOP]);
+    bool opposite = (ours / 8 + ours % 8 + theirs / 8 + theirs % 8) % 2 == 1;
+    return opposite ? scale * 3 / 8 : scale;
+}
+
+static int (*const SCALINGS[2])(position *, int) = {
+    NULL, scaling_opposite_bishops
+};
+
+/* --- EVALUATION --- */
+
+int evaluate(position *P, pawn_table *T) {
+    dbg_requires(P != NULL && MATERIAL_READY);
+    material_entry material;
+    const material_entry *M = material_probe(P, &material);
+    int score;
+    if (M->endgame != ENDGAME_NONE && 
+        ENDGAMES[M->endgame](P, M->strong, &score)) return score;
+
+    int mg = M->mg, eg = M->eg;
+    for (Whose w = OURS; w <= THEIRS; w++) {
+        int sign = w == OURS ? 1 : -1;
+        square s;
+        for (Piece p = PAWN; p <= QUEEN; p++) {
+            bitboard bb = P->whose[w] & P->pieces[p];
+            if (p == PAWN) bb &= PAWNS_MASK;
+            while ((s = bitboard_iter_first(&bb)) != INVALID_SQUARE) {
+                int bonus = PIECE_SQUARE[p][own_square(w, s) ^ 56];
+                mg += sign * bonus;
+                eg += sign * bonus;
+            }
+        }
+    }
+
+    pawn_entry pawns;
+    const pawn_entry *E = pawn_probe(T, P, &pawns);
+    for (Whose w = OURS; w <= THEIRS; w++) {
+        int sign = w == OURS ? 1 : -1;
+        const pawn_side *S = &E->sides[w == OURS ? P->color : !P->color];
+        square king = own_square(w, P->king[w]);
+        mg += sign * (S->mg + KING_SQUARE[MG][king ^ 56]);
+        eg += sign * (S->eg + KING_SQUARE[EG][king ^ 56]);
+        if (king < 16) mg += sign * S->shield[king % 8];
+    }
+
+    int scale = M->scale[eg >= 0 ? OURS : THEIRS];
+    if (M->scaling != SCALING_NONE) scale = SCALINGS[M->scaling](P, scale);
+    eg = eg * scale / SCALE_NORMAL;
+
+    return (mg * M->phase + eg * (PHASE_MAX - M->phase)) / PHASE_MAX;
+}
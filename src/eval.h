@@ -0,0 +1,66 @@
+/**
+ * @file eval.h
+ * @brief Provides an interface for evaluating positions.
+ *
+ * Scores are in centipawns, from the point of view of the side to move, and
+ * taper between middlegame and endgame weights with the material left.
+ */
+
+#ifndef _EVAL_H_
+#define _EVAL_H_
+
+#include "position.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/** @brief Score of a won endgame before its progress terms, below any mate */
+#define VALUE_KNOWN_WIN 10000
+
+/**
+ * @brief A cache of pawn structure terms, keyed by P->pawn_hash
+ *
+ * Pawn structure changes on few moves, so nearly every node finds its terms
+ * here. Tables are not shared: each search thread owns one.
+ */
+typedef struct pawn_table pawn_table;
+
+/**
+ * @brief Allocates an empty pawn table
+ *
+ * @param[in] kilobytes (rounded down to a power of two number of entries)
+ * @pre kilobytes >= 1
+ */
+pawn_table *pawn_table_new(size_t kilobytes);
+
+/** @brief Frees a pawn table */
+void pawn_table_free(pawn_table *T);
+
+/** @brief Lookups made in a table, and how many of them found the terms */
+uint64_t pawn_table_probes(pawn_table *T);
+uint64_t pawn_table_hits(pawn_table *T);
+
+/**
+ * @brief Builds the material signature table, once before any evaluate
+ *
+ * Every signature of up to 8 pawns, 2 knights, 2 bishops, 2 rooks and a
+ * queen a side has its material, imbalance and game phase worked out, and a
+ * recogniser for endgames with known outcomes (K+mating material vs K, KBNK,
+ * KPK) or a scaling of the endgame terms (no mating material, bishops of
+ * opposite colors). Builds the bitbases the recognisers look up too.
+ */
+void eval_init(void);
+
+/**
+ * @brief Statically evaluates a position
+ *
+ * Known endgames are scored by their recogniser without the generic terms.
+ *
+ * @param[in] P
+ * @param[in] T pawn table of the calling thread, or NULL to work the pawn
+ *              structure out from scratch
+ * @pre P != NULL
+ */
+int evaluate(position *P, pawn_table *T);
+
+#endif
@@ -0,0 +1,17 @@
+/**
+ * @file main.c
+ * @brief The monke engine, speaking UCI on stdin and stdout.
+ */
+
+#include "eval.h"
+#include "moves.h"
+#include "uci.h"
+
+#include <stdio.h>
+
+int main(void) {
+    moves_init();
+    eval_init();
+    uci_loop(stdin, stdout);
+    return 0;
+}
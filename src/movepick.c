@@ -0,0 +1,235 @@
+/**
+ * @file movepick.c
+ * @brief Provides the implementation for picking moves in the order to
+ * search them.
+ */
+
+#include "movepick.h"
+#include "moves.h"
+#include "position.h"
+
+#include "../lib/contracts.h"
+
+#include <stdbool.h>
+#include <stdlib.h>
+
+/** @brief Evasions that capture go before any quiet one */
+#define EVASION_CAPTURE_BONUS (1 << 20)
+
+static bool move_equal(move a, move b) {
+    return a.piece == b.piece && a.from == b.from && a.to == b.to &&
+           a.flags == b.flags;
+}
+
+static bool move_is_quiet(move m) {
+    return !(m.flags & (M_FLAG_CAPTURE | M_FLAG_PROMOTION[KNIGHT]));
+}
+
+/* --- SCORING --- */
+
+/**
+ * @brief Most valuable victim first, then least valuable attacker; queen
+ * promotions count as taking a queen
+ */
+static int mvv_lva(position *P, move m) {
+    Piece victim = move_captured(P, m);
+    int score = (victim == KING ? 0 : 8 * SEE_VALUE[victim]) - m.piece;
+    if ((m.flags & M_FLAG_PROMOTION[KNIGHT]) && (m.flags & 3) == 3)
+        score += 8 * SEE_VALUE[QUEEN];
+    return score;
+}
+
+static void score_captures(move_picker *MP) {
+    for (int i = 0; i < MP->moves.size; i++)
+        MP->scores[i] = mvv_lva(MP->P, MP->moves.array[i]);
+    return;
+}
+
+static void score_quiets(move_picker *MP) {
+    for (int i = 0; i < MP->moves.size; i++) {
+        move m = MP->moves.array[i];
+        MP->scores[i] = (*MP->history)[m.from][m.to];
+    }
+    return;
+}
+
+static void score_evasions(move_picker *MP) {
+    for (int i = 0; i < MP->moves.size; i++) {
+        move m = MP->moves.array[i];
+        MP->scores[i] = move_is_quiet(m)
+                      ? (*MP->history)[m.from][m.to]
+                      : EVASION_CAPTURE_BONUS + mvv_lva(MP->P, m);
+    }
+    return;
+}
+
+/**
+ * @brief The best scored move left in the stage, by a selection sort step
+ *
+ * Only as much of the list gets sorted as gets searched.
+ */
+static move pick_best(move_picker *MP) {
+    movelist *M = &MP->moves;
+    int i = MP->index, best = i;
+    for (int j = i + 1; j < M->size; j++) {
+        if (MP->scores[j] > MP->scores[best]) best = j;
+    }
+    move m = M->array[best];
+    M->array[best] = M->array[i];
+    MP->scores[best] = MP->scores[i];
+    M->array[i] = m;
+    MP->index++;
+    return m;
+}
+
+/* --- PICKING --- */
+
+void move_picker_init(move_picker *MP, position *P, move hash_move,
+                      const move killers[2], move counter,
+                      const history_table *history) {
+    dbg_requires(MP != NULL && P != NULL);
+    dbg_requires(killers != NULL && history != NULL);
+    MP->P = P;
+    MP->hash_move = hash_move;
+    MP->refutations[0] = killers[0];
+    MP->refutations[1] = killers[1];
+    MP->refutations[2] = counter;
+    MP->history = history;
+    MP->stage = king_in_check(P, OURS) ? PICK_EVASIONS_HASH : PICK_HASH;
+    return;
+}
+
+void move_picker_init_quiescence(move_picker *MP, position *P, move hash_move,
+                                 const history_table *history) {
+    dbg_requires(MP != NULL && P != NULL && history != NULL);
+    MP->P = P;
+    MP->hash_move = hash_move;
+    MP->refutations[0] = MP->refutations[1] = MP->refutations[2] = NULL_MOVE;
+    MP->history = history;
+    MP->stage = king_in_check(P, OURS) ? PICK_EVASIONS_HASH
+                                       : PICK_QUIESCENCE_HASH;
+    return;
+}
+
+/** @brief Whether a refutation is a move to try, and not tried already */
+static bool refutation_is_new(move_picker *MP, int i) {
+    move m = MP->refutations[i];
+    if (m.from == m.to || !move_is_quiet(m) || move_equal(m, MP->hash_move))
+        return false;
+    for (int j = 0; j < i; j++) {
+        if (move_equal(m, MP->refutations[j])) return false;
+    }
+    return move_is_valid(MP->P, m);
+}
+
+/** @brief Whether a generated move was picked in an earlier stage */
+static bool picked_before(move_picker *MP, move m) {
+    if (move_equal(m, MP->hash_move)) return true;
+    if (MP->stage != PICK_QUIETS) return false;
+    for (int i = 0; i < 3; i++) {
+        if (move_equal(m, MP->refutations[i])) return true;
+    }
+    return false;
+}
+
+move move_picker_next(move_picker *MP) {
+    dbg_requires(MP != NULL);
+    move m;
+    while (true) {
+        switch (MP->stage) {
+        case PICK_HASH:
+        case PICK_EVASIONS_HASH:
+        case PICK_QUIESCENCE_HASH:
+            MP->stage++;
+            m = MP->hash_move;
+            if (MP->stage == PICK_QUIESCENCE_INIT && move_is_quiet(m)) break;
+            if (m.from != m.to && move_is_valid(MP->P, m)) return m;
+            MP->hash_move = NULL_MOVE;
+            break;
+
+        case PICK_CAPTURES_INIT:
+        case PICK_QUIESCENCE_INIT:
+            movelist_clear(&MP->moves);
+            generate_captures(&MP->moves, MP->P);
+            score_captures(MP);
+            MP->index = 0;
+            movelist_clear(&MP->bad_captures);
+            MP->bad_index = 0;
+            MP->stage++;
+            break;
+
+        case PICK_GOOD_CAPTURES:
+            while (MP->index < MP->moves.size) {
+                m = pick_best(MP);
+                if (picked_before(MP, m)) continue;
+                // Losing captures wait until the quiets have been tried
+                if (!see_ge(MP->P, m, 0)) {
+                    MP->bad_captures.array[MP->bad_captures.size++] = m;
+                    continue;
+                }
+                return m;
+            }
+            MP->stage++;
+            break;
+
+        case PICK_KILLER_1:
+        case PICK_KILLER_2:
+        case PICK_COUNTER: {
+            int i = MP->stage - PICK_KILLER_1;
+            MP->stage++;
+            if (refutation_is_new(MP, i)) return MP->refutations[i];
+            MP->refutations[i] = NULL_MOVE;
+            break;
+        }
+
+        case PICK_QUIETS_INIT:
+            movelist_clear(&MP->moves);
+            generate_quiets(&MP->moves, MP->P);
+            score_quiets(MP);
+            MP->index = 0;
+            MP->stage++;
+            break;
+
+        case PICK_QUIETS:
+            while (MP->index < MP->moves.size) {
+                m = pick_best(MP);
+                if (!picked_before(MP, m)) return m;
+            }
+            MP->stage++;
+            break;
+
+        case PICK_BAD_CAPTURES:
+            if (MP->bad_index < MP->bad_captures.size)
+                return MP->bad_captures.array[MP->bad_index++];
+            MP->stage = PICK_DONE;
+            break;
+
+        case PICK_EVASIONS_INIT:
+            movelist_clear(&MP->moves);
+            generate_moves(&MP->moves, MP->P);
+            score_evasions(MP);
+            MP->index = 0;
+            MP->stage++;
+            break;
+
+        case PICK_EVASIONS:
+        case PICK_QUIESCENCE:
+            while (MP->index < MP->moves.size) {
+                m = pick_best(MP);
+                if (!picked_before(MP, m)) return m;
+            }
+            MP->stage = PICK_DONE;
+            break;
+
+        case PICK_DONE:
+            return NULL_MOVE;
+        }
+    }
+}
+
+void history_update(int16_t *h, int bonus) {
+    dbg_requires(-HISTORY_MAX <= bonus && bonus <= HISTORY_MAX);
+    // The further from zero, the less a bonus away from it counts
+    *h += bonus - *h * abs(bonus) / HISTORY_MAX;
+    return;
+}
@@ -0,0 +1,117 @@
+/**
+ * @file movepick.h
+ * @brief Provides an interface for picking moves in the order to search them.
+ *
+ * A move picker hands out the moves of a position one at a time, in stages:
+ *
+ *     1. the hash move, checked with move_is_valid, nothing generated
+ *     2. captures and promotions that don't lose material (SEE), by most
+ *        valuable victim and least valuable attacker
+ *     3. the killer moves and the counter move, checked like the hash move
+ *     4. the other quiet moves, by history
+ *     5. the captures that lose material
+ *
+ * Each stage generates its moves only when the one before runs out, so a
+ * beta cutoff on the hash move or a capture never generates the quiets. In
+ * check, every evasion is generated at once instead. Quiescence pickers
+ * stop after the captures.
+ *
+ *     move_picker MP;
+ *     move_picker_init(&MP, P, hash_move, killers, counter, history);
+ *     while (true) {
+ *         move m = move_picker_next(&MP);
+ *         if (m.from == m.to) break;      // NULL_MOVE
+ *         ...
+ *     }
+ */
+
+#ifndef _MOVEPICK_H_
+#define _MOVEPICK_H_
+
+#include "moves.h"
+#include "position.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/** @brief Bound on history scores, which saturate towards it */
+#define HISTORY_MAX 16384
+
+/** @brief History of the side to move, by from and to square (OURS) */
+typedef int16_t history_table[64][64];
+
+typedef enum PickStage {
+    PICK_HASH,
+    PICK_CAPTURES_INIT,
+    PICK_GOOD_CAPTURES,
+    PICK_KILLER_1,
+    PICK_KILLER_2,
+    PICK_COUNTER,
+    PICK_QUIETS_INIT,
+    PICK_QUIETS,
+    PICK_BAD_CAPTURES,
+    PICK_EVASIONS_HASH,
+    PICK_EVASIONS_INIT,
+    PICK_EVASIONS,
+    PICK_QUIESCENCE_HASH,
+    PICK_QUIESCENCE_INIT,
+    PICK_QUIESCENCE,
+    PICK_DONE
+} PickStage;
+
+/** @brief A position's moves being picked, kept by the caller (e.g. a ply) */
+typedef struct move_picker {
+    position *P;
+    PickStage stage;
+    move hash_move;
+    move refutations[3];        // killers, then the counter move
+    const history_table *history;
+
+    movelist moves;             // of the stage being picked from
+    int scores[MAX_MOVES];
+    int index;
+    movelist bad_captures;
+    int bad_index;
+} move_picker;
+
+/**
+ * @brief Starts picking the moves of a position
+ *
+ * @param[out] MP
+ * @param[in] P (not changed between calls to move_picker_next)
+ * @param[in] hash_move (or NULL_MOVE)
+ * @param[in] killers two quiet moves that caused cutoffs at this ply
+ * @param[in] counter the quiet move that refuted the last move (or NULL_MOVE)
+ * @param[in] history of the side to move
+ * @pre MP != NULL && P != NULL && killers != NULL && history != NULL
+ */
+void move_picker_init(move_picker *MP, position *P, move hash_move,
+                      const move killers[2], move counter,
+                      const history_table *history);
+
+/**
+ * @brief Starts picking the captures and promotions of a position, or every
+ * evasion in check
+ *
+ * @pre MP != NULL && P != NULL && history != NULL
+ */
+void move_picker_init_quiescence(move_picker *MP, position *P, move hash_move,
+                                 const history_table *history);
+
+/**
+ * @brief The next legal move to search
+ *
+ * @return NULL_MOVE once every move was picked
+ */
+move move_picker_next(move_picker *MP);
+
+/**
+ * @brief Moves a history score towards the bonus, saturating at HISTORY_MAX
+ *
+ * @param[in] h
+ * @param[in] bonus (negative for a malus)
+ * @pre -HISTORY_MAX <= bonus <= HISTORY_MAX
+ */
+void history_update(int16_t *h, int bonus);
+
+#endif
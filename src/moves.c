@@ -6,6 +6,7 @@
 #include "bits.h"
 #include "position.h"
 #include "moves.h"
+#include "zobrist.h"
 
 #include "../lib/contracts.h"
 
@@ -13,6 +14,13 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#ifdef USE_PEXT
+#if !defined(__x86_64__) || !defined(__BMI2__)
+#error "USE_PEXT requires an x86-64 target and -mbmi2"
+#endif
+#include <immintrin.h>
+#endif
+
 /** @brief Labels for directions on a chess board */
 typedef enum {
     NORTH,
@@ -35,8 +43,20 @@ const uint8_t M_FLAG_EN_PASSANT = 0x05; // Includes M_FLAG_CAPTURE
 const uint8_t M_FLAG_IS_PROMOTION = 0x08;
 const uint8_t M_FLAG_PROMOTION[5] = { 0x00, 0x08, 0x09, 0x0A, 0x0B };
 
-/** @brief Masks for the important squares regarding castling */
-static const bitboard CASTLING_MASK[2] = { 0x60, 0x0C };
+/** 
+ * @brief Squares between the king and rook that must be empty for castling
+ * 
+ * Indexed by color and castling side, in rotated (OURS-relative) coordinates
+ */
+static const bitboard CASTLING_EMPTY_MASK[2][2] = { { 0x60, 0x0E }, 
+                                                    { 0x06, 0x70 } };
+
+/** @brief Squares the king starts on and crosses, which can't be attacked */
+static const bitboard CASTLING_SAFE_MASK[2][2] = { { 0x70, 0x1C }, 
+                                                   { 0x0E, 0x38 } };
+
+/** @brief Corners of THEIR rooks, capturing one removes their castling right */
+static const square THEIR_ROOK_CORNERS[2][2] = { { H8, A8 }, { h1, a1 } };
 
 /** 
  * @brief Maps for rays in specific directions from specific squares 
@@ -291,12 +311,17 @@ static const bitboard KING_ATTACKS[64] = {
     0x40c0000000000000
 };
 
-/** @brief Maps for the squares that a pawn attacks from a given square */
+/** 
+ * @brief Maps for the squares that a pawn attacks from a given square
+ * 
+ * Back rank entries are filled in too, so PAWN_ATTACKS[OURS][s] also gives
+ * the squares THEIR pawns attack s from, wherever s is.
+ */
 static const bitboard PAWN_ATTACKS[2][64] = {
     {
-        0x0000000000000000, 0x0000000000000000, 0x0000000000000000,
-        0x0000000000000000, 0x0000000000000000, 0x0000000000000000,
-        0x0000000000000000, 0x0000000000000000, 0x0000000000020000,
+        0x0000000000000200, 0x0000000000000500, 0x0000000000000a00,
+        0x0000000000001400, 0x0000000000002800, 0x0000000000005000,
+        0x000000000000a000, 0x0000000000004000, 0x0000000000020000,
         0x0000000000050000, 0x00000000000a0000, 0x0000000000140000,
         0x0000000000280000, 0x0000000000500000, 0x0000000000a00000,
         0x0000000000400000, 0x0000000002000000, 0x0000000005000000,
@@ -336,10 +361,10 @@ static const bitboard PAWN_ATTACKS[2][64] = {
         0x0000005000000000, 0x000000a000000000, 0x0000004000000000,
         0x0000020000000000, 0x0000050000000000, 0x00000a0000000000,
         0x0000140000000000, 0x0000280000000000, 0x0000500000000000,
-        0x0000a00000000000, 0x0000400000000000, 0x0000000000000000,
-        0x0000000000000000, 0x0000000000000000, 0x0000000000000000,
-        0x0000000000000000, 0x0000000000000000, 0x0000000000000000,
-        0x0000000000000000
+        0x0000a00000000000, 0x0000400000000000, 0x0002000000000000,
+        0x0005000000000000, 0x000a000000000000, 0x0014000000000000,
+        0x0028000000000000, 0x0050000000000000, 0x00a0000000000000,
+        0x0040000000000000
     }
 };
 
@@ -369,6 +394,94 @@ static const bitboard PAWN_MOVES[64] = {
     0x0000000000000000
 };
 
+/**
+ * @brief Magic multipliers for indexing the sliding attack tables
+ *
+ * Generated by scripts/sliding-movegen.py. Multiplying the relevant occupancy
+ * of a square by its magic maps every occupancy to a unique index (or to an
+ * index shared with an occupancy that yields the same attacks).
+ */
+static const bitboard BISHOP_MAGICS[64] = {
+    0x4140421084010140, 0x0020821081011004, 0x22900501d1128046,
+    0x1208084100200406, 0x04011041800a0000, 0x0032080208180000,
+    0x01020090080a0420, 0x4000154804042040, 0x0420400244440091,
+    0x0204101002004051, 0x2b000800a1020044, 0x0000880861040400,
+    0x0000011041606002, 0x0082082838080442, 0x0040140088041020,
+    0x0010020602014498, 0x1426441084080820, 0x0010002001220080,
+    0x1402004044004080, 0x008080c802084000, 0x00c2000402a20280,
+    0x2006402608200422, 0x40040404a6011002, 0xc082210884980804,
+    0x0420200404091208, 0x1010284e24080080, 0x8804100002082142,
+    0x1004010020200880, 0x000100108d004008, 0x8000920005012081,
+    0x04010521144c1000, 0xa016052040809800, 0x0004300400410494,
+    0x00040108002022c0, 0x8101024121080800, 0x400b020080480080,
+    0x0040004100081100, 0x8201010200040a00, 0x4004808200140100,
+    0x0801020082002420, 0x0211100804202000, 0x40004208c4006000,
+    0x0002001048020420, 0x0010802011021808, 0x0800020202008410,
+    0x411010300c409020, 0x082008010050c108, 0x060208a122000301,
+    0x4202080208041000, 0x4800290808041000, 0xa800004208040422,
+    0x0000200020880040, 0xe090001202020a00, 0x000010602101080c,
+    0x4808b04448044000, 0x00901220c1020880, 0x4011018804210c80,
+    0x001c01040201050a, 0x180800004044106c, 0x202e001001048800,
+    0x0048080071020220, 0x0800608590041840, 0x0000089004008400,
+    0xa004300a00640080
+};
+
+static const bitboard ROOK_MAGICS[64] = {
+    0xa080002d10400080, 0x054000c090002000, 0x2100090014200040,
+    0x2b00050048100020, 0x0480080042800400, 0x2200020048350410,
+    0x2100440081000200, 0x01800850a0800100, 0x0000801020804000,
+    0x0800401000200045, 0x0080802000100081, 0x0000808008001000,
+    0x0d20800400800800, 0x4080808004000200, 0x8004000108021004,
+    0x1822000120440082, 0x6000648000834001, 0x0800404000201000,
+    0x1882410020001902, 0x0000808010000800, 0x0800050010080100,
+    0x2409010004000802, 0x0142030100020004, 0x40a0020010842041,
+    0x4020802080004018, 0x80005004c0012002, 0x0210208a00120040,
+    0x0210100080080084, 0x0405000500100800, 0x1049006900040022,
+    0x108010040011a208, 0x6000440600014081, 0x0042344000800280,
+    0x8c00884008802004, 0x0040801004802000, 0x0300200901001003,
+    0x8004800800800401, 0x0101000401000802, 0x20a0a21004000108,
+    0x084403804200290c, 0x0c32812940008000, 0x0420008040010100,
+    0x0000200100110040, 0x080820100101000c, 0x0228010108110004,
+    0x0068020004008080, 0x1008025081040028, 0x002600904c020009,
+    0x00a0800040002080, 0x0510902000400080, 0x0500801002200480,
+    0x0010000800908280, 0x0020040008008080, 0x0409000400180300,
+    0x0000800100020080, 0x0044014411238200, 0x0011001020800049,
+    0x00828022d2c00501, 0x800260010508c011, 0x0000081000200501,
+    0x02820104a0081002, 0x06c100080e040003, 0x0082881006a5020c,
+    0x0084010400804022
+};
+
+/** @brief Everything needed to look up a slider's attacks from one square */
+typedef struct magic {
+    bitboard mask;      // relevant occupancy (board edges excluded)
+    bitboard magic;
+    bitboard *attacks;  // this square's slice of SLIDING_ATTACKS
+#ifdef USE_PEXT
+    bitboard *pext_attacks; // this square's slice of PEXT_ATTACKS
+#endif
+    uint8_t shift;      // 64 - popcount(mask)
+} magic;
+
+static magic BISHOP_MAGIC_ENTRIES[64];
+static magic ROOK_MAGIC_ENTRIES[64];
+
+/** @brief Shared attack table: 5248 bishop entries followed by 102400 rook entries */
+static bitboard SLIDING_ATTACKS[5248 + 102400];
+
+#ifdef USE_PEXT
+/** @brief Same layout as SLIDING_ATTACKS, but indexed by pext(occupancy, mask) */
+static bitboard PEXT_ATTACKS[5248 + 102400];
+#endif
+
+/** 
+ * @brief Squares strictly between two squares on a shared line, else empty
+ * 
+ * e.g. BETWEEN[E1][E4] == e2 | e3
+ */
+static bitboard BETWEEN[64][64];
+
+/** @brief The whole board-spanning line through two squares, else empty */
+static bitboard LINE[64][64];
 
 /*
  * ---------------------------------------------------------------------------
@@ -381,65 +494,137 @@ static bool move_is_null(move m) {
     return m.piece == 0 && m.from == 0 && m.to == 0 && m.flags == 0;
 }
 
-position move_make(position *P, move m) {
-    position prev_P = *P;
-    bitboard from_bb = square_to_bitboard(m.from);
-    bitboard to_bb = square_to_bitboard(m.to);
-    bitboard move_bb = from_bb | to_bb;;
-
-    // All moves reset the en_passant flags
-    position_reset_en_passant(P);
+/** @brief King squares before and after castling, indexed by color (rotated) */
+static const square CASTLING_KING_FROM[2] = { E1, e8 };
+static const square CASTLING_KING_TO[2][2] = { { G1, C1 }, { g8, c8 } };
+
+/** @brief Hash keys of the king and rook moves of castling, by color and side */
+static zhash move_castling_hash(Color color, Castling castling) {
+    static const square ROOK_FROM[2][2] = { { H1, A1 }, { h8, a8 } };
+    static const square ROOK_TO[2][2] = { { F1, D1 }, { f8, d8 } };
+    return PIECE_PRN[color][KING][hash_square(color, CASTLING_KING_FROM[color])] ^
+           PIECE_PRN[color][KING][hash_square(color, CASTLING_KING_TO[color][castling])] ^
+           PIECE_PRN[color][ROOK][hash_square(color, ROOK_FROM[color][castling])] ^
+           PIECE_PRN[color][ROOK][hash_square(color, ROOK_TO[color][castling])];
+}
 
-    // Castling
-    if (m.flags == M_FLAG_CASTLING[KINGSIDE]) {
+/** @brief Toggles the rook and the king's occupancy for castling (self-inverse) */
+static void move_toggle_castling(position *P, Castling castling) {
+    if (castling == KINGSIDE) {
         if (P->color == WHITE) {
-            P->king[OURS] += 2;
             P->pieces[ROOK] ^= square_to_bitboard(F1) | square_to_bitboard(H1);
             P->whose[OURS] ^= square_to_bitboard(E1) | square_to_bitboard(F1) |
                               square_to_bitboard(G1) | square_to_bitboard(H1);
         } else { // P.color == BLACK
-            P->king[OURS] -= 2;
             P->pieces[ROOK] ^= square_to_bitboard(f8) | square_to_bitboard(h8);
             P->whose[OURS] ^= square_to_bitboard(e8) | square_to_bitboard(f8) |
                               square_to_bitboard(g8) | square_to_bitboard(h8);
         }
-        position_set_castling(P, OURS, KINGSIDE, false);
-        return prev_P;
-    } else if (m.flags == M_FLAG_CASTLING[QUEENSIDE]) {
+    } else { // castling == QUEENSIDE
         if (P->color == WHITE) {
-            P->king[OURS] -= 2;
             P->pieces[ROOK] ^= square_to_bitboard(A1) | square_to_bitboard(D1);
             P->whose[OURS] ^= square_to_bitboard(A1) | square_to_bitboard(C1) |
                               square_to_bitboard(D1) | square_to_bitboard(E1);
         } else { // P.color == BLACK
-            P->king[OURS] += 2;
             P->pieces[ROOK] ^= square_to_bitboard(a8) | square_to_bitboard(d8);
             P->whose[OURS] ^= square_to_bitboard(a8) | square_to_bitboard(c8) |
                               square_to_bitboard(d8) | square_to_bitboard(e8);
         }
+    }
+    return;
+}
+
+/** @brief Gets the piece that sits on a square, or KING if there is none */
+static Piece position_get_piece_at(position *P, bitboard b) {
+    if (P->pieces[PAWN] & PAWNS_MASK & b) return PAWN;
+    for (Piece piece = KNIGHT; piece <= QUEEN; piece++) {
+        if (P->pieces[piece] & b) return piece;
+    }
+    return KING;
+}
+
+void move_make(position *P, move m, undo *U) {
+    dbg_requires(P != NULL && U != NULL);
+    bitboard from_bb = square_to_bitboard(m.from);
+    bitboard to_bb = square_to_bitboard(m.to);
+    bitboard move_bb = from_bb | to_bb;
+
+    U->captured = KING;
+    U->castling = P->castling;
+    U->en_passant = position_get_en_passant(P, OURS);
+    U->halfmoves = P->halfmoves;
+    U->hash = P->hash;
+    U->pawn_hash = P->pawn_hash;
+
+    // Castling rights and en passant go back into the hash once they're known
+    Color us = P->color;
+    zhash hash = P->hash ^ hash_castling(P);
+    if (U->en_passant != INVALID_SQUARE) 
+        hash ^= EN_PASSANT_PRN[hash_square(us, U->en_passant) % 8];
+
+    // All moves reset the en_passant flags
+    position_reset_en_passant(P);
+    P->halfmoves++;
+    if (P->color == BLACK) P->fullmoves++;
+
+    // Castling
+    if (m.flags == M_FLAG_CASTLING[KINGSIDE]) {
+        move_toggle_castling(P, KINGSIDE);
+        P->king[OURS] = CASTLING_KING_TO[P->color][KINGSIDE];
         position_set_castling(P, OURS, KINGSIDE, false);
-        return prev_P;
+        position_set_castling(P, OURS, QUEENSIDE, false);
+        P->hash = hash ^ move_castling_hash(us, KINGSIDE) ^ hash_castling(P);
+        dbg_ensures(P->hash == hash_position(P));
+        return;
+    } else if (m.flags == M_FLAG_CASTLING[QUEENSIDE]) {
+        move_toggle_castling(P, QUEENSIDE);
+        P->king[OURS] = CASTLING_KING_TO[P->color][QUEENSIDE];
+        position_set_castling(P, OURS, KINGSIDE, false);
+        position_set_castling(P, OURS, QUEENSIDE, false);
+        P->hash = hash ^ move_castling_hash(us, QUEENSIDE) ^ hash_castling(P);
+        dbg_ensures(P->hash == hash_position(P));
+        return;
     }
 
     // Non-castling moves
+    square from = hash_square(us, m.from);
+    square to = hash_square(us, m.to);
+    Piece placed = m.flags & M_FLAG_IS_PROMOTION ? KNIGHT + (m.flags & 0x03) 
+                                                 : m.piece;
+    hash ^= PIECE_PRN[us][m.piece][from] ^ PIECE_PRN[us][placed][to];
+    if (m.piece == PAWN) {
+        P->pawn_hash ^= PIECE_PRN[us][PAWN][from];
+        if (placed == PAWN) P->pawn_hash ^= PIECE_PRN[us][PAWN][to];
+    }
+
     P->whose[OURS] ^= move_bb;
     if (m.piece != KING) P->pieces[m.piece] ^= from_bb;
+    if (m.piece == PAWN) P->halfmoves = 0;
 
     if (m.flags == M_FLAG_DPP) {
         position_set_en_passant(P, THEIRS, m.to);
+        hash ^= EN_PASSANT_PRN[to % 8];
     } else if (m.flags == M_FLAG_EN_PASSANT) {
         bitboard capture_bb = to_bb >> 8;
         P->whose[THEIRS] ^= capture_bb;
         P->pieces[PAWN] ^= capture_bb;
+        U->captured = PAWN;
+        hash ^= PIECE_PRN[!us][PAWN][hash_square(us, m.to - 8)];
+        P->pawn_hash ^= PIECE_PRN[!us][PAWN][hash_square(us, m.to - 8)];
     } else if (m.flags & M_FLAG_CAPTURE) {
+        U->captured = position_get_piece_at(P, to_bb);
+        dbg_assert(U->captured != KING);
         P->whose[THEIRS] ^= to_bb;
-        for (Piece piece = PAWN; piece <= KING; piece++) {
-            if (P->pieces[piece] & to_bb) {
-                P->pieces[piece] ^= to_bb;
-                break;
-            }
-        }
+        P->pieces[U->captured] ^= to_bb;
+        P->halfmoves = 0;
+        hash ^= PIECE_PRN[!us][U->captured][to];
+        if (U->captured == PAWN) P->pawn_hash ^= PIECE_PRN[!us][PAWN][to];
         m.flags &= ~M_FLAG_CAPTURE;
+
+        if (m.to == THEIR_ROOK_CORNERS[P->color][KINGSIDE])
+            position_set_castling(P, THEIRS, KINGSIDE, false);
+        else if (m.to == THEIR_ROOK_CORNERS[P->color][QUEENSIDE])
+            position_set_castling(P, THEIRS, QUEENSIDE, false);
     }
 
     if (m.piece == ROOK) {
@@ -468,7 +653,85 @@ position move_make(position *P, move m) {
     }
     else P->pieces[m.piece] ^= to_bb;
 
-    return prev_P;
+    P->hash = hash ^ hash_castling(P);
+    dbg_ensures(P->hash == hash_position(P));
+    dbg_ensures(P->pawn_hash == hash_pawns(P));
+    return;
+}
+
+void move_unmake(position *P, move m, const undo *U) {
+    dbg_requires(P != NULL && U != NULL);
+    bitboard from_bb = square_to_bitboard(m.from);
+    bitboard to_bb = square_to_bitboard(m.to);
+
+    if (m.flags == M_FLAG_CASTLING[KINGSIDE]) {
+        move_toggle_castling(P, KINGSIDE);
+        P->king[OURS] = CASTLING_KING_FROM[P->color];
+    } else if (m.flags == M_FLAG_CASTLING[QUEENSIDE]) {
+        move_toggle_castling(P, QUEENSIDE);
+        P->king[OURS] = CASTLING_KING_FROM[P->color];
+    } else {
+        P->whose[OURS] ^= from_bb | to_bb;
+
+        if (m.flags & M_FLAG_IS_PROMOTION) {
+            Piece promotion = KNIGHT + (m.flags & 0x03);
+            P->pieces[promotion] ^= to_bb;
+            P->pieces[PAWN] ^= from_bb;
+        } else if (m.piece == KING) {
+            P->king[OURS] = m.from;
+        } else {
+            P->pieces[m.piece] ^= from_bb | to_bb;
+        }
+
+        if (m.flags == M_FLAG_EN_PASSANT) {
+            bitboard capture_bb = to_bb >> 8;
+            P->whose[THEIRS] ^= capture_bb;
+            P->pieces[PAWN] ^= capture_bb;
+        } else if (m.flags & M_FLAG_CAPTURE) {
+            P->whose[THEIRS] ^= to_bb;
+            P->pieces[U->captured] ^= to_bb;
+        }
+    }
+
+    position_reset_en_passant(P);
+    if (U->en_passant != INVALID_SQUARE)
+        position_set_en_passant(P, OURS, U->en_passant - 8);
+    P->castling = U->castling;
+    P->halfmoves = U->halfmoves;
+    P->hash = U->hash;
+    P->pawn_hash = U->pawn_hash;
+    if (P->color == BLACK) P->fullmoves--;
+
+    return;
+}
+
+void move_make_null(position *P, undo *U) {
+    dbg_requires(P != NULL && U != NULL);
+    U->captured = KING;
+    U->castling = P->castling;
+    U->en_passant = position_get_en_passant(P, OURS);
+    U->halfmoves = P->halfmoves;
+    U->hash = P->hash;
+    U->pawn_hash = P->pawn_hash;
+
+    if (U->en_passant != INVALID_SQUARE) {
+        P->hash ^= EN_PASSANT_PRN[hash_square(P->color, U->en_passant) % 8];
+        position_reset_en_passant(P);
+    }
+    P->halfmoves++;
+    if (P->color == BLACK) P->fullmoves++;
+    dbg_ensures(P->hash == hash_position(P));
+    return;
+}
+
+void move_unmake_null(position *P, const undo *U) {
+    dbg_requires(P != NULL && U != NULL);
+    if (U->en_passant != INVALID_SQUARE)
+        position_set_en_passant(P, OURS, U->en_passant - 8);
+    P->halfmoves = U->halfmoves;
+    P->hash = U->hash;
+    if (P->color == BLACK) P->fullmoves--;
+    return;
 }
 
 /** @brief Prints a move in bitboard form, with to and from squares labelled */
@@ -533,9 +796,28 @@ void move_print(move m, Color c) {
     return;
 }
 
+char *move_to_string(move m, Color c, char *str) {
+    square from = c == WHITE ? m.from : 63 - m.from;
+    square to = c == WHITE ? m.to : 63 - m.to;
+    
+    int n = sprintf(str, "%s%s", SQUARES_TO_STRINGS[from], 
+                    SQUARES_TO_STRINGS[to]);
+    if (m.flags & M_FLAG_IS_PROMOTION) 
+        sprintf(str + n, "%c", PIECE_CHARS[BLACK][KNIGHT + (m.flags & 0x03)]);
+
+    return str;
+}
+
+/** 
+ * @brief Whether a pseudo-legal move leaves our king safe
+ * 
+ * Makes the move on a scratch copy: a position is small enough that copying
+ * it is cheaper than move_unmake for a one-ply probe.
+ */
 static bool move_is_legal(move m, position *P) {
+    undo U;
     position _P = *P;
-    move_make(&_P, m);
+    move_make(&_P, m, &U);
     return !king_in_check(&_P, OURS);
 }
 
@@ -551,13 +833,7 @@ movelist *movelist_new(void) {
         perror("malloc error");
         exit(1);
     }
-    M->array = malloc(sizeof(move));
-    if (M == NULL) {
-        perror("malloc error");
-        exit(1);
-    }
     M->size = 0;
-    M->limit = 1;
 
     return M;
 }
@@ -572,53 +848,223 @@ void movelist_clear(movelist_t M) {
 }
 
 void movelist_free(movelist *M) {
-    free(M->array);
     free(M);
     return;
 }
 
-static void movelist_resize(movelist *M, int new_limit) {
-    dbg_requires(new_limit >= M->size);
+static void movelist_append(movelist *M, move m) {
+    dbg_requires(M->size < MAX_MOVES);
+    M->array[M->size++] = m;
+    return;
+}
 
-    move *old_array = M->array;
-    M->limit = new_limit;
-    M->array = malloc(sizeof(move) * new_limit);
+static move movelist_pop(movelist *M) {
+    if (M->size == 0)
+        return NULL_MOVE;
+    return M->array[--M->size];
+}
 
+void movelist_print(movelist_t M, Color c) {
     for (int i = 0; i < M->size; i++) {
-        M->array[i] = old_array[i];
+        printf("%d - ", i);
+        move_print(M->array[i], c);
+    }
+    return;
+}
+
+/*
+ * ---------------------------------------------------------------------------
+ *                              SLIDING ATTACKS
+ * ---------------------------------------------------------------------------
+ */
+
+/** @brief Whether a direction's rays run towards higher squares */
+static bool direction_is_forward(int dir) {
+    return dir == NORTH || dir == EAST || dir == NORTH_EAST || dir == NORTH_WEST;
+}
+
+/** @brief Slider attacks along a single ray, stopping at the first blocker */
+static bitboard get_ray_map(square from, int dir, bitboard all) {
+    bitboard blockers = RAYS[dir][from] & all;
+    square block = direction_is_forward(dir) ? bitboard_bsf(blockers) 
+                                             : bitboard_bsr(blockers);
+    return RAYS[dir][from] & (block < 64 ? ~RAYS[dir][block] : BITBOARD_FULL);
+}
+
+/** @brief Ray-by-ray slider attacks, only used to fill the magic tables */
+static bitboard get_sliding_ray_map(square from, int first_dir, int last_dir,
+                                    bitboard all) {
+    bitboard sliding_map = BITBOARD_EMPTY;
+    for (int dir = first_dir; dir <= last_dir; dir++) {
+        sliding_map |= get_ray_map(from, dir, all);
+    }
+    return sliding_map;
+}
+
+/** @brief Rays from a square with the last square of each ray removed */
+static bitboard get_relevant_mask(square from, int first_dir, int last_dir) {
+    bitboard mask = BITBOARD_EMPTY;
+    for (int dir = first_dir; dir <= last_dir; dir++) {
+        bitboard ray = RAYS[dir][from];
+        square edge = direction_is_forward(dir) ? bitboard_bsr(ray) 
+                                                : bitboard_bsf(ray);
+        mask |= bitboard_reset(ray, edge);
+    }
+    return mask;
+}
+
+#ifdef USE_PEXT
+/** @brief Portable parallel bit extract, only used to fill PEXT_ATTACKS */
+static uint64_t software_pext(bitboard b, bitboard mask) {
+    uint64_t result = 0;
+    for (uint64_t bit = 1; mask != BITBOARD_EMPTY; bit <<= 1) {
+        square s = bitboard_iter_first(&mask);
+        if (b & square_to_bitboard(s)) result |= bit;
     }
+    return result;
+}
+#endif
 
-    free(old_array);
+/**
+ * @brief Fills one square's slice of SLIDING_ATTACKS (and of PEXT_ATTACKS)
+ * 
+ * @return The number of table entries used by the square
+ */
+static int magic_init(magic *M, int offset, bitboard magic_number,
+                      square from, int first_dir, int last_dir) {
+    M->mask = get_relevant_mask(from, first_dir, last_dir);
+    M->magic = magic_number;
+    M->attacks = SLIDING_ATTACKS + offset;
+    M->shift = BITBOARD_SIZE - bitboard_count_bits(M->mask);
+#ifdef USE_PEXT
+    M->pext_attacks = PEXT_ATTACKS + offset;
+#endif
+
+    int size = 1 << bitboard_count_bits(M->mask);
+    for (int i = 0; i < size; i++) {
+        M->attacks[i] = BITBOARD_EMPTY;
+    }
 
+    // Carry-Rippler trick: enumerates every subset of the mask
+    bitboard occupancy = BITBOARD_EMPTY;
+    do {
+        bitboard sliding_map = get_sliding_ray_map(from, first_dir, last_dir, 
+                                                   occupancy);
+        bitboard *entry = &M->attacks[(occupancy * M->magic) >> M->shift];
+        dbg_assert(*entry == BITBOARD_EMPTY || *entry == sliding_map);
+        *entry = sliding_map;
+#ifdef USE_PEXT
+        M->pext_attacks[software_pext(occupancy, M->mask)] = sliding_map;
+#endif
+        occupancy = (occupancy - M->mask) & M->mask;
+    } while (occupancy != BITBOARD_EMPTY);
+
+    return size;
+}
+
+/** @brief Fills BETWEEN and LINE by walking every ray from every square */
+static void lines_init(void) {
+    for (square from = 0; from < BITBOARD_SIZE; from++) {
+        for (int dir = NORTH; dir <= NORTH_WEST; dir++) {
+            // Opposite directions differ by 2 in the Direction enum
+            bitboard line = RAYS[dir][from] | RAYS[dir ^ 2][from] | 
+                            square_to_bitboard(from);
+            bitboard ray = RAYS[dir][from];
+            square to;
+            while ((to = bitboard_iter_first(&ray)) != INVALID_SQUARE) {
+                BETWEEN[from][to] = RAYS[dir][from] & ~RAYS[dir][to] & 
+                                    ~square_to_bitboard(to);
+                LINE[from][to] = line;
+            }
+        }
+    }
     return;
 }
 
-static void movelist_append(movelist *M, move m) {
-    if (M->size == M->limit-1)
-        movelist_resize(M, M->limit * 2);
+void moves_init(void) {
+    lines_init();
 
-    M->array[M->size++] = m;
+    int offset = 0;
+    for (square from = 0; from < BITBOARD_SIZE; from++) {
+        offset += magic_init(&BISHOP_MAGIC_ENTRIES[from], offset, 
+                             BISHOP_MAGICS[from], from, NORTH_EAST, NORTH_WEST);
+    }
+    for (square from = 0; from < BITBOARD_SIZE; from++) {
+        offset += magic_init(&ROOK_MAGIC_ENTRIES[from], offset, 
+                             ROOK_MAGICS[from], from, NORTH, WEST);
+    }
+    dbg_ensures(offset == sizeof(SLIDING_ATTACKS) / sizeof(bitboard));
 
+#ifdef USE_PEXT
+    // The whole build uses BMI2, so there is nothing to fall back to
+    __builtin_cpu_init();
+    if (!__builtin_cpu_supports("bmi2")) {
+        fprintf(stderr, "this CPU lacks BMI2, rebuild without PEXT=1\n");
+        exit(1);
+    }
+#endif
     return;
 }
-// [REVIEW]
-static move movelist_pop(movelist *M) {
-    if (M->limit == 1)
-        return NULL_MOVE;
-    
-    int half_limit = M->limit / 2;
-    if (M->size == half_limit)
-        movelist_resize(M, half_limit);
-    
-    return M->array[M->size--];
+
+/** @brief Slider attacks given all occupied squares: one multiply, shift, load */
+static inline bitboard magic_lookup(const magic *M, bitboard all) {
+    return M->attacks[((all & M->mask) * M->magic) >> M->shift];
 }
 
-void movelist_print(movelist_t M, Color c) {
-    for (int i = 0; i < M->size; i++) {
-        printf("%d - ", i);
-        move_print(M->array[i], c);
+#ifdef USE_PEXT
+/** @brief Slider attacks given all occupied squares: one pext, load */
+static inline bitboard pext_lookup(const magic *M, bitboard all) {
+    return M->pext_attacks[_pext_u64(all, M->mask)];
+}
+#endif
+
+/** @brief Looks up slider attacks with the backend chosen at compile time */
+static inline bitboard sliding_lookup(const magic *M, bitboard all) {
+#ifdef USE_PEXT
+    return pext_lookup(M, all);
+#else
+    return magic_lookup(M, all);
+#endif
+}
+
+bool slider_backend_available(SliderBackend backend) {
+#ifdef USE_PEXT
+    return true;
+#else
+    return backend != SLIDER_PEXT;
+#endif
+}
+
+SliderBackend slider_backend(void) {
+    return slider_backend_available(SLIDER_PEXT) ? SLIDER_PEXT : SLIDER_MAGIC;
+}
+
+bitboard slider_attacks(SliderBackend backend, Piece piece, square from, 
+                        bitboard all) {
+    dbg_requires(piece == BISHOP || piece == ROOK || piece == QUEEN);
+    dbg_requires(slider_backend_available(backend));
+    bitboard attacks = BITBOARD_EMPTY;
+    
+    if (piece != ROOK) {
+        const magic *M = &BISHOP_MAGIC_ENTRIES[from];
+        if (backend == SLIDER_RAYS) 
+            attacks |= get_sliding_ray_map(from, NORTH_EAST, NORTH_WEST, all);
+#ifdef USE_PEXT
+        else if (backend == SLIDER_PEXT) attacks |= pext_lookup(M, all);
+#endif
+        else attacks |= magic_lookup(M, all);
     }
-    return;
+    if (piece != BISHOP) {
+        const magic *M = &ROOK_MAGIC_ENTRIES[from];
+        if (backend == SLIDER_RAYS) 
+            attacks |= get_sliding_ray_map(from, NORTH, WEST, all);
+#ifdef USE_PEXT
+        else if (backend == SLIDER_PEXT) attacks |= pext_lookup(M, all);
+#endif
+        else attacks |= magic_lookup(M, all);
+    }
+
+    return attacks;
 }
 
 /*
@@ -627,6 +1073,34 @@ void movelist_print(movelist_t M, Color c) {
  * ---------------------------------------------------------------------------
  */
 
+/** @brief Appends captures then quiet moves of a piece from `targets` */
+static inline void append_moves(movelist *M, Piece piece, square from,
+                                bitboard targets, bitboard theirs) {
+    square to;
+    bitboard captures = targets & theirs;
+    while ((to = bitboard_iter_first(&captures)) != INVALID_SQUARE) {
+        move m = { piece, from, to, M_FLAG_CAPTURE };
+        movelist_append(M, m);
+    }
+
+    bitboard quiet_moves = targets & ~theirs;
+    while ((to = bitboard_iter_first(&quiet_moves)) != INVALID_SQUARE) {
+        move m = { piece, from, to, M_FLAG_QUIET };
+        movelist_append(M, m);
+    }
+    return;
+}
+
+/** @brief Appends all four promotions of a pawn move */
+static inline void append_promotions(movelist *M, square from, square to,
+                                     uint8_t flags) {
+    for (Piece p = KNIGHT; p <= QUEEN; p++) {
+        move m = { PAWN, from, to, flags | M_FLAG_PROMOTION[p] };
+        movelist_append(M, m);
+    }
+    return;
+}
+
 static bitboard get_pawn_attack_map(square from, Whose whose, 
                                            position *P) {
     return PAWN_ATTACKS[whose][from] & P->whose[!whose];
@@ -706,17 +1180,8 @@ static movelist *generate_knight_moves(movelist *M, square from, position *P) {
 }
 
 static bitboard get_diagonal_sliding_map(square from, Whose whose, position *P) {
-    bitboard diagonal_map, blockers, block;
-    bool is_forward;
-    diagonal_map = BITBOARD_EMPTY;
-
-    for (int dir = NORTH_EAST; dir <= NORTH_WEST; dir++) {
-        blockers = RAYS[dir][from] & (P->whose[OURS] | P->whose[THEIRS]);
-        is_forward = dir == NORTH_EAST || dir == NORTH_WEST;
-        block = is_forward ? bitboard_bsf(blockers) : bitboard_bsr(blockers);
-        diagonal_map |= RAYS[dir][from] & (block < 64 ? ~RAYS[dir][block] : BITBOARD_FULL);
-    }
-    return diagonal_map;
+    bitboard all = P->whose[OURS] | P->whose[THEIRS];
+    return sliding_lookup(&BISHOP_MAGIC_ENTRIES[from], all);
 }
 
 static movelist *generate_bishop_moves(movelist *M, square from, position *P)  {
@@ -740,18 +1205,8 @@ static movelist *generate_bishop_moves(movelist *M, square from, position *P)  {
 }
 
 static bitboard get_straight_sliding_map(square from, Whose whose, position *P) {
-    bitboard straight_map, blockers, block;
-    bool is_forward;
-    straight_map = BITBOARD_EMPTY;
-
-    for (int dir = NORTH; dir <= WEST; dir++) {
-        blockers = RAYS[dir][from] & (P->whose[OURS] | P->whose[THEIRS]);
-        is_forward = dir == NORTH || dir == EAST;
-        block = is_forward ? bitboard_bsf(blockers) : bitboard_bsr(blockers);
-        straight_map |= RAYS[dir][from] & (block < 64 ? ~RAYS[dir][block] : BITBOARD_FULL);
-    }
-
-    return straight_map;
+    bitboard all = P->whose[OURS] | P->whose[THEIRS];
+    return sliding_lookup(&ROOK_MAGIC_ENTRIES[from], all);
 }
 
 
@@ -820,28 +1275,35 @@ static movelist *generate_king_moves(movelist *M, square from, position *P) {
     bitboard their_attacks = build_attack_map(P, THEIRS);
 
     if (position_get_castling(P, OURS, KINGSIDE) && 
-        bitboard_is_empty(CASTLING_MASK[KINGSIDE] & all) &&
-        bitboard_is_empty(CASTLING_MASK[KINGSIDE] & their_attacks)) {
-        move m = { KING, 0, 0, M_FLAG_CASTLING[KINGSIDE] };
+        bitboard_is_empty(CASTLING_EMPTY_MASK[P->color][KINGSIDE] & all) &&
+        bitboard_is_empty(CASTLING_SAFE_MASK[P->color][KINGSIDE] & their_attacks)) {
+        move m = { KING, from, CASTLING_KING_TO[P->color][KINGSIDE], 
+                   M_FLAG_CASTLING[KINGSIDE] };
         movelist_append(M, m);
     }
 
     if (position_get_castling(P, OURS, QUEENSIDE) && 
-        bitboard_is_empty(CASTLING_MASK[QUEENSIDE] & all) &&
-        bitboard_is_empty(CASTLING_MASK[KINGSIDE] & their_attacks)) {
-        move m = { KING, 0, 0, M_FLAG_CASTLING[QUEENSIDE] };
+        bitboard_is_empty(CASTLING_EMPTY_MASK[P->color][QUEENSIDE] & all) &&
+        bitboard_is_empty(CASTLING_SAFE_MASK[P->color][QUEENSIDE] & their_attacks)) {
+        move m = { KING, from, CASTLING_KING_TO[P->color][QUEENSIDE], 
+                   M_FLAG_CASTLING[QUEENSIDE] };
         movelist_append(M, m);
     }
 
     return M;
 }
 
-// [REVIEW]
-bitboard build_attack_map(position *P, Whose whose) {
+/** 
+ * @brief Squares attacked by the pieces of `whose`, sliders blocked by `all`
+ * 
+ * Passing an occupancy without OUR king gives the king danger map: squares
+ * the king can't step to, including the ones behind it on a checking ray.
+ */
+static bitboard get_attack_map(position *P, Whose whose, bitboard all) {
     square from;
     bitboard attacks = BITBOARD_EMPTY;
 
-    bitboard pawns = P->whose[whose] & P->pieces[PAWN];
+    bitboard pawns = P->whose[whose] & P->pieces[PAWN] & PAWNS_MASK;
     while ((from = bitboard_iter_first(&pawns)) != INVALID_SQUARE) {
         attacks |= PAWN_ATTACKS[whose][from];
     }
@@ -851,28 +1313,25 @@ bitboard build_attack_map(position *P, Whose whose) {
         attacks |= KNIGHT_ATTACKS[from];
     }
 
-    bitboard bishops = P->whose[whose] & P->pieces[BISHOP];
-    while ((from = bitboard_iter_first(&bishops)) != INVALID_SQUARE) {
-        attacks |= get_diagonal_sliding_map(from, whose, P);
+    bitboard diagonals = P->whose[whose] & (P->pieces[BISHOP] | P->pieces[QUEEN]);
+    while ((from = bitboard_iter_first(&diagonals)) != INVALID_SQUARE) {
+        attacks |= sliding_lookup(&BISHOP_MAGIC_ENTRIES[from], all);
     }
 
-    bitboard rooks = P->whose[whose] & P->pieces[ROOK];
-    while ((from = bitboard_iter_first(&rooks)) != INVALID_SQUARE) {
-        attacks |= get_straight_sliding_map(from, whose, P);
-    }
-
-    bitboard queens = P->whose[whose] & P->pieces[QUEEN];
-    while ((from = bitboard_iter_first(&queens)) != INVALID_SQUARE) {
-        attacks |= get_diagonal_sliding_map(from, whose, P);
-        attacks |= get_straight_sliding_map(from, whose, P);
+    bitboard straights = P->whose[whose] & (P->pieces[ROOK] | P->pieces[QUEEN]);
+    while ((from = bitboard_iter_first(&straights)) != INVALID_SQUARE) {
+        attacks |= sliding_lookup(&ROOK_MAGIC_ENTRIES[from], all);
     }
     
-    from = P->king[whose];
-    attacks |= KING_ATTACKS[from];
+    attacks |= KING_ATTACKS[P->king[whose]];
 
     return attacks;
 }
 
+bitboard build_attack_map(position *P, Whose whose) {
+    return get_attack_map(P, whose, P->whose[OURS] | P->whose[THEIRS]);
+}
+
 bool king_in_check(position *P, Whose whose) {
     return square_to_bitboard(P->king[whose]) & build_attack_map(P, !whose);
 }
@@ -887,43 +1346,790 @@ GameState get_game_state(position *P, movelist_t M) {
     } else return CONTINUE;
 }
 
-movelist *generate_moves(movelist *M, position *P) {
+movelist *generate_moves_reference(movelist *M, position *P) {
     dbg_requires(M->size == 0);
-    movelist_t _M = movelist_new();
 
     square from;
-    bitboard our_pawns = P->whose[OURS] & P->pieces[PAWN];
+    bitboard our_pawns = P->whose[OURS] & P->pieces[PAWN] & PAWNS_MASK;
     while ((from = bitboard_iter_first(&our_pawns)) != INVALID_SQUARE) {
-        generate_pawn_moves(_M, from, P);
+        generate_pawn_moves(M, from, P);
     }
 
     bitboard our_knights = P->whose[OURS] & P->pieces[KNIGHT];
     while ((from = bitboard_iter_first(&our_knights)) != INVALID_SQUARE) {
-        generate_knight_moves(_M, from, P);
+        generate_knight_moves(M, from, P);
     }
 
     bitboard our_bishops = P->whose[OURS] & P->pieces[BISHOP];
     while ((from = bitboard_iter_first(&our_bishops)) != INVALID_SQUARE) {
-        generate_bishop_moves(_M, from, P);
+        generate_bishop_moves(M, from, P);
     }
 
     bitboard our_rooks = P->whose[OURS] & P->pieces[ROOK];
     while ((from = bitboard_iter_first(&our_rooks)) != INVALID_SQUARE) {
-        generate_rook_moves(_M, from, P);
+        generate_rook_moves(M, from, P);
     }
 
     bitboard our_queens = P->whose[OURS] & P->pieces[QUEEN];
     while ((from = bitboard_iter_first(&our_queens)) != INVALID_SQUARE) {
-        generate_queen_moves(_M, from, P);
+        generate_queen_moves(M, from, P);
     }
     
     from = P->king[OURS];
-    generate_king_moves(_M, from, P);
+    generate_king_moves(M, from, P);
+
+    // Keep only the legal moves, compacting the list in place
+    int size = 0;
+    for (int i = 0; i < M->size; i++) {
+        if (move_is_legal(M->array[i], P))
+            M->array[size++] = M->array[i];
+    }
+    M->size = size;
+
+    return M;
+}
+
+/** @brief OUR pieces pinned to our king, each allowed to move along LINE only */
+static bitboard get_pinned(position *P, bitboard all) {
+    square k = P->king[OURS];
+    bitboard theirs = P->whose[THEIRS];
+    bitboard pinned = BITBOARD_EMPTY;
+
+    // Their sliders that would attack our king if only their pieces blocked
+    bitboard snipers = 
+        (sliding_lookup(&BISHOP_MAGIC_ENTRIES[k], theirs) & theirs & 
+         (P->pieces[BISHOP] | P->pieces[QUEEN])) |
+        (sliding_lookup(&ROOK_MAGIC_ENTRIES[k], theirs) & theirs & 
+         (P->pieces[ROOK] | P->pieces[QUEEN]));
+
+    square sniper;
+    while ((sniper = bitboard_iter_first(&snipers)) != INVALID_SQUARE) {
+        bitboard blockers = BETWEEN[k][sniper] & all;
+        if (bitboard_count_bits(blockers) == 1)
+            pinned |= blockers & P->whose[OURS];
+    }
+
+    return pinned;
+}
+
+/** @brief THEIR pieces attacking `target` when `all` are the occupied squares */
+static bitboard get_attackers(position *P, square target, bitboard all) {
+    bitboard theirs = P->whose[THEIRS];
+    bitboard pawns = P->pieces[PAWN] & PAWNS_MASK;
+    return (PAWN_ATTACKS[OURS][target] & theirs & pawns) |
+           (KNIGHT_ATTACKS[target] & theirs & P->pieces[KNIGHT]) |
+           (sliding_lookup(&BISHOP_MAGIC_ENTRIES[target], all) & theirs & 
+            (P->pieces[BISHOP] | P->pieces[QUEEN])) |
+           (sliding_lookup(&ROOK_MAGIC_ENTRIES[target], all) & theirs & 
+            (P->pieces[ROOK] | P->pieces[QUEEN]));
+}
+
+/** 
+ * @brief Whether an en passant capture leaves our king safe
+ * 
+ * Two pawns leave the same rank at once, so neither the pin nor the check
+ * mask covers it: look for attackers on the board as it would be afterwards.
+ */
+static bool en_passant_is_legal(position *P, square from, square to) {
+    bitboard captured = square_to_bitboard(to) >> 8;
+    bitboard all = ((P->whose[OURS] | P->whose[THEIRS]) ^ 
+                    square_to_bitboard(from) ^ captured) | square_to_bitboard(to);
+    return bitboard_is_empty(get_attackers(P, P->king[OURS], all) & ~captured);
+}
+
+/** @brief Which of the legal moves to generate */
+typedef enum GenType {
+    GEN_ALL,
+    GEN_CAPTURES,   // captures (en passant included) and promotions
+    GEN_QUIETS      // the rest: no capture, no promotion
+} GenType;
+
+#define RANK_8 0xFF00000000000000
+
+/** 
+ * @brief Legal moves of a GenType
+ * 
+ * Forced inline so that each caller compiles with `type` as a constant.
+ */
+static inline __attribute__((always_inline))
+movelist *generate_legal(movelist *M, position *P, GenType type) {
+    dbg_requires(M->size == 0);
+
+    square from, to;
+    square k = P->king[OURS];
+    bitboard ours = P->whose[OURS];
+    bitboard theirs = P->whose[THEIRS];
+    bitboard all = ours | theirs;
+    bitboard targets_mask = type == GEN_ALL ? ~ours 
+                          : type == GEN_CAPTURES ? theirs : ~all;
+    bitboard pushes_mask = type == GEN_ALL ? BITBOARD_FULL 
+                         : type == GEN_CAPTURES ? RANK_8 : ~RANK_8;
+
+    // Their attacks see through our king, so it can't retreat along a ray
+    bitboard danger = get_attack_map(P, THEIRS, all ^ square_to_bitboard(k));
+    append_moves(M, KING, k, KING_ATTACKS[k] & targets_mask & ~danger, theirs);
+
+    bitboard checkers = get_attackers(P, k, all);
+    if (bitboard_count_bits(checkers) > 1) 
+        return M;
+
+    // Squares a non-king move must land on: capture the checker or block it
+    bitboard check_mask = BITBOARD_FULL;
+    if (checkers != BITBOARD_EMPTY)
+        check_mask = checkers | BETWEEN[k][bitboard_to_square(checkers)];
+    bitboard pinned = get_pinned(P, all);
+
+    bitboard pawns = ours & P->pieces[PAWN] & PAWNS_MASK;
+    square ep_square = position_get_en_passant(P, OURS);
+    while ((from = bitboard_iter_first(&pawns)) != INVALID_SQUARE) {
+        bitboard mask = check_mask;
+        if (pinned & square_to_bitboard(from)) mask &= LINE[k][from];
+
+        bitboard captures = PAWN_ATTACKS[OURS][from] & theirs & mask;
+        if (type == GEN_QUIETS) captures = BITBOARD_EMPTY;
+        while ((to = bitboard_iter_first(&captures)) != INVALID_SQUARE) {
+            if (56 <= to && to < 64) {
+                append_promotions(M, from, to, M_FLAG_CAPTURE);
+            } else {
+                move m = { PAWN, from, to, M_FLAG_CAPTURE };
+                movelist_append(M, m);
+            }
+        }
+
+        bitboard quiet_moves = get_pawn_quiet_moves_map(from, OURS, P) & 
+                               mask & pushes_mask;
+        while ((to = bitboard_iter_first(&quiet_moves)) != INVALID_SQUARE) {
+            if (56 <= to && to < 64) {
+                append_promotions(M, from, to, M_FLAG_QUIET);
+            } else {
+                move m = { PAWN, from, to, to - from == 16 ? M_FLAG_DPP 
+                                                           : M_FLAG_QUIET };
+                movelist_append(M, m);
+            }
+        }
+
+        if (type != GEN_QUIETS && ep_square != INVALID_SQUARE && 
+            (PAWN_ATTACKS[OURS][from] & square_to_bitboard(ep_square)) &&
+            en_passant_is_legal(P, from, ep_square)) {
+            move m = { PAWN, from, ep_square, M_FLAG_EN_PASSANT };
+            movelist_append(M, m);
+        }
+    }
+
+    // A pinned knight can never stay on its pin line
+    bitboard knights = ours & P->pieces[KNIGHT] & ~pinned;
+    while ((from = bitboard_iter_first(&knights)) != INVALID_SQUARE) {
+        bitboard targets = KNIGHT_ATTACKS[from] & targets_mask & check_mask;
+        append_moves(M, KNIGHT, from, targets, theirs);
+    }
+
+    for (Piece piece = BISHOP; piece <= QUEEN; piece++) {
+        bitboard sliders = ours & P->pieces[piece];
+        while ((from = bitboard_iter_first(&sliders)) != INVALID_SQUARE) {
+            bitboard targets = BITBOARD_EMPTY;
+            if (piece != ROOK) 
+                targets |= sliding_lookup(&BISHOP_MAGIC_ENTRIES[from], all);
+            if (piece != BISHOP) 
+                targets |= sliding_lookup(&ROOK_MAGIC_ENTRIES[from], all);
+            targets &= targets_mask & check_mask;
+            if (pinned & square_to_bitboard(from)) targets &= LINE[k][from];
+            append_moves(M, piece, from, targets, theirs);
+        }
+    }
+
+    if (type == GEN_CAPTURES || checkers != BITBOARD_EMPTY) 
+        return M;
+
+    for (Castling side = KINGSIDE; side <= QUEENSIDE; side++) {
+        if (position_get_castling(P, OURS, side) && 
+            bitboard_is_empty(CASTLING_EMPTY_MASK[P->color][side] & all) &&
+            bitboard_is_empty(CASTLING_SAFE_MASK[P->color][side] & danger)) {
+            move m = { KING, k, CASTLING_KING_TO[P->color][side], 
+                       M_FLAG_CASTLING[side] };
+            movelist_append(M, m);
+        }
+    }
+
+    return M;
+}
+
+movelist *generate_moves(movelist *M, position *P) {
+    return generate_legal(M, P, GEN_ALL);
+}
+
+movelist *generate_captures(movelist *M, position *P) {
+    return generate_legal(M, P, GEN_CAPTURES);
+}
+
+movelist *generate_quiets(movelist *M, position *P) {
+    return generate_legal(M, P, GEN_QUIETS);
+}
+
+bool move_is_valid(position *P, move m) {
+    dbg_requires(P != NULL);
+    if (m.from == m.to || m.from >= 64 || m.to >= 64 || m.piece > KING) 
+        return false;
+    bitboard from_bb = square_to_bitboard(m.from);
+    bitboard to_bb = square_to_bitboard(m.to);
+    bitboard ours = P->whose[OURS];
+    bitboard theirs = P->whose[THEIRS];
+    bitboard all = ours | theirs;
+    if (!(from_bb & ours) || (to_bb & ours)) return false;
+    if (m.piece == KING ? P->king[OURS] != m.from 
+                        : position_get_piece_at(P, from_bb) != m.piece)
+        return false;
+
+    for (Castling side = KINGSIDE; side <= QUEENSIDE; side++) {
+        if (m.flags != M_FLAG_CASTLING[side]) continue;
+        bitboard danger = get_attack_map(P, THEIRS, all);
+        return m.piece == KING && 
+               m.to == CASTLING_KING_TO[P->color][side] &&
+               position_get_castling(P, OURS, side) && 
+               bitboard_is_empty(CASTLING_EMPTY_MASK[P->color][side] & all) &&
+               bitboard_is_empty(CASTLING_SAFE_MASK[P->color][side] & danger);
+    }
+
+    if (m.flags == M_FLAG_EN_PASSANT) {
+        return m.piece == PAWN && 
+               m.to == position_get_en_passant(P, OURS) &&
+               (PAWN_ATTACKS[OURS][m.from] & to_bb) &&
+               en_passant_is_legal(P, m.from, m.to);
+    }
+
+    // The capture flag has to match the target, promotions the last rank
+    bool capture = m.flags & M_FLAG_CAPTURE;
+    if (capture != !bitboard_is_empty(to_bb & theirs)) return false;
+    bool promotion = m.flags & M_FLAG_IS_PROMOTION;
+    if (promotion != (m.piece == PAWN && m.to >= 56)) return false;
+    bool dpp = m.flags == M_FLAG_DPP;
+    if (m.flags > 0x0F || (!promotion && !dpp && m.flags != M_FLAG_QUIET && 
+                           m.flags != M_FLAG_CAPTURE))
+        return false;
+
+    if (dpp && m.piece != PAWN) return false;
+
+    bitboard targets;
+    switch (m.piece) {
+    case PAWN:
+        if (capture) {
+            targets = PAWN_ATTACKS[OURS][m.from];
+        } else {
+            targets = get_pawn_quiet_moves_map(m.from, OURS, P);
+            // Only a double push is flagged as one
+            if ((m.to - m.from == 16) != dpp) return false;
+        }
+        break;
+    case KNIGHT:
+        targets = KNIGHT_ATTACKS[m.from];
+        break;
+    case KING:
+        targets = KING_ATTACKS[m.from];
+        break;
+    default:
+        targets = BITBOARD_EMPTY;
+        if (m.piece != ROOK) 
+            targets |= sliding_lookup(&BISHOP_MAGIC_ENTRIES[m.from], all);
+        if (m.piece != BISHOP) 
+            targets |= sliding_lookup(&ROOK_MAGIC_ENTRIES[m.from], all);
+        break;
+    }
+    return (targets & to_bb) && move_is_legal(m, P);
+}
+
+Piece move_captured(position *P, move m) {
+    if (m.flags == M_FLAG_EN_PASSANT) return PAWN;
+    if (!(m.flags & M_FLAG_CAPTURE)) return KING;
+    return position_get_piece_at(P, square_to_bitboard(m.to));
+}
+
+/*
+ * ---------------------------------------------------------------------------
+ *                              STATIC EXCHANGE
+ * ---------------------------------------------------------------------------
+ */
+
+const int SEE_VALUE[6] = { 100, 320, 330, 500, 950, 20000 };
+
+/** @brief Pieces of both sides attacking `target` through the `all` squares */
+static bitboard get_all_attackers(position *P, square target, bitboard all) {
+    bitboard pawns = P->pieces[PAWN] & PAWNS_MASK;
+    bitboard kings = square_to_bitboard(P->king[OURS]) | 
+                     square_to_bitboard(P->king[THEIRS]);
+    return (PAWN_ATTACKS[OURS][target] & P->whose[THEIRS] & pawns) |
+           (PAWN_ATTACKS[THEIRS][target] & P->whose[OURS] & pawns) |
+           (KNIGHT_ATTACKS[target] & P->pieces[KNIGHT]) |
+           (KING_ATTACKS[target] & kings) |
+           (sliding_lookup(&BISHOP_MAGIC_ENTRIES[target], all) & 
+            (P->pieces[BISHOP] | P->pieces[QUEEN])) |
+           (sliding_lookup(&ROOK_MAGIC_ENTRIES[target], all) & 
+            (P->pieces[ROOK] | P->pieces[QUEEN]));
+}
+
+/** 
+ * @brief The least valuable of `attackers`, as its square's bitboard
+ * 
+ * @param[out] piece
+ * @return BITBOARD_EMPTY if there are no attackers
+ */
+static bitboard least_valuable(position *P, bitboard attackers, Piece *piece) {
+    bitboard pawns = attackers & P->pieces[PAWN] & PAWNS_MASK;
+    if (pawns != BITBOARD_EMPTY) {
+        *piece = PAWN;
+        return pawns & -pawns;
+    }
+    for (Piece p = KNIGHT; p <= QUEEN; p++) {
+        bitboard b = attackers & P->pieces[p];
+        if (b != BITBOARD_EMPTY) {
+            *piece = p;
+            return b & -b;
+        }
+    }
+    *piece = KING;
+    return attackers;   // the king, if anything
+}
+
+/** @brief Sliders revealed on `target` once a piece has left `all` */
+static bitboard get_xrays(position *P, square target, bitboard all, 
+                          Piece removed) {
+    bitboard xrays = BITBOARD_EMPTY;
+    if (removed == PAWN || removed == BISHOP || removed == QUEEN)
+        xrays |= sliding_lookup(&BISHOP_MAGIC_ENTRIES[target], all) & 
+                 (P->pieces[BISHOP] | P->pieces[QUEEN]);
+    if (removed == ROOK || removed == QUEEN)
+        xrays |= sliding_lookup(&ROOK_MAGIC_ENTRIES[target], all) & 
+                 (P->pieces[ROOK] | P->pieces[QUEEN]);
+    return xrays & all;
+}
+
+/** @brief What a move takes, and what it leaves on its square to be taken */
+static void see_move_values(position *P, move m, int *captured, int *moved) {
+    *captured = 0;
+    *moved = SEE_VALUE[m.piece];
+    if (m.flags & M_FLAG_CAPTURE) *captured = SEE_VALUE[move_captured(P, m)];
+    if (m.flags & M_FLAG_PROMOTION[KNIGHT]) {
+        Piece promoted = KNIGHT + (m.flags & 3);
+        *captured += SEE_VALUE[promoted] - SEE_VALUE[PAWN];
+        *moved = SEE_VALUE[promoted];
+    }
+    return;
+}
+
+/** @brief The occupied squares once a move has left its square */
+static bitboard see_occupied(position *P, move m) {
+    bitboard all = (P->whose[OURS] | P->whose[THEIRS]) ^ 
+                   square_to_bitboard(m.from);
+    if (m.flags == M_FLAG_EN_PASSANT) 
+        all ^= square_to_bitboard(m.to) >> 8;
+    return all;
+}
+
+int see(position *P, move m) {
+    dbg_requires(P != NULL);
+    if (m.flags == M_FLAG_CASTLING[KINGSIDE] || 
+        m.flags == M_FLAG_CASTLING[QUEENSIDE]) 
+        return 0;
+
+    // gain[d]: what the side making the d-th capture is up if it's the last
+    int gain[32];
+    int captured, moved;
+    see_move_values(P, m, &captured, &moved);
+    gain[0] = captured;
+
+    bitboard all = see_occupied(P, m);
+    bitboard attackers = get_all_attackers(P, m.to, all) & all;
+    Whose side = OURS;
+    Piece piece = m.piece;
+    int d = 0;
+    while (true) {
+        side = !side;
+        bitboard ours = attackers & P->whose[side];
+        bitboard from = least_valuable(P, ours, &piece);
+        if (from == BITBOARD_EMPTY) break;
+        // A king can only take when nothing takes it back
+        if (piece == KING && (attackers & P->whose[!side])) break;
+
+        d++;
+        gain[d] = moved - gain[d - 1];
+        moved = SEE_VALUE[piece];
+        all ^= from;
+        attackers = (attackers & all) | get_xrays(P, m.to, all, piece);
+    }
+
+    // Either side can stop capturing when carrying on loses more
+    while (d > 0) {
+        if (-gain[d] < gain[d - 1]) gain[d - 1] = -gain[d];
+        d--;
+    }
+    return gain[0];
+}
+
+bool see_ge(position *P, move m, int threshold) {
+    dbg_requires(P != NULL);
+    if (m.flags == M_FLAG_CASTLING[KINGSIDE] || 
+        m.flags == M_FLAG_CASTLING[QUEENSIDE]) 
+        return 0 >= threshold;
+
+    // swap: how far past the threshold the side to recapture has to get
+    int captured, moved;
+    see_move_values(P, m, &captured, &moved);
+    int swap = captured - threshold;
+    if (swap < 0) return false;
+    swap = moved - swap;
+    if (swap <= 0) return true;
+
+    bitboard all = see_occupied(P, m);
+    bitboard attackers = get_all_attackers(P, m.to, all) & all;
+    Whose side = OURS;
+    bool result = true;
+    while (true) {
+        side = !side;
+        Piece piece;
+        bitboard from = least_valuable(P, attackers & P->whose[side], &piece);
+        if (from == BITBOARD_EMPTY) break;
+        if (piece == KING) {
+            // Taking with the king only stands if nothing takes it back
+            return (attackers & P->whose[!side]) ? result : !result;
+        }
+
+        result = !result;
+        swap = SEE_VALUE[piece] - swap;
+        if (swap < result) break;
+        all ^= from;
+        attackers = (attackers & all) | get_xrays(P, m.to, all, piece);
+    }
+    return result;
+}
+
+/*
+ * ---------------------------------------------------------------------------
+ *                               BOARD MOVE GEN
+ * ---------------------------------------------------------------------------
+ * 
+ * Move generation for the absolute-color board. Every side-dependent function
+ * is written once with a `Color us` parameter and forced inline, then stamped
+ * out for WHITE and BLACK by DEFINE_BOARD_VARIANTS, so each variant compiles
+ * with the side as a constant. Squares in board moves are absolute.
+ */
+
+#define BOARD_INLINE static inline __attribute__((always_inline))
+
+/** @brief Castling rights kept when a move touches a square (absolute) */
+static const uint8_t BOARD_CASTLING_RIGHTS[64] = {
+    // Bits follow CASTLING_MASKS in position.c: WK, WQ, BK, BQ
+    0xB, 0xF, 0xF, 0xF, 0x3, 0xF, 0xF, 0x7,
+    0xF, 0xF, 0xF, 0xF, 0xF, 0xF, 0xF, 0xF,
+    0xF, 0xF, 0xF, 0xF, 0xF, 0xF, 0xF, 0xF,
+    0xF, 0xF, 0xF, 0xF, 0xF, 0xF, 0xF, 0xF,
+    0xF, 0xF, 0xF, 0xF, 0xF, 0xF, 0xF, 0xF,
+    0xF, 0xF, 0xF, 0xF, 0xF, 0xF, 0xF, 0xF,
+    0xF, 0xF, 0xF, 0xF, 0xF, 0xF, 0xF, 0xF,
+    0xE, 0xF, 0xF, 0xF, 0xC, 0xF, 0xF, 0xD
+};
+
+/** @brief Castling squares by color and side (absolute) */
+static const bitboard BOARD_CASTLING_EMPTY_MASK[2][2] = {
+    { 0x0000000000000060, 0x000000000000000E },
+    { 0x6000000000000000, 0x0E00000000000000 }
+};
+static const bitboard BOARD_CASTLING_SAFE_MASK[2][2] = {
+    { 0x0000000000000070, 0x000000000000001C },
+    { 0x7000000000000000, 0x1C00000000000000 }
+};
+static const square BOARD_CASTLING_KING_FROM[2] = { E1, E8 };
+static const square BOARD_CASTLING_KING_TO[2][2] = { { G1, C1 }, { G8, C8 } };
+static const bitboard BOARD_CASTLING_ROOKS[2][2] = {
+    { 0x00000000000000A0, 0x0000000000000009 },     // h1|f1, a1|d1
+    { 0xA000000000000000, 0x0900000000000000 }      // h8|f8, a8|d8
+};
+
+/** @brief Ranks a pawn promotes on, and lands on after a single push it can double */
+static const bitboard BOARD_PROMOTION_RANK[2] = { 0xFF00000000000000, 0x00000000000000FF };
+static const bitboard BOARD_DPP_RANK[2] = { 0x0000000000FF0000, 0x0000FF0000000000 };
+
+/** @brief Shifts a bitboard one rank forward from `us`'s point of view */
+BOARD_INLINE bitboard board_forward(bitboard b, Color us) {
+    return us == WHITE ? b << 8 : b >> 8;
+}
+
+BOARD_INLINE bitboard board_attack_map_for(board *B, Color them) {
+    square from;
+    bitboard all = B->colors[WHITE] | B->colors[BLACK];
+    bitboard attacks = BITBOARD_EMPTY;
+
+    bitboard pawns = B->colors[them] & B->pieces[PAWN];
+    while ((from = bitboard_iter_first(&pawns)) != INVALID_SQUARE) {
+        attacks |= PAWN_ATTACKS[them][from];    // WHITE attacks like OURS
+    }
+
+    bitboard knights = B->colors[them] & B->pieces[KNIGHT];
+    while ((from = bitboard_iter_first(&knights)) != INVALID_SQUARE) {
+        attacks |= KNIGHT_ATTACKS[from];
+    }
+
+    bitboard diagonals = B->colors[them] & (B->pieces[BISHOP] | B->pieces[QUEEN]);
+    while ((from = bitboard_iter_first(&diagonals)) != INVALID_SQUARE) {
+        attacks |= sliding_lookup(&BISHOP_MAGIC_ENTRIES[from], all);
+    }
+
+    bitboard straights = B->colors[them] & (B->pieces[ROOK] | B->pieces[QUEEN]);
+    while ((from = bitboard_iter_first(&straights)) != INVALID_SQUARE) {
+        attacks |= sliding_lookup(&ROOK_MAGIC_ENTRIES[from], all);
+    }
+
+    attacks |= KING_ATTACKS[B->king[them]];
+
+    return attacks;
+}
+
+BOARD_INLINE void board_move_make_for(board *B, move m, undo *U, Color us) {
+    Color them = !us;
+    bitboard from_bb = square_to_bitboard(m.from);
+    bitboard to_bb = square_to_bitboard(m.to);
 
-    for (int i = 0; i < _M->size; i++) {
-        if (move_is_legal(_M->array[i], P))
-            movelist_append(M, _M->array[i]);
+    U->captured = KING;
+    U->castling = B->castling;
+    U->en_passant = B->en_passant;
+    U->halfmoves = B->halfmoves;
+
+    B->en_passant = INVALID_SQUARE;
+    B->halfmoves++;
+    if (us == BLACK) B->fullmoves++;
+    B->castling &= BOARD_CASTLING_RIGHTS[m.from] & BOARD_CASTLING_RIGHTS[m.to];
+    B->color = them;
+
+    if (m.flags == M_FLAG_CASTLING[KINGSIDE] || 
+        m.flags == M_FLAG_CASTLING[QUEENSIDE]) {
+        Castling side = m.flags == M_FLAG_CASTLING[KINGSIDE] ? KINGSIDE : QUEENSIDE;
+        B->pieces[ROOK] ^= BOARD_CASTLING_ROOKS[us][side];
+        B->colors[us] ^= BOARD_CASTLING_ROOKS[us][side] | from_bb | to_bb;
+        B->king[us] = m.to;
+        return;
     }
 
+    B->colors[us] ^= from_bb | to_bb;
+    if (m.piece != KING) B->pieces[m.piece] ^= from_bb;
+    if (m.piece == PAWN) B->halfmoves = 0;
+
+    if (m.flags == M_FLAG_DPP) {
+        B->en_passant = (m.from + m.to) / 2;
+    } else if (m.flags == M_FLAG_EN_PASSANT) {
+        bitboard capture_bb = board_forward(to_bb, them);
+        B->colors[them] ^= capture_bb;
+        B->pieces[PAWN] ^= capture_bb;
+        U->captured = PAWN;
+    } else if (m.flags & M_FLAG_CAPTURE) {
+        for (Piece piece = PAWN; piece <= QUEEN; piece++) {
+            if (B->pieces[piece] & to_bb) {
+                U->captured = piece;
+                break;
+            }
+        }
+        B->colors[them] ^= to_bb;
+        B->pieces[U->captured] ^= to_bb;
+        B->halfmoves = 0;
+    }
+
+    if (m.flags & M_FLAG_IS_PROMOTION)
+        B->pieces[KNIGHT + (m.flags & 0x03)] ^= to_bb;
+    else if (m.piece == KING)
+        B->king[us] = m.to;
+    else 
+        B->pieces[m.piece] ^= to_bb;
+
+    return;
+}
+
+BOARD_INLINE void board_move_unmake_for(board *B, move m, const undo *U, Color us) {
+    Color them = !us;
+    bitboard from_bb = square_to_bitboard(m.from);
+    bitboard to_bb = square_to_bitboard(m.to);
+
+    B->color = us;
+    B->castling = U->castling;
+    B->en_passant = U->en_passant;
+    B->halfmoves = U->halfmoves;
+    if (us == BLACK) B->fullmoves--;
+
+    if (m.flags == M_FLAG_CASTLING[KINGSIDE] || 
+        m.flags == M_FLAG_CASTLING[QUEENSIDE]) {
+        Castling side = m.flags == M_FLAG_CASTLING[KINGSIDE] ? KINGSIDE : QUEENSIDE;
+        B->pieces[ROOK] ^= BOARD_CASTLING_ROOKS[us][side];
+        B->colors[us] ^= BOARD_CASTLING_ROOKS[us][side] | from_bb | to_bb;
+        B->king[us] = m.from;
+        return;
+    }
+
+    B->colors[us] ^= from_bb | to_bb;
+    if (m.flags & M_FLAG_IS_PROMOTION) {
+        B->pieces[KNIGHT + (m.flags & 0x03)] ^= to_bb;
+        B->pieces[PAWN] ^= from_bb;
+    } else if (m.piece == KING) {
+        B->king[us] = m.from;
+    } else {
+        B->pieces[m.piece] ^= from_bb | to_bb;
+    }
+
+    if (m.flags == M_FLAG_EN_PASSANT) {
+        bitboard capture_bb = board_forward(to_bb, them);
+        B->colors[them] ^= capture_bb;
+        B->pieces[PAWN] ^= capture_bb;
+    } else if (m.flags & M_FLAG_CAPTURE) {
+        B->colors[them] ^= to_bb;
+        B->pieces[U->captured] ^= to_bb;
+    }
+
+    return;
+}
+
+/** @brief Whether a pseudo-legal move leaves `us`'s king safe (scratch copy) */
+BOARD_INLINE bool board_move_is_legal_for(board *B, move m, Color us) {
+    undo U;
+    board _B = *B;
+    board_move_make_for(&_B, m, &U, us);
+    return !(square_to_bitboard(_B.king[us]) & board_attack_map_for(&_B, !us));
+}
+
+BOARD_INLINE void board_generate_pawn_moves_for(movelist *M, board *B, Color us) {
+    square from, to;
+    Color them = !us;
+    bitboard empty = ~(B->colors[WHITE] | B->colors[BLACK]);
+    bitboard pawns = B->colors[us] & B->pieces[PAWN];
+
+    while ((from = bitboard_iter_first(&pawns)) != INVALID_SQUARE) {
+        bitboard from_bb = square_to_bitboard(from);
+
+        bitboard captures = PAWN_ATTACKS[us][from] & B->colors[them];
+        while ((to = bitboard_iter_first(&captures)) != INVALID_SQUARE) {
+            if (square_to_bitboard(to) & BOARD_PROMOTION_RANK[us]) {
+                append_promotions(M, from, to, M_FLAG_CAPTURE);
+            } else {
+                move m = { PAWN, from, to, M_FLAG_CAPTURE };
+                movelist_append(M, m);
+            }
+        }
+
+        bitboard single = board_forward(from_bb, us) & empty;
+        if (single & BOARD_PROMOTION_RANK[us]) {
+            append_promotions(M, from, bitboard_to_square(single), M_FLAG_QUIET);
+        } else if (single) {
+            move m = { PAWN, from, bitboard_to_square(single), M_FLAG_QUIET };
+            movelist_append(M, m);
+            bitboard dpp = board_forward(single & BOARD_DPP_RANK[us], us) & empty;
+            if (dpp) {
+                move m = { PAWN, from, bitboard_to_square(dpp), M_FLAG_DPP };
+                movelist_append(M, m);
+            }
+        }
+
+        if (B->en_passant != INVALID_SQUARE && 
+            (PAWN_ATTACKS[us][from] & square_to_bitboard(B->en_passant))) {
+            move m = { PAWN, from, B->en_passant, M_FLAG_EN_PASSANT };
+            movelist_append(M, m);
+        }
+    }
+    return;
+}
+
+BOARD_INLINE movelist *board_generate_moves_for(movelist *M, board *B, Color us) {
+    dbg_requires(M->size == 0);
+    square from;
+    Color them = !us;
+    bitboard all = B->colors[WHITE] | B->colors[BLACK];
+    bitboard ours = B->colors[us];
+    bitboard theirs = B->colors[them];
+
+    board_generate_pawn_moves_for(M, B, us);
+
+    bitboard knights = ours & B->pieces[KNIGHT];
+    while ((from = bitboard_iter_first(&knights)) != INVALID_SQUARE) {
+        append_moves(M, KNIGHT, from, KNIGHT_ATTACKS[from] & ~ours, theirs);
+    }
+
+    bitboard bishops = ours & B->pieces[BISHOP];
+    while ((from = bitboard_iter_first(&bishops)) != INVALID_SQUARE) {
+        bitboard targets = sliding_lookup(&BISHOP_MAGIC_ENTRIES[from], all);
+        append_moves(M, BISHOP, from, targets & ~ours, theirs);
+    }
+
+    bitboard rooks = ours & B->pieces[ROOK];
+    while ((from = bitboard_iter_first(&rooks)) != INVALID_SQUARE) {
+        bitboard targets = sliding_lookup(&ROOK_MAGIC_ENTRIES[from], all);
+        append_moves(M, ROOK, from, targets & ~ours, theirs);
+    }
+
+    bitboard queens = ours & B->pieces[QUEEN];
+    while ((from = bitboard_iter_first(&queens)) != INVALID_SQUARE) {
+        bitboard targets = sliding_lookup(&BISHOP_MAGIC_ENTRIES[from], all) |
+                           sliding_lookup(&ROOK_MAGIC_ENTRIES[from], all);
+        append_moves(M, QUEEN, from, targets & ~ours, theirs);
+    }
+
+    from = B->king[us];
+    append_moves(M, KING, from, KING_ATTACKS[from] & ~ours, theirs);
+
+    uint8_t our_castling = B->castling & ~BOARD_CASTLING_RIGHTS[BOARD_CASTLING_KING_FROM[us]];
+    if (our_castling) {
+        bitboard their_attacks = board_attack_map_for(B, them);
+        for (Castling side = KINGSIDE; side <= QUEENSIDE; side++) {
+            if (board_get_castling(B, OURS, side) &&
+                bitboard_is_empty(BOARD_CASTLING_EMPTY_MASK[us][side] & all) &&
+                bitboard_is_empty(BOARD_CASTLING_SAFE_MASK[us][side] & their_attacks)) {
+                move m = { KING, BOARD_CASTLING_KING_FROM[us], 
+                           BOARD_CASTLING_KING_TO[us][side], M_FLAG_CASTLING[side] };
+                movelist_append(M, m);
+            }
+        }
+    }
+
+    // Keep only the legal moves, compacting the list in place
+    int size = 0;
+    for (int i = 0; i < M->size; i++) {
+        if (board_move_is_legal_for(B, M->array[i], us))
+            M->array[size++] = M->array[i];
+    }
+    M->size = size;
+
     return M;
-}
\ No newline at end of file
+}
+
+#define DEFINE_BOARD_VARIANTS(COLOR)                                           \
+    static movelist *board_generate_moves_##COLOR(movelist *M, board *B) {     \
+        return board_generate_moves_for(M, B, COLOR);                          \
+    }                                                                          \
+    static void board_move_make_##COLOR(board *B, move m, undo *U) {           \
+        board_move_make_for(B, m, U, COLOR);                                   \
+    }                                                                          \
+    static void board_move_unmake_##COLOR(board *B, move m, const undo *U) {   \
+        board_move_unmake_for(B, m, U, COLOR);                                 \
+    }
+
+DEFINE_BOARD_VARIANTS(WHITE)
+DEFINE_BOARD_VARIANTS(BLACK)
+
+void board_move_make(board *B, move m, undo *U) {
+    dbg_requires(B != NULL && U != NULL);
+    if (B->color == WHITE) board_move_make_WHITE(B, m, U);
+    else board_move_make_BLACK(B, m, U);
+    return;
+}
+
+void board_move_unmake(board *B, move m, const undo *U) {
+    dbg_requires(B != NULL && U != NULL);
+    // The board was handed over to the other side by board_move_make
+    if (B->color == BLACK) board_move_unmake_WHITE(B, m, U);
+    else board_move_unmake_BLACK(B, m, U);
+    return;
+}
+
+bitboard build_board_attack_map(board *B, Whose whose) {
+    return board_attack_map_for(B, board_get_color(B, whose));
+}
+
+bool board_king_in_check(board *B, Whose whose) {
+    return board_get_king(B, whose) & build_board_attack_map(B, !whose);
+}
+
+movelist *generate_board_moves(movelist *M, board *B) {
+    if (B->color == WHITE) return board_generate_moves_WHITE(M, B);
+    return board_generate_moves_BLACK(M, B);
+}
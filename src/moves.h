@@ -38,24 +38,58 @@ typedef enum GameState {
  *   15  |      1        |      1      |     1      |     1      | Q x promo
  */
 typedef struct move {
-    Piece piece;
+    uint8_t piece;      // a Piece, kept to a byte so a move fits in 32 bits
     square from;
     square to;
     uint8_t flags;
 } move;
 
+/** @brief Room for a move in long algebraic notation, e.g. "e7e8q" */
+#define MOVE_STRING_SIZE 6
+
+/** @brief Upper bound on the moves in a position (the known maximum is 218) */
+#define MAX_MOVES 256
+
 /**
- * @brief A dynamic array housing the legal or pseudo-legal moves
+ * @brief A fixed-capacity array housing the legal or pseudo-legal moves
+ * 
+ * Meant to live on the caller's stack (or in a per-ply search stack), so that
+ * move generation never touches the heap:
  * 
- * Array size doubles or halves when resizing
+ *     movelist M;
+ *     movelist_clear(&M);
+ *     generate_moves(&M, P);
+ * 
+ * movelist_new/movelist_free remain for callers that want a heap movelist_t.
  */
 typedef struct movelist {
-    move *array;
+    move array[MAX_MOVES];
     int size;
-    int limit;
 } movelist;
 typedef movelist *movelist_t;
 
+/** @brief Implementations of the sliding piece attack lookups */
+typedef enum SliderBackend {
+    SLIDER_RAYS,    // bitscan along each ray (reference implementation)
+    SLIDER_MAGIC,   // fancy magic bitboards
+    SLIDER_PEXT     // BMI2 pext indexing, only in a `make PEXT=1` build
+} SliderBackend;
+
+/** 
+ * @brief Everything a move destroys that can't be recovered from the move
+ * 
+ * Filled in by move_make and consumed by move_unmake, so that a tree can be
+ * walked in place instead of copying the position at every node.
+ */
+typedef struct undo {
+    Piece    captured;    // KING if the move captured nothing
+    square   en_passant;  // our en passant capture square, or INVALID_SQUARE
+    uint8_t  castling;
+    uint16_t halfmoves;
+    uint64_t hash;
+    uint64_t pawn_hash;
+} undo;
+
 /** @brief An invalid move returned by popping from an empty movelist */
 extern const move NULL_MOVE;
 
@@ -74,19 +108,68 @@ extern const uint8_t M_FLAG_PROMOTION[5];   // 8, 9, 10, 11
  * ---------------------------------------------------------------------------
  */
 
-/** @brief Applies a pseudo-legal move and returns the old position */
-position move_make(position *P, move m);
+/**
+ * @brief Applies a pseudo-legal move for OUR side
+ * 
+ * The position is not rotated, call position_rotate to hand the move over to
+ * the other side.
+ * 
+ * @param[in] P
+ * @param[in] m
+ * @param[out] U (what's needed to take the move back)
+ * @pre P != NULL && U != NULL
+ */
+void move_make(position *P, move m, undo *U);
+
+/**
+ * @brief Takes back a move applied by move_make
+ * 
+ * @param[in] P (in the same orientation move_make left it in)
+ * @param[in] m
+ * @param[in] U (filled in by move_make)
+ * @pre P != NULL && U != NULL
+ */
+void move_unmake(position *P, move m, const undo *U);
+
+/**
+ * @brief Passes the move: only the en passant right is lost
+ * 
+ * For null-move pruning. Like move_make, call position_rotate afterwards.
+ * 
+ * @param[in] P (not in check)
+ * @param[out] U
+ * @pre P != NULL && U != NULL
+ */
+void move_make_null(position *P, undo *U);
+
+/**
+ * @brief Takes back a move_make_null
+ * 
+ * @pre P != NULL && U != NULL
+ */
+void move_unmake_null(position *P, const undo *U);
 
 /** @brief Prints a move in human-readable format */
 void move_print(move m, Color c);
 
+/**
+ * @brief Writes a move in long algebraic (UCI) notation, e.g. "e2e4", "e1g1"
+ * 
+ * @param[in] m
+ * @param[in] c (the color that plays the move, to un-rotate BLACK squares)
+ * @param[out] str (at least MOVE_STRING_SIZE chars)
+ * 
+ * @return str
+ */
+char *move_to_string(move m, Color c, char *str);
+
 /*
  * ---------------------------------------------------------------------------
  *                                 MOVELIST
  * ---------------------------------------------------------------------------
  */
 
-/** @brief Dynamically allocates a movelist */
+/** @brief Dynamically allocates an empty movelist */
 movelist_t movelist_new(void);
 
 /** @brief Gets the length of the array */
@@ -102,6 +185,39 @@ void movelist_free(movelist_t M);
 /** @brief Prints all the moves in the movelist */
 void movelist_print(movelist_t M, Color c);
 
+/*
+ * ---------------------------------------------------------------------------
+ *                              SLIDING ATTACKS
+ * ---------------------------------------------------------------------------
+ */
+
+/** @brief Builds the sliding attack tables, must be called before move gen */
+void moves_init(void);
+
+/** @brief Whether a backend was compiled in */
+bool slider_backend_available(SliderBackend backend);
+
+/** @brief The backend used by move generation (PEXT if compiled in, else magic) */
+SliderBackend slider_backend(void);
+
+/**
+ * @brief Computes slider attacks with a specific backend
+ * 
+ * Move generation never goes through here, it's for testing and benchmarking
+ * the backends against each other.
+ * 
+ * @param[in] backend
+ * @param[in] piece
+ * @param[in] from
+ * @param[in] all (every occupied square)
+ * @pre piece == BISHOP || piece == ROOK || piece == QUEEN
+ * @pre slider_backend_available(backend)
+ * 
+ * @return The squares attacked by `piece` on `from`
+ */
+bitboard slider_attacks(SliderBackend backend, Piece piece, square from, 
+                        bitboard all);
+
 /*
  * ---------------------------------------------------------------------------
  *                                 MOVE GEN
@@ -116,7 +232,105 @@ bool king_in_check(position *P, Whose whose);
 
 GameState get_game_state(position *P, movelist_t M);
 
-/** @brief Populates a movelist with all legal moves for OUR pieces */
+/** 
+ * @brief Populates a movelist with all legal moves for OUR pieces
+ * 
+ * Checkers, pinned pieces and the squares our king can't step to are worked
+ * out once per position, so only legal moves are ever emitted.
+ */
 movelist_t generate_moves(movelist_t M, position *P);
 
+/** 
+ * @brief Populates a movelist with only the legal captures and promotions
+ * 
+ * The moves of generate_moves that take a piece (en passant included) or
+ * promote, for quiescence search: no quiet move is ever generated.
+ */
+movelist_t generate_captures(movelist_t M, position *P);
+
+/** 
+ * @brief Populates a movelist with the legal moves generate_captures leaves
+ * out: no capture and no promotion
+ */
+movelist_t generate_quiets(movelist_t M, position *P);
+
+/**
+ * @brief Whether a move is one generate_moves would emit
+ * 
+ * For moves from elsewhere (the transposition table, killers) that may not
+ * belong to this position, checked without generating any moves.
+ * 
+ * @pre P != NULL
+ */
+bool move_is_valid(position *P, move m);
+
+/** @brief The piece a move of OUR side takes, KING if it takes nothing */
+Piece move_captured(position *P, move m);
+
+/** 
+ * @brief Same moves as generate_moves, by filtering pseudo-legal moves
+ * 
+ * Tries every move on a copy of the position, much slower; kept as a
+ * reference to test generate_moves against.
+ */
+movelist_t generate_moves_reference(movelist_t M, position *P);
+
+/*
+ * ---------------------------------------------------------------------------
+ *                              STATIC EXCHANGE
+ * ---------------------------------------------------------------------------
+ */
+
+/** @brief Piece values for exchanges, by Piece; the king's can't be traded */
+extern const int SEE_VALUE[6];
+
+/**
+ * @brief Material OUR side comes out of the exchange on a move's square with
+ * 
+ * Both sides capture with their least valuable attacker, sliders behind the
+ * pieces taken off join in (x-rays), and either side stops once taking on
+ * loses more. Pins and checks are ignored. A quiet move scores what it
+ * loses by standing where it can be taken.
+ * 
+ * @param[in] P
+ * @param[in] m (a legal move for OUR side)
+ * @return centipawns, see SEE_VALUE
+ * @pre P != NULL
+ */
+int see(position *P, move m);
+
+/**
+ * @brief Whether see(P, m) >= threshold
+ * 
+ * Stops as soon as the outcome can't cross the threshold any more, so it's
+ * cheaper than see when only the sign (or a margin) matters.
+ * 
+ * @pre P != NULL
+ */
+bool see_ge(position *P, move m, int threshold);
+
+/*
+ * ---------------------------------------------------------------------------
+ *                               BOARD MOVE GEN
+ * ---------------------------------------------------------------------------
+ * 
+ * The same operations on the absolute-color `board`, specialised per side.
+ * Moves use absolute squares, and castling moves carry the king's from/to.
+ */
+
+/** @brief Applies a pseudo-legal move and hands the board to the other side */
+void board_move_make(board *B, move m, undo *U);
+
+/** @brief Takes back a move applied by board_move_make */
+void board_move_unmake(board *B, move m, const undo *U);
+
+/** @brief Returns all the squares attacked by the pieces of `whose` */
+bitboard build_board_attack_map(board *B, Whose whose);
+
+/** @brief Whether a king is in check or not */
+bool board_king_in_check(board *B, Whose whose);
+
+/** @brief Populates a movelist with all legal moves for the side to move */
+movelist_t generate_board_moves(movelist_t M, board *B);
+
 #endif
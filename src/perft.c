@@ -0,0 +1,435 @@
+/**
+ * @file perft.c
+ * @brief Provides the implementation for counting the nodes of the move tree.
+ */
+
+#include "position.h"
+#include "moves.h"
+#include "perft.h"
+#include "zobrist.h"
+
+#include "../lib/contracts.h"
+
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+uint64_t perft(position *P, int depth) {
+    dbg_requires(P != NULL && depth >= 0);
+    if (depth == 0) return 1;
+
+    movelist M;
+    movelist_clear(&M);
+    generate_moves(&M, P);
+    if (depth == 1) return M.size;
+
+    uint64_t nodes = 0;
+    for (int i = 0; i < M.size; i++) {
+        undo U;
+        position _P = *P;
+        move_make(&_P, M.array[i], &U);
+        position_rotate(&_P);
+        nodes += perft(&_P, depth - 1);
+    }
+
+    return nodes;
+}
+
+uint64_t perft_divide(position *P, int depth) {
+    dbg_requires(P != NULL && depth >= 1);
+
+    movelist M;
+    movelist_clear(&M);
+    generate_moves(&M, P);
+
+    uint64_t nodes = 0;
+    for (int i = 0; i < M.size; i++) {
+        undo U;
+        char str[MOVE_STRING_SIZE];
+        position _P = *P;
+        move_make(&_P, M.array[i], &U);
+        position_rotate(&_P);
+        uint64_t count = perft(&_P, depth - 1);
+        printf("%s: %" PRIu64 "\n", move_to_string(M.array[i], P->color, str), 
+               count);
+        nodes += count;
+    }
+    printf("\n");
+
+    return nodes;
+}
+
+/*
+ * ---------------------------------------------------------------------------
+ *                                HASHED PERFT
+ * ---------------------------------------------------------------------------
+ */
+
+/** @brief One ply of a walk: the position and its moves */
+typedef struct perft_frame {
+    position P;
+    movelist M;
+} perft_frame;
+
+/** @brief A subtree count, data is nodes << 8 | depth */
+typedef struct perft_entry {
+    uint64_t check;     // hash ^ data
+    uint64_t data;
+} perft_entry;
+
+/** @brief Slot 0 keeps the deepest subtree seen, slot 1 the latest other one */
+typedef struct perft_bucket {
+    perft_entry slots[2];
+} perft_bucket;
+
+struct perft_table {
+    perft_bucket *buckets;
+    uint64_t mask;          // number of buckets - 1
+    bool prefetch;
+    uint64_t probes;
+    uint64_t hits;
+    uint64_t prefetches;
+};
+
+/** @brief Lookups made by one walk, added to the table's totals at the end */
+typedef struct perft_stats {
+    uint64_t probes;
+    uint64_t hits;
+    uint64_t prefetches;
+} perft_stats;
+
+perft_table *perft_table_new(size_t megabytes) {
+    dbg_requires(megabytes >= 1);
+    perft_table *T = malloc(sizeof(perft_table));
+    if (T == NULL) {
+        perror("malloc error");
+        exit(1);
+    }
+
+    uint64_t buckets = 1;
+    while (buckets * 2 * sizeof(perft_bucket) <= megabytes << 20) {
+        buckets *= 2;
+    }
+    T->buckets = calloc(buckets, sizeof(perft_bucket));
+    if (T->buckets == NULL) {
+        perror("calloc error");
+        exit(1);
+    }
+    T->mask = buckets - 1;
+    T->prefetch = false;
+    T->probes = 0;
+    T->hits = 0;
+    T->prefetches = 0;
+
+    return T;
+}
+
+void perft_table_free(perft_table *T) {
+    free(T->buckets);
+    free(T);
+    return;
+}
+
+uint64_t perft_table_probes(perft_table *T) {
+    return __atomic_load_n(&T->probes, __ATOMIC_RELAXED);
+}
+
+uint64_t perft_table_hits(perft_table *T) {
+    return __atomic_load_n(&T->hits, __ATOMIC_RELAXED);
+}
+
+uint64_t perft_table_prefetches(perft_table *T) {
+    return __atomic_load_n(&T->prefetches, __ATOMIC_RELAXED);
+}
+
+void perft_table_set_prefetch(perft_table *T, bool prefetch) {
+    T->prefetch = prefetch;
+    return;
+}
+
+/** @brief Starts loading the bucket of `key` into the cache */
+static inline void perft_table_prefetch(perft_table *T, zhash key) {
+    __builtin_prefetch(&T->buckets[key & T->mask]);
+    return;
+}
+
+/** @brief Looks for the count of a subtree, `depth` plies deep */
+static bool perft_table_probe(perft_table *T, zhash key, int depth, 
+                              uint64_t *nodes) {
+    perft_bucket *B = &T->buckets[key & T->mask];
+    for (int i = 0; i < 2; i++) {
+        uint64_t data = __atomic_load_n(&B->slots[i].data, __ATOMIC_RELAXED);
+        uint64_t check = __atomic_load_n(&B->slots[i].check, __ATOMIC_RELAXED);
+        if ((check ^ data) == key && (int) (data & 0xFF) == depth) {
+            *nodes = data >> 8;
+            return true;
+        }
+    }
+    return false;
+}
+
+static void perft_table_store(perft_table *T, zhash key, int depth, 
+                              uint64_t nodes) {
+    perft_bucket *B = &T->buckets[key & T->mask];
+    uint64_t data = nodes << 8 | depth;
+    uint64_t deepest = __atomic_load_n(&B->slots[0].data, __ATOMIC_RELAXED);
+    perft_entry *E = depth >= (int) (deepest & 0xFF) ? &B->slots[0] 
+                                                     : &B->slots[1];
+    __atomic_store_n(&E->check, key ^ data, __ATOMIC_RELAXED);
+    __atomic_store_n(&E->data, data, __ATOMIC_RELAXED);
+    return;
+}
+
+/** @brief Adds a walk's lookups to the table, other threads may be adding too */
+static void perft_stats_flush(perft_table *T, perft_stats *S) {
+    __atomic_fetch_add(&T->probes, S->probes, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&T->hits, S->hits, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&T->prefetches, S->prefetches, __ATOMIC_RELAXED);
+    return;
+}
+
+/** 
+ * @brief perft over a stack of frames, copy-making each child into the next
+ * 
+ * Subtrees of depth 2 and more go through T when there is one, depth 1 is
+ * bulk counted and cheaper to redo than to look up.
+ */
+static uint64_t perft_frames(perft_frame *F, int depth, perft_table *T, 
+                             perft_stats *S) {
+    if (depth == 0) return 1;
+
+    // With prefetching, the bucket was requested when the parent made the
+    // move; generating moves before probing gives the load time to land
+    bool generated = false;
+    if (T != NULL && T->prefetch && depth >= 2) {
+        movelist_clear(&F->M);
+        generate_moves(&F->M, &F->P);
+        generated = true;
+    }
+
+    zhash key = 0;
+    uint64_t nodes = 0;
+    if (T != NULL && depth >= 2) {
+        key = F->P.hash;
+        S->probes++;
+        if (perft_table_probe(T, key, depth, &nodes)) {
+            S->hits++;
+            return nodes;
+        }
+    }
+
+    if (!generated) {
+        movelist_clear(&F->M);
+        generate_moves(&F->M, &F->P);
+    }
+    if (depth == 1) return F->M.size;
+
+    bool prefetch = T != NULL && T->prefetch && depth - 1 >= 2;
+    for (int i = 0; i < F->M.size; i++) {
+        undo U;
+        F[1].P = F->P;
+        move_make(&F[1].P, F->M.array[i], &U);
+        position_rotate(&F[1].P);
+        if (prefetch) {
+            perft_table_prefetch(T, F[1].P.hash);
+            S->prefetches++;
+        }
+        nodes += perft_frames(F + 1, depth - 1, T, S);
+    }
+
+    if (T != NULL) perft_table_store(T, key, depth, nodes);
+    return nodes;
+}
+
+/** @brief Allocates a frame stack deep enough for a `depth` ply walk */
+static perft_frame *perft_frames_new(int depth) {
+    perft_frame *F = malloc((depth + 1) * sizeof(perft_frame));
+    if (F == NULL) {
+        perror("malloc error");
+        exit(1);
+    }
+    return F;
+}
+
+uint64_t perft_hashed(position *P, int depth, perft_table *T) {
+    dbg_requires(P != NULL && depth >= 0 && T != NULL);
+    perft_stats S = { 0, 0, 0 };
+    perft_frame *F = perft_frames_new(depth);
+    F[0].P = *P;
+    uint64_t nodes = perft_frames(F, depth, T, &S);
+    perft_stats_flush(T, &S);
+    free(F);
+    return nodes;
+}
+
+/*
+ * ---------------------------------------------------------------------------
+ *                               PARALLEL PERFT
+ * ---------------------------------------------------------------------------
+ */
+
+/** @brief A subtree to count, and its count once a worker has counted it */
+typedef struct perft_task {
+    position P;
+    uint64_t nodes;
+} perft_task;
+
+/** @brief The tasks [head, tail) not yet taken from a worker's deque */
+typedef struct perft_deque {
+    pthread_mutex_t lock;
+    int head;
+    int tail;
+} perft_deque;
+
+typedef struct perft_pool {
+    perft_task *tasks;
+    int num_tasks;
+    int depth;              // remaining depth below every task
+    perft_deque *deques;
+    int threads;
+    perft_table *T;         // shared by the workers, or NULL
+} perft_pool;
+
+typedef struct perft_worker {
+    perft_pool *pool;
+    int id;
+    perft_frame *frames;    // depth + 1 frames, frames[0] holds the task
+} perft_worker;
+
+/** @brief Grows the task array by doubling when it's full */
+static void perft_task_append(perft_pool *pool, int *capacity, position *P) {
+    if (pool->num_tasks == *capacity) {
+        *capacity *= 2;
+        pool->tasks = realloc(pool->tasks, *capacity * sizeof(perft_task));
+        if (pool->tasks == NULL) {
+            perror("realloc error");
+            exit(1);
+        }
+    }
+    pool->tasks[pool->num_tasks].P = *P;
+    pool->tasks[pool->num_tasks].nodes = 0;
+    pool->num_tasks++;
+    return;
+}
+
+/** @brief Collects every position `depth` plies below P as a task */
+static void perft_split(perft_pool *pool, int *capacity, position *P, 
+                        int depth) {
+    if (depth == 0) {
+        perft_task_append(pool, capacity, P);
+        return;
+    }
+
+    movelist M;
+    movelist_clear(&M);
+    generate_moves(&M, P);
+    for (int i = 0; i < M.size; i++) {
+        undo U;
+        position _P = *P;
+        move_make(&_P, M.array[i], &U);
+        position_rotate(&_P);
+        perft_split(pool, capacity, &_P, depth - 1);
+    }
+    return;
+}
+
+/** 
+ * @brief Takes a task off the front of our deque, or the back of another's
+ * 
+ * @return The task's index, or -1 once every deque is empty
+ */
+static int perft_take(perft_pool *pool, int id) {
+    for (int i = 0; i < pool->threads; i++) {
+        int victim = (id + i) % pool->threads;
+        perft_deque *D = &pool->deques[victim];
+        int task = -1;
+
+        pthread_mutex_lock(&D->lock);
+        if (D->head < D->tail) 
+            task = victim == id ? D->head++ : --D->tail;
+        pthread_mutex_unlock(&D->lock);
+
+        if (task >= 0) return task;
+    }
+    // Tasks never spawn tasks, so empty deques stay empty
+    return -1;
+}
+
+static void *perft_work(void *arg) {
+    perft_worker *W = arg;
+    perft_pool *pool = W->pool;
+
+    perft_stats S = { 0, 0, 0 };
+    int task;
+    while ((task = perft_take(pool, W->id)) >= 0) {
+        W->frames[0].P = pool->tasks[task].P;
+        pool->tasks[task].nodes = perft_frames(W->frames, pool->depth, 
+                                               pool->T, &S);
+    }
+    if (pool->T != NULL) perft_stats_flush(pool->T, &S);
+
+    return NULL;
+}
+
+uint64_t perft_parallel(position *P, int depth, int threads, int split_depth,
+                        perft_table *T) {
+    dbg_requires(P != NULL && depth >= 0);
+    dbg_requires(threads >= 1 && split_depth >= 1);
+    if (split_depth > depth - 1) split_depth = depth - 1;
+    if (split_depth < 1) return T != NULL ? perft_hashed(P, depth, T) 
+                                          : perft(P, depth);
+
+    perft_pool pool;
+    int capacity = 64;
+    pool.tasks = malloc(capacity * sizeof(perft_task));
+    pool.deques = malloc(threads * sizeof(perft_deque));
+    perft_worker *workers = malloc(threads * sizeof(perft_worker));
+    pthread_t *ids = malloc(threads * sizeof(pthread_t));
+    if (pool.tasks == NULL || pool.deques == NULL || workers == NULL || 
+        ids == NULL) {
+        perror("malloc error");
+        exit(1);
+    }
+    pool.num_tasks = 0;
+    pool.depth = depth - split_depth;
+    pool.threads = threads;
+    pool.T = T;
+    perft_split(&pool, &capacity, P, split_depth);
+
+    // Deal out contiguous runs of tasks, neighbouring subtrees stay together
+    for (int i = 0; i < threads; i++) {
+        pthread_mutex_init(&pool.deques[i].lock, NULL);
+        pool.deques[i].head = (int64_t) pool.num_tasks * i / threads;
+        pool.deques[i].tail = (int64_t) pool.num_tasks * (i + 1) / threads;
+    }
+
+    for (int i = 0; i < threads; i++) {
+        workers[i].pool = &pool;
+        workers[i].id = i;
+        workers[i].frames = perft_frames_new(pool.depth);
+        if (pthread_create(&ids[i], NULL, perft_work, &workers[i]) != 0) {
+            perror("pthread_create error");
+            exit(1);
+        }
+    }
+
+    for (int i = 0; i < threads; i++) {
+        pthread_join(ids[i], NULL);
+        free(workers[i].frames);
+        pthread_mutex_destroy(&pool.deques[i].lock);
+    }
+
+    uint64_t nodes = 0;
+    for (int i = 0; i < pool.num_tasks; i++) {
+        nodes += pool.tasks[i].nodes;
+    }
+
+    free(ids);
+    free(workers);
+    free(pool.deques);
+    free(pool.tasks);
+
+    return nodes;
+}
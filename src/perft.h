@@ -0,0 +1,103 @@
+/**
+ * @file perft.h
+ * @brief Provides an interface for counting the nodes of the move tree.
+ * 
+ * Perft counts are known for many positions, which makes them the standard
+ * way of checking move generation, and of timing it.
+ */
+
+#ifndef _PERFT_H_
+#define _PERFT_H_
+
+#include "position.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/** 
+ * @brief A table of (hash, depth) -> subtree count, shared lock-free 
+ * 
+ * Entries are stored as (hash ^ data, data): a read racing with a write sees
+ * a mismatched pair and is treated as a miss, so no locks are needed.
+ */
+typedef struct perft_table perft_table;
+
+/**
+ * @brief Counts the leaf nodes of the legal move tree `depth` plies deep
+ * 
+ * The last ply is bulk counted: its moves are generated but never made.
+ * 
+ * @param[in] P
+ * @param[in] depth
+ * @pre P != NULL && depth >= 0
+ */
+uint64_t perft(position *P, int depth);
+
+/**
+ * @brief Same as perft, but prints the count under each root move
+ * 
+ * @pre P != NULL && depth >= 1
+ */
+uint64_t perft_divide(position *P, int depth);
+
+/**
+ * @brief Same count as perft, looking subtrees up in a table before walking
+ * 
+ * @param[in] P
+ * @param[in] depth
+ * @param[in] T (may be shared with other threads, see perft_table_new)
+ * @pre P != NULL && depth >= 0 && T != NULL
+ */
+uint64_t perft_hashed(position *P, int depth, perft_table *T);
+
+/**
+ * @brief Same count as perft, with the tree split across a pool of threads
+ * 
+ * Every node `split_depth` plies below the root becomes a task. Tasks are
+ * dealt out to one deque per worker, and a worker that runs out steals from
+ * the back of the others' deques. Each worker walks its tasks with its own
+ * position and move stack, so nothing is shared but the deques.
+ * 
+ * @param[in] P
+ * @param[in] depth
+ * @param[in] threads
+ * @param[in] split_depth (clamped to depth - 1)
+ * @param[in] T (shared by all the workers, or NULL to not hash)
+ * @pre P != NULL && depth >= 0 && threads >= 1 && split_depth >= 1
+ */
+uint64_t perft_parallel(position *P, int depth, int threads, int split_depth,
+                        perft_table *T);
+
+/**
+ * @brief Allocates an empty perft table
+ * 
+ * The table is keyed by the Zobrist hash positions carry (see zobrist.h).
+ * 
+ * @param[in] megabytes (rounded down to a power of two number of buckets)
+ * @pre megabytes >= 1
+ */
+perft_table *perft_table_new(size_t megabytes);
+
+/** @brief Frees a perft table */
+void perft_table_free(perft_table *T);
+
+/** @brief Lookups made in a table, and how many of them found a count */
+uint64_t perft_table_probes(perft_table *T);
+uint64_t perft_table_hits(perft_table *T);
+
+/** @brief Buckets prefetched ahead of their lookups */
+uint64_t perft_table_prefetches(perft_table *T);
+
+/**
+ * @brief Turns prefetching on or off (the default), to measure what it buys
+ *
+ * With prefetching, the bucket of each child is requested as soon as its move
+ * is made, and the child generates its moves before probing, so that the
+ * load from memory overlaps with move generation instead of stalling it.
+ * perft probes too rarely for that to pay for the moves generated at nodes
+ * that then hit, so it is off unless asked for.
+ */
+void perft_table_set_prefetch(perft_table *T, bool prefetch);
+
+#endif
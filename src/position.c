@@ -5,6 +5,7 @@
 
 #include "position.h"
 #include "bits.h"
+#include "zobrist.h"
 
 #include "../lib/contracts.h"
 
@@ -23,8 +24,7 @@ const char PIECE_CHARS[2][6] = {
     { 'p', 'n', 'b', 'r', 'q', 'k' }
 };
 
-/** @brief Gets the pawns from P->pieces[PAWN] */
-static const bitboard PAWNS_MASK = 0x00FFFFFFFFFFFF00;
+const bitboard PAWNS_MASK = 0x00FFFFFFFFFFFF00;
 
 /** @brief En_passant flags for P->pieces[PAWN] */
 static const bitboard EN_PASSANT_MASKS[2] = { 0xFF00000000000000 , 
@@ -88,6 +88,8 @@ void position_clear(position *P) {
     P->halfmoves = P->fullmoves = 0;
     P->castling = 0b0000;
     P->color = WHITE;
+    P->hash = 0;    // hash_position of an empty board
+    P->pawn_hash = 0;
     return;
 }
 
@@ -195,7 +197,11 @@ void position_from_fen(position *P, const char *fen) {
     bool is_black;
 
     temp = malloc(sizeof(char) * (strlen(fen)+1));
-    temp = strncpy(temp, fen, strlen(fen));
+    if (temp == NULL) {
+        perror("malloc error");
+        exit(1);
+    }
+    strcpy(temp, fen);
 
     position_clear(P);
 
@@ -250,22 +256,27 @@ void position_from_fen(position *P, const char *fen) {
         }
     }
 
-    // En passant flag
+    // En passant flag (capture square, set while the board is still white's)
     token = strtok(NULL, " ");
-    if (token[0] != '-')
-        return;
+    if (token != NULL && token[0] != '-') {
+        square ep_square = square_from_string(token);
+        if (is_black) position_set_en_passant(P, THEIRS, ep_square + 8);
+        else position_set_en_passant(P, OURS, ep_square - 8);
+    }
 
-    // Halfmove
+    // Halfmove and fullmove (optional, EPD records leave them out)
     token = strtok(NULL, " ");
-    P->halfmoves = strtol(token, NULL, 10);
-
-    // Fullmove
+    P->halfmoves = token != NULL ? strtol(token, NULL, 10) : 0;
     token = strtok(NULL, " ");
-    P->fullmoves = strtol(token, NULL, 10);
+    P->fullmoves = token != NULL ? strtol(token, NULL, 10) : 1;
 
     if (is_black) {
         position_rotate(P);
     }
+    P->hash = hash_position(P);
+    P->pawn_hash = hash_pawns(P);
+
+    free(temp);
     
     dbg_ensures(is_position(P));
     return;
@@ -292,6 +303,7 @@ square position_get_en_passant(position *P, Whose whose) {
     dbg_requires(is_position(P));
     square offset = whose ? 16 : -16; // -16 if OURS, +16 if THEIRS
     bitboard en_passant_bb = P->pieces[PAWN] & EN_PASSANT_MASKS[whose];
+    if (bitboard_is_empty(en_passant_bb)) return INVALID_SQUARE;
     return bitboard_to_square(en_passant_bb) + offset;
 }
 
@@ -333,6 +345,12 @@ void position_set_castling(position *P, Whose whose, Castling castling, bool can
     return;
 }
 
+bool position_has_non_pawn_material(position *P, Whose whose) {
+    bitboard pieces = P->pieces[KNIGHT] | P->pieces[BISHOP] | 
+                      P->pieces[ROOK] | P->pieces[QUEEN];
+    return !bitboard_is_empty(P->whose[whose] & pieces);
+}
+
 void position_rotate(position *P) {
     P->whose[OURS] = bitboard_rotate(P->whose[OURS]);
     P->whose[THEIRS] = bitboard_rotate(P->whose[THEIRS]);
@@ -356,6 +374,7 @@ void position_rotate(position *P) {
     P->castling = (our_castling >> 2) | (their_castling << 2);
     
     P->color = !P->color;
+    P->hash ^= COLOR_PRN;
 }
 
 void position_print(position *P) {
@@ -415,4 +434,98 @@ void position_print(position *P) {
     if (P->castling & CASTLING_MASKS[THEIRS][KINGSIDE]) printf("O-O ");
     if (P->castling & CASTLING_MASKS[THEIRS][QUEENSIDE]) printf("O-O-O ");
     printf("\n");
-}
\ No newline at end of file
+}
+
+/*
+ * ---------------------------------------------------------------------------
+ *                                  BOARDS
+ * ---------------------------------------------------------------------------
+ */
+
+void board_from_position(board *B, position *P) {
+    dbg_requires(B != NULL && is_position(P));
+    position _P = *P;
+    square en_passant = position_get_en_passant(&_P, OURS);
+    if (_P.color == BLACK) {
+        position_rotate(&_P);   // back to white's squares, white is now OURS
+        if (en_passant != INVALID_SQUARE) en_passant = 63 - en_passant;
+    }
+
+    B->colors[WHITE] = _P.whose[OURS];
+    B->colors[BLACK] = _P.whose[THEIRS];
+    for (Piece piece = PAWN; piece <= QUEEN; piece++) {
+        B->pieces[piece] = _P.pieces[piece];
+    }
+    B->pieces[PAWN] &= PAWNS_MASK;
+    B->king[WHITE] = _P.king[OURS];
+    B->king[BLACK] = _P.king[THEIRS];
+    B->en_passant = en_passant;
+    B->halfmoves = _P.halfmoves;
+    B->fullmoves = _P.fullmoves;
+    B->castling = _P.castling;
+    B->color = P->color;
+    return;
+}
+
+void board_to_position(position *P, board *B) {
+    dbg_requires(P != NULL && B != NULL);
+    P->whose[OURS] = B->colors[WHITE];
+    P->whose[THEIRS] = B->colors[BLACK];
+    for (Piece piece = PAWN; piece <= QUEEN; piece++) {
+        P->pieces[piece] = B->pieces[piece];
+    }
+    P->king[OURS] = B->king[WHITE];
+    P->king[THEIRS] = B->king[BLACK];
+    P->halfmoves = B->halfmoves;
+    P->fullmoves = B->fullmoves;
+    P->castling = B->castling;
+    P->color = WHITE;
+
+    if (B->en_passant != INVALID_SQUARE) {
+        if (B->color == WHITE) position_set_en_passant(P, OURS, B->en_passant - 8);
+        else position_set_en_passant(P, THEIRS, B->en_passant + 8);
+    }
+    if (B->color == BLACK) position_rotate(P);
+    P->hash = hash_position(P);
+    P->pawn_hash = hash_pawns(P);
+
+    dbg_ensures(is_position(P));
+    return;
+}
+
+void board_from_fen(board *B, const char *fen) {
+    position P;
+    position_from_fen(&P, fen);
+    board_from_position(B, &P);
+    return;
+}
+
+Color board_get_color(board *B, Whose whose) {
+    return B->color ^ whose;
+}
+
+bitboard board_get_pieces(board *B, Whose whose, Piece piece) {
+    return B->colors[board_get_color(B, whose)] & B->pieces[piece];
+}
+
+bitboard board_get_king(board *B, Whose whose) {
+    return square_to_bitboard(B->king[board_get_color(B, whose)]);
+}
+
+bool board_get_castling(board *B, Whose whose, Castling castling) {
+    // Colors share their index with Whose: WHITE's bits are OURS' bits
+    return B->castling & CASTLING_MASKS[board_get_color(B, whose)][castling];
+}
+
+void board_set_castling(board *B, Color color, Castling castling, bool can_castle) {
+    B->castling = (B->castling & ~CASTLING_MASKS[color][castling]) | 
+                  (CASTLING_MASKS[color][castling] * can_castle);
+    return;
+}
+
+void board_print(board *B) {
+    position P;
+    board_to_position(&P, B);
+    position_print(&P);
+    return;
+}
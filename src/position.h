@@ -61,9 +61,29 @@ typedef struct position {
     uint16_t fullmoves;
     uint8_t  castling;    // a four-bit word
     Color    color;       // WHITE or BLACK
-
+    uint64_t hash;        // Zobrist hash, see zobrist.h (stale after set_*)
+    uint64_t pawn_hash;   // Zobrist hash of the pawns alone, likewise
 } position;
 
+/** 
+ * @brief A board stored in absolute colors (alternative to `position`)
+ * 
+ * Nothing is ever rotated: squares are always white's, pieces are split by 
+ * Color, and handing the move to the other side only flips `color`. The
+ * board_get_* functions give the usual OURS/THEIRS view on top of it by
+ * indexing with the side to move.
+ */
+typedef struct board {
+    bitboard colors[2];     // indexed by Color
+    bitboard pieces[5];     // no en passant flags, see `en_passant`
+    square   king[2];       // indexed by Color
+    square   en_passant;    // capture square, or INVALID_SQUARE
+    uint16_t halfmoves;
+    uint16_t fullmoves;
+    uint8_t  castling;      // same four bits as position, but indexed by Color
+    Color    color;         // side to move
+} board;
+
 /**
  * @brief The ASCII characters of pieces of different colors
  * 
@@ -71,6 +91,14 @@ typedef struct position {
  */
 extern const char PIECE_CHARS[2][6];
 
+/** 
+ * @brief Gets the pawns from P->pieces[PAWN]
+ * 
+ * The back ranks of P->pieces[PAWN] hold en passant flags, which can share a
+ * square with any other piece standing there.
+ */
+extern const bitboard PAWNS_MASK;
+
 /*
  * ---------------------------------------------------------------------------
  *                                 POSITION
@@ -166,10 +194,51 @@ bool position_get_castling(position *P, Whose whose, Castling castling);
 /** @brief Sets the castling status of a given possesion for a certain side */
 void position_set_castling(position *P, Whose whose, Castling castling, bool can_castle);
 
+/** 
+ * @brief Whether `whose` has a piece other than pawns and the king
+ * 
+ * A side with only pawns is the one likely in zugzwang, where passing would
+ * be better than any move.
+ */
+bool position_has_non_pawn_material(position *P, Whose whose);
+
 /** @brief Rotate the position (rotates bitboards and swaps castling flags). */
 void position_rotate(position *P);
 
 /** @brief Prints the position as a human-readable chess position. */
 void position_print(position *P);
 
+/*
+ * ---------------------------------------------------------------------------
+ *                                  BOARD
+ * ---------------------------------------------------------------------------
+ */
+
+/** @brief Converts a (rotated, OURS/THEIRS) position to an absolute board */
+void board_from_position(board *B, position *P);
+
+/** @brief Converts an absolute board back to a rotated position */
+void board_to_position(position *P, board *B);
+
+/** @brief Initiliazes a board according to the given FEN string */
+void board_from_fen(board *B, const char *fen);
+
+/** @brief The absolute color of `whose` pieces */
+Color board_get_color(board *B, Whose whose);
+
+/** @brief Retrieves `whose` pieces of type `piece`, like position_get_pieces */
+bitboard board_get_pieces(board *B, Whose whose, Piece piece);
+
+/** @brief Gets the singular bitboard with `whose` king's square set to true */
+bitboard board_get_king(board *B, Whose whose);
+
+/** @brief Gets the castling status of `whose` for a certain side */
+bool board_get_castling(board *B, Whose whose, Castling castling);
+
+/** @brief Sets the castling status of a color for a certain side */
+void board_set_castling(board *B, Color color, Castling castling, bool can_castle);
+
+/** @brief Prints the board as a human-readable chess position. */
+void board_print(board *B);
+
 #endif
\ No newline at end of file
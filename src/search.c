@@ -0,0 +1,811 @@
+/**
+ * @file search.c
+ * @brief Provides the implementation for searching positions.
+ */
+
+#define _POSIX_C_SOURCE 200809L     // clock_gettime and nanosleep
+
+#include "eval.h"
+#include "movepick.h"
+#include "moves.h"
+#include "search.h"
+#include "tb.h"
+#include "tt.h"
+
+#include "../lib/contracts.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/*
+ * ---------------------------------------------------------------------------
+ *                                  SEARCH
+ * ---------------------------------------------------------------------------
+ */
+
+/** @brief Size in kilobytes of the pawn table of a search */
+#define SEARCH_PAWN_TABLE_KB 1024
+
+/** @brief Half-width of the first aspiration window, in centipawns */
+#define ASPIRATION_DELTA 25
+
+/** @brief First depth searched with an aspiration window */
+#define ASPIRATION_DEPTH 4
+
+/** @brief Margin over the victim's value that a capture has to reach alpha by */
+#define DELTA_MARGIN 200
+
+/** @brief What a capture can win by Piece, at the larger of the eval weights */
+static const int DELTA_PIECE_VALUE[6] = { 110, 320, 330, 530, 980, 0 };
+
+/** @brief Largest history bonus a cutoff gives */
+#define HISTORY_BONUS_MAX 1200
+
+/** @brief Everything a ply of the search keeps while its children run */
+typedef struct search_ply {
+    move_picker picker;
+    move current;           // being searched (NULL_MOVE for a null move)
+    move killers[2];        // quiet moves that caused cutoffs at this ply
+    int plies_from_null;    // repetitions can't be looked for past a pass
+    undo undo;
+    move pv[MAX_PLY];       // triangular: the PV from this ply on
+    int pv_length;
+} search_ply;
+
+struct search {
+    tt *tt;
+    pawn_table *pawns;
+    FILE *out;
+    bool prefetch;
+
+    search_ply stack[MAX_PLY + 1];
+    movelist root_moves;    // best move of the last iteration first
+
+    // Move ordering, by Color of the side to move
+    history_table history[2];
+    move counters[2][6][64];    // by the last move's piece and to square
+
+    // Selective search
+    int params[SEARCH_PARAM_COUNT];
+    int8_t reductions[MAX_PLY][MAX_MOVES];  // by depth and move number
+    int null_min_ply;       // plies before which null moves are verified
+
+    // Hashes of the game, then of the positions on the path from the root
+    zhash *keys;
+    int keys_capacity;
+    int root_index;
+
+    search_limits limits;
+    double start;
+    double soft_limit;      // seconds after which no iteration is started
+    double hard_limit;      // seconds after which the search stops
+    bool stop;              // set by search_stop, read atomically
+    bool can_stop;          // an iteration completed, so there's a move
+    uint64_t nodes;
+    uint64_t qnodes;        // of the nodes, those in quiescence search
+    uint64_t tb_hits;
+    uint64_t prefetches;
+    int seldepth;
+};
+
+const search_param_info SEARCH_PARAMS[SEARCH_PARAM_COUNT] = {
+    [PARAM_NULL_MOVE_DEPTH] = { "NullMoveDepth", 2, 1, MAX_PLY },
+    [PARAM_NULL_MOVE_REDUCTION] = { "NullMoveReduction", 3, 1, 8 },
+    [PARAM_NULL_MOVE_DIVISOR] = { "NullMoveDivisor", 4, 1, 16 },
+    [PARAM_NULL_MOVE_VERIFY] = { "NullMoveVerifyDepth", 12, 1, MAX_PLY },
+    [PARAM_LMR_BASE] = { "LmrBase", 75, 0, 300 },
+    [PARAM_LMR_DIVISOR] = { "LmrDivisor", 225, 0, 1000 },
+    [PARAM_RFP_DEPTH] = { "RfpDepth", 8, 0, 16 },
+    [PARAM_RFP_MARGIN] = { "RfpMargin", 80, 0, 500 },
+    [PARAM_FUTILITY_DEPTH] = { "FutilityDepth", 6, 0, 16 },
+    [PARAM_FUTILITY_BASE] = { "FutilityBase", 100, 0, 1000 },
+    [PARAM_FUTILITY_MARGIN] = { "FutilityMargin", 100, 0, 500 }
+};
+
+/**
+ * @brief Reductions grow with the log of both the depth and move number
+ *
+ * A divisor of 0 turns them off, whatever the base.
+ */
+static void search_init_reductions(search *S) {
+    double base = S->params[PARAM_LMR_BASE] / 100.0;
+    double divisor = S->params[PARAM_LMR_DIVISOR] / 100.0;
+    for (int depth = 0; depth < MAX_PLY; depth++) {
+        for (int n = 0; n < MAX_MOVES; n++) {
+            double r = depth > 0 && n > 0 && divisor > 0
+                     ? base + log(depth) * log(n) / divisor : 0;
+            S->reductions[depth][n] = r < MAX_PLY ? (int8_t) r : MAX_PLY - 1;
+        }
+    }
+    return;
+}
+
+/** @brief Seconds on a monotonic clock */
+static double seconds_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+search *search_new(tt *T) {
+    dbg_requires(T != NULL);
+    search *S = malloc(sizeof(search));
+    if (S == NULL) {
+        perror("malloc error");
+        exit(1);
+    }
+    S->tt = T;
+    S->pawns = pawn_table_new(SEARCH_PAWN_TABLE_KB);
+    S->out = NULL;
+    S->prefetch = true;
+    S->keys = NULL;
+    S->keys_capacity = 0;
+    S->stop = false;
+    search_clear(S);
+    for (int p = 0; p < SEARCH_PARAM_COUNT; p++) {
+        S->params[p] = SEARCH_PARAMS[p].value;
+    }
+    search_init_reductions(S);
+    return S;
+}
+
+void search_set_param(search *S, SearchParam param, int value) {
+    dbg_requires(S != NULL && 0 <= param && param < SEARCH_PARAM_COUNT);
+    const search_param_info *info = &SEARCH_PARAMS[param];
+    if (value < info->min) value = info->min;
+    if (value > info->max) value = info->max;
+    S->params[param] = value;
+    if (param == PARAM_LMR_BASE || param == PARAM_LMR_DIVISOR)
+        search_init_reductions(S);
+    return;
+}
+
+int search_get_param(search *S, SearchParam param) {
+    dbg_requires(S != NULL && 0 <= param && param < SEARCH_PARAM_COUNT);
+    return S->params[param];
+}
+
+void search_clear(search *S) {
+    dbg_requires(S != NULL);
+    memset(S->history, 0, sizeof(S->history));
+    memset(S->counters, 0, sizeof(S->counters));
+    return;
+}
+
+void search_free(search *S) {
+    pawn_table_free(S->pawns);
+    free(S->keys);
+    free(S);
+    return;
+}
+
+void search_set_tt(search *S, tt *T) {
+    dbg_requires(S != NULL && T != NULL);
+    S->tt = T;
+    return;
+}
+
+void search_set_prefetch(search *S, bool prefetch) {
+    dbg_requires(S != NULL);
+    S->prefetch = prefetch;
+    return;
+}
+
+void search_set_output(search *S, FILE *out) {
+    dbg_requires(S != NULL);
+    S->out = out;
+    return;
+}
+
+void search_stop(search *S) {
+    __atomic_store_n(&S->stop, true, __ATOMIC_RELAXED);
+    return;
+}
+
+/* --- LIMITS --- */
+
+/** @brief Works out when to stop from the limits and the clock of `us` */
+static void search_budget(search *S, Color us) {
+    const search_limits *L = &S->limits;
+    S->soft_limit = S->hard_limit = 0;
+    if (L->infinite) return;
+    if (L->movetime > 0) {
+        S->soft_limit = S->hard_limit = L->movetime / 1000.0;
+        return;
+    }
+    if (L->time[us] <= 0) return;
+
+    // An even share of the clock, and most of the increment
+    double left = L->time[us] / 1000.0, inc = L->inc[us] / 1000.0;
+    int moves = L->movestogo > 0 ? L->movestogo : 30;
+    double optimum = left / moves + 0.75 * inc;
+    double maximum = 4 * optimum;
+    if (maximum > 0.8 * left - 0.05) maximum = 0.8 * left - 0.05;
+    if (maximum < 0.005) maximum = 0.005;
+    if (optimum > maximum) optimum = maximum;
+    // An iteration takes longer than all of the ones before it
+    S->soft_limit = optimum / 2;
+    S->hard_limit = maximum;
+    return;
+}
+
+/** @brief Whether the search was stopped, once it can be */
+static bool search_stopped(search *S) {
+    return S->can_stop && __atomic_load_n(&S->stop, __ATOMIC_RELAXED);
+}
+
+/** @brief Whether the search has to unwind, checked at every node */
+static bool search_should_stop(search *S) {
+    if (!S->can_stop) return false;
+    if (__atomic_load_n(&S->stop, __ATOMIC_RELAXED)) return true;
+    if ((S->limits.nodes > 0 && S->nodes >= S->limits.nodes) ||
+        (S->hard_limit > 0 && (S->nodes & 1023) == 0 &&
+         seconds_now() - S->start >= S->hard_limit)) {
+        search_stop(S);
+        return true;
+    }
+    return false;
+}
+
+/** @brief Requests the table bucket of a child, once its move is made */
+static inline void search_prefetch(search *S, position *P) {
+    if (!S->prefetch) return;
+    tt_prefetch(S->tt, P->hash);
+    S->prefetches++;
+    return;
+}
+
+/* --- SCORES --- */
+
+/** @brief Mate scores are stored relative to the node, not the root */
+static int score_to_tt(int score, int ply) {
+    if (score >= VALUE_TB_WIN_IN_MAX_PLY) return score + ply;
+    if (score <= -VALUE_TB_WIN_IN_MAX_PLY) return score - ply;
+    return score;
+}
+
+static int score_from_tt(int score, int ply) {
+    if (score >= VALUE_TB_WIN_IN_MAX_PLY) return score - ply;
+    if (score <= -VALUE_TB_WIN_IN_MAX_PLY) return score + ply;
+    return score;
+}
+
+/** @brief The static evaluation, kept clear of mate and tablebase scores */
+static int search_evaluate(search *S, position *P) {
+    int score = evaluate(P, S->pawns);
+    if (score >= VALUE_TB_WIN_IN_MAX_PLY) return VALUE_TB_WIN_IN_MAX_PLY - 1;
+    if (score <= -VALUE_TB_WIN_IN_MAX_PLY) return -VALUE_TB_WIN_IN_MAX_PLY + 1;
+    return score;
+}
+
+/**
+ * @brief Whether the position at `ply` is drawn by the fifty-move rule or
+ * repeats one since the last capture or pawn move
+ *
+ * Repeating a position of the search once is scored as a draw: whatever was
+ * best the first time can be played again. Positions of the game before the
+ * root have to repeat twice, as the rules say. Mate on the hundredth halfmove
+ * still counts. Nothing before a null move counts: passing isn't a move.
+ */
+static bool search_is_draw(search *S, position *P, int ply, bool in_check) {
+    if (P->halfmoves >= 100) {
+        if (!in_check) return true;
+        movelist M;
+        movelist_clear(&M);
+        generate_moves(&M, P);
+        return M.size > 0;
+    }
+    int index = S->root_index + ply;
+    int reach = S->stack[ply].plies_from_null;
+    if (reach > P->halfmoves) reach = P->halfmoves;
+    bool before_root = false;
+    for (int back = 4; back <= reach && back <= index; back += 2) {
+        if (S->keys[index - back] != P->hash) continue;
+        if (back <= ply || before_root) return true;
+        before_root = true;
+    }
+    return false;
+}
+
+/* --- ORDERING --- */
+
+static bool move_equal(move a, move b) {
+    return a.piece == b.piece && a.from == b.from && a.to == b.to &&
+           a.flags == b.flags;
+}
+
+static bool move_is_quiet(move m) {
+    return !(m.flags & (M_FLAG_CAPTURE | M_FLAG_PROMOTION[KNIGHT]));
+}
+
+/** @brief The move that led to a ply, NULL_MOVE at the root */
+static move search_previous_move(search *S, int ply) {
+    return ply > 0 ? S->stack[ply - 1].current : NULL_MOVE;
+}
+
+/**
+ * @brief Rewards a quiet move that caused a cutoff: it becomes a killer and
+ * the counter move, and gains history over the quiets tried before it
+ */
+static void search_update_quiets(search *S, position *P, int ply, int depth,
+                                 move best, const move *tried, int n_tried) {
+    search_ply *st = &S->stack[ply];
+    if (!move_equal(st->killers[0], best)) {
+        st->killers[1] = st->killers[0];
+        st->killers[0] = best;
+    }
+    move previous = search_previous_move(S, ply);
+    if (previous.from != previous.to)
+        S->counters[P->color][previous.piece][previous.to] = best;
+
+    int bonus = depth * depth < HISTORY_BONUS_MAX ? depth * depth
+                                                  : HISTORY_BONUS_MAX;
+    history_table *history = &S->history[P->color];
+    history_update(&(*history)[best.from][best.to], bonus);
+    for (int i = 0; i < n_tried; i++) {
+        history_update(&(*history)[tried[i].from][tried[i].to], -bonus);
+    }
+    return;
+}
+
+/* --- NODES --- */
+
+/**
+ * @brief Searches captures and promotions from a leaf until the position is
+ * quiet, so that leaves aren't scored in the middle of an exchange
+ *
+ * The side to move can stand pat on the static evaluation instead of
+ * capturing, except in check, where every evasion is searched. Captures that
+ * can't reach alpha even winning their victim for free are skipped (delta
+ * pruning), and so are losing exchanges and underpromotions.
+ */
+static int search_quiescence(search *S, position *P, int alpha, int beta,
+                             int ply) {
+    search_ply *st = &S->stack[ply];
+    st->pv_length = 0;
+
+    S->nodes++;
+    S->qnodes++;
+    if (ply > S->seldepth) S->seldepth = ply;
+    if (search_should_stop(S)) return 0;
+    S->keys[S->root_index + ply] = P->hash;
+
+    bool in_check = king_in_check(P, OURS);
+    if (search_is_draw(S, P, ply, in_check)) return VALUE_DRAW;
+    if (ply >= MAX_PLY - 1) return search_evaluate(S, P);
+
+    tt_entry E;
+    move hash_move = NULL_MOVE;
+    if (tt_probe(S->tt, P->hash, &E)) {
+        hash_move = E.move;
+        int score = score_from_tt(E.score, ply);
+        Bound fits = score >= beta ? BOUND_LOWER : BOUND_UPPER;
+        if (E.bound & fits) return score;
+    }
+
+    int best_score = -VALUE_INFINITE, static_eval = 0;
+    if (!in_check) {
+        static_eval = best_score = search_evaluate(S, P);
+        if (best_score >= beta) return best_score;
+        if (best_score > alpha) alpha = best_score;
+    }
+
+    move_picker *MP = &st->picker;
+    move_picker_init_quiescence(MP, P, hash_move, &S->history[P->color]);
+
+    int old_alpha = alpha;
+    move best_move = NULL_MOVE;
+    while (true) {
+        move m = move_picker_next(MP);
+        if (m.from == m.to) break;
+        bool promotion = m.flags & M_FLAG_PROMOTION[KNIGHT];
+
+        if (!in_check) {
+            if (promotion && (m.flags & 3) != 3) continue;
+            if (!promotion) {
+                int futility = static_eval + 
+                               DELTA_PIECE_VALUE[move_captured(P, m)] + 
+                               DELTA_MARGIN;
+                if (futility <= alpha) {
+                    if (futility > best_score) best_score = futility;
+                    continue;
+                }
+            }
+            if (!see_ge(P, m, 0)) continue;
+        }
+
+        st->current = m;
+        S->stack[ply + 1].plies_from_null = st->plies_from_null + 1;
+        move_make(P, m, &st->undo);
+        position_rotate(P);
+        search_prefetch(S, P);
+        int score = -search_quiescence(S, P, -beta, -alpha, ply + 1);
+        position_rotate(P);
+        move_unmake(P, m, &st->undo);
+        if (search_stopped(S)) return 0;
+
+        if (score > best_score) {
+            best_score = score;
+            if (score > alpha) {
+                best_move = m;
+                alpha = score;
+                if (alpha >= beta) break;
+            }
+        }
+    }
+    if (in_check && best_score == -VALUE_INFINITE) return -VALUE_MATE + ply;
+
+    Bound bound = best_score >= beta ? BOUND_LOWER
+                : alpha > old_alpha ? BOUND_EXACT : BOUND_UPPER;
+    tt_store(S->tt, P->hash, best_move, score_to_tt(best_score, ply), 0, bound);
+    return best_score;
+}
+
+/**
+ * @brief Searches a node of the tree with a window (alpha, beta)
+ *
+ * Fails soft: the score returned can be outside the window, bounding the
+ * true value from the side it fell on.
+ */
+static int search_node(search *S, position *P, int alpha, int beta, int depth,
+                       int ply) {
+    if (depth <= 0) return search_quiescence(S, P, alpha, beta, ply);
+    search_ply *st = &S->stack[ply];
+    bool pv_node = beta - alpha > 1;
+    st->pv_length = 0;
+
+    S->nodes++;
+    if (ply > S->seldepth) S->seldepth = ply;
+    if (search_should_stop(S)) return 0;
+    S->keys[S->root_index + ply] = P->hash;
+
+    bool in_check = king_in_check(P, OURS);
+    if (in_check) depth++;
+    if (ply > 0 && search_is_draw(S, P, ply, in_check)) return VALUE_DRAW;
+
+    if (ply > 0) {
+        if (ply >= MAX_PLY - 1) return search_evaluate(S, P);
+
+        // No line from here mates sooner than one found already
+        if (alpha < -VALUE_MATE + ply) alpha = -VALUE_MATE + ply;
+        if (beta > VALUE_MATE - ply - 1) beta = VALUE_MATE - ply - 1;
+        if (alpha >= beta) return alpha;
+    }
+
+    tt_entry E;
+    move hash_move = NULL_MOVE;
+    if (tt_probe(S->tt, P->hash, &E)) {
+        hash_move = E.move;
+        int score = score_from_tt(E.score, ply);
+        Bound fits = score >= beta ? BOUND_LOWER : BOUND_UPPER;
+        if (!pv_node && E.depth >= depth && (E.bound & fits)) return score;
+    }
+
+    // Tablebases know the result, right after a capture or pawn move
+    if (ply > 0 && P->halfmoves == 0 && P->castling == 0 &&
+        bitboard_count_bits(P->whose[OURS] | P->whose[THEIRS])
+            <= tb_max_pieces()) {
+        int wdl;
+        if (tb_probe_wdl(P, &wdl)) {
+            S->tb_hits++;
+            int score = wdl == TB_WIN ? VALUE_TB_WIN - ply
+                      : wdl == TB_LOSS ? -VALUE_TB_WIN + ply : VALUE_DRAW;
+            int stored = depth + 6 < TT_MAX_DEPTH ? depth + 6 : TT_MAX_DEPTH;
+            tt_store(S->tt, P->hash, NULL_MOVE, score_to_tt(score, ply),
+                     stored, BOUND_EXACT);
+            return score;
+        }
+    }
+
+    const int *params = S->params;
+    int static_eval = in_check ? -VALUE_INFINITE : search_evaluate(S, P);
+    bool winning = beta >= VALUE_TB_WIN_IN_MAX_PLY;
+    bool losing = alpha <= -VALUE_TB_WIN_IN_MAX_PLY;
+
+    // Reverse futility: far enough above beta that no move would drop below
+    if (!pv_node && !in_check && !winning &&
+        depth <= params[PARAM_RFP_DEPTH] &&
+        static_eval - params[PARAM_RFP_MARGIN] * depth >= beta) {
+        return static_eval;
+    }
+
+    // Null move: if passing still beats beta, a move would too, unless only
+    // pawns can move and every move makes things worse (zugzwang)
+    move previous = search_previous_move(S, ply);
+    if (!pv_node && !in_check && !winning && ply > 0 &&
+        previous.from != previous.to && ply >= S->null_min_ply &&
+        depth >= params[PARAM_NULL_MOVE_DEPTH] && static_eval >= beta &&
+        position_has_non_pawn_material(P, OURS)) {
+        int margin = (static_eval - beta) / 200 < 3 ? (static_eval - beta) / 200
+                                                     : 3;
+        int R = params[PARAM_NULL_MOVE_REDUCTION] + margin +
+                depth / params[PARAM_NULL_MOVE_DIVISOR];
+        st->current = NULL_MOVE;
+        S->stack[ply + 1].plies_from_null = 0;
+        move_make_null(P, &st->undo);
+        position_rotate(P);
+        search_prefetch(S, P);
+        int score = -search_node(S, P, -beta, -beta + 1, depth - R, ply + 1);
+        position_rotate(P);
+        move_unmake_null(P, &st->undo);
+        if (search_stopped(S)) return 0;
+
+        if (score >= beta) {
+            // Mates found after passing aren't proven
+            if (score >= VALUE_TB_WIN_IN_MAX_PLY) score = beta;
+            if (depth < params[PARAM_NULL_MOVE_VERIFY] || S->null_min_ply > 0)
+                return score;
+            // Deep down, verify with a search that can't pass near here
+            S->null_min_ply = ply + 3 * (depth - R) / 4;
+            int verified = search_node(S, P, beta - 1, beta, depth - R, ply);
+            S->null_min_ply = 0;
+            if (search_stopped(S)) return 0;
+            if (verified >= beta) return score;
+        }
+    }
+    int futility = static_eval + params[PARAM_FUTILITY_BASE] +
+                   params[PARAM_FUTILITY_MARGIN] * depth;
+    bool futile = ply > 0 && !in_check && !losing &&
+                  depth <= params[PARAM_FUTILITY_DEPTH] && futility <= alpha;
+
+    // The root searches its moves in the order of the last iteration
+    move_picker *MP = &st->picker;
+    if (ply > 0) {
+        move counter = previous.from != previous.to
+                     ? S->counters[P->color][previous.piece][previous.to]
+                     : NULL_MOVE;
+        move_picker_init(MP, P, hash_move, st->killers, counter,
+                         &S->history[P->color]);
+    }
+    if (ply + 2 <= MAX_PLY) {
+        S->stack[ply + 2].killers[0] = S->stack[ply + 2].killers[1] = NULL_MOVE;
+    }
+
+    int best_score = -VALUE_INFINITE;
+    move best_move = NULL_MOVE, m;
+    move quiets_tried[MAX_MOVES];
+    int n_quiets = 0, n_moves = 0;
+    while (true) {
+        if (ply == 0) {
+            if (n_moves == S->root_moves.size) break;
+            m = S->root_moves.array[n_moves];
+        } else {
+            m = move_picker_next(MP);
+            if (m.from == m.to) break;
+        }
+
+        bool quiet = move_is_quiet(m);
+        st->current = m;
+        S->stack[ply + 1].plies_from_null = st->plies_from_null + 1;
+        move_make(P, m, &st->undo);
+        position_rotate(P);
+        bool gives_check = king_in_check(P, OURS);
+
+        // Futility: quiet moves can't lift a hopeless score near the leaves
+        if (futile && quiet && !gives_check && n_moves > 0) {
+            position_rotate(P);
+            move_unmake(P, m, &st->undo);
+            if (futility > best_score) best_score = futility;
+            continue;
+        }
+        search_prefetch(S, P);
+
+        int score;
+        if (n_moves++ == 0) {
+            score = -search_node(S, P, -beta, -alpha, depth - 1, ply + 1);
+        } else {
+            // Late quiet moves are searched shallower first
+            int r = 0;
+            if (depth >= 3 && quiet && !in_check && !gives_check) {
+                r = S->reductions[depth < MAX_PLY ? depth : MAX_PLY - 1]
+                                 [n_moves < MAX_MOVES ? n_moves : MAX_MOVES - 1];
+                if (pv_node) r--;
+                if (move_equal(m, st->killers[0]) ||
+                    move_equal(m, st->killers[1]))
+                    r--;
+                if (r > depth - 2) r = depth - 2;
+                if (r < 0) r = 0;
+            }
+            // Only a move that beats alpha needs an exact score
+            score = -search_node(S, P, -alpha - 1, -alpha, depth - 1 - r,
+                                 ply + 1);
+            if (score > alpha && r > 0) {
+                score = -search_node(S, P, -alpha - 1, -alpha, depth - 1,
+                                     ply + 1);
+            }
+            if (alpha < score && score < beta) {
+                score = -search_node(S, P, -beta, -alpha, depth - 1, ply + 1);
+            }
+        }
+        position_rotate(P);
+        move_unmake(P, m, &st->undo);
+        if (search_stopped(S)) return 0;
+
+        if (score > best_score) {
+            best_score = score;
+            if (score > alpha) {
+                best_move = m;
+                alpha = score;
+                search_ply *child = &S->stack[ply + 1];
+                st->pv[0] = m;
+                memcpy(st->pv + 1, child->pv, child->pv_length * sizeof(move));
+                st->pv_length = child->pv_length + 1;
+                if (alpha >= beta) break;
+            }
+        }
+        if (quiet) quiets_tried[n_quiets++] = m;
+    }
+    if (n_moves == 0) return in_check ? -VALUE_MATE + ply : VALUE_DRAW;
+    if (best_score >= beta && move_is_quiet(best_move)) {
+        search_update_quiets(S, P, ply, depth, best_move, quiets_tried,
+                             n_quiets);
+    }
+
+    Bound bound = best_score >= beta ? BOUND_LOWER
+                : best_move.from != best_move.to ? BOUND_EXACT : BOUND_UPPER;
+    tt_store(S->tt, P->hash, best_move, score_to_tt(best_score, ply),
+             depth < TT_MAX_DEPTH ? depth : TT_MAX_DEPTH, bound);
+    return best_score;
+}
+
+/* --- ROOT --- */
+
+/** @brief Prints an iteration as a UCI info line */
+static void search_report(search *S, position *P, int depth, int score) {
+    if (S->out == NULL) return;
+    double elapsed = seconds_now() - S->start;
+    fprintf(S->out, "info depth %d seldepth %d score ", depth, S->seldepth);
+    if (score >= VALUE_MATE_IN_MAX_PLY) {
+        fprintf(S->out, "mate %d", (VALUE_MATE - score + 1) / 2);
+    } else if (score <= -VALUE_MATE_IN_MAX_PLY) {
+        fprintf(S->out, "mate %d", -(VALUE_MATE + score) / 2);
+    } else {
+        fprintf(S->out, "cp %d", score);
+    }
+    fprintf(S->out, " nodes %lu nps %.0f time %.0f hashfull %d",
+            (unsigned long) S->nodes, elapsed > 0 ? S->nodes / elapsed : 0.0,
+            1000 * elapsed, tt_hashfull(S->tt));
+    if (S->tb_hits > 0) {
+        fprintf(S->out, " tbhits %lu", (unsigned long) S->tb_hits);
+    }
+    fprintf(S->out, " pv");
+    search_ply *root = &S->stack[0];
+    for (int i = 0; i < root->pv_length; i++) {
+        char str[MOVE_STRING_SIZE];
+        fprintf(S->out, " %s", move_to_string(root->pv[i], P->color ^ (i & 1),
+                                              str));
+    }
+    fprintf(S->out, "\n");
+    fflush(S->out);
+    return;
+}
+
+/** @brief Moves the best move of an iteration to the front of the root */
+static void search_promote_root(search *S, move best) {
+    movelist *M = &S->root_moves;
+    for (int i = 0; i < M->size; i++) {
+        if (!move_equal(M->array[i], best)) continue;
+        memmove(M->array + 1, M->array, i * sizeof(move));
+        M->array[0] = best;
+        return;
+    }
+    return;
+}
+
+void search_run(search *S, position *P, const zhash *history, int history_size,
+                const search_limits *L, search_result *R) {
+    dbg_requires(S != NULL && P != NULL && L != NULL && R != NULL);
+    S->start = seconds_now();
+    S->limits = *L;
+    search_budget(S, P->color);
+    S->nodes = S->qnodes = S->tb_hits = S->prefetches = 0;
+    S->can_stop = false;
+    __atomic_store_n(&S->stop, false, __ATOMIC_RELAXED);
+
+    if (S->keys_capacity < history_size + MAX_PLY + 1) {
+        S->keys_capacity = history_size + MAX_PLY + 1;
+        S->keys = realloc(S->keys, S->keys_capacity * sizeof(zhash));
+        if (S->keys == NULL) {
+            perror("malloc error");
+            exit(1);
+        }
+    }
+    if (history_size > 0) memcpy(S->keys, history, history_size * sizeof(zhash));
+    S->root_index = history_size;
+
+    R->best = R->ponder = NULL_MOVE;
+    R->score = R->depth = R->seldepth = 0;
+    tt_new_search(S->tt);
+    for (int ply = 0; ply <= MAX_PLY; ply++) {
+        S->stack[ply].killers[0] = S->stack[ply].killers[1] = NULL_MOVE;
+    }
+    S->stack[0].plies_from_null = history_size;
+    S->null_min_ply = 0;
+    movelist_clear(&S->root_moves);
+    generate_moves(&S->root_moves, P);
+
+    // Tablebases pick the moves that keep the result, the search the best
+    int wdl;
+    if (S->root_moves.size > 0 &&
+        bitboard_count_bits(P->whose[OURS] | P->whose[THEIRS])
+            <= tb_max_pieces() &&
+        tb_root_filter(P, S->keys, S->root_index, &S->root_moves, &wdl)) {
+        S->tb_hits++;
+    }
+
+    int score = 0;
+    int max_depth = L->depth > 0 && L->depth < MAX_PLY - 1 ? L->depth
+                                                           : MAX_PLY - 1;
+    for (int depth = 1; depth <= max_depth && S->root_moves.size > 0; depth++) {
+        S->seldepth = 0;
+        int delta = ASPIRATION_DELTA;
+        int alpha = -VALUE_INFINITE, beta = VALUE_INFINITE;
+        if (depth >= ASPIRATION_DEPTH) {
+            alpha = score - delta > -VALUE_INFINITE ? score - delta
+                                                    : -VALUE_INFINITE;
+            beta = score + delta < VALUE_INFINITE ? score + delta
+                                                  : VALUE_INFINITE;
+        }
+
+        // Widens the window on the side the score fell out of until it fits
+        int value;
+        while (true) {
+            value = search_node(S, P, alpha, beta, depth, 0);
+            if (search_stopped(S)) break;
+            if (value <= alpha) {
+                beta = (alpha + beta) / 2;
+                alpha = value - delta > -VALUE_INFINITE ? value - delta
+                                                        : -VALUE_INFINITE;
+            } else if (value >= beta) {
+                beta = value + delta < VALUE_INFINITE ? value + delta
+                                                      : VALUE_INFINITE;
+            } else {
+                break;
+            }
+            delta += delta / 2;
+        }
+        if (search_stopped(S)) break;
+
+        score = value;
+        search_ply *root = &S->stack[0];
+        R->best = root->pv[0];
+        R->ponder = root->pv_length > 1 ? root->pv[1] : NULL_MOVE;
+        R->score = score;
+        R->depth = depth;
+        R->seldepth = S->seldepth;
+        search_promote_root(S, R->best);
+        search_report(S, P, depth, score);
+        S->can_stop = true;
+
+        if (S->soft_limit > 0 && seconds_now() - S->start >= S->soft_limit)
+            break;
+    }
+
+    // An infinite search only returns when told to
+    if (L->infinite) {
+        S->can_stop = true;
+        struct timespec ms = { 0, 1000000 };
+        while (!__atomic_load_n(&S->stop, __ATOMIC_RELAXED)) {
+            nanosleep(&ms, NULL);
+        }
+    }
+    if (R->depth == 0 && S->root_moves.size > 0) {
+        R->best = S->root_moves.array[0];
+    } else if (S->root_moves.size == 0) {
+        R->score = king_in_check(P, OURS) ? -VALUE_MATE : VALUE_DRAW;
+    }
+    R->nodes = S->nodes;
+    R->qnodes = S->qnodes;
+    R->prefetches = S->prefetches;
+    if (S->out != NULL && S->nodes > 0) {
+        fprintf(S->out, "info string qnodes %lu (%.1f%% of nodes) "
+                "prefetches %lu\n", (unsigned long) S->qnodes,
+                100.0 * S->qnodes / S->nodes, (unsigned long) S->prefetches);
+        fflush(S->out);
+    }
+    return;
+}
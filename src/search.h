@@ -0,0 +1,168 @@
+/**
+ * @file search.h
+ * @brief Provides an interface for searching positions.
+ *
+ * A principal variation search (negamax alpha-beta, searching every move
+ * after the first with a null window) under iterative deepening, with
+ * aspiration windows around the score of the last iteration. Positions are
+ * walked in place with move_make/move_unmake; everything a ply needs (its
+ * moves, undo record and PV) lives on a stack allocated with the search.
+ * Leaves are resolved by a quiescence search over captures and promotions.
+ * Moves come from a staged move picker (see movepick.h), ordered by the
+ * table, killer and counter moves and a history of cutoffs.
+ *
+ * Away from the principal variation, the search is selective: null-move
+ * pruning (verified at high depths), reverse futility and futility pruning
+ * near the leaves, and late move reductions for quiet moves ordered late.
+ * Their margins and depths are parameters, settable as UCI options.
+ *
+ * Scores are in centipawns for the side to move. Mates are scored
+ * VALUE_MATE less the plies to mate, tablebase wins VALUE_TB_WIN less the
+ * plies to the table.
+ */
+
+#ifndef _SEARCH_H_
+#define _SEARCH_H_
+
+#include "moves.h"
+#include "position.h"
+#include "tt.h"
+#include "zobrist.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/** @brief Deepest ply a search reaches, quiescence included */
+#define MAX_PLY 128
+
+#define VALUE_DRAW 0
+#define VALUE_MATE 32000
+#define VALUE_INFINITE 32001
+#define VALUE_MATE_IN_MAX_PLY (VALUE_MATE - MAX_PLY)
+#define VALUE_TB_WIN (VALUE_MATE_IN_MAX_PLY - 1)
+#define VALUE_TB_WIN_IN_MAX_PLY (VALUE_TB_WIN - MAX_PLY)
+
+/** @brief When to stop searching; zeroes mean no limit */
+typedef struct search_limits {
+    int depth;
+    uint64_t nodes;
+    int movetime;           // milliseconds
+    int time[2];            // milliseconds left on the clock, by Color
+    int inc[2];             // milliseconds added per move, by Color
+    int movestogo;          // moves until the next time control, 0 if none
+    bool infinite;          // search until search_stop, even when done
+} search_limits;
+
+/** @brief What a search found */
+typedef struct search_result {
+    move best;              // NULL_MOVE if the position has no moves
+    move ponder;            // the reply expected, or NULL_MOVE
+    int score;
+    int depth;              // of the last iteration completed
+    int seldepth;
+    uint64_t nodes;
+    uint64_t qnodes;        // of the nodes, those in quiescence search
+    uint64_t prefetches;    // table buckets prefetched ahead of their probes
+} search_result;
+
+/** @brief Tunable parameters of the selective search */
+typedef enum SearchParam {
+    PARAM_NULL_MOVE_DEPTH,      // least depth to try a null move at (the
+                                // maximum, MAX_PLY, is never reached)
+    PARAM_NULL_MOVE_REDUCTION,  // of the null move search, at least
+    PARAM_NULL_MOVE_DIVISOR,    // the reduction grows by a ply per this depth
+    PARAM_NULL_MOVE_VERIFY,     // least depth to verify null move cutoffs at
+    PARAM_LMR_BASE,             // reductions, in hundredths of a ply...
+    PARAM_LMR_DIVISOR,          // ...plus ln(depth) ln(moves) / (this / 100),
+                                // 0 for no reductions at all
+    PARAM_RFP_DEPTH,
+    PARAM_RFP_MARGIN,           // centipawns per ply
+    PARAM_FUTILITY_DEPTH,
+    PARAM_FUTILITY_BASE,        // centipawns
+    PARAM_FUTILITY_MARGIN,      // centipawns per ply
+    SEARCH_PARAM_COUNT
+} SearchParam;
+
+typedef struct search_param_info {
+    const char *name;       // as a UCI option
+    int value;              // default
+    int min;
+    int max;
+} search_param_info;
+
+extern const search_param_info SEARCH_PARAMS[SEARCH_PARAM_COUNT];
+
+/** @brief A search, with its stack and pawn table, over a shared table */
+typedef struct search search;
+
+/**
+ * @brief Allocates a search
+ *
+ * @param[in] T transposition table, not owned by the search
+ * @pre T != NULL
+ */
+search *search_new(tt *T);
+
+/** @brief Frees a search */
+void search_free(search *S);
+
+/** @brief Forgets the move ordering learned from earlier searches */
+void search_clear(search *S);
+
+/**
+ * @brief Sets a parameter of a search that isn't running
+ *
+ * @param[in] S
+ * @param[in] param
+ * @param[in] value (clamped to the parameter's range)
+ */
+void search_set_param(search *S, SearchParam param, int value);
+
+/** @brief The value of a parameter */
+int search_get_param(search *S, SearchParam param);
+
+/**
+ * @brief Turns prefetching on (the default) or off, to measure what it buys
+ *
+ * With prefetching, the table bucket of each child is requested as soon as
+ * its move is made, so that the load from memory overlaps with the checks
+ * and evaluation the child does before it probes.
+ */
+void search_set_prefetch(search *S, bool prefetch);
+
+/** @brief Changes the table of a search that isn't running */
+void search_set_tt(search *S, tt *T);
+
+/**
+ * @brief Sets where to report each iteration, in UCI `info` lines
+ *
+ * @param[in] S
+ * @param[in] out (NULL for no reports, the default)
+ */
+void search_set_output(search *S, FILE *out);
+
+/**
+ * @brief Searches a position within limits
+ *
+ * @param[in] S
+ * @param[in] P (restored when the search returns)
+ * @param[in] history hashes of the positions of the game before P, oldest
+ *                    first, to tell repetitions
+ * @param[in] history_size
+ * @param[in] L
+ * @param[out] R
+ * @pre S != NULL && P != NULL && L != NULL && R != NULL
+ */
+void search_run(search *S, position *P, const zhash *history, int history_size,
+                const search_limits *L, search_result *R);
+
+/**
+ * @brief Makes a running search return as soon as it can
+ *
+ * Safe to call from another thread. search_run forgets stops made before it
+ * started, so a caller racing with its start has to stop it until it returns.
+ */
+void search_stop(search *S);
+
+#endif
@@ -0,0 +1,1194 @@
+/**
+ * @file tb.c
+ * @brief Provides the implementation for Syzygy endgame tablebases on disk.
+ *
+ * The layout of the files is Ronald de Man's, as read by his own probing
+ * code and the engines that followed it (Stockfish, Fathom): this is a port
+ * of that reader to the board and move generator of this engine.
+ */
+
+#define _DEFAULT_SOURCE     // DIR entries, strtok_r
+
+#include "moves.h"
+#include "position.h"
+#include "tb.h"
+
+#include "../lib/contracts.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define TB_NAME_SIZE 16
+
+/** @brief Files of the leading pawn a table is split by (a to d) */
+#define TB_PAWN_FILES 4
+
+/** @brief Size of the lookup from material keys to tables (a power of 2) */
+#define TB_HASH_SIZE 8192
+
+static const uint8_t TB_WDL_MAGIC[4] = { 0x71, 0xE8, 0x23, 0x5D };
+static const uint8_t TB_DTZ_MAGIC[4] = { 0xD7, 0x66, 0x0C, 0xA5 };
+
+/** @brief Flags of a file, after its magic */
+#define TB_SPLIT 1              // both sides to move are stored
+#define TB_HAS_PAWNS 2
+
+/** @brief Flags of a side to move of a file */
+#define TB_FLAG_STM 1           // DTZ: the side to move stored
+#define TB_FLAG_MAPPED 2        // DTZ: values go through a map
+#define TB_FLAG_WIN_PLIES 4     // DTZ: wins are stored in plies, not moves
+#define TB_FLAG_LOSS_PLIES 8
+#define TB_FLAG_WIDE 16         // DTZ: the map holds 16-bit values
+#define TB_FLAG_SINGLE_VALUE 128
+
+/** @brief Piece codes of the files: PAWN to KING are 1 to 6, black's + 8 */
+#define TB_BLACK_CODE 8
+
+static uint16_t read_le16(const uint8_t *p) {
+    return (uint16_t) (p[0] | p[1] << 8);
+}
+
+static uint32_t read_le32(const uint8_t *p) {
+    return (uint32_t) p[0] | (uint32_t) p[1] << 8 | (uint32_t) p[2] << 16 |
+           (uint32_t) p[3] << 24;
+}
+
+static uint32_t read_be32(const uint8_t *p) {
+    return (uint32_t) p[0] << 24 | (uint32_t) p[1] << 16 |
+           (uint32_t) p[2] << 8 | (uint32_t) p[3];
+}
+
+static uint64_t read_be64(const uint8_t *p) {
+    return (uint64_t) read_be32(p) << 32 | read_be32(p + 4);
+}
+
+/*
+ * ---------------------------------------------------------------------------
+ *                                 MATERIAL
+ * ---------------------------------------------------------------------------
+ *
+ * Tables are looked up by a key of their piece counts, four bits per piece of
+ * each side. A table is named with the stronger side first, which is white
+ * in its files: positions where black has that material are probed with the
+ * colors swapped and the board flipped.
+ */
+
+/** @brief The key of the piece counts of two sides */
+static uint64_t tb_key(int counts[2][6]) {
+    uint64_t key = 0;
+    for (int side = 0; side < 2; side++) {
+        for (Piece p = PAWN; p <= KING; p++) {
+            key += (uint64_t) counts[side][p] << (4 * (6 * side + p));
+        }
+    }
+    return key;
+}
+
+/** @brief The key of a board with the pieces of `first` first */
+static uint64_t tb_board_key(board *B, Color first) {
+    int counts[2][6];
+    for (int side = 0; side < 2; side++) {
+        Color c = first ^ side;
+        for (Piece p = PAWN; p < KING; p++) {
+            counts[side][p] = bitboard_count_bits(B->colors[c] & B->pieces[p]);
+        }
+        counts[side][KING] = 1;
+    }
+    return tb_key(counts);
+}
+
+/**
+ * @brief Reads the pieces of a material name such as "KRvK"
+ *
+ * @param[in] name
+ * @param[out] counts pieces of each type of each side
+ *
+ * @return The number of pieces, or 0 if the name is malformed
+ */
+static int tb_parse(const char *name, int counts[2][6]) {
+    memset(counts, 0, 2 * sizeof(counts[0]));
+    int side = 0, pieces = 0;
+    Piece last = KING;
+    for (const char *ch = name; *ch != '\0'; ch++) {
+        if (*ch == 'v') {
+            if (side == 1 || counts[0][KING] == 0) return 0;
+            side = 1;
+            last = KING;
+            continue;
+        }
+        Piece p = PAWN;
+        while (p <= KING && PIECE_CHARS[WHITE][p] != *ch) p++;
+        if (p > KING || ++pieces > TB_MAX_PIECES) return 0;
+        // The king first, then from the queen down to pawns
+        bool in_order = counts[side][KING] == 0 ? p == KING
+                                                : p != KING && p <= last;
+        if (!in_order) return 0;
+        counts[side][p]++;
+        last = p;
+    }
+    if (side == 0 || counts[1][KING] == 0) return 0;
+    return pieces;
+}
+
+/** @brief The code in the files of the piece on a square of a board */
+static uint8_t tb_piece_code(board *B, square s) {
+    Color c = B->colors[BLACK] & square_to_bitboard(s) ? BLACK : WHITE;
+    Piece p = PAWN;
+    while (p < KING && !(B->pieces[p] & square_to_bitboard(s))) p++;
+    return (uint8_t) ((p + 1) | (c == BLACK ? TB_BLACK_CODE : 0));
+}
+
+/*
+ * ---------------------------------------------------------------------------
+ *                                 INDEXING
+ * ---------------------------------------------------------------------------
+ *
+ * A position is indexed by its pieces in groups: first a leading group, then
+ * runs of identical pieces, each group in the order the file gives. Without
+ * pawns, the leading group is the first three pieces if a piece is alone of
+ * its kind, else the two kings, and symmetry moves its first piece into the
+ * a1-d1-d4 triangle. With pawns, the leading group is the pawns of one color,
+ * the most advanced of them (as MAP_PAWNS orders them) picking both one of
+ * four subtables by its file, mirrored into a-d, and its own slot. Groups of
+ * k identical pieces are indexed as a combination of k free squares.
+ */
+
+static int MAP_B1H1H7[64];      // squares below the a1-h8 diagonal
+static int MAP_A1D1D4[64];      // squares of the a1-d1-d4 triangle
+static int MAP_KK[10][64];      // two kings, the first in the triangle
+static uint64_t BINOMIAL[6][64];
+static int MAP_PAWNS[64];
+static int LEAD_PAWN_IDX[6][64];
+static int LEAD_PAWNS_SIZE[6][TB_PAWN_FILES];
+
+/** @brief Positions of three leading pieces, and of two kings */
+#define TB_UNIQUE_SIZE 31332
+#define TB_KK_SIZE 462
+
+/** @brief Rank minus file: 0 on the a1-h8 diagonal, negative below it */
+static int off_diagonal(square s) {
+    return (int) (s / 8) - (int) (s % 8);
+}
+
+static square flip_diagonal(square s) {
+    return (square) (((s >> 3) | (s << 3)) & 63);
+}
+
+static void tb_init_indexing(void) {
+    int code = 0;
+    for (square s = 0; s < 64; s++) {
+        if (off_diagonal(s) < 0) MAP_B1H1H7[s] = code++;
+    }
+
+    // Below the diagonal first, then on it
+    square diagonal[4];
+    int on_diagonal = 0;
+    code = 0;
+    for (square s = 0; s < 32; s++) {
+        if (s % 8 > 3) continue;
+        if (off_diagonal(s) < 0) MAP_A1D1D4[s] = code++;
+        if (off_diagonal(s) == 0) diagonal[on_diagonal++] = s;
+    }
+    for (int i = 0; i < on_diagonal; i++) MAP_A1D1D4[diagonal[i]] = code++;
+
+    // Both kings on the diagonal last
+    int both[40][2], n_both = 0;
+    code = 0;
+    for (int idx = 0; idx < 10; idx++) {
+        for (square s1 = 0; s1 < 32; s1++) {
+            if (s1 % 8 > 3 || off_diagonal(s1) > 0 || MAP_A1D1D4[s1] != idx)
+                continue;
+            for (square s2 = 0; s2 < 64; s2++) {
+                int ranks = s1 / 8 - s2 / 8, files = s1 % 8 - s2 % 8;
+                if (-1 <= ranks && ranks <= 1 && -1 <= files && files <= 1)
+                    continue;
+                if (off_diagonal(s1) == 0 && off_diagonal(s2) > 0) continue;
+                if (off_diagonal(s1) == 0 && off_diagonal(s2) == 0) {
+                    both[n_both][0] = idx;
+                    both[n_both++][1] = s2;
+                } else {
+                    MAP_KK[idx][s2] = code++;
+                }
+            }
+        }
+    }
+    for (int i = 0; i < n_both; i++) MAP_KK[both[i][0]][both[i][1]] = code++;
+    dbg_assert(code == TB_KK_SIZE);
+
+    BINOMIAL[0][0] = 1;
+    for (int n = 1; n < 64; n++) {
+        for (int k = 0; k < 6 && k <= n; k++) {
+            BINOMIAL[k][n] = (k > 0 ? BINOMIAL[k - 1][n - 1] : 0) +
+                             (k < n ? BINOMIAL[k][n - 1] : 0);
+        }
+    }
+
+    // Pawns from a2, h2, b2, g2, ... to e7; the leading pawn by rank, then file
+    int available = 47;
+    for (int lead = 1; lead < 6; lead++) {
+        for (int f = 0; f < TB_PAWN_FILES; f++) {
+            int idx = 0;
+            for (int r = 1; r < 7; r++) {
+                square s = 8 * r + f;
+                if (lead == 1) {
+                    MAP_PAWNS[s] = available--;
+                    MAP_PAWNS[s ^ 7] = available--;
+                }
+                LEAD_PAWN_IDX[lead][s] = idx;
+                idx += BINOMIAL[lead - 1][MAP_PAWNS[s]];
+            }
+            LEAD_PAWNS_SIZE[lead][f] = idx;
+        }
+    }
+    return;
+}
+
+/*
+ * ---------------------------------------------------------------------------
+ *                               DECOMPRESSION
+ * ---------------------------------------------------------------------------
+ *
+ * Values are compressed by pairing: each symbol stands for a value or a pair
+ * of symbols, and symbols are coded with canonical Huffman codes in blocks of
+ * a few KB. A sparse index gives, every `span` values, the block and the
+ * offset in it of a value, from which the blocks' lengths lead to any other.
+ */
+
+/** @brief How one side to move (and leading pawn file) of a file is stored */
+typedef struct tb_pairs {
+    uint8_t flags;
+    uint8_t pieces[TB_MAX_PIECES];          // piece codes in index order
+    uint8_t group_len[TB_MAX_PIECES + 1];   // 0 after the last group
+    uint64_t group_idx[TB_MAX_PIECES + 1];  // factors, then the table size
+    uint8_t single_value;
+    size_t block_size;
+    uint64_t span;
+    uint64_t sparse_size;
+    const uint8_t *sparse;                  // block (32 bits), offset (16)
+    uint32_t blocks;
+    uint64_t block_lengths_size;
+    const uint8_t *block_lengths;           // values in a block - 1 (16 bits)
+    const uint8_t *data;
+    int min_sym_len;
+    const uint8_t *lowest_sym;              // by code length (16 bits)
+    uint64_t *base;                         // by code length
+    const uint8_t *btree;                   // children of each symbol
+    uint8_t *sym_len;                       // values of each symbol - 1
+    const uint8_t *map[4];                  // DTZ: win, loss, cursed, blessed
+} tb_pairs;
+
+static int tb_btree_left(const tb_pairs *d, int sym) {
+    const uint8_t *lr = d->btree + 3 * sym;
+    return ((lr[1] & 0xF) << 8) | lr[0];
+}
+
+static int tb_btree_right(const tb_pairs *d, int sym) {
+    const uint8_t *lr = d->btree + 3 * sym;
+    return (lr[2] << 4) | (lr[1] >> 4);
+}
+
+/** @brief Counts the values of a symbol and those it is made of */
+static bool tb_count_sym(tb_pairs *d, int sym, int symbols, uint8_t *visited) {
+    visited[sym] = true;
+    int left = tb_btree_left(d, sym), right = tb_btree_right(d, sym);
+    if (right == 0xFFF) {
+        d->sym_len[sym] = 0;
+        return true;
+    }
+    if (left >= symbols || right >= symbols) return false;
+    if (!visited[left] && !tb_count_sym(d, left, symbols, visited)) return false;
+    if (!visited[right] && !tb_count_sym(d, right, symbols, visited))
+        return false;
+    int len = d->sym_len[left] + d->sym_len[right] + 1;
+    if (len > UINT8_MAX) return false;
+    d->sym_len[sym] = (uint8_t) len;
+    return true;
+}
+
+/**
+ * @brief Reads the sizes and Huffman codes of a side to move
+ *
+ * @return The data after them, or NULL if they don't make sense
+ */
+static const uint8_t *tb_setup_pairs(tb_pairs *d, const uint8_t *data,
+                                     uint64_t size) {
+    d->flags = *data++;
+    if (d->flags & TB_FLAG_SINGLE_VALUE) {
+        d->single_value = *data++;
+        return data;
+    }
+
+    d->block_size = (size_t) 1 << *data++;
+    d->span = (uint64_t) 1 << *data++;
+    d->sparse_size = (size + d->span - 1) / d->span;
+    int padding = *data++;
+    d->blocks = read_le32(data);
+    data += 4;
+    d->block_lengths_size = (uint64_t) d->blocks + padding;
+    int max_sym_len = *data++;
+    d->min_sym_len = *data++;
+    if (d->min_sym_len == 0 || max_sym_len < d->min_sym_len ||
+        max_sym_len > 32) return NULL;
+
+    // Codes of the same length are consecutive, longer codes first
+    int lengths = max_sym_len - d->min_sym_len + 1;
+    d->lowest_sym = data;
+    d->base = calloc(lengths, sizeof(uint64_t));
+    if (d->base == NULL) {
+        perror("malloc error");
+        exit(1);
+    }
+    for (int i = lengths - 2; i >= 0; i--) {
+        d->base[i] = (d->base[i + 1] + read_le16(d->lowest_sym + 2 * i) -
+                      read_le16(d->lowest_sym + 2 * (i + 1))) / 2;
+    }
+    for (int i = 0; i < lengths; i++) d->base[i] <<= 64 - i - d->min_sym_len;
+    data += 2 * lengths;
+
+    int symbols = read_le16(data);
+    data += 2;
+    d->btree = data;
+    d->sym_len = malloc(symbols);
+    uint8_t *visited = calloc(symbols, 1);
+    if (d->sym_len == NULL || visited == NULL) {
+        perror("malloc error");
+        exit(1);
+    }
+    bool ok = true;
+    for (int sym = 0; sym < symbols && ok; sym++) {
+        if (!visited[sym]) ok = tb_count_sym(d, sym, symbols, visited);
+    }
+    free(visited);
+    return ok ? data + 3 * symbols + (symbols & 1) : NULL;
+}
+
+/** @brief The value at an index of a side to move */
+static int tb_decompress(const tb_pairs *d, uint64_t idx) {
+    if (d->flags & TB_FLAG_SINGLE_VALUE) return d->single_value;
+
+    const uint8_t *sparse = d->sparse + 6 * (idx / d->span);
+    uint32_t block = read_le32(sparse);
+    int offset = read_le16(sparse + 4) + (int) (idx % d->span) -
+                 (int) (d->span / 2);
+    while (offset < 0) offset += read_le16(d->block_lengths + 2 * --block) + 1;
+    while (offset > read_le16(d->block_lengths + 2 * block)) {
+        offset -= read_le16(d->block_lengths + 2 * block++) + 1;
+    }
+
+    // Skips whole symbols up to the one holding the value
+    const uint8_t *ptr = d->data + (uint64_t) block * d->block_size;
+    uint64_t buffer = read_be64(ptr);
+    ptr += 8;
+    int bits = 64, sym;
+    while (true) {
+        int len = 0;
+        while (buffer < d->base[len]) len++;
+        sym = (int) ((buffer - d->base[len]) >> (64 - len - d->min_sym_len));
+        sym += read_le16(d->lowest_sym + 2 * len);
+        if (offset < d->sym_len[sym] + 1) break;
+        offset -= d->sym_len[sym] + 1;
+        len += d->min_sym_len;
+        buffer <<= len;
+        bits -= len;
+        if (bits <= 32) {
+            bits += 32;
+            buffer |= (uint64_t) read_be32(ptr) << (64 - bits);
+            ptr += 4;
+        }
+    }
+
+    // Then down the pairs to the value
+    while (d->sym_len[sym] != 0) {
+        int left = tb_btree_left(d, sym);
+        if (offset < d->sym_len[left] + 1) {
+            sym = left;
+        } else {
+            offset -= d->sym_len[left] + 1;
+            sym = tb_btree_right(d, sym);
+        }
+    }
+    return tb_btree_left(d, sym);
+}
+
+/*
+ * ---------------------------------------------------------------------------
+ *                                  TABLES
+ * ---------------------------------------------------------------------------
+ */
+
+/** @brief A file of a table, mapped on first use */
+typedef struct tb_file {
+    char *path;                 // NULL if it wasn't found
+    const uint8_t *memory;
+    size_t size;
+    bool ready;                 // mapped and read, set last
+    bool failed;                // couldn't be, so isn't tried again
+    tb_pairs pairs[2][TB_PAWN_FILES];   // by side to move, leading pawn file
+} tb_file;
+
+/** @brief A material found by tb_init */
+typedef struct tb_table {
+    char name[TB_NAME_SIZE];
+    uint64_t key;               // the first side of the name white
+    uint64_t key2;              // and black, the same if symmetric
+    int pieces;
+    bool has_pawns;
+    bool has_unique;            // a piece other than a king alone of its kind
+    int pawns[2];               // of the leading color, then of the other
+    tb_file wdl, dtz;
+} tb_table;
+
+static tb_table *TABLES = NULL;
+static int NUM_TABLES = 0;
+static int NUM_WDL = 0;
+static int NUM_DTZ = 0;         // of those, with a DTZ file too
+static int MAX_PIECES = 0;
+static int HASH[TB_HASH_SIZE];  // indices of tables with a result file, or -1
+
+/** @brief Serialises mapping; probes of mapped tables don't take it */
+static pthread_mutex_t MAP_LOCK = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t INDEXING_ONCE = PTHREAD_ONCE_INIT;
+
+static int tb_hash(uint64_t key) {
+    return (int) ((key * 0x9E3779B97F4A7C15ull) >> 52) & (TB_HASH_SIZE - 1);
+}
+
+static tb_table *tb_find(uint64_t key) {
+    for (int h = tb_hash(key); HASH[h] >= 0; h = (h + 1) & (TB_HASH_SIZE - 1)) {
+        tb_table *T = &TABLES[HASH[h]];
+        if (T->key == key || T->key2 == key) return T;
+    }
+    return NULL;
+}
+
+/** @brief Splits pieces into groups and works out their factors */
+static void tb_setup_groups(tb_table *T, tb_pairs *d, int order[2], int f) {
+    int n = 0;
+    int first_len = T->has_pawns ? 0 : T->has_unique ? 3 : 2;
+    d->group_len[0] = 1;
+    for (int i = 1; i < T->pieces; i++) {
+        if (--first_len > 0 || d->pieces[i] == d->pieces[i - 1]) {
+            d->group_len[n]++;
+        } else {
+            d->group_len[++n] = 1;
+        }
+    }
+    d->group_len[++n] = 0;
+
+    // The file gives the order of the groups, the lead and other pawns first
+    bool pp = T->has_pawns && T->pawns[1] > 0;
+    int next = pp ? 2 : 1;
+    int free_squares = 64 - d->group_len[0] - (pp ? d->group_len[1] : 0);
+    uint64_t idx = 1;
+    for (int k = 0; next < n || k == order[0] || k == order[1]; k++) {
+        if (k == order[0]) {
+            d->group_idx[0] = idx;
+            idx *= T->has_pawns ? LEAD_PAWNS_SIZE[d->group_len[0]][f]
+                 : T->has_unique ? TB_UNIQUE_SIZE : TB_KK_SIZE;
+        } else if (k == order[1]) {
+            d->group_idx[1] = idx;
+            idx *= BINOMIAL[d->group_len[1]][48 - d->group_len[0]];
+        } else {
+            d->group_idx[next] = idx;
+            idx *= BINOMIAL[d->group_len[next]][free_squares];
+            free_squares -= d->group_len[next++];
+        }
+    }
+    d->group_idx[n] = idx;
+    return;
+}
+
+/** @brief The number of positions a side to move of a file indexes */
+static uint64_t tb_pairs_size(const tb_pairs *d) {
+    int n = 0;
+    while (d->group_len[n] != 0) n++;
+    return d->group_idx[n];
+}
+
+/** @brief Reads the layout of a mapped file */
+static bool tb_setup(tb_table *T, tb_file *F, bool dtz) {
+    const uint8_t *data = F->memory + 4, *end = F->memory + F->size;
+    if (((*data & TB_HAS_PAWNS) != 0) != T->has_pawns) return false;
+    data++;
+
+    // Only result files of unsymmetric materials store both sides to move
+    int sides = !dtz && T->key != T->key2 ? 2 : 1;
+    int files = T->has_pawns ? TB_PAWN_FILES : 1;
+    bool pp = T->has_pawns && T->pawns[1] > 0;
+    for (int f = 0; f < files; f++) {
+        int order[2][2] = {
+            { data[0] & 0xF, pp ? data[1] & 0xF : 0xF },
+            { data[0] >> 4, pp ? data[1] >> 4 : 0xF }
+        };
+        data += 1 + pp;
+        for (int k = 0; k < T->pieces; k++, data++) {
+            for (int i = 0; i < sides; i++) {
+                F->pairs[i][f].pieces[k] = i == 0 ? *data & 0xF : *data >> 4;
+            }
+        }
+        for (int i = 0; i < sides; i++) {
+            tb_setup_groups(T, &F->pairs[i][f], order[i], f);
+        }
+    }
+    data += (data - F->memory) & 1;
+
+    for (int f = 0; f < files; f++) {
+        for (int i = 0; i < sides && data != NULL; i++) {
+            tb_pairs *d = &F->pairs[i][f];
+            data = tb_setup_pairs(d, data, tb_pairs_size(d));
+        }
+    }
+    if (data == NULL) return false;
+
+    // DTZ maps from the stored values to plies, by result
+    if (dtz) {
+        for (int f = 0; f < files; f++) {
+            tb_pairs *d = &F->pairs[0][f];
+            if (!(d->flags & TB_FLAG_MAPPED)) continue;
+            if (d->flags & TB_FLAG_WIDE) {
+                data += (data - F->memory) & 1;
+                for (int i = 0; i < 4; i++) {
+                    d->map[i] = data + 2;
+                    data += 2 + 2 * read_le16(data);
+                }
+            } else {
+                for (int i = 0; i < 4; i++) {
+                    d->map[i] = data + 1;
+                    data += 1 + *data;
+                }
+            }
+        }
+        data += (data - F->memory) & 1;
+    }
+
+    for (int f = 0; f < files; f++) {
+        for (int i = 0; i < sides; i++) {
+            tb_pairs *d = &F->pairs[i][f];
+            d->sparse = data;
+            data += 6 * d->sparse_size;
+        }
+    }
+    for (int f = 0; f < files; f++) {
+        for (int i = 0; i < sides; i++) {
+            tb_pairs *d = &F->pairs[i][f];
+            d->block_lengths = data;
+            data += 2 * d->block_lengths_size;
+        }
+    }
+    for (int f = 0; f < files; f++) {
+        for (int i = 0; i < sides; i++) {
+            tb_pairs *d = &F->pairs[i][f];
+            data += (64 - (data - F->memory) % 64) % 64;
+            d->data = data;
+            data += (uint64_t) d->blocks * d->block_size;
+        }
+    }
+    return data <= end;
+}
+
+/** @brief Frees what tb_setup allocated for a file */
+static void tb_free_pairs(tb_file *F) {
+    for (int i = 0; i < 2; i++) {
+        for (int f = 0; f < TB_PAWN_FILES; f++) {
+            free(F->pairs[i][f].base);
+            free(F->pairs[i][f].sym_len);
+        }
+    }
+    memset(F->pairs, 0, sizeof(F->pairs));
+    return;
+}
+
+/** @brief Maps a file, checking its magic and reading its layout */
+static bool tb_map_file(tb_table *T, tb_file *F, bool dtz) {
+    int fd = open(F->path, O_RDONLY);
+    if (fd < 0) {
+        perror("open error");
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size % 64 != 16) {
+        close(fd);
+        fprintf(stderr, "%s: not a Syzygy table\n", F->path);
+        return false;
+    }
+    F->size = st.st_size;
+    void *memory = mmap(NULL, F->size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (memory == MAP_FAILED) {
+        perror("mmap error");
+        return false;
+    }
+    F->memory = memory;
+
+    const uint8_t *magic = dtz ? TB_DTZ_MAGIC : TB_WDL_MAGIC;
+    if (memcmp(F->memory, magic, 4) != 0 || !tb_setup(T, F, dtz)) {
+        tb_free_pairs(F);
+        munmap(memory, F->size);
+        F->memory = NULL;
+        fprintf(stderr, "%s: not a Syzygy table\n", F->path);
+        return false;
+    }
+    return true;
+}
+
+/** @brief Whether a file is mapped, mapping it on first use */
+static bool tb_map(tb_table *T, bool dtz) {
+    tb_file *F = dtz ? &T->dtz : &T->wdl;
+    if (__atomic_load_n(&F->ready, __ATOMIC_ACQUIRE)) return true;
+    if (F->path == NULL) return false;
+
+    pthread_mutex_lock(&MAP_LOCK);
+    if (!F->ready && !F->failed) {
+        F->failed = !tb_map_file(T, F, dtz);
+        __atomic_store_n(&F->ready, !F->failed, __ATOMIC_RELEASE);
+    }
+    bool ready = F->ready;
+    pthread_mutex_unlock(&MAP_LOCK);
+    return ready;
+}
+
+void tb_free(void) {
+    for (int i = 0; i < NUM_TABLES; i++) {
+        tb_file *files[2] = { &TABLES[i].wdl, &TABLES[i].dtz };
+        for (int j = 0; j < 2; j++) {
+            if (files[j]->ready) {
+                tb_free_pairs(files[j]);
+                munmap((void *) files[j]->memory, files[j]->size);
+            }
+            free(files[j]->path);
+        }
+    }
+    free(TABLES);
+    TABLES = NULL;
+    NUM_TABLES = NUM_WDL = NUM_DTZ = MAX_PIECES = 0;
+    return;
+}
+
+/** @brief Adds a file found in a directory to the table of its material */
+static void tb_add_file(const char *dir, const char *file) {
+    size_t length = strlen(file);
+    if (length < 5 || length - 5 >= TB_NAME_SIZE) return;
+    bool dtz = strcmp(file + length - 5, ".rtbz") == 0;
+    if (!dtz && strcmp(file + length - 5, ".rtbw") != 0) return;
+    char name[TB_NAME_SIZE];
+    memcpy(name, file, length - 5);
+    name[length - 5] = '\0';
+    int counts[2][6];
+    int pieces = tb_parse(name, counts);
+    if (pieces == 0) return;
+
+    tb_table *T = NULL;
+    for (int i = 0; i < NUM_TABLES && T == NULL; i++) {
+        if (strcmp(TABLES[i].name, name) == 0) T = &TABLES[i];
+    }
+    if (T == NULL) {
+        TABLES = realloc(TABLES, (NUM_TABLES + 1) * sizeof(tb_table));
+        if (TABLES == NULL) {
+            perror("malloc error");
+            exit(1);
+        }
+        T = &TABLES[NUM_TABLES++];
+        memset(T, 0, sizeof(tb_table));
+        strcpy(T->name, name);
+        T->key = tb_key(counts);
+        int swapped[2][6];
+        memcpy(swapped[0], counts[1], sizeof(counts[1]));
+        memcpy(swapped[1], counts[0], sizeof(counts[0]));
+        T->key2 = tb_key(swapped);
+        T->pieces = pieces;
+        T->has_pawns = counts[0][PAWN] + counts[1][PAWN] > 0;
+        for (int side = 0; side < 2; side++) {
+            for (Piece p = PAWN; p < KING; p++) {
+                if (counts[side][p] == 1) T->has_unique = true;
+            }
+        }
+        // The color with the fewest pawns leads, if it has any
+        int lead = counts[1][PAWN] > 0 &&
+                   (counts[0][PAWN] == 0 || counts[1][PAWN] < counts[0][PAWN]);
+        T->pawns[0] = counts[lead][PAWN];
+        T->pawns[1] = counts[!lead][PAWN];
+    }
+
+    // The first directory a file is found in wins
+    tb_file *F = dtz ? &T->dtz : &T->wdl;
+    if (F->path != NULL) return;
+    F->path = malloc(strlen(dir) + length + 2);
+    if (F->path == NULL) {
+        perror("malloc error");
+        exit(1);
+    }
+    sprintf(F->path, "%s/%s", dir, file);
+    return;
+}
+
+int tb_init(const char *path) {
+    pthread_once(&INDEXING_ONCE, tb_init_indexing);
+    tb_free();
+    for (int h = 0; h < TB_HASH_SIZE; h++) HASH[h] = -1;
+    if (path == NULL || path[0] == '\0') return 0;
+
+    char *paths = strdup(path), *saved;
+    if (paths == NULL) {
+        perror("malloc error");
+        exit(1);
+    }
+    for (char *dir = strtok_r(paths, ":", &saved); dir != NULL;
+         dir = strtok_r(NULL, ":", &saved)) {
+        DIR *D = opendir(dir);
+        if (D == NULL) continue;
+        struct dirent *entry;
+        while ((entry = readdir(D)) != NULL) tb_add_file(dir, entry->d_name);
+        closedir(D);
+    }
+    free(paths);
+
+    // Only materials with results can be probed, under both keys
+    for (int i = 0; i < NUM_TABLES && NUM_WDL < TB_HASH_SIZE / 4; i++) {
+        tb_table *T = &TABLES[i];
+        if (T->wdl.path == NULL) continue;
+        NUM_WDL++;
+        if (T->dtz.path != NULL) NUM_DTZ++;
+        if (T->pieces > MAX_PIECES) MAX_PIECES = T->pieces;
+        uint64_t keys[2] = { T->key, T->key2 };
+        for (int k = 0; k < (T->key == T->key2 ? 1 : 2); k++) {
+            int h = tb_hash(keys[k]);
+            while (HASH[h] >= 0) h = (h + 1) & (TB_HASH_SIZE - 1);
+            HASH[h] = i;
+        }
+    }
+    return NUM_WDL;
+}
+
+int tb_dtz_tables(void) {
+    return NUM_DTZ;
+}
+
+int tb_max_pieces(void) {
+    return MAX_PIECES;
+}
+
+/*
+ * ---------------------------------------------------------------------------
+ *                                  PROBES
+ * ---------------------------------------------------------------------------
+ */
+
+/** @brief How a probe went, besides its value */
+typedef enum TbState {
+    TB_FAIL,                // a table is missing or broken
+    TB_OK,
+    TB_CHANGE_STM,          // DTZ is stored for the other side to move
+    TB_ZEROING_BEST_MOVE    // the best move captures or moves a pawn
+} TbState;
+
+/** @brief Maps the values of DTZ files to plies */
+static int tb_map_dtz(const tb_pairs *d, int value, int wdl) {
+    static const int MAPS[5] = { 1, 3, 0, 2, 0 };   // by wdl - TB_LOSS
+    if (d->flags & TB_FLAG_MAPPED) {
+        const uint8_t *map = d->map[MAPS[wdl - TB_LOSS]];
+        value = d->flags & TB_FLAG_WIDE ? read_le16(map + 2 * value)
+                                        : map[value];
+    }
+    // Moves rather than plies, unless stored in plies
+    if ((wdl == TB_WIN && !(d->flags & TB_FLAG_WIN_PLIES)) ||
+        (wdl == TB_LOSS && !(d->flags & TB_FLAG_LOSS_PLIES)) ||
+        wdl == TB_CURSED_WIN || wdl == TB_BLESSED_LOSS) {
+        value *= 2;
+    }
+    return value + 1;
+}
+
+/**
+ * @brief Looks a position without captures up in the files of its material
+ *
+ * @param[in] P
+ * @param[in] dtz whether to look up DTZ rather than the result
+ * @param[in] wdl result of the position, for DTZ
+ * @param[out] state TB_FAIL, or TB_CHANGE_STM for DTZ of the other side
+ *
+ * @return The result, or DTZ in plies counted from 1
+ */
+static int tb_probe_table(position *P, bool dtz, int wdl, TbState *state) {
+    board B;
+    board_from_position(&B, P);
+    bitboard occupied = B.colors[WHITE] | B.colors[BLACK];
+    if (bitboard_count_bits(occupied) == 2) return TB_DRAW;
+
+    uint64_t key = tb_board_key(&B, WHITE);
+    tb_table *T = tb_find(key);
+    if (T == NULL || !tb_map(T, dtz)) {
+        *state = TB_FAIL;
+        return 0;
+    }
+    tb_file *F = dtz ? &T->dtz : &T->wdl;
+
+    // Into the colors of the files, white the stronger side
+    bool symmetric = T->key == T->key2;
+    bool flip = symmetric ? B.color == BLACK : key != T->key;
+    uint8_t flip_code = flip ? TB_BLACK_CODE : 0;
+    square flip_squares = flip ? 56 : 0;
+    int stm = flip ^ (B.color == BLACK);
+
+    square squares[TB_MAX_PIECES];
+    uint8_t pieces[TB_MAX_PIECES];
+    int size = 0, lead_pawns = 0, f = 0;
+    bitboard lead = BITBOARD_EMPTY;
+    if (T->has_pawns) {
+        uint8_t code = F->pairs[0][0].pieces[0] ^ flip_code;
+        Color c = code & TB_BLACK_CODE ? BLACK : WHITE;
+        lead = B.colors[c] & B.pieces[PAWN];
+        bitboard b = lead;
+        while (b) {
+            squares[size] = bitboard_iter_first(&b) ^ flip_squares;
+            pieces[size++] = code ^ flip_code;
+        }
+        lead_pawns = size;
+        int most = 0;
+        for (int i = 1; i < size; i++) {
+            if (MAP_PAWNS[squares[i]] > MAP_PAWNS[squares[most]]) most = i;
+        }
+        square s = squares[0];
+        squares[0] = squares[most];
+        squares[most] = s;
+        f = squares[0] % 8 > 3 ? 7 - squares[0] % 8 : squares[0] % 8;
+    }
+
+    if (dtz && (F->pairs[0][f].flags & TB_FLAG_STM) != stm &&
+        !(symmetric && !T->has_pawns)) {
+        *state = TB_CHANGE_STM;
+        return 0;
+    }
+
+    bitboard b = occupied ^ lead;
+    while (b) {
+        square s = bitboard_iter_first(&b);
+        squares[size] = s ^ flip_squares;
+        pieces[size++] = tb_piece_code(&B, s) ^ flip_code;
+    }
+    const tb_pairs *d = &F->pairs[dtz ? 0 : stm][f];
+
+    // Into the order of the file
+    for (int i = lead_pawns; i < size - 1; i++) {
+        for (int j = i; j < size; j++) {
+            if (d->pieces[i] != pieces[j]) continue;
+            uint8_t code = pieces[i];
+            square s = squares[i];
+            pieces[i] = pieces[j];
+            squares[i] = squares[j];
+            pieces[j] = code;
+            squares[j] = s;
+            break;
+        }
+    }
+
+    // The first piece into the a-d files, and without pawns the triangle
+    if (squares[0] % 8 > 3) {
+        for (int i = 0; i < size; i++) squares[i] ^= 7;
+    }
+    uint64_t idx;
+    if (T->has_pawns) {
+        for (int i = 2; i < lead_pawns; i++) {
+            for (int j = i; j > 1 && MAP_PAWNS[squares[j - 1]] > MAP_PAWNS[squares[j]]; j--) {
+                square s = squares[j];
+                squares[j] = squares[j - 1];
+                squares[j - 1] = s;
+            }
+        }
+        idx = LEAD_PAWN_IDX[lead_pawns][squares[0]];
+        for (int i = 1; i < lead_pawns; i++) {
+            idx += BINOMIAL[i][MAP_PAWNS[squares[i]]];
+        }
+    } else {
+        if (squares[0] / 8 > 3) {
+            for (int i = 0; i < size; i++) squares[i] ^= 56;
+        }
+        // The first leading piece off the diagonal below it
+        for (int i = 0; i < d->group_len[0]; i++) {
+            if (off_diagonal(squares[i]) == 0) continue;
+            if (off_diagonal(squares[i]) > 0) {
+                for (int j = i; j < size; j++) {
+                    squares[j] = flip_diagonal(squares[j]);
+                }
+            }
+            break;
+        }
+
+        if (T->has_unique) {
+            int adjust1 = squares[1] > squares[0];
+            int adjust2 = (squares[2] > squares[0]) + (squares[2] > squares[1]);
+            if (off_diagonal(squares[0]) != 0) {
+                idx = (MAP_A1D1D4[squares[0]] * 63 + (squares[1] - adjust1)) *
+                      62 + squares[2] - adjust2;
+            } else if (off_diagonal(squares[1]) != 0) {
+                idx = (6 * 63 + (squares[0] / 8) * 28 + MAP_B1H1H7[squares[1]]) *
+                      62 + squares[2] - adjust2;
+            } else if (off_diagonal(squares[2]) != 0) {
+                idx = 6 * 63 * 62 + 4 * 28 * 62 + (squares[0] / 8) * 7 * 28 +
+                      (squares[1] / 8 - adjust1) * 28 + MAP_B1H1H7[squares[2]];
+            } else {
+                idx = 6 * 63 * 62 + 4 * 28 * 62 + 4 * 7 * 28 +
+                      (squares[0] / 8) * 7 * 6 + (squares[1] / 8 - adjust1) * 6 +
+                      (squares[2] / 8 - adjust2);
+            }
+        } else {
+            idx = MAP_KK[MAP_A1D1D4[squares[0]]][squares[1]];
+        }
+    }
+
+    // Each further group as a combination of the squares left to it
+    idx *= d->group_idx[0];
+    int first = d->group_len[0];
+    bool remaining_pawns = T->has_pawns && T->pawns[1] > 0;
+    for (int g = 1; d->group_len[g] != 0; g++) {
+        int len = d->group_len[g];
+        for (int i = first + 1; i < first + len; i++) {
+            for (int j = i; j > first && squares[j - 1] > squares[j]; j--) {
+                square s = squares[j];
+                squares[j] = squares[j - 1];
+                squares[j - 1] = s;
+            }
+        }
+        uint64_t n = 0;
+        for (int i = 0; i < len; i++) {
+            int adjust = 0;
+            for (int k = 0; k < first; k++) adjust += squares[first + i] > squares[k];
+            n += BINOMIAL[i + 1][squares[first + i] - adjust - 8 * remaining_pawns];
+        }
+        remaining_pawns = false;
+        idx += n * d->group_idx[g];
+        first += len;
+    }
+
+    int value = tb_decompress(d, idx);
+    return dtz ? tb_map_dtz(d, value, wdl) : value - 2;
+}
+
+/** @brief Whether a move resets the fifty-move counter */
+static bool tb_zeroing(move m) {
+    return m.piece == PAWN || (m.flags & M_FLAG_CAPTURE);
+}
+
+/**
+ * @brief The result of a position, searching the captures the files leave out
+ *
+ * @param[in] P
+ * @param[in] zeroing whether pawn moves are searched too, for DTZ
+ * @param[out] state TB_ZEROING_BEST_MOVE if the result is a searched move's
+ */
+static int tb_search(position *P, bool zeroing, TbState *state) {
+    movelist M;
+    movelist_clear(&M);
+    generate_moves(&M, P);
+
+    int best = TB_LOSS, searched = 0;
+    for (int i = 0; i < M.size; i++) {
+        move m = M.array[i];
+        if (!(m.flags & M_FLAG_CAPTURE) && (!zeroing || m.piece != PAWN))
+            continue;
+        searched++;
+        undo U;
+        move_make(P, m, &U);
+        position_rotate(P);
+        int value = -tb_search(P, false, state);
+        position_rotate(P);
+        move_unmake(P, m, &U);
+        if (*state == TB_FAIL) return TB_DRAW;
+        if (value > best) {
+            best = value;
+            if (value >= TB_WIN) {
+                *state = TB_ZEROING_BEST_MOVE;
+                return value;
+            }
+        }
+    }
+
+    // With every move searched, the files aren't needed
+    bool no_more_moves = searched > 0 && searched == M.size;
+    int value = best;
+    if (!no_more_moves) {
+        value = tb_probe_table(P, false, TB_DRAW, state);
+        if (*state == TB_FAIL) return TB_DRAW;
+    }
+    if (best >= value) {
+        *state = best > TB_DRAW || no_more_moves ? TB_ZEROING_BEST_MOVE : TB_OK;
+        return best;
+    }
+    *state = TB_OK;
+    return value;
+}
+
+/** @brief DTZ of a result reached by a zeroing move */
+static int tb_dtz_before_zeroing(int wdl) {
+    switch (wdl) {
+        case TB_WIN: return 1;
+        case TB_CURSED_WIN: return 101;
+        case TB_BLESSED_LOSS: return -101;
+        case TB_LOSS: return -1;
+        default: return 0;
+    }
+}
+
+static int sign(int x) {
+    return (x > 0) - (x < 0);
+}
+
+/** @brief Whether the side to move is mated */
+static bool tb_mated(position *P) {
+    if (!king_in_check(P, OURS)) return false;
+    movelist M;
+    movelist_clear(&M);
+    generate_moves(&M, P);
+    return M.size == 0;
+}
+
+/** @brief DTZ of a position, see tb_probe_dtz */
+static int tb_dtz(position *P, TbState *state) {
+    *state = TB_OK;
+    int wdl = tb_search(P, true, state);
+    if (*state == TB_FAIL || wdl == TB_DRAW) return 0;
+    if (*state == TB_ZEROING_BEST_MOVE) return tb_dtz_before_zeroing(wdl);
+
+    int dtz = tb_probe_table(P, true, wdl, state);
+    if (*state == TB_FAIL) return 0;
+    if (*state != TB_CHANGE_STM) {
+        int cursed = wdl == TB_CURSED_WIN || wdl == TB_BLESSED_LOSS;
+        return (dtz + 100 * cursed) * sign(wdl);
+    }
+
+    // Stored for the other side to move: a ply further than its best
+    movelist M;
+    movelist_clear(&M);
+    generate_moves(&M, P);
+    int min_dtz = INT32_MAX;
+    for (int i = 0; i < M.size; i++) {
+        move m = M.array[i];
+        undo U;
+        move_make(P, m, &U);
+        position_rotate(P);
+        if (tb_zeroing(m)) {
+            dtz = -tb_dtz_before_zeroing(tb_search(P, false, state));
+        } else {
+            dtz = -tb_dtz(P, state);
+        }
+        if (dtz == 1 && tb_mated(P)) min_dtz = 1;
+        if (!tb_zeroing(m)) dtz += sign(dtz);
+        if (sign(dtz) == sign(wdl) && dtz < min_dtz) min_dtz = dtz;
+        position_rotate(P);
+        move_unmake(P, m, &U);
+        if (*state == TB_FAIL) return 0;
+    }
+    return min_dtz == INT32_MAX ? -1 : min_dtz;
+}
+
+bool tb_probe_wdl(position *P, int *wdl) {
+    dbg_requires(P != NULL && wdl != NULL);
+    if (P->castling != 0 ||
+        bitboard_count_bits(P->whose[OURS] | P->whose[THEIRS]) > MAX_PIECES)
+        return false;
+    TbState state = TB_OK;
+    *wdl = tb_search(P, false, &state);
+    return state != TB_FAIL;
+}
+
+bool tb_probe_dtz(position *P, int *dtz) {
+    dbg_requires(P != NULL && dtz != NULL);
+    if (P->castling != 0 ||
+        bitboard_count_bits(P->whose[OURS] | P->whose[THEIRS]) > MAX_PIECES)
+        return false;
+    TbState state;
+    *dtz = tb_dtz(P, &state);
+    return state != TB_FAIL;
+}
+
+/** @brief Rank of a certain win, above any other move */
+#define TB_MAX_RANK (1 << 18)
+
+/** @brief Whether a hash is among those of the game from index `first` on */
+static bool tb_in_game(const zhash *history, int first, int size, zhash key) {
+    for (int i = first > 0 ? first : 0; i < size; i++) {
+        if (history[i] == key) return true;
+    }
+    return false;
+}
+
+bool tb_root_filter(position *P, const zhash *history, int history_size,
+                    movelist_t M, int *wdl) {
+    dbg_requires(P != NULL && M != NULL && wdl != NULL);
+    dbg_requires(history != NULL || history_size == 0);
+    if (M->size == 0 || P->castling != 0 ||
+        bitboard_count_bits(P->whose[OURS] | P->whose[THEIRS]) > MAX_PIECES)
+        return false;
+
+    // Whether a position repeated since the last zeroing move, P included
+    int first = history_size > P->halfmoves ? history_size - P->halfmoves : 0;
+    bool repeated = tb_in_game(history, first, history_size, P->hash);
+    for (int i = history_size - 1; i > first && !repeated; i--) {
+        repeated = tb_in_game(history, first, i, history[i]);
+    }
+
+    /*
+     * DTZ of each move for the side playing it, and a rank of its result
+     * under the fifty-move rule, counting the plies played since zeroing:
+     * certain wins rank the same, as do losses no draw is in reach of.
+     */
+    int cnt50 = P->halfmoves;
+    int distances[MAX_MOVES], ranks[MAX_MOVES];
+    for (int i = 0; i < M->size; i++) {
+        undo U;
+        TbState state = TB_OK;
+        int dtz;
+        move_make(P, M->array[i], &U);
+        position_rotate(P);
+        if (tb_zeroing(M->array[i])) {
+            dtz = tb_dtz_before_zeroing(-tb_search(P, false, &state));
+        } else if (tb_in_game(history, history_size + 1 - P->halfmoves,
+                              history_size, P->hash)) {
+            dtz = 0;    // the other side can repeat it again
+        } else {
+            dtz = -tb_dtz(P, &state);
+            dtz += sign(dtz);
+        }
+        if (dtz == 2 && tb_mated(P)) dtz = 1;
+        position_rotate(P);
+        move_unmake(P, M->array[i], &U);
+        if (state == TB_FAIL) return false;
+
+        distances[i] = dtz;
+        ranks[i] = dtz > 0 ? (dtz + cnt50 <= 99 && !repeated
+                              ? TB_MAX_RANK : TB_MAX_RANK - (dtz + cnt50))
+                 : dtz < 0 ? (-dtz * 2 + cnt50 < 100 ? -TB_MAX_RANK
+                                                     : -TB_MAX_RANK + (-dtz + cnt50))
+                 : 0;
+    }
+
+    int best = -TB_MAX_RANK;
+    for (int i = 0; i < M->size; i++) {
+        if (ranks[i] > best) best = ranks[i];
+    }
+    // Shortest way to zeroing for a win, longest for a loss
+    int target = best > 0 ? INT32_MAX : 0;
+    for (int i = 0; i < M->size; i++) {
+        if (ranks[i] != best) continue;
+        if (best != 0 && distances[i] < target) target = distances[i];
+    }
+
+    int kept = 0;
+    for (int i = 0; i < M->size; i++) {
+        if (ranks[i] != best) continue;
+        if (best != 0 && distances[i] != target) continue;
+        M->array[kept++] = M->array[i];
+    }
+    M->size = kept;
+    *wdl = best == TB_MAX_RANK ? TB_WIN : best > 0 ? TB_CURSED_WIN
+         : best == 0 ? TB_DRAW : best == -TB_MAX_RANK ? TB_LOSS
+         : TB_BLESSED_LOSS;
+    return true;
+}
@@ -0,0 +1,123 @@
+/**
+ * @file tb.h
+ * @brief Provides an interface for Syzygy endgame tablebases on disk.
+ *
+ * A tablebase holds the exact result of every position of some material
+ * (KRvK, KPvK, ...) and its distance to zeroing (DTZ): the number of plies
+ * until the winning side captures or moves a pawn on its way to mate, or the
+ * losing side is forced to. The tables are Ronald de Man's Syzygy files, a
+ * `.rtbw` (results) and a `.rtbz` (DTZ) file per material, named after it
+ * with the stronger side first, as they are downloaded and as every other
+ * engine reads them. They are found by tb_init and memory-mapped the first
+ * time a position of theirs is probed, so unused tables cost nothing.
+ *
+ * The files only store positions without captures, which are searched
+ * instead, and DTZ for one side to move, the other being a ply away. Results
+ * count the fifty-move rule: a win that takes more than 100 plies to its next
+ * zeroing move is a "cursed" win, a draw under the rule, and the loss it
+ * saves a "blessed" loss. Tables ignore positions with castling rights.
+ */
+
+#ifndef _TB_H_
+#define _TB_H_
+
+#include "moves.h"
+#include "position.h"
+#include "zobrist.h"
+
+#include <stdbool.h>
+
+/** @brief Most pieces, kings included, of a position tables can hold */
+#define TB_MAX_PIECES 7
+
+/** @brief Results of a position for the side to move */
+#define TB_LOSS -2
+#define TB_BLESSED_LOSS -1
+#define TB_DRAW 0
+#define TB_CURSED_WIN 1
+#define TB_WIN 2
+
+/**
+ * @brief Finds the tables in directories, replacing those found before
+ *
+ * Nothing is mapped until probed.
+ *
+ * @param[in] path directories separated by ':' (NULL or "" to only forget
+ *                 the tables found before)
+ * @return The number of materials with a result (`.rtbw`) table
+ */
+int tb_init(const char *path);
+
+/**
+ * @brief Materials found by tb_init with a DTZ (`.rtbz`) table as well
+ *
+ * Those without one are still probed for results, but tb_root_filter fails
+ * on their positions.
+ */
+int tb_dtz_tables(void);
+
+/** @brief Unmaps and forgets every table */
+void tb_free(void);
+
+/**
+ * @brief Most pieces of a position that can be probed
+ *
+ * @return 0 if no table was found, so that searches can skip probing with
+ *         a single comparison
+ */
+int tb_max_pieces(void);
+
+/**
+ * @brief Probes the result of a position
+ *
+ * Bare kings are a draw without a table; every other material needs its
+ * own and those that captures lead to.
+ *
+ * @param[in] P
+ * @param[out] wdl TB_LOSS up to TB_WIN for the side to move
+ * @pre P != NULL && wdl != NULL
+ *
+ * @return false if a table is missing or broken, or the position can castle
+ */
+bool tb_probe_wdl(position *P, int *wdl);
+
+/**
+ * @brief Probes the distance to zeroing of a position
+ *
+ * Needs the DTZ table of the position, and the result tables of those that
+ * captures lead to.
+ *
+ * @param[in] P
+ * @param[out] dtz plies until a zeroing move, positive when the side to move
+ *                 wins, negative when it loses (-1 when mated), 0 for draws;
+ *                 100 more for cursed wins and blessed losses
+ * @pre P != NULL && dtz != NULL
+ *
+ * @return false if a table is missing or broken, or the position can castle
+ */
+bool tb_probe_dtz(position *P, int *dtz);
+
+/**
+ * @brief Keeps the root moves that preserve the result of the position
+ *
+ * The fifty-move counter of P is taken into account: a win keeps the moves
+ * with the shortest distance to zeroing, so that any move left makes progress
+ * in time, a loss the longest. So is the game: a move back to a position of
+ * the game since the last zeroing move is a draw, and once a position has
+ * repeated, no win is taken as certain (it is reported as cursed).
+ *
+ * @param[in] P
+ * @param[in] history hashes of the positions of the game before P, oldest
+ *                    first, as for search_run
+ * @param[in] history_size
+ * @param[in,out] M (legal moves of P, reordered and cut down)
+ * @param[out] wdl result of the position for the side to move
+ * @pre P != NULL && M != NULL && wdl != NULL
+ * @pre history != NULL || history_size == 0
+ *
+ * @return false, leaving M untouched, if a move can't be probed
+ */
+bool tb_root_filter(position *P, const zhash *history, int history_size,
+                    movelist_t M, int *wdl);
+
+#endif
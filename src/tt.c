@@ -0,0 +1,481 @@
+/**
+ * @file tt.c
+ * @brief Provides the implementation for the transposition table.
+ */
+
+#define _DEFAULT_SOURCE     // posix_memalign, mmap flags and madvise
+
+#include "moves.h"
+#include "tt.h"
+#include "zobrist.h"
+
+#include "../lib/contracts.h"
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/** @brief Entries per bucket, a bucket fills one cache line */
+#define TT_BUCKET_SIZE 4
+
+/** @brief Number of buckets tt_hashfull samples */
+#define TT_HASHFULL_BUCKETS 250
+
+/** @brief Searches are numbered modulo this, in the age bits of an entry */
+#define TT_AGES 64
+
+/** @brief Size of a huge page, on x86-64 and most arm64 kernels */
+#define TT_HUGE_PAGE_SIZE ((size_t) 2 << 20)
+
+/** @brief Bytes before the buckets in a table file, keeps them page aligned */
+#define TT_HEADER_SIZE 4096
+
+/** @brief Bumped whenever the entry layout or the header changes */
+#define TT_FILE_VERSION 1
+
+static const char TT_FILE_MAGIC[8] = "monke-tt";
+
+/**
+ * @brief A packed entry
+ *
+ * data holds, from the low bits up: the move (32 bits, as in struct move),
+ * the score (16), the depth (8), the bound (2) and the age (6). An empty
+ * entry is all zeroes, which reads back as BOUND_NONE.
+ */
+typedef struct tt_slot {
+    uint64_t check;     // key ^ data
+    uint64_t data;
+} tt_slot;
+
+typedef struct tt_bucket {
+    tt_slot slots[TT_BUCKET_SIZE];
+} tt_bucket;
+
+/**
+ * @brief The start of a table file, the buckets follow at TT_HEADER_SIZE
+ *
+ * A file is only reused when all of it matches: an entry written under other
+ * Zobrist keys or another layout would be read back as a wrong position.
+ * Fields are in the machine's byte order.
+ */
+typedef struct tt_header {
+    char magic[8];      // TT_FILE_MAGIC
+    uint32_t version;   // TT_FILE_VERSION
+    uint32_t age;       // of the last search
+    uint64_t keys;      // tt_keys_fingerprint of the keys entries were hashed by
+    uint64_t bytes;     // size of the buckets
+} tt_header;
+
+struct tt {
+    tt_bucket *buckets;
+    uint64_t mask;      // number of buckets - 1
+    uint8_t age;        // of the current search
+    TTPages pages;      // how buckets was allocated
+    int threads;        // that clear the table
+    tt_header *header;  // of the table file, NULL if the table is anonymous
+};
+
+/* --- PACKING --- */
+
+static uint64_t tt_pack(move m, int score, int depth, Bound bound,
+                        uint8_t age) {
+    uint64_t packed_move = (uint64_t) m.piece
+                         | (uint64_t) m.from << 8
+                         | (uint64_t) m.to << 16
+                         | (uint64_t) m.flags << 24;
+    return packed_move
+         | (uint64_t) (uint16_t) (int16_t) score << 32
+         | (uint64_t) (uint8_t) (int8_t) depth << 48
+         | (uint64_t) bound << 56
+         | (uint64_t) age << 58;
+}
+
+static move tt_data_move(uint64_t data) {
+    move m;
+    m.piece = data & 0xFF;
+    m.from = (data >> 8) & 0xFF;
+    m.to = (data >> 16) & 0xFF;
+    m.flags = (data >> 24) & 0xFF;
+    return m;
+}
+
+static int tt_data_score(uint64_t data) {
+    return (int16_t) (uint16_t) (data >> 32);
+}
+
+static int tt_data_depth(uint64_t data) {
+    return (int8_t) (uint8_t) (data >> 48);
+}
+
+static Bound tt_data_bound(uint64_t data) {
+    return (Bound) ((data >> 56) & 0x3);
+}
+
+static uint8_t tt_data_age(uint64_t data) {
+    return (data >> 58) & (TT_AGES - 1);
+}
+
+static uint64_t tt_data_with_move(uint64_t data, uint64_t from) {
+    return (data & ~(uint64_t) 0xFFFFFFFF) | (from & 0xFFFFFFFF);
+}
+
+/* --- ALLOCATION --- */
+
+/**
+ * @brief Maps `bytes` of memory aligned to a huge page
+ *
+ * Maps one huge page more than needed and unmaps the slack on either side,
+ * transparent huge pages only back 2 MB aligned ranges.
+ */
+static void *tt_map_aligned(size_t bytes) {
+    size_t padded = bytes + TT_HUGE_PAGE_SIZE;
+    char *mapped = mmap(NULL, padded, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mapped == MAP_FAILED) return NULL;
+
+    uintptr_t address = (uintptr_t) mapped;
+    size_t head = (TT_HUGE_PAGE_SIZE - address % TT_HUGE_PAGE_SIZE)
+                % TT_HUGE_PAGE_SIZE;
+    if (head > 0) munmap(mapped, head);
+    if (padded - head > bytes) {
+        munmap(mapped + head + bytes, padded - head - bytes);
+    }
+    return mapped + head;
+}
+
+/**
+ * @brief Allocates the buckets with the largest pages available up to `pages`
+ *
+ * Falls back from MAP_HUGETLB (needs pages reserved in vm.nr_hugepages) to
+ * madvise(MADV_HUGEPAGE) (needs transparent huge pages set to madvise or
+ * always) to posix_memalign.
+ */
+static void tt_alloc(tt *T, size_t bytes, TTPages pages) {
+#ifdef MAP_HUGETLB
+    if (pages >= TT_PAGES_HUGETLB && bytes % TT_HUGE_PAGE_SIZE == 0) {
+        void *memory = mmap(NULL, bytes, PROT_READ | PROT_WRITE,
+                            MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (memory != MAP_FAILED) {
+            T->buckets = memory;
+            T->pages = TT_PAGES_HUGETLB;
+            return;
+        }
+    }
+#endif
+#ifdef MADV_HUGEPAGE
+    if (pages >= TT_PAGES_TRANSPARENT && bytes % TT_HUGE_PAGE_SIZE == 0) {
+        void *memory = tt_map_aligned(bytes);
+        if (memory != NULL) {
+            if (madvise(memory, bytes, MADV_HUGEPAGE) != 0) {
+                perror("madvise error");    // still usable on small pages
+            }
+            T->buckets = memory;
+            T->pages = TT_PAGES_TRANSPARENT;
+            return;
+        }
+    }
+#endif
+    void *memory;
+    if (posix_memalign(&memory, sizeof(tt_bucket), bytes) != 0) {
+        perror("posix_memalign error");
+        exit(1);
+    }
+    T->buckets = memory;
+    T->pages = TT_PAGES_SMALL;
+    return;
+}
+
+/** @brief A slice of the table cleared by one thread */
+typedef struct tt_clear_job {
+    char *start;
+    size_t bytes;
+} tt_clear_job;
+
+static void *tt_clear_worker(void *arg) {
+    tt_clear_job *job = arg;
+    memset(job->start, 0, job->bytes);
+    return NULL;
+}
+
+/* --- TABLE --- */
+
+/** @brief Number of buckets in a table of at most `megabytes` MB */
+static uint64_t tt_buckets(size_t megabytes) {
+    uint64_t buckets = 1;
+    while (buckets * 2 * sizeof(tt_bucket) <= megabytes << 20) {
+        buckets *= 2;
+    }
+    return buckets;
+}
+
+tt *tt_new(size_t megabytes, int threads) {
+    return tt_new_paged(megabytes, threads, TT_PAGES_HUGETLB);
+}
+
+tt *tt_new_paged(size_t megabytes, int threads, TTPages pages) {
+    dbg_requires(megabytes >= 1 && threads >= 1);
+    dbg_assert(sizeof(tt_bucket) == 64);
+    tt *T = malloc(sizeof(tt));
+    if (T == NULL) {
+        perror("malloc error");
+        exit(1);
+    }
+
+    uint64_t buckets = tt_buckets(megabytes);
+    tt_alloc(T, buckets * sizeof(tt_bucket), pages);
+    T->mask = buckets - 1;
+    T->threads = threads;
+    T->header = NULL;
+    tt_clear(T);
+
+    return T;
+}
+
+/** @brief A digest of every Zobrist key, changes if any key does */
+static uint64_t tt_keys_fingerprint(void) {
+    uint64_t fingerprint = 0;
+    const zhash *tables[4] = { &PIECE_PRN[0][0][0], CASTLING_PRN, 
+                               EN_PASSANT_PRN, &COLOR_PRN };
+    const size_t sizes[4] = { 2 * 6 * 64, 16, 8, 1 };
+    for (int t = 0; t < 4; t++) {
+        for (size_t i = 0; i < sizes[t]; i++) {
+            fingerprint = (fingerprint ^ tables[t][i]) * 0x100000001b3;
+        }
+    }
+    return fingerprint;
+}
+
+/**
+ * The file is read before it is touched: a file that isn't a table at all is
+ * refused, while a table of another version, keys or size is started over.
+ */
+tt *tt_open(const char *path, size_t megabytes, int threads, bool *warm) {
+    dbg_requires(path != NULL && megabytes >= 1 && threads >= 1);
+    dbg_requires(warm != NULL);
+    uint64_t buckets = tt_buckets(megabytes);
+    tt_header expected;
+    memset(&expected, 0, sizeof(expected));
+    memcpy(expected.magic, TT_FILE_MAGIC, sizeof(expected.magic));
+    expected.version = TT_FILE_VERSION;
+    expected.keys = tt_keys_fingerprint();
+    expected.bytes = buckets * sizeof(tt_bucket);
+
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        perror(path);
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        perror(path);
+        close(fd);
+        return NULL;
+    }
+
+    tt_header found;
+    memset(&found, 0, sizeof(found));
+    if (st.st_size > 0) {
+        if (pread(fd, &found, sizeof(found), 0) != (ssize_t) sizeof(found) ||
+            memcmp(found.magic, TT_FILE_MAGIC, sizeof(found.magic)) != 0) {
+            fprintf(stderr, "%s: not a transposition table file\n", path);
+            close(fd);
+            return NULL;
+        }
+    }
+    *warm = found.version == expected.version && found.keys == expected.keys 
+            && found.bytes == expected.bytes 
+            && st.st_size == (off_t) (TT_HEADER_SIZE + expected.bytes);
+
+    size_t mapped = TT_HEADER_SIZE + expected.bytes;
+    if (!*warm && ftruncate(fd, mapped) != 0) {
+        perror(path);
+        close(fd);
+        return NULL;
+    }
+    char *memory = mmap(NULL, mapped, PROT_READ | PROT_WRITE, MAP_SHARED, 
+                        fd, 0);
+    close(fd);      // the mapping keeps the file open
+    if (memory == MAP_FAILED) {
+        perror(path);
+        return NULL;
+    }
+
+    tt *T = malloc(sizeof(tt));
+    if (T == NULL) {
+        perror("malloc error");
+        exit(1);
+    }
+    T->buckets = (tt_bucket *) (memory + TT_HEADER_SIZE);
+    T->mask = buckets - 1;
+    T->pages = TT_PAGES_SMALL;
+    T->threads = threads;
+    T->header = (tt_header *) memory;
+    if (*warm) {
+        T->age = found.age % TT_AGES;
+    } else {
+        *T->header = expected;
+        if (st.st_size > 0) tt_clear(T);    // a new file is already zeroes
+        T->age = 0;
+    }
+
+    return T;
+}
+
+void tt_free(tt *T) {
+    if (T->header != NULL) munmap(T->header, TT_HEADER_SIZE + tt_size(T));
+    else if (T->pages == TT_PAGES_SMALL) free(T->buckets);
+    else munmap(T->buckets, tt_size(T));
+    free(T);
+    return;
+}
+
+/**
+ * Every thread zeroes one contiguous slice. Zeroing is the first touch of a
+ * fresh table, so on a NUMA machine each slice is placed on the node of the
+ * thread that cleared it instead of all of it on the allocating thread's.
+ */
+void tt_clear(tt *T) {
+    size_t bytes = tt_size(T);
+    int threads = T->threads;
+    if ((size_t) threads > bytes / TT_HUGE_PAGE_SIZE) {    // small tables
+        threads = 1;
+    }
+
+    tt_clear_job jobs[threads];
+    pthread_t ids[threads];
+    size_t slice = bytes / threads;
+    for (int t = 0; t < threads; t++) {
+        jobs[t].start = (char *) T->buckets + t * slice;
+        jobs[t].bytes = t < threads - 1 ? slice : bytes - t * slice;
+    }
+    for (int t = 1; t < threads; t++) {
+        if (pthread_create(&ids[t], NULL, tt_clear_worker, &jobs[t]) != 0) {
+            perror("pthread_create error");
+            exit(1);
+        }
+    }
+    tt_clear_worker(&jobs[0]);
+    for (int t = 1; t < threads; t++) pthread_join(ids[t], NULL);
+
+    T->age = 0;
+    if (T->header != NULL) T->header->age = T->age;
+    return;
+}
+
+TTPages tt_pages(tt *T) {
+    return T->pages;
+}
+
+/**
+ * Transparent huge pages are a request, so the kernel's accounting of the
+ * mapping in /proc/self/smaps is what says whether it was honoured.
+ */
+size_t tt_page_size(tt *T) {
+    size_t small = (size_t) sysconf(_SC_PAGESIZE);
+    if (T->pages == TT_PAGES_HUGETLB) return TT_HUGE_PAGE_SIZE;
+    if (T->pages == TT_PAGES_SMALL) return small;   // table files too
+
+    FILE *smaps = fopen("/proc/self/smaps", "r");
+    if (smaps == NULL) return small;
+    char line[256];
+    bool in_table = false;
+    size_t huge_kb = 0;
+    while (fgets(line, sizeof(line), smaps) != NULL) {
+        unsigned long start, end;
+        if (sscanf(line, "%lx-%lx ", &start, &end) == 2) {
+            in_table = start <= (uintptr_t) T->buckets &&
+                       (uintptr_t) T->buckets < end;
+        } else if (in_table) {
+            sscanf(line, "AnonHugePages: %zu kB", &huge_kb);
+        }
+    }
+    fclose(smaps);
+    return huge_kb > 0 ? TT_HUGE_PAGE_SIZE : small;
+}
+
+size_t tt_size(tt *T) {
+    return (T->mask + 1) * sizeof(tt_bucket);
+}
+
+void tt_new_search(tt *T) {
+    T->age = (T->age + 1) % TT_AGES;
+    if (T->header != NULL) T->header->age = T->age;
+    return;
+}
+
+void tt_prefetch(tt *T, zhash key) {
+    __builtin_prefetch(&T->buckets[key & T->mask]);
+    return;
+}
+
+bool tt_probe(tt *T, zhash key, tt_entry *E) {
+    tt_bucket *B = &T->buckets[key & T->mask];
+    for (int i = 0; i < TT_BUCKET_SIZE; i++) {
+        uint64_t data = __atomic_load_n(&B->slots[i].data, __ATOMIC_RELAXED);
+        uint64_t check = __atomic_load_n(&B->slots[i].check, __ATOMIC_RELAXED);
+        if ((check ^ data) == key && tt_data_bound(data) != BOUND_NONE) {
+            E->move = tt_data_move(data);
+            E->score = tt_data_score(data);
+            E->depth = tt_data_depth(data);
+            E->bound = tt_data_bound(data);
+            return true;
+        }
+    }
+    return false;
+}
+
+/** @brief How much an entry is worth keeping: its depth, less 8 per search */
+static int tt_worth(tt *T, uint64_t data) {
+    if (tt_data_bound(data) == BOUND_NONE) return -TT_AGES * 8 - 1;
+    int searches_ago = (T->age - tt_data_age(data)) & (TT_AGES - 1);
+    return tt_data_depth(data) - 8 * searches_ago;
+}
+
+void tt_store(tt *T, zhash key, move m, int score, int depth, Bound bound) {
+    dbg_requires(-TT_MAX_DEPTH <= depth && depth <= TT_MAX_DEPTH);
+    dbg_requires(-TT_MAX_SCORE <= score && score <= TT_MAX_SCORE);
+    tt_bucket *B = &T->buckets[key & T->mask];
+    uint64_t data = tt_pack(m, score, depth, bound, T->age);
+
+    tt_slot *victim = NULL;
+    int victim_worth = 0;
+    for (int i = 0; i < TT_BUCKET_SIZE; i++) {
+        tt_slot *S = &B->slots[i];
+        uint64_t old = __atomic_load_n(&S->data, __ATOMIC_RELAXED);
+        uint64_t check = __atomic_load_n(&S->check, __ATOMIC_RELAXED);
+        if ((check ^ old) == key) {
+            if (m.from == m.to) data = tt_data_with_move(data, old);
+            victim = S;
+            break;
+        }
+        int worth = tt_worth(T, old);
+        if (victim == NULL || worth < victim_worth) {
+            victim = S;
+            victim_worth = worth;
+        }
+    }
+
+    __atomic_store_n(&victim->check, key ^ data, __ATOMIC_RELAXED);
+    __atomic_store_n(&victim->data, data, __ATOMIC_RELAXED);
+    return;
+}
+
+int tt_hashfull(tt *T) {
+    uint64_t buckets = T->mask + 1 < TT_HASHFULL_BUCKETS ? T->mask + 1
+                                                         : TT_HASHFULL_BUCKETS;
+    int used = 0;
+    for (uint64_t b = 0; b < buckets; b++) {
+        for (int i = 0; i < TT_BUCKET_SIZE; i++) {
+            uint64_t data = __atomic_load_n(&T->buckets[b].slots[i].data,
+                                            __ATOMIC_RELAXED);
+            if (tt_data_bound(data) != BOUND_NONE &&
+                tt_data_age(data) == T->age) used++;
+        }
+    }
+    return used * 1000 / (int) (buckets * TT_BUCKET_SIZE);
+}
@@ -0,0 +1,150 @@
+/**
+ * @file tt.h
+ * @brief Provides an interface for the transposition table.
+ *
+ * The table maps Zobrist hashes to what a search learned about a position:
+ * its best move, a score and how that score bounds the true value. One table
+ * is shared by every search thread without locks; see tt_store.
+ */
+
+#ifndef _TT_H_
+#define _TT_H_
+
+#include "moves.h"
+#include "zobrist.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/** @brief How a stored score relates to the true value of the position */
+typedef enum Bound {
+    BOUND_NONE,
+    BOUND_UPPER,    // failed low: value <= score
+    BOUND_LOWER,    // failed high: value >= score
+    BOUND_EXACT     // BOUND_UPPER | BOUND_LOWER
+} Bound;
+
+/** @brief An unpacked table entry, as returned by tt_probe */
+typedef struct tt_entry {
+    move move;      // NULL_MOVE if none was stored
+    int score;
+    int depth;
+    Bound bound;
+} tt_entry;
+
+/** @brief A table of 64-byte buckets of four entries each */
+typedef struct tt tt;
+
+/** @brief Pages backing a table, from the smallest to the largest */
+typedef enum TTPages {
+    TT_PAGES_SMALL,         // posix_memalign, usually 4 KiB pages
+    TT_PAGES_TRANSPARENT,   // madvise(MADV_HUGEPAGE), up to the kernel
+    TT_PAGES_HUGETLB        // MAP_HUGETLB, needs reserved huge pages
+} TTPages;
+
+/** @brief Deepest depth an entry can record */
+#define TT_MAX_DEPTH 127
+
+/** @brief Largest magnitude a stored score can have */
+#define TT_MAX_SCORE 32767
+
+/**
+ * @brief Allocates an empty table of at most `megabytes` MB, on the largest
+ * pages the system will give
+ *
+ * Tables of a few GB on small pages spend much of a probe missing the TLB.
+ *
+ * @param[in] megabytes (rounded down to a power of two number of buckets)
+ * @param[in] threads that clear the table, see tt_clear
+ * @pre megabytes >= 1 && threads >= 1
+ */
+tt *tt_new(size_t megabytes, int threads);
+
+/** @brief Same as tt_new, but with pages no larger than `pages` */
+tt *tt_new_paged(size_t megabytes, int threads, TTPages pages);
+
+/**
+ * @brief Opens a table kept in a file, so that it survives restarts
+ *
+ * The file is mapped shared: everything stored is in the file once the
+ * process exits, even if it crashes. Reopening a file of the same size,
+ * written under the same Zobrist keys and entry layout, resumes with the
+ * entries of the earlier sessions. Any other table file is started over,
+ * and a file that isn't a table is left alone.
+ *
+ * @param[in] path
+ * @param[in] megabytes (rounded down to a power of two number of buckets)
+ * @param[in] threads that clear the table, see tt_clear
+ * @param[out] warm whether the entries in the file were kept
+ * @return the table, or NULL (with a message on stderr) if the file can't be
+ *         used
+ * @pre path != NULL && megabytes >= 1 && threads >= 1 && warm != NULL
+ */
+tt *tt_open(const char *path, size_t megabytes, int threads, bool *warm);
+
+/** @brief Frees a table, and closes the file of one from tt_open */
+void tt_free(tt *T);
+
+/**
+ * @brief Empties a table, not to be called while a search is using it
+ *
+ * The table is split between the threads given to tt_new, so that clearing
+ * is faster and, as the first touch of its pages, spreads a new table over
+ * the memory of every NUMA node those threads run on.
+ */
+void tt_clear(tt *T);
+
+/** @brief Size of a table in bytes */
+size_t tt_size(tt *T);
+
+/** @brief How a table was allocated, after falling back from tt_new's request */
+TTPages tt_pages(tt *T);
+
+/** @brief Size of the pages that actually back a table */
+size_t tt_page_size(tt *T);
+
+/**
+ * @brief Starts a new search: entries of earlier searches become the first
+ * candidates for replacement
+ */
+void tt_new_search(tt *T);
+
+/**
+ * @brief Starts loading the bucket of `key` into the cache
+ *
+ * Meant to be called with the key of a child as soon as its move is made, so
+ * that the probe at the child finds the bucket in the cache instead of
+ * stalling on memory for it.
+ */
+void tt_prefetch(tt *T, zhash key);
+
+/**
+ * @brief Looks up a position
+ *
+ * @param[in] T
+ * @param[in] key
+ * @param[out] E the entry, left untouched on a miss
+ * @return true if the table holds an entry for `key`
+ */
+bool tt_probe(tt *T, zhash key, tt_entry *E);
+
+/**
+ * @brief Records a search result
+ *
+ * An entry for the same key is overwritten, keeping its move if `m` is a
+ * NULL_MOVE. Otherwise the entry replaced is the one that is shallowest,
+ * counting entries of earlier searches as shallower the older they are.
+ *
+ * Each entry is written as (key ^ data, data). A probe racing with a store
+ * sees a pair that doesn't verify against its key and treats it as a miss.
+ *
+ * @pre -TT_MAX_DEPTH <= depth <= TT_MAX_DEPTH
+ * @pre -TT_MAX_SCORE <= score <= TT_MAX_SCORE
+ */
+void tt_store(tt *T, zhash key, move m, int score, int depth, Bound bound);
+
+/** @brief Permille of a sample of entries that were written this search */
+int tt_hashfull(tt *T);
+
+#endif
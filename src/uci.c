@@ -0,0 +1,306 @@
+/**
+ * @file uci.c
+ * @brief Provides the implementation for talking to chess GUIs over UCI.
+ */
+
+#define _POSIX_C_SOURCE 200809L     // getline, strtok_r and nanosleep
+
+#include "moves.h"
+#include "position.h"
+#include "search.h"
+#include "tb.h"
+#include "tt.h"
+#include "uci.h"
+#include "zobrist.h"
+
+#include "../lib/contracts.h"
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define UCI_HASH_DEFAULT 16
+#define UCI_HASH_MAX 65536
+
+/** @brief Everything the engine keeps between commands */
+typedef struct uci_engine {
+    FILE *out;
+    position *P;
+    zhash *history;         // hashes of the game before P, see search_run
+    int history_size;
+    int history_capacity;
+
+    tt *T;
+    size_t hash_mb;
+    char *hash_file;        // NULL for a table in memory
+    search *S;
+
+    pthread_t thread;
+    bool searching;
+    bool done;              // the search thread is returning, read atomically
+    search_limits limits;
+} uci_engine;
+
+/* --- OPTIONS --- */
+
+/** @brief (Re)allocates the table, in memory or in the hash file */
+static void uci_new_table(uci_engine *E) {
+    if (E->T != NULL) tt_free(E->T);
+    E->T = NULL;
+    if (E->hash_file != NULL) {
+        bool warm;
+        E->T = tt_open(E->hash_file, E->hash_mb, 1, &warm);
+        if (E->T != NULL) {
+            fprintf(E->out, "info string hash file %s %s\n", E->hash_file,
+                    warm ? "resumed" : "started");
+        }
+    }
+    if (E->T == NULL) E->T = tt_new(E->hash_mb, 1);
+    if (E->S != NULL) search_set_tt(E->S, E->T);
+    return;
+}
+
+/** @brief Handles `setoption name <name> [value <value>]` */
+static void uci_setoption(uci_engine *E, char *args) {
+    char *name = strstr(args, "name ");
+    if (name == NULL) return;
+    name += strlen("name ");
+    char *value = strstr(name, " value ");
+    if (value != NULL) {
+        *value = '\0';
+        value += strlen(" value ");
+    }
+
+    if (strcmp(name, "Hash") == 0 && value != NULL) {
+        long mb = strtol(value, NULL, 10);
+        if (mb < 1 || mb > UCI_HASH_MAX) return;
+        E->hash_mb = mb;
+        uci_new_table(E);
+    } else if (strcmp(name, "HashFile") == 0) {
+        free(E->hash_file);
+        E->hash_file = NULL;
+        if (value != NULL && value[0] != '\0' && strcmp(value, "<empty>") != 0)
+            E->hash_file = strdup(value);
+        uci_new_table(E);
+    } else if (strcmp(name, "Clear Hash") == 0) {
+        tt_clear(E->T);
+    } else if (strcmp(name, "SyzygyPath") == 0) {
+        bool none = value == NULL || value[0] == '\0' ||
+                    strcmp(value, "<empty>") == 0;
+        int found = tb_init(none ? NULL : value);
+        if (!none && found == 0) {
+            fprintf(E->out, "info string warning: no Syzygy tables (.rtbw) "
+                    "found in %s, tablebases are off\n", value);
+        } else if (found > 0) {
+            fprintf(E->out, "info string found %d WDL and %d DTZ Syzygy "
+                    "tables, up to %d pieces\n", found, tb_dtz_tables(),
+                    tb_max_pieces());
+        }
+    } else if (strcmp(name, "Prefetch") == 0 && value != NULL) {
+        // Not listed by `uci`: a switch to measure prefetching with
+        search_set_prefetch(E->S, strcmp(value, "false") != 0);
+    } else if (value != NULL) {
+        for (int p = 0; p < SEARCH_PARAM_COUNT; p++) {
+            if (strcmp(name, SEARCH_PARAMS[p].name) == 0)
+                search_set_param(E->S, p, strtol(value, NULL, 10));
+        }
+    }
+    return;
+}
+
+/* --- POSITION --- */
+
+/** @brief Finds the legal move written in long algebraic notation */
+static bool uci_parse_move(position *P, const char *str, move *m) {
+    movelist M;
+    movelist_clear(&M);
+    generate_moves(&M, P);
+    for (int i = 0; i < M.size; i++) {
+        char s[MOVE_STRING_SIZE];
+        if (strcmp(move_to_string(M.array[i], P->color, s), str) == 0) {
+            *m = M.array[i];
+            return true;
+        }
+    }
+    return false;
+}
+
+/** @brief Handles `position [startpos | fen <fen>] [moves <move>...]` */
+static void uci_position(uci_engine *E, char *args) {
+    char *moves = strstr(args, "moves");
+    if (moves != NULL) *moves = '\0';
+
+    char *fen = strstr(args, "fen ");
+    if (fen != NULL) position_from_fen(E->P, fen + strlen("fen "));
+    else position_init(E->P);
+    E->history_size = 0;
+    if (moves == NULL) return;
+
+    char *save;
+    for (char *token = strtok_r(moves + strlen("moves"), " \t", &save);
+         token != NULL; token = strtok_r(NULL, " \t", &save)) {
+        move m;
+        if (!uci_parse_move(E->P, token, &m)) break;
+        if (E->history_size == E->history_capacity) {
+            E->history_capacity = 2 * E->history_capacity + 64;
+            E->history = realloc(E->history,
+                                 E->history_capacity * sizeof(zhash));
+            if (E->history == NULL) {
+                perror("malloc error");
+                exit(1);
+            }
+        }
+        E->history[E->history_size++] = E->P->hash;
+        undo U;
+        move_make(E->P, m, &U);
+        position_rotate(E->P);
+    }
+    return;
+}
+
+/* --- GO --- */
+
+/** @brief Runs a search and announces its move */
+static void *uci_search_thread(void *arg) {
+    uci_engine *E = arg;
+    search_result R;
+    search_run(E->S, E->P, E->history, E->history_size, &E->limits, &R);
+
+    char best[MOVE_STRING_SIZE], ponder[MOVE_STRING_SIZE];
+    if (R.best.from == R.best.to) {
+        fprintf(E->out, "bestmove 0000\n");
+    } else if (R.ponder.from == R.ponder.to) {
+        fprintf(E->out, "bestmove %s\n",
+                move_to_string(R.best, E->P->color, best));
+    } else {
+        fprintf(E->out, "bestmove %s ponder %s\n",
+                move_to_string(R.best, E->P->color, best),
+                move_to_string(R.ponder, !E->P->color, ponder));
+    }
+    fflush(E->out);
+    __atomic_store_n(&E->done, true, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+/** @brief Waits for the running search, if any, to return */
+static void uci_wait(uci_engine *E, bool stop) {
+    if (!E->searching) return;
+    // Until it returns: the search may not have started yet
+    struct timespec ms = { 0, 1000000 };
+    while (stop && !__atomic_load_n(&E->done, __ATOMIC_ACQUIRE)) {
+        search_stop(E->S);
+        nanosleep(&ms, NULL);
+    }
+    pthread_join(E->thread, NULL);
+    E->searching = false;
+    return;
+}
+
+/** @brief Handles `go [<limit> <value>]... [infinite]` */
+static void uci_go(uci_engine *E, char *args) {
+    search_limits *L = &E->limits;
+    memset(L, 0, sizeof(search_limits));
+
+    char *save;
+    for (char *token = strtok_r(args, " \t", &save); token != NULL;
+         token = strtok_r(NULL, " \t", &save)) {
+        if (strcmp(token, "infinite") == 0) {
+            L->infinite = true;
+            continue;
+        }
+        char *value = strtok_r(NULL, " \t", &save);
+        if (value == NULL) break;
+        long n = strtol(value, NULL, 10);
+        if (strcmp(token, "depth") == 0) L->depth = n;
+        else if (strcmp(token, "nodes") == 0) L->nodes = n;
+        else if (strcmp(token, "movetime") == 0) L->movetime = n;
+        else if (strcmp(token, "wtime") == 0) L->time[WHITE] = n;
+        else if (strcmp(token, "btime") == 0) L->time[BLACK] = n;
+        else if (strcmp(token, "winc") == 0) L->inc[WHITE] = n;
+        else if (strcmp(token, "binc") == 0) L->inc[BLACK] = n;
+        else if (strcmp(token, "movestogo") == 0) L->movestogo = n;
+    }
+
+    E->searching = true;
+    E->done = false;
+    if (pthread_create(&E->thread, NULL, uci_search_thread, E) != 0) {
+        perror("pthread_create error");
+        exit(1);
+    }
+    return;
+}
+
+/* --- LOOP --- */
+
+void uci_loop(FILE *in, FILE *out) {
+    dbg_requires(in != NULL && out != NULL);
+    uci_engine E;
+    memset(&E, 0, sizeof(E));
+    E.out = out;
+    E.P = position_new();
+    position_init(E.P);
+    E.hash_mb = UCI_HASH_DEFAULT;
+    uci_new_table(&E);
+    E.S = search_new(E.T);
+    search_set_output(E.S, out);
+
+    char *line = NULL;
+    size_t capacity = 0;
+    while (getline(&line, &capacity, in) != -1) {
+        line[strcspn(line, "\r\n")] = '\0';
+        char *args = line + strspn(line, " \t");
+        char *command = args;
+        args += strcspn(args, " \t");
+        if (*args != '\0') *args++ = '\0';
+
+        if (strcmp(command, "uci") == 0) {
+            fprintf(out, "id name monke\n");
+            fprintf(out, "id author mattngaw\n");
+            fprintf(out, "option name Hash type spin default %d min 1 max %d\n",
+                    UCI_HASH_DEFAULT, UCI_HASH_MAX);
+            fprintf(out, "option name HashFile type string default <empty>\n");
+            fprintf(out, "option name Clear Hash type button\n");
+            fprintf(out, "option name SyzygyPath type string default <empty>\n");
+            for (int p = 0; p < SEARCH_PARAM_COUNT; p++) {
+                const search_param_info *info = &SEARCH_PARAMS[p];
+                fprintf(out, "option name %s type spin default %d min %d "
+                        "max %d\n", info->name, info->value, info->min,
+                        info->max);
+            }
+            fprintf(out, "uciok\n");
+        } else if (strcmp(command, "isready") == 0) {
+            fprintf(out, "readyok\n");
+        } else if (strcmp(command, "setoption") == 0) {
+            uci_wait(&E, true);
+            uci_setoption(&E, args);
+        } else if (strcmp(command, "ucinewgame") == 0) {
+            uci_wait(&E, true);
+            tt_clear(E.T);
+            search_clear(E.S);
+        } else if (strcmp(command, "position") == 0) {
+            uci_wait(&E, true);
+            uci_position(&E, args);
+        } else if (strcmp(command, "go") == 0) {
+            uci_wait(&E, true);
+            uci_go(&E, args);
+        } else if (strcmp(command, "stop") == 0) {
+            uci_wait(&E, true);
+        } else if (strcmp(command, "quit") == 0) {
+            break;
+        }
+        fflush(out);
+    }
+
+    uci_wait(&E, true);
+    free(line);
+    search_free(E.S);
+    tt_free(E.T);
+    tb_free();
+    free(E.hash_file);
+    free(E.history);
+    position_free(E.P);
+    return;
+}
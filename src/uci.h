@@ -0,0 +1,24 @@
+/**
+ * @file uci.h
+ * @brief Provides an interface for talking to chess GUIs over UCI.
+ *
+ * See engine-interface.txt for the protocol. Searches run on their own
+ * thread, so that `stop`, `isready` and `quit` are answered while thinking.
+ */
+
+#ifndef _UCI_H_
+#define _UCI_H_
+
+#include <stdio.h>
+
+/**
+ * @brief Answers UCI commands until `quit` or the end of the input
+ *
+ * @param[in] in
+ * @param[in] out
+ * @pre in != NULL && out != NULL
+ * @pre moves_init and eval_init were called
+ */
+void uci_loop(FILE *in, FILE *out);
+
+#endif
@@ -9,54 +9,324 @@
 
 #include "../lib/contracts.h"
 
-#include <stdlib.h>
-#include <time.h>
-
-static uint64_t SEED;
-
-/** @brief PRNs for all piece types of both color on any square */
-static uint64_t PIECE_PRN[2][6][64]; // contains en-passant in pawns bitboard
-
-/** @brief PRNs for castling rights for both colors */
-static uint64_t CASTLING_PRN[2][2];
-
-/** @brief PRN for black */
-static uint64_t COLOR_PRN;
-
 /**
- * @brief XORShift implementation: https://en.wikipedia.org/wiki/Xorshift
+ * @brief Zobrist keys
+ *
+ * Generated by scripts/zobrist-keys.py from a fixed seed, so hashes are the
+ * same on every run and every machine and can be persisted. CASTLING_PRN
+ * holds one key per set of rights, the XOR of the keys of its own rights.
  */
-void hash_init(void) {
-    uint64_t x;
-    SEED = (uint64_t) time(NULL);
-
-    for (int c = 0; c < NUM_COLORS; c++) {
-        for (int p = 0; p < NUM_PIECES; p++)  {
-            for (int s = 0; s < BITBOARD_SIZE; s++) {
-                x = SEED;
-                x ^= x << 13;
-                x ^= x >> 7;
-                x ^= x << 17;
-                PIECE_PRN[c][p][s] = SEED = x;
-            }
+const zhash PIECE_PRN[2][6][64] = {
+    {
+        {
+            0x6debd3d3715960f9, 0x2ca73f03a7d61dcc, 0x9b9f2ab24969b76e,
+            0xb2d9600e9836a786, 0x255f8bcc3dee49ef, 0xcd84ef6e460af7de,
+            0x6563b6a19c1d1b02, 0x02c5c17edd948f51, 0xa741f35b447ca5bc,
+            0xeebea15b5740f301, 0xa51fcbf3ee9e8340, 0x8e9b60b94e17dbf6,
+            0x354bb50d60425eb5, 0xb19f659ee8d4dfcb, 0xd831b34d4612728c,
+            0xe430bd534ceb8343, 0x19206801dde6ddbd, 0x8c4b636c4a95ef5c,
+            0x203741ac7a96ea82, 0x957e592915a92797, 0x236c60ca4c7c13c0,
+            0x30c5ee36b81fb791, 0xdd156577ad913cbc, 0xc41a8bf90653ff66,
+            0x9e73e29d05f7e087, 0x8e1c323566740ba1, 0xe49ae011e381ef5e,
+            0x4d31e9e1dcf4eafd, 0xe3030bd10b0aa8e5, 0xd788f3a5c5f5393c,
+            0x0059e990a613ddb8, 0x56c29cd7fb80ff83, 0xafe2fa3eaf070931,
+            0x037cf0e9c7782fe6, 0xec4fb71ad9fef353, 0x956bdbf162911a3e,
+            0x89b3dee1c2b381ab, 0x9fb752a714dee1ea, 0x25e16f9d0cfd1ff0,
+            0x1a80386425af419a, 0x5f61ced3fb19afe3, 0x4de949405ce92807,
+            0x5487bea9288f1a2c, 0xa23d50accb902062, 0x7789bdb11e9ac927,
+            0x678741cb097722b6, 0x891c17b4c3b91047, 0x46ab73bb325f610a,
+            0xd13eb83bb09d1615, 0xfbe9d265bf1aabdd, 0x1b42a26952658f7e,
+            0x66d53275d1ece796, 0x69a1ca461967a121, 0xee9f6d8545dc1864,
+            0xf81e0ae6de04bc3f, 0xef0e070e9c49c723, 0x91f06b08a5c960da,
+            0x49578c857dc7a331, 0x393656a639a08991, 0xe692ea2fc67b9ddb,
+            0xf88339a8e8243d08, 0xcd634d67cfacee64, 0xe2e14745a1159206,
+            0xc5851467273ff66f
+        },
+        {
+            0xa961fecaaadd1a64, 0xe1fd8493610ec99c, 0x903b3fb900f060aa,
+            0xe18e222b79a6d16e, 0x459f1c35c1bf8931, 0x47bc38ff01786dde,
+            0x4bce5ebe36fce354, 0x6f1abfede908783a, 0x29707587faccee41,
+            0x7a934499b74b1ab7, 0xa8ebf71e05799bba, 0xd9c30abb7c1f9b87,
+            0xafd1db2cd2940f48, 0xed2806404ca18a7f, 0x2d20ed4e0976340e,
+            0x4605fe5c2ba766e7, 0x9188cac85aa07a17, 0xc563f13c5bb5bdf6,
+            0x39ab6dcec3837164, 0x4214214d1d24db8a, 0x0aa38cf719a46f11,
+            0xe7d6a3559a1da8cb, 0x18ca6b8294aa08cd, 0xd858b19c433559b5,
+            0x4b5727a6df6e79c8, 0x8caa3855b319e4f2, 0x01f7f4d5847be32b,
+            0x7d9f0f882acd5ce3, 0x26b6d82567b71aa3, 0xa3fd482b47e82521,
+            0x218b43537b8f583e, 0x9411e2a45de1374d, 0x6bb7debe6656fa16,
+            0x30a98cfee4cbb656, 0x9f3151e1084f7c74, 0x6928e3c00ab0fdc3,
+            0x3c602d1b937f65d3, 0xf220170fdcd63bcf, 0xb647d458e34dfa3c,
+            0x95fe0e70d31bbc5a, 0x7741c7f282808929, 0xafd6147c0f2ac6de,
+            0x6ecb04219a77208e, 0xa4a29e66ff392d71, 0x487d46faa4cc878f,
+            0xd70d6adcee9cb191, 0x439b262c53d1c0e2, 0xc66f7350479456e8,
+            0xbfa1aac3755198c5, 0xfaa2a323dc60a5ce, 0xdde8d3a463141e7e,
+            0x00cf95da44f0247f, 0xef4734149103af08, 0x62b4d0df3bf59b97,
+            0x48a9e6b029288ead, 0xb3d78816caabd3a7, 0xbdbcf8c66e0d5972,
+            0x80f42c040eaa9e40, 0x8f198353f81ac5bd, 0x8f9aa23e5e213985,
+            0xa845de645c9c7577, 0xf1efcd39cbcbb7ac, 0x5ed8b59af8df1332,
+            0xe097b855a2a26a9a
+        },
+        {
+            0x7659fe2e1d1c5efe, 0x08d7a698d2f44454, 0x1f2cbe458fc3fcc5,
+            0xdc68c454433d203b, 0x4acda02e3edf3a25, 0xfa086a9d684a5a4b,
+            0xf2b870ba98a3279e, 0x7ea6ea6f22c5204e, 0xf618e3fe92f8ca9f,
+            0xe5b8f29dc38b36f9, 0x7006aa9c0b1f9c61, 0x1bf232dd088e445e,
+            0xef5f070520dc6434, 0xeaf68d7f98f4ba9f, 0x542b624c3ab57d83,
+            0x0ed5589fae1b9ada, 0x2bb57048fd3f37d4, 0xa053b7102675a1fa,
+            0x0c732420518c8634, 0x44a96be232182bd0, 0x3196003ee620fd29,
+            0x4aa12cdc5abe48e4, 0x517965135cabf813, 0x831b24548ea9cd23,
+            0xeeb9e84dd160dfbb, 0xdb7554e455c2377f, 0x333d094aacb116f6,
+            0x39188bcee82770fc, 0x15bb33680cba54b3, 0x8c61674c78bb9a62,
+            0xd44082e529007b7a, 0xb96c7c479b62da90, 0xd4c61e1135fe883d,
+            0x411fcf9c23f75e12, 0x59025666fbde92c0, 0xb11559df9b20764f,
+            0x263c53e51e0dbb1e, 0xf0eb02202e44988f, 0xb514fe1eff70b90f,
+            0xd107f06c3428d6c2, 0xf77b52f0a88a5490, 0xd3409c538cfa0c9f,
+            0xbcfbbb3e2a839004, 0xbb50ec35bc33a61b, 0xfd8fe73714967849,
+            0x720814a7f8b9907a, 0x712f1b11147e0dd7, 0x1ccfbd413573f085,
+            0xd5d88aa348273b6e, 0x672c0b986d33d67b, 0xdadfba5804da8564,
+            0x1d24ebf7611a5fd4, 0xe28bf12453a6abfb, 0xd74bb8c8929bfa66,
+            0x2ee8f09a92a33966, 0x63739cd2738e7785, 0xed9a7585b0c7dfdd,
+            0x0108061dc67a4bc4, 0x254852982970540d, 0xef8b055dd7f2142f,
+            0x7f08d35548055eec, 0x651d851844e60c12, 0xdd9bab859a3bd4c7,
+            0x80ea2fb9260c63f2
+        },
+        {
+            0x6d517d62430110dd, 0x867b0cf326068be3, 0x1399750ec1b73e2d,
+            0x0b062b3f9b3f37f2, 0x3b3b1084ada68472, 0x8594c0afdbd04e71,
+            0x61f043f9d84731a7, 0xf2559bf8942dc202, 0xb1499b5a1593fe1c,
+            0xa995dd87269985b6, 0xf9b51c1f47fec244, 0x60dc080893685041,
+            0xca8e3d7474a23e29, 0xa17ca2fe511d6f24, 0x8e6cc26b93cf42f5,
+            0x2d17c2742d36cbe4, 0xbb54c3eefe4d5e83, 0x4b037b79419e4f60,
+            0xa63e7f96f1b4ebea, 0x8c3a2941378e1ed1, 0xbe95b2c59b893040,
+            0xb91460f155609d28, 0x6cd9a6cda4c541a2, 0x4a26dade998c0851,
+            0x477341ae18357a6c, 0x4712d835df6fe31e, 0xf6e6ab0071038a06,
+            0x428e8dca489cfbd0, 0x361d709f2d7fce94, 0x95609a9d8e68137b,
+            0xe05b9eb0b1d92fa6, 0xc6965ae85f354626, 0xb8e37359cf5f5202,
+            0x5c43d91b62f9d736, 0xa218286a0967e89e, 0xb9895814551e6f91,
+            0x3a08daa598ec6016, 0x8ad0ef615c5ab317, 0xad85914787a2006f,
+            0x5b1f7f35f1be8584, 0x0b2ac3535508d784, 0xfb7821274381e9a0,
+            0xb7651d321a6131c8, 0x1027f68d4187a544, 0x9f99cde9776f7a95,
+            0xe1f400747119beec, 0xfa9d523a2985dc58, 0x4855d228d91c587d,
+            0xd5cafc42e1163e4b, 0xf744da74e617dff1, 0x7d2e9fc195ccecfd,
+            0x796d23f9336a90ec, 0x2f87ee2a40cce611, 0x16395d79832b08ac,
+            0x2ff058438af8681b, 0x20340ff86fc1bfae, 0x1854e2abb16290e9,
+            0xa0760b5d3d469498, 0x0068b98d6b8ebb5a, 0x7aa59be7552875c8,
+            0x52362a991f20fa46, 0x41c1d52bb94a0d16, 0x94a3f45ca5001282,
+            0xf178abec7d1fb65e
+        },
+        {
+            0x5c9c183004d7466b, 0xd7275ba48df457ee, 0xfcc50380a7ecfde2,
+            0x9f953829273a6783, 0xe34a84c3b156a31d, 0x452048fc78acf106,
+            0xb0de512aa41b0a4a, 0x2ab4e9b9be0182c1, 0x9338bd5b8cb792f8,
+            0x987715ba039420eb, 0x0dbfecbc8d314a03, 0x18f5470b78316bb0,
+            0xfe70be1329cae3d8, 0x13f6e97c0a2f7ff1, 0x0c28ca633d5b9491,
+            0xce607f7caf7de431, 0xc25d7899efcc0717, 0xe4e2b4de1ff577e6,
+            0x95e97ed83ad38caa, 0x223fbe9b26424916, 0x1ebf5d7be6ed4936,
+            0xdbda1b7efeb0a9e1, 0x028f9416936b6190, 0xb0fc424e89a6d471,
+            0x9f5d7b9e97ac58ba, 0x2980458d4f03bb6f, 0x0d6ebaca7b1df27e,
+            0x825bcacb15a5e660, 0x35c0f4d29dc36ea2, 0xccefa261e70de96d,
+            0x6c5663d8759b0e45, 0x0799811425f3dabb, 0xc834386d9a913fb4,
+            0xe0ec9edef082e35d, 0x8e80e2833910968f, 0xd279a5ceaa622771,
+            0x7f069184fbecaef7, 0x6f8fcb8d4c30fd0c, 0xb7eb4cf90345ffbe,
+            0xffee1dd220f6c5a8, 0x6d5764e51a9ab7fb, 0x99b54d18072976c2,
+            0xb0f692f71c4b580b, 0xb85be08770e76f2d, 0x3221caaf5c35b601,
+            0x2103f47b94641d43, 0xc55faaee85375000, 0xb316ebaa44f92a81,
+            0xfe9324bc38134e8c, 0xcacfff7d569bb5e3, 0x2bcdc47b3d9256ad,
+            0xa51ce7f49dde840e, 0xcce1f26944fd816a, 0xefada486b8425793,
+            0x172c7eba36fd1da5, 0x08a3f3d15f4ef70e, 0x2749dfdea7a9fe09,
+            0x029dba1c059f5cde, 0x17bb955a591d5089, 0x333ed091245c2da7,
+            0x07cbc70fb456effb, 0x2fb57f8524213d60, 0x1a9d15791ed8d189,
+            0x3efbbbf89f319acd
+        },
+        {
+            0x810a3a7376906edf, 0x419e339366ca18e6, 0xa3ebe92fc8891e4d,
+            0x6a6659df74e3aa8b, 0x7a1921d8ddf447ed, 0x792cab7958f47a4d,
+            0xa6283dc3c3345cad, 0x0f9b27b0bb69f7d4, 0x053d5fa1eb54ea3f,
+            0xb934b4fad1ab600d, 0x7b0e80f4d705e61a, 0x6d49c12390d313c6,
+            0x66888e7830ed95aa, 0xf25c7f17ad75ee94, 0xf76d59bd687f5e15,
+            0xe7414fbc9dfe5223, 0xe2417b7bf2743fd1, 0x2e13f52acf47cb45,
+            0x41082efe4924c68b, 0x967e1cfc0029e550, 0x4361ac4ef781b88f,
+            0x7d35c87ceb292597, 0xd6248908acf74d53, 0x35a54deb1174d9c3,
+            0x21ed8778fe2958ff, 0x670042a360cb62db, 0x78e0a301ad2abfa6,
+            0xa63a9d489736c434, 0x197062da97807d53, 0xd70d9c410107093c,
+            0x1269f73209d58df5, 0x067878552a99a3df, 0xe8a610248f7a042b,
+            0x44ff249ed6f744e1, 0x37b3976de799c056, 0x3ac544f96df923f8,
+            0xc5be4741660a7104, 0x862815aff45bef2c, 0x0e37795ea50f9d4c,
+            0x2e2577b8f9af9db6, 0x7aec68810183a51e, 0x93136b2c67b188e5,
+            0x72b01e4bafcba073, 0xae718a7a40d9213e, 0xe16ed8e537eeaa45,
+            0xf31b6114de0c9b53, 0xb06c8ac7a9203773, 0x9a22f9d8259869df,
+            0x9a720298c83fd342, 0xf4cf274ba14bac02, 0x9cc9bd9d4ba3b41d,
+            0x90a33b87ca0db6b0, 0x501904f509420b2e, 0x1f5d3b2933221ce0,
+            0x3dfdbc6be3a85e74, 0x4eebffd88c8a1cf8, 0xcc30204ebb559ffc,
+            0x38404290f88f3dff, 0x6752f7d57c974456, 0x19412a79883793a8,
+            0x8d6a785ef2fe3a57, 0x18ad2277e506b35c, 0xdb370df3ac6092fc,
+            0x470161006001379a
         }
-        for (int o = 0; o < NUM_CASTLINGS; o++) {
-            x = SEED;
-            x ^= x << 13;
-            x ^= x >> 7;
-            x ^= x << 17;
-            CASTLING_PRN[c][o] = SEED = x;
+    },
+    {
+        {
+            0x3db749cada489a1d, 0x948a1aa0d15a1d2b, 0x39fbb9bab06d7790,
+            0x1565afc4c04e08c6, 0x942621ea09307af2, 0x669a33d47c456dd9,
+            0x983e853fecfb11f5, 0x481f07199896cc8e, 0x6f7772c389b1e4da,
+            0x7df45a845a7c10bf, 0x6eb2785c2c6afe43, 0x41d61206b9319c01,
+            0x781bb6afeef3be1d, 0xd4eef7c0a2ad97d2, 0x90043b03c220b752,
+            0x1b4d4e4272cb468a, 0x336a1995f7b7b103, 0x6aa923c75b3938ea,
+            0xc433205e12ec336d, 0xa07c46c98f810131, 0x32f7e04d76058ca6,
+            0x1e709775937504d7, 0x01e1a4e658cc6578, 0xb174ef34fdf6ed1b,
+            0xc088958fa0f77d85, 0x89bfde91ded996dc, 0xe292694c994ecac9,
+            0xa2061788fa256dcd, 0x7bb0cb9b87956d7d, 0x0fda78a82b26c20b,
+            0xd099a65a8e9213e8, 0x62122e47e6a0d792, 0xd19517141bfdd35b,
+            0x31a0ff0880bba4df, 0x05834df1ed1a511a, 0x903893d8c74877bf,
+            0x0cd4e6bc509aea51, 0x3fb4fb452720d0c4, 0xcd18798274d6bfaa,
+            0x61fd405d3d63cb27, 0xe927cc0fd55296b7, 0x4eb461084578e06b,
+            0x34e72262fcf17ee7, 0xa4a9af7853248505, 0x3d073a12b53cadff,
+            0x0e1312410ac86372, 0x9dbe78d191079a36, 0x1bdc0ca2e9214b82,
+            0xf00cb38f68a4155e, 0xb7841436328fedd4, 0xf363546837159108,
+            0x9cdfb1d245156da5, 0x18625752165b37cb, 0xd460e7f1739090ac,
+            0x4e13025d253362f8, 0x236220cea8df84ad, 0xc2d345b1d66cf1ff,
+            0xff4f5f2c141e9c5a, 0xa64301f0372e1b5c, 0xdbaadd8359f4b775,
+            0x0b433359b9bf244d, 0xc5b313bd6d6a0beb, 0x9a54f54e2f6a26c2,
+            0xa884987cb29a1983
+        },
+        {
+            0xc35ac859bad54f38, 0x6cb37e22db771ab7, 0x957d2c9cd1722db3,
+            0x540bce3029124ae2, 0x373c81b62ea1d743, 0xefea1f03f37b737d,
+            0xa09ee0f60b3a493e, 0x17c3c12e2cab39aa, 0xe9c2b87144c3ba31,
+            0x413f19a0d58d8b82, 0x65ae780857cab914, 0xbad11d338c25ea45,
+            0xe728faeaa9aed44c, 0x37a23c69349c3934, 0x6f6f656c91ae8af7,
+            0xf8a47d57f3de8c1a, 0xc7e8abcdc5b7982c, 0xd45aa7731fd9a36a,
+            0x1fba22714c3626e1, 0x63bf96f412d33106, 0xedf0b41db83145a0,
+            0x4caaeb3504e8e68b, 0xdcd2904df4a300d4, 0x164a1ccfbb77746e,
+            0x6a86f8b9d818af81, 0x89344652b5f917ff, 0x4ddc9cf0e417e5da,
+            0xc3c6a1b1e71748e1, 0x0ea28aa8166f3edb, 0xf0a45a0d91dc3154,
+            0x0dc3fbe40bbc9c49, 0xd0088e87806a408f, 0x843ea76cd380f6fb,
+            0xef749182ccd7dc5d, 0x22419e4bc4b09ac9, 0xc5733af8deeb9f5d,
+            0xea2c8e6d8d15e79b, 0x42f03c702f9144b7, 0x3a8f4c04fe72ae81,
+            0x2233665f6de80ed1, 0xacbe3e82f461b461, 0x81c9a32e231af966,
+            0xa0f1c34f95cea68f, 0xf7d59d1ddddd4977, 0x44bd4361be477363,
+            0x0a13ac0c095bd70f, 0xb3aef6b179cb1a38, 0xc14ab7e0bdf1b80d,
+            0xc0e76c993946a98d, 0x94bc748cd464cf48, 0x7d57725d40956092,
+            0xccca12cf8d8a1304, 0xff93c78e564acd74, 0x0534e646fdbe14b6,
+            0x04733321d912e16c, 0xbfb64e26e02401f1, 0x04e5af97f91d8d7f,
+            0xe2242e3ca0c81508, 0x160fb8a6b0052060, 0xe470bd97a8c1f94e,
+            0x4b19b22837a6a9fc, 0x982475f1c62f5c31, 0xdb505d53cd5aae1f,
+            0xbd1ee7000f499a63
+        },
+        {
+            0xfd678f5a2c8892fd, 0xb0a74a7f4bf977e9, 0xb98d84334539edb9,
+            0x0e059c767335307e, 0x72b23aca00a0efb1, 0x22f8fe3e60036fdd,
+            0xe852e6a3a8044b67, 0xbeb15054050dc776, 0xe3397def2505c171,
+            0xa5ccca2f59937554, 0x296bd463d73ad6cb, 0x142adc5d9b1052ab,
+            0x8028124b121d02a1, 0x1dccd45857944f95, 0x5125417790103e09,
+            0xff6dc17641476057, 0x708d2e73a597d216, 0xd63454b836c2c402,
+            0x00834480e0b5bda0, 0x0140fe4a74f02b6d, 0x9ae02505d02c44dc,
+            0x6519ec0be2ff48d2, 0x2f145cd0e1ce99df, 0x03fcaef29e63f0f9,
+            0xe4520c2f3fe5091e, 0x0030fae18287b010, 0xd30f3a7ca2ffbb89,
+            0xa3c1fdf30ae74f5d, 0xe2d595031be887b5, 0x9bfd1e233f33d637,
+            0xa7365951854d36d6, 0xc13f5cd7235ed89e, 0xbfc18d11bd8b0269,
+            0xeba7b292cda9c5a0, 0x03f1c7fbb795bb62, 0x82b7ffcec77bfcc9,
+            0x168785ceadcdcea2, 0x9ab6049b523e1315, 0x7b9744b127bbb6f7,
+            0x62629e425e2b2f48, 0x8f23bad58018adbf, 0x4ebee3f6fd229513,
+            0xe054aeeb77880748, 0x53923ff0de8670b3, 0xfff2f798fbee4d9e,
+            0xd7e55d3717986217, 0xd21d29b2c0c7b9a2, 0x878c4a46910b2471,
+            0x9b82ab090d328a40, 0xf3f2660f59ce33d2, 0x5b41e6c9a1f1085f,
+            0xf1257cadea672a83, 0xd948e1b4ba4baba6, 0x0d80e36c92c7c9c0,
+            0x445c2207ef442641, 0x022891edecd3d8d5, 0xb8d5ac2ed3e738f5,
+            0x2c5fc1fb31e41471, 0x2f2fec3501462c8e, 0xdae57dd9d3ccd77d,
+            0x20b10ff6ee137029, 0x1d48413bc87514cc, 0xdb9f7e358e46ccd7,
+            0x887cebe812fbdbb6
+        },
+        {
+            0x7a22b7903b86927d, 0x66c00314ed3534a3, 0x7c8d2996fd972bfd,
+            0xb818d328a6c9f628, 0xdc1d5087abc9bb29, 0x59f656d04bf5e9b9,
+            0x436c8cb0cdbb34e8, 0xe85b56fb212c48c1, 0x6626a99c356c2854,
+            0x637e3a7d1ea0c041, 0x8bb08329a94f2ed6, 0x311fdeb299ddf5de,
+            0xb033c87eccfeff13, 0xa465bd8e8da90c1c, 0x5ae737527d09dd2e,
+            0x2d87eaa110d5db1a, 0x5455356fcde5ee9a, 0x8cde988787c1dbcd,
+            0x8ed063b94e8bea0e, 0x57c390a75d3bed68, 0x1d2eff43786c30db,
+            0x5eb65125a51e47c0, 0x1dbfb7596b5010a1, 0x29856b01d0863f21,
+            0x0c79792bb23009c0, 0x0854247579e1af57, 0x5f9fa74eadec1699,
+            0x8de4e73b8bb7b33a, 0x096f1e70e261556f, 0x4df66da08cd80031,
+            0x96a01200076dde8d, 0x04a2a1bb4b06f34b, 0x7f8bcf77c03dc562,
+            0x1f8ebf0b8c453581, 0xe2de6e0322cf79d3, 0xc79126368d63d218,
+            0x351d6929abd73ff7, 0x98aeb3ce2886ae22, 0xa515da9afd635066,
+            0x06a3ba723518250d, 0xb85fa01ce0563fd2, 0xfb1637aa32d91405,
+            0x2bd93e3f9f4297f8, 0xbeae8f7dab9f70ce, 0x0a0b1302e3f4fc1a,
+            0x5fd383524e49c4aa, 0xd621720f4fb12ac4, 0xd43d879bc979a9bb,
+            0x5738ee95c74ea3c4, 0x207933d297e2a464, 0xa43f3292b923ee1e,
+            0xd392300bd59c4e38, 0xa56c4544510bce89, 0xef066b3100f82f4d,
+            0x5957068ed832a396, 0x7d888823c3bedd6d, 0xdc75551b09e01e34,
+            0x4fd68caa6fe74198, 0x37155c39d9de6cd9, 0xb9274dea5ec7780d,
+            0x834c4944b22059c9, 0x95ec3ca75762901f, 0xb3034cd2d0996cef,
+            0xdea0ad603dd4e640
+        },
+        {
+            0xb7c5eb0f98707740, 0x76cabc46fd39c0dd, 0xc9e5be81005e52b3,
+            0x62588b23475438ba, 0xe951ac95c0c7af74, 0xeab8917d58caf29f,
+            0xb42796158456d6a8, 0xe46aa59dd805399a, 0x10c801991e0052f5,
+            0xe6dbc915bfbd283a, 0xd40ac538625211a5, 0x7740c4be974bfa2d,
+            0x081318f4decf6925, 0x83852d77ba1f5f0f, 0x166178fe2a6878f9,
+            0xc999a8be8d1d9ebb, 0xf0c18648a2fbebf8, 0xda1b2aa0813a1bd2,
+            0x8366c38668e00cb1, 0xb96ccee632d308cc, 0x099b65f15a1540e0,
+            0x0068ffbb399dd35d, 0x5df68572e4a4e571, 0x1d873f37be071043,
+            0x55df2a98c80a18ed, 0x70fa5a5ee67d83c1, 0xbe6423a8c4bfa63a,
+            0x70fb083da0e2733b, 0x33bd6501557ec90b, 0x90c22d73e6243756,
+            0x4f5c5be5b9470b3e, 0x696805ff2f9aad84, 0x71b55d893f34a4b1,
+            0x8c877e1c66263e96, 0x1979374449c30a43, 0x719ec05656c843d6,
+            0xb905aa06d9175801, 0x874ac923380af150, 0x31c8804ed0fbfaec,
+            0xb41c44db88e3d796, 0xb15a52177a8ccaef, 0x4ce94924853a535d,
+            0x22ea5bf7229d0cac, 0x8ec5c016f1dbd029, 0x6eca232dcbba8b00,
+            0x863e22604b968c74, 0x9e0a6b758ee3a561, 0xd08079702cb17360,
+            0x8104a098e9d10aca, 0x83394f0811190773, 0x57149fbc263d6026,
+            0x26e3c5dda44fe945, 0x2509b98ab6d66291, 0x15b8266b7a83e463,
+            0xf8841a1b50dc7957, 0x8c55ff896a553bfb, 0x134b1d5d481c0d10,
+            0x10ef39a4892218ed, 0x2095a3553312b6e1, 0x53142211d7b6a2f5,
+            0xadd8b2eeef325300, 0x19e7bf3497ada752, 0x18e9ffb0c5ec57f2,
+            0xb0e1b6c5ba4cf504
+        },
+        {
+            0xdc6029aa75e3b558, 0x42971f9a6d3e4015, 0x1d73abacc0bd5c12,
+            0x4fd70c710a96ca80, 0xf4b103527847f056, 0x7540396853372026,
+            0xd172b165ffe944c8, 0x04972ca5ef883f84, 0xf1c814c4477b534f,
+            0xd8bedf9d1c7048d8, 0x7912dbcea860a166, 0xcc1a5ed9f766034e,
+            0xdecc3ad114e389c8, 0x7951b12b93f5241f, 0x850342de95f9e996,
+            0x85dfb10a2b12a00e, 0x2cfd831700b292c9, 0x31ba8453db45d317,
+            0x697995bc37449cd1, 0x47bc68280233e468, 0x006156af01d97ff8,
+            0xd0e356e50c2d64fd, 0x236a3f7bae017754, 0x1605d0548921fe0f,
+            0x86b1498ab6dbe801, 0x64e40a894de93755, 0xd61b76e61d1f6a42,
+            0x9360323a3a6a6686, 0x948e0c6eedfa5754, 0x87356d9de7bc32e3,
+            0x65f2c71556282092, 0xf8e249546e3d9283, 0x07183deec1cf4210,
+            0xf383c2f4a081eeb2, 0xd23d019ba857be0d, 0xf16395830da83073,
+            0x8f3d4bbbec70b15b, 0xcb066b974465c87e, 0xb85c1c4ad8b0eb5e,
+            0x2155ac92f445c1de, 0xae957428d8ad15ca, 0x5305da755e95c498,
+            0xb79a24b8ecd34937, 0xd881f9f3ee2cbe5c, 0x91a689bb09f23df1,
+            0xc6712a1f4bbf7cd1, 0xabc632c2dc4382c4, 0x173ce46e7f0e7459,
+            0xb4e083c7cce4b82d, 0x1ed66d15586bee4b, 0x7d3aeaa43582f6f5,
+            0x942b1e141f4a208f, 0x1a50f60d59b2d7e5, 0x254dbf34e987e97b,
+            0x14cfaf3058904969, 0xec3d8fcb0c9d085b, 0x589e1ebfd46b600f,
+            0x519c397360e6d088, 0xd360eb23df3b2a83, 0x36c0af39fe1e8905,
+            0x2da04257ab036e0b, 0xd98c243a6776b2d7, 0x6af3d3f34e8c8a61,
+            0x1a714a3abebe43eb
         }
     }
-    
-    x = SEED;
-    x ^= x << 13;
-    x ^= x >> 7;
-    x ^= x << 17;
-    COLOR_PRN = SEED = x;
+};
 
-    return;
-}
+const zhash CASTLING_PRN[16] = {
+    0x0000000000000000, 0x333e502498429463, 0xe9dff1c8ccfdb987,
+    0xdae1a1ec54bf2de4, 0x06e498450ab0fac9, 0x35dac86192f26eaa,
+    0xef3b698dc64d434e, 0xdc0539a95e0fd72d, 0x1883dea3c61f732a,
+    0x2bbd8e875e5de749, 0xf15c2f6b0ae2caad, 0xc2627f4f92a05ece,
+    0x1e6746e6ccaf89e3, 0x2d5916c254ed1d80, 0xf7b8b72e00523064,
+    0xc486e70a9810a407
+};
+
+const zhash EN_PASSANT_PRN[8] = {
+    0x9f60afff4ee6a858, 0x59b1e2f2977bb4d8, 0x5e499391b0ba4b3d,
+    0x3adf0360702a41e0, 0x2003615e1b7f0026, 0x709f8c01556b2eb5,
+    0x44aeebf173c694a7, 0x8c57f5746346c597
+};
+
+const zhash COLOR_PRN = 0x5fde669988ed7efc;
 
 /**
  * @brief Zobrist hashing: https://www.chessprogramming.org/Zobrist_Hashing
@@ -73,17 +343,35 @@ zhash hash_position(position *P) {
 
     for (int c = 0; c < NUM_COLORS; c++) {
         for (int p = 0; p < KING; p++)  {   // For each of the pieces minus king
-            bb = _P.whose[c] & _P.pieces[p];
+            bb = _P.whose[c] & _P.pieces[p] & (p == PAWN ? PAWNS_MASK 
+                                                          : BITBOARD_FULL);
             while ((s = bitboard_iter_first(&bb)) != INVALID_SQUARE) {
                 Z ^= PIECE_PRN[c][p][s];
             }
         }
-        Z ^= PIECE_PRN[c][KING][_P.king[c]]; // KING is special case
+        if (_P.king[c] != INVALID_SQUARE)   // KING is special case
+            Z ^= PIECE_PRN[c][KING][_P.king[c]];
+    }
+    Z ^= CASTLING_PRN[_P.castling];     // white to move, so already white's
 
-        for (int o = 0; o < NUM_CASTLINGS; o++) {   // For each of the castlings
-            if (position_get_castling(&_P, c, o)) Z ^= CASTLING_PRN[c][o];
-        }
+    // Positions that differ only in en passant rights have different moves
+    bb = _P.pieces[PAWN] & ~PAWNS_MASK;
+    while ((s = bitboard_iter_first(&bb)) != INVALID_SQUARE) {
+        Z ^= EN_PASSANT_PRN[s % 8];
     }
 
+    return Z;
+}
+
+zhash hash_pawns(position *P) {
+    square s;
+    zhash Z = 0;
+    for (Whose w = OURS; w <= THEIRS; w++) {
+        Color color = w == OURS ? P->color : !P->color;
+        bitboard bb = P->whose[w] & P->pieces[PAWN] & PAWNS_MASK;
+        while ((s = bitboard_iter_first(&bb)) != INVALID_SQUARE) {
+            Z ^= PIECE_PRN[color][PAWN][hash_square(P->color, s)];
+        }
+    }
     return Z;
 }
\ No newline at end of file
@@ -1,6 +1,12 @@
 /**
  * @file zobrist.h
  * @brief Provides an interface for hashing positions positions.
+ * 
+ * Hashes are absolute: the same game position hashes the same whichever way
+ * the position is rotated. Positions carry their hash in P->hash, which
+ * move_make, move_unmake and position_rotate keep up to date by XORing in and
+ * out the keys below, which are fixed at compile time (see
+ * scripts/zobrist-keys.py) so hashes are stable across runs and machines.
  */
 
 #ifndef _ZOBRIST_H_
@@ -11,10 +17,41 @@
 /** @brief Namespace for hashes */
 typedef uint64_t zhash;
 
-/** @brief Initializes the seed and pseudo-random numbers for hashing */
-void hash_init(void);
+/** @brief PRNs for all piece types of both colors on any (white's) square */
+extern const zhash PIECE_PRN[2][6][64];
 
-/** @brief Returns a hash value for a given position */
+/** @brief PRNs for every set of castling rights, indexed by the white-relative 
+ * castling word (white's rights in the high bits, like OURS when white moves) */
+extern const zhash CASTLING_PRN[16];
+
+/** @brief PRNs for the file of an en passant capture square */
+extern const zhash EN_PASSANT_PRN[8];
+
+/** @brief PRN for black to move */
+extern const zhash COLOR_PRN;
+
+/** @brief Returns a hash value for a given position, computed from scratch */
 zhash hash_position(position *P);
 
-#endif
\ No newline at end of file
+/** 
+ * @brief Returns the hash of the pawns of a position alone, from scratch
+ * 
+ * Made of the same keys as hash_position, so it is just as stable. Keys
+ * caches of whatever depends on the pawn structure only (see eval.c).
+ */
+zhash hash_pawns(position *P);
+
+/** @brief White's square for a square of a position with `color` to move */
+static inline square hash_square(Color color, square s) {
+    return color == WHITE ? s : 63 - s;
+}
+
+/** @brief The castling rights key of a position */
+static inline zhash hash_castling(position *P) {
+    uint8_t castling = P->color == WHITE ? P->castling 
+                                         : (P->castling >> 2) | 
+                                           ((P->castling & 0x3) << 2);
+    return CASTLING_PRN[castling];
+}
+
+#endif
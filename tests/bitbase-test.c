@@ -0,0 +1,139 @@
+/**
+ * @file bitbase-test.c
+ * @brief Tests for the bitbase interface.
+ */
+
+#include "../src/bitbase.h"
+#include "../src/moves.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+/** @brief Writes the FEN of white king and pawn against the black king */
+static void kpk_fen(square white_king, square pawn, square black_king,
+                    Color to_move, char *fen) {
+    char *c = fen;
+    for (int rank = 7; rank >= 0; rank--) {
+        int empty = 0;
+        for (int file = 0; file < 8; file++) {
+            square s = rank * 8 + file;
+            char piece = s == white_king ? 'K' : s == pawn ? 'P'
+                       : s == black_king ? 'k' : '\0';
+            if (piece == '\0') {
+                empty++;
+                continue;
+            }
+            if (empty > 0) *c++ = '0' + empty;
+            empty = 0;
+            *c++ = piece;
+        }
+        if (empty > 0) *c++ = '0' + empty;
+        if (rank > 0) *c++ = '/';
+    }
+    sprintf(c, " %c - - 0 1", to_move == WHITE ? 'w' : 'b');
+    return;
+}
+
+/** @brief Looks a position with one pawn up, whichever side has it */
+static bool kpk_probe(position *P) {
+    Whose strong = (P->whose[OURS] & P->pieces[PAWN] & PAWNS_MASK)
+                   ? OURS : THEIRS;
+    square pawn = bitboard_bsf(P->whose[strong] & P->pieces[PAWN] & PAWNS_MASK);
+    square winner = P->king[strong], loser = P->king[!strong];
+    if (strong == THEIRS) {
+        pawn = 63 - pawn;
+        winner = 63 - winner;
+        loser = 63 - loser;
+    }
+    return bitbase_kpk(winner, pawn, loser, strong == OURS);
+}
+
+/**
+ * @brief Checks a position against its children, found by the move generator
+ *
+ * The side to move wins if one of its moves wins, and loses if all of them
+ * do. Positions with a promotion to play are where the search starts from,
+ * so they aren't checked.
+ */
+static bool kpk_consistent(position *P) {
+    bool strong_to_move = P->whose[OURS] & P->pieces[PAWN] & PAWNS_MASK;
+    bool win = kpk_probe(P);
+
+    movelist M;
+    movelist_clear(&M);
+    generate_moves(&M, P);
+    if (M.size == 0) return win == (!strong_to_move && king_in_check(P, OURS));
+
+    bool any_win = false, all_win = true;
+    for (int i = 0; i < M.size; i++) {
+        move m = M.array[i];
+        if (m.flags & M_FLAG_PROMOTION[KNIGHT]) return true;     // any promotion
+        undo U;
+        move_make(P, m, &U);
+        position_rotate(P);
+        bool child = (P->pieces[PAWN] & PAWNS_MASK) && kpk_probe(P);
+        position_rotate(P);
+        move_unmake(P, m, &U);
+        any_win |= child;
+        all_win &= child;
+    }
+    return win == (strong_to_move ? any_win : all_win);
+}
+
+void bitbase_tests(void) {
+    position *P = position_new();
+    char fen[100];
+
+    /* Every legal position agrees with the moves played from it */
+    int positions = 0, wins = 0;
+    for (square pawn = 8; pawn < 56; pawn++) {
+        for (square white_king = 0; white_king < 64; white_king++) {
+            for (square black_king = 0; black_king < 64; black_king++) {
+                int ranks = white_king / 8 - black_king / 8;
+                int files = white_king % 8 - black_king % 8;
+                if (white_king == pawn || black_king == pawn ||
+                    (-1 <= ranks && ranks <= 1 && -1 <= files && files <= 1))
+                    continue;
+                for (Color c = WHITE; c <= BLACK; c++) {
+                    kpk_fen(white_king, pawn, black_king, c, fen);
+                    position_from_fen(P, fen);
+                    if (king_in_check(P, THEIRS)) continue;
+                    assert(kpk_consistent(P));
+                    positions++;
+                    wins += kpk_probe(P);
+                }
+            }
+        }
+    }
+    printf("KPK: %d positions, %d wins\n", positions, wins);
+
+    /* Known positions */
+    position_from_fen(P, "8/8/8/8/k7/8/6P1/4K3 w - - 0 1");     // outside
+    assert(kpk_probe(P));
+    position_from_fen(P, "8/8/8/8/5k2/8/6P1/4K3 w - - 0 1");    // inside
+    assert(!kpk_probe(P));
+    position_from_fen(P, "4k3/8/4K3/4P3/8/8/8/8 b - - 0 1");    // king ahead
+    assert(kpk_probe(P));
+    position_from_fen(P, "4k3/8/4K3/4P3/8/8/8/8 w - - 0 1");
+    assert(kpk_probe(P));
+    position_from_fen(P, "k7/8/K7/P7/8/8/8/8 w - - 0 1");       // rook pawn
+    assert(!kpk_probe(P));
+    position_from_fen(P, "8/8/8/8/8/4k3/4p3/4K3 w - - 0 1");    // stalemate
+    assert(!kpk_probe(P));
+    position_from_fen(P, "8/8/8/8/8/4k3/4p3/2K5 w - - 0 1");    // black pawn
+    assert(kpk_probe(P));
+
+    position_free(P);
+    return;
+}
+
+int main(int argc, char *argv[]) {
+    moves_init();
+    bitbase_init();
+    bitbase_tests();
+
+    printf("All tests passed!\n");
+
+    return 0;
+}
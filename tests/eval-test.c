@@ -0,0 +1,175 @@
+/**
+ * @file eval-test.c
+ * @brief Tests for the evaluation interface.
+ */
+
+#include "../src/eval.h"
+#include "../src/moves.h"
+#include "../src/zobrist.h"
+
+#include <assert.h>
+#include <ctype.h>
+#include <stdio.h>
+#include <string.h>
+
+#define NUM_FENS 11
+
+static const char *EVAL_FENS[NUM_FENS] = {
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+    "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+    "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+    "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+    "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+    "8/8/3k4/8/8/8/1Q6/4K3 b - - 0 1",
+    "8/8/8/3k4/8/8/2BN4/4K3 w - - 0 1",
+    "8/8/8/8/k7/8/6P1/4K3 w - - 0 1",
+    "8/5p2/3b3k/8/8/3B4/5PP1/6K1 w - - 0 1",
+    "8/8/3k4/8/8/8/2N5/4K3 w - - 0 1"
+};
+
+/** @brief Writes the FEN of the same position with the colors swapped */
+static void fen_flip(const char *fen, char *flipped) {
+    char board[100], color[4], castling[8], en_passant[4];
+    int halfmoves, fullmoves;
+    sscanf(fen, "%99s %3s %7s %3s %d %d", board, color, castling, en_passant,
+           &halfmoves, &fullmoves);
+
+    // Ranks in reverse order, pieces in the other case
+    char *ranks[8];
+    int n = 0;
+    for (char *r = strtok(board, "/"); r != NULL; r = strtok(NULL, "/")) {
+        ranks[n++] = r;
+    }
+    flipped[0] = '\0';
+    for (int i = n - 1; i >= 0; i--) {
+        for (char *c = ranks[i]; *c != '\0'; c++) {
+            *c = isupper(*c) ? tolower(*c) : toupper(*c);
+        }
+        strcat(flipped, ranks[i]);
+        if (i > 0) strcat(flipped, "/");
+    }
+
+    for (char *c = castling; *c != '\0'; c++) {
+        if (*c != '-') *c = isupper(*c) ? tolower(*c) : toupper(*c);
+    }
+    if (en_passant[0] != '-') en_passant[1] = en_passant[1] == '3' ? '6' : '3';
+    sprintf(flipped + strlen(flipped), " %c %s %s %d %d",
+            color[0] == 'w' ? 'b' : 'w', castling, en_passant, halfmoves,
+            fullmoves);
+    return;
+}
+
+/** @brief Checks the cached evaluation against the uncached one at every node */
+static void eval_walk(position *P, int depth, pawn_table *T) {
+    assert(evaluate(P, T) == evaluate(P, NULL));
+    if (depth == 0) return;
+
+    movelist M;
+    movelist_clear(&M);
+    generate_moves(&M, P);
+    for (int i = 0; i < M.size; i++) {
+        undo U;
+        move_make(P, M.array[i], &U);
+        position_rotate(P);
+        eval_walk(P, depth - 1, T);
+        position_rotate(P);
+        move_unmake(P, M.array[i], &U);
+    }
+    return;
+}
+
+void eval_tests(void) {
+    position *P = position_new();
+    char flipped[128];
+
+    /* The side to move sees the same score, whichever color it is */
+    for (int i = 0; i < NUM_FENS; i++) {
+        position_from_fen(P, EVAL_FENS[i]);
+        int score = evaluate(P, NULL);
+        fen_flip(EVAL_FENS[i], flipped);
+        position_from_fen(P, flipped);
+        assert(evaluate(P, NULL) == score);
+    }
+
+    position_init(P);
+    assert(evaluate(P, NULL) == 0);
+
+    /* Material, and pawn structure */
+    position_from_fen(P, "4k3/8/8/8/8/8/8/3QK3 w - - 0 1");
+    assert(evaluate(P, NULL) > 800);
+    position_rotate(P);
+    assert(evaluate(P, NULL) < -800);
+
+    int passed, blocked;
+    position_from_fen(P, "4k3/7p/8/3P4/8/8/8/4K3 w - - 0 1");
+    passed = evaluate(P, NULL);
+    position_from_fen(P, "4k3/2p5/8/3P4/8/8/8/4K3 w - - 0 1");
+    blocked = evaluate(P, NULL);
+    assert(passed > blocked);
+
+    int doubled, apart;
+    position_from_fen(P, "4k3/8/8/8/8/3P4/3P4/4K3 w - - 0 1");
+    doubled = evaluate(P, NULL);
+    position_from_fen(P, "4k3/8/8/8/8/4P3/3P4/4K3 w - - 0 1");
+    apart = evaluate(P, NULL);
+    assert(apart > doubled);
+
+    int shielded, bare;
+    position_from_fen(P, "r5k1/5ppp/8/8/8/8/5PPP/R5K1 w - - 0 1");
+    shielded = evaluate(P, NULL);
+    position_from_fen(P, "r5k1/5ppp/8/8/8/5PPP/8/R5K1 w - - 0 1");
+    bare = evaluate(P, NULL);
+    assert(shielded > bare);
+
+    /* Endgames recognised by their material */
+    position_from_fen(P, "8/8/3k4/8/8/8/1Q6/4K3 b - - 0 1");
+    assert(evaluate(P, NULL) < -VALUE_KNOWN_WIN);
+    int center, corner;
+    position_from_fen(P, "8/8/8/3k4/8/8/2BN4/4K3 w - - 0 1");
+    center = evaluate(P, NULL);
+    position_from_fen(P, "k7/8/8/8/8/8/2BN4/4K3 w - - 0 1");     // light a8
+    corner = evaluate(P, NULL);
+    assert(VALUE_KNOWN_WIN / 2 < center && center < corner);
+
+    position_from_fen(P, "8/8/8/8/k7/8/6P1/4K3 w - - 0 1");     // outside
+    assert(evaluate(P, NULL) > VALUE_KNOWN_WIN);
+    position_from_fen(P, "8/8/8/8/5k2/8/6P1/4K3 w - - 0 1");     // inside
+    assert(evaluate(P, NULL) < VALUE_KNOWN_WIN);
+
+    position_from_fen(P, "8/8/3k4/8/8/8/2N5/4K3 w - - 0 1");     // no mate
+    assert(evaluate(P, NULL) < 100);
+
+    int opposite, same;
+    position_from_fen(P, "8/5p2/3b3k/8/8/3B4/5PP1/6K1 w - - 0 1");
+    opposite = evaluate(P, NULL);
+    position_from_fen(P, "8/5p2/4b2k/8/8/3B4/5PP1/6K1 w - - 0 1");
+    same = evaluate(P, NULL);
+    assert(0 < opposite && opposite < same);
+
+    /* The pawn table gives the same scores, and answers most lookups */
+    pawn_table *T = pawn_table_new(64);
+    for (int i = 0; i < NUM_FENS; i++) {
+        position_from_fen(P, EVAL_FENS[i]);
+        eval_walk(P, 3, T);
+    }
+    uint64_t probes = pawn_table_probes(T);
+    uint64_t hits = pawn_table_hits(T);
+    printf("Pawn table: %lu probes, %.1f%% hits\n", probes,
+           100.0 * hits / probes);
+    assert(hits * 10 > probes * 8);
+    pawn_table_free(T);
+
+    position_free(P);
+    return;
+}
+
+int main(int argc, char *argv[]) {
+    moves_init();
+    eval_init();
+    eval_tests();
+
+    printf("All tests passed!\n");
+
+    return 0;
+}
@@ -0,0 +1,159 @@
+/**
+ * @file movepick-test.c
+ * @brief Tests for the move picker.
+ */
+
+#include "../src/movepick.h"
+#include "../src/moves.h"
+#include "../src/position.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static bool move_equal(move a, move b) {
+    return memcmp(&a, &b, sizeof(move)) == 0;
+}
+
+static bool movelist_has(movelist *M, move m) {
+    for (int i = 0; i < M->size; i++) {
+        if (move_equal(M->array[i], m)) return true;
+    }
+    return false;
+}
+
+static bool move_is_quiet(move m) {
+    return !(m.flags & (M_FLAG_CAPTURE | M_FLAG_PROMOTION[KNIGHT]));
+}
+
+static history_table history;
+
+/**
+ * @brief Picks every move of a position, and checks they're its legal moves,
+ * once each, in stage order
+ *
+ * @param[in] P
+ * @param[in] others moves to try as hash, killer and counter moves, which
+ *                   mostly don't belong to P
+ */
+static void check_picker(position *P, movelist *others) {
+    movelist M;
+    movelist_clear(&M);
+    generate_moves(&M, P);
+    bool in_check = king_in_check(P, OURS);
+
+    move hash_move = others->size > 0 ? others->array[rand() % others->size]
+                                      : NULL_MOVE;
+    move killers[2] = { NULL_MOVE, NULL_MOVE };
+    move counter = NULL_MOVE;
+    if (M.size > 0 && rand() % 2) hash_move = M.array[rand() % M.size];
+    if (M.size > 0) killers[0] = M.array[rand() % M.size];
+    if (others->size > 0) killers[1] = others->array[rand() % others->size];
+    if (M.size > 0) counter = M.array[rand() % M.size];
+
+    move_picker MP;
+    move_picker_init(&MP, P, hash_move, killers, counter, &history);
+    movelist picked;
+    movelist_clear(&picked);
+    bool quiets_started = false, bad_started = false;
+    while (true) {
+        move m = move_picker_next(&MP);
+        if (m.from == m.to) break;
+        assert(movelist_has(&M, m) && !movelist_has(&picked, m));
+        if (picked.size == 0 && movelist_has(&M, hash_move))
+            assert(move_equal(m, hash_move));
+        if (!in_check && picked.size > 0) {
+            // Good captures, then quiets, then losing captures
+            if (move_is_quiet(m)) {
+                assert(!bad_started);
+                quiets_started = true;
+            } else if (quiets_started) {
+                assert(!see_ge(P, m, 0));
+                bad_started = true;
+            }
+        }
+        picked.array[picked.size++] = m;
+    }
+    assert(picked.size == M.size);
+    assert(move_picker_next(&MP).from == NULL_MOVE.to);
+
+    // Quiescence: the captures and promotions, or every evasion
+    move_picker_init_quiescence(&MP, P, hash_move, &history);
+    movelist_clear(&picked);
+    int loud = 0;
+    for (int i = 0; i < M.size; i++) loud += !move_is_quiet(M.array[i]);
+    while (true) {
+        move m = move_picker_next(&MP);
+        if (m.from == m.to) break;
+        assert(movelist_has(&M, m) && !movelist_has(&picked, m));
+        assert(in_check || !move_is_quiet(m));
+        picked.array[picked.size++] = m;
+    }
+    assert(picked.size == (in_check ? M.size : loud));
+    return;
+}
+
+/** @brief Walks a tree, checking the picker at every node */
+static void picker_walk(position *P, int depth, movelist *parent) {
+    check_picker(P, parent);
+    if (depth == 0) return;
+
+    movelist M;
+    movelist_clear(&M);
+    generate_moves(&M, P);
+    for (int i = 0; i < M.size; i++) {
+        undo U;
+        move_make(P, M.array[i], &U);
+        position_rotate(P);
+        picker_walk(P, depth - 1, &M);
+        position_rotate(P);
+        move_unmake(P, M.array[i], &U);
+    }
+    return;
+}
+
+void movepick_tests(void) {
+    const char *fens[6] = {
+        "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+        "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+        "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+        "r2q1rk1/pP1p2pp/Q4n2/bbp1p3/Np6/1B3NBn/pPPP1PPP/R3K2R b KQ - 0 1",
+        "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+        "8/8/2pp4/KP5r/4Pp2/6k1/6P1/4R3 b - e3 0 3"
+    };
+
+    srand(0);
+    for (int from = 0; from < 64; from++) {
+        for (int to = 0; to < 64; to++) {
+            history[from][to] = rand() % 2001 - 1000;
+        }
+    }
+
+    position *P = position_new();
+    movelist none;
+    movelist_clear(&none);
+    for (int i = 0; i < 6; i++) {
+        position_from_fen(P, fens[i]);
+        picker_walk(P, 2, &none);
+    }
+    position_free(P);
+
+    /* History saturates */
+    int16_t h = 0;
+    for (int i = 0; i < 1000; i++) history_update(&h, 1200);
+    assert(0 < h && h <= HISTORY_MAX);
+    for (int i = 0; i < 1000; i++) history_update(&h, -1200);
+    assert(-HISTORY_MAX <= h && h < 0);
+
+    return;
+}
+
+int main(void) {
+    moves_init();
+    movepick_tests();
+
+    printf("All tests passed!\n");
+
+    return 0;
+}
@@ -5,6 +5,7 @@
 
 #include "../src/position.h"
 #include "../src/moves.h"
+#include "../src/zobrist.h"
 
 #include <assert.h>
 #include <stdbool.h>
@@ -28,10 +29,309 @@ static int randrange(int lower, int upper) {
     return (n % (upper - lower + 1)) + lower;
 }
 
+/** @brief Field-by-field comparison (struct padding may differ) */
+static bool position_equal(position *A, position *B) {
+    bool same_pieces = true;
+    for (Piece p = PAWN; p <= QUEEN; p++)
+        same_pieces = same_pieces && A->pieces[p] == B->pieces[p];
+    return same_pieces && A->whose[OURS] == B->whose[OURS] 
+           && A->whose[THEIRS] == B->whose[THEIRS]
+           && A->king[OURS] == B->king[OURS] 
+           && A->king[THEIRS] == B->king[THEIRS]
+           && A->halfmoves == B->halfmoves && A->fullmoves == B->fullmoves
+           && A->castling == B->castling && A->color == B->color
+           && A->hash == B->hash && A->pawn_hash == B->pawn_hash;
+}
+
+/** @brief Walks a small tree, checking that every unmake restores the position */
+static void make_unmake_walk(position *P, int depth) {
+    if (depth == 0) return;
+    movelist M;
+    movelist_clear(&M);
+    generate_moves(&M, P);
+    for (int i = 0; i < M.size; i++) {
+        undo U;
+        position before = *P;
+        move_make(P, M.array[i], &U);
+        position_rotate(P);
+        make_unmake_walk(P, depth - 1);
+        position_rotate(P);
+        move_unmake(P, M.array[i], &U);
+        assert(position_equal(P, &before));
+    }
+
+    // Passing, when allowed, hands over the same pieces
+    if (!king_in_check(P, OURS)) {
+        undo U;
+        position before = *P;
+        move_make_null(P, &U);
+        position_rotate(P);
+        assert(P->hash == hash_position(P));
+        assert(position_get_en_passant(P, THEIRS) == INVALID_SQUARE);
+        position_rotate(P);
+        move_unmake_null(P, &U);
+        assert(position_equal(P, &before));
+    }
+}
+
+void make_unmake_tests(void) {
+    position *P = position_new();
+
+    position_init(P);
+    make_unmake_walk(P, 3);
+
+    // Castling, en passant and promotions (with and without capture)
+    position_from_fen(P, "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1");
+    make_unmake_walk(P, 2);
+    position_from_fen(P, "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1");
+    make_unmake_walk(P, 2);
+    position_from_fen(P, "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8");
+    make_unmake_walk(P, 2);
+
+    position_free(P);
+
+    return;
+}
+
+static unsigned long position_perft(position *P, int depth) {
+    if (depth == 0) return 1;
+    unsigned long nodes = 0;
+    movelist M;
+    movelist_clear(&M);
+    generate_moves(&M, P);
+    for (int i = 0; i < M.size; i++) {
+        undo U;
+        position _P = *P;
+        move_make(&_P, M.array[i], &U);
+        position_rotate(&_P);
+        nodes += position_perft(&_P, depth - 1);
+    }
+    return nodes;
+}
+
+static unsigned long board_perft(board *B, int depth) {
+    if (depth == 0) return 1;
+    unsigned long nodes = 0;
+    movelist M;
+    movelist_clear(&M);
+    generate_board_moves(&M, B);
+    for (int i = 0; i < M.size; i++) {
+        undo U;
+        board before = *B;
+        board_move_make(B, M.array[i], &U);
+        nodes += board_perft(B, depth - 1);
+        board_move_unmake(B, M.array[i], &U);
+        assert(memcmp(&before.colors, &B->colors, sizeof(B->colors)) == 0);
+        assert(memcmp(&before.pieces, &B->pieces, sizeof(B->pieces)) == 0);
+        assert(before.king[WHITE] == B->king[WHITE] && before.king[BLACK] == B->king[BLACK]);
+        assert(before.en_passant == B->en_passant && before.castling == B->castling);
+        assert(before.color == B->color && before.halfmoves == B->halfmoves);
+    }
+    return nodes;
+}
+
+/** @brief Orders moves by their bytes, to compare lists as sets */
+static int move_compare(const void *a, const void *b) {
+    return memcmp(a, b, sizeof(move));
+}
+
+/** @brief Whether a movelist holds a move */
+static bool movelist_has(movelist *M, move m) {
+    for (int i = 0; i < M->size; i++) {
+        if (memcmp(&M->array[i], &m, sizeof(move)) == 0) return true;
+    }
+    return false;
+}
+
+/** 
+ * @brief Walks a tree, checking generate_moves against the reference, and
+ * generate_captures, generate_quiets and move_is_valid against generate_moves
+ * at every node
+ * 
+ * Moves of the parent, which mostly don't belong to the node, test 
+ * move_is_valid with moves it must turn down.
+ */
+static void legal_walk(position *P, int depth, movelist *parent) {
+    movelist M, R;
+    movelist_clear(&M);
+    movelist_clear(&R);
+    generate_moves(&M, P);
+    generate_moves_reference(&R, P);
+    assert(M.size == R.size);
+    qsort(M.array, M.size, sizeof(move), move_compare);
+    qsort(R.array, R.size, sizeof(move), move_compare);
+    assert(memcmp(M.array, R.array, M.size * sizeof(move)) == 0);
+
+    // Captures and quiets split the moves between them
+    movelist C, Q;
+    movelist_clear(&C);
+    movelist_clear(&Q);
+    generate_captures(&C, P);
+    generate_quiets(&Q, P);
+    assert(C.size + Q.size == M.size);
+    for (int i = 0; i < M.size; i++) {
+        move m = M.array[i];
+        bool loud = m.flags & (M_FLAG_CAPTURE | M_FLAG_PROMOTION[KNIGHT]);
+        assert(movelist_has(loud ? &C : &Q, m));
+        // The same squares with any other flags or piece
+        for (int f = 0; f < 16; f++) {
+            move n = { m.piece, m.from, m.to, f };
+            assert(move_is_valid(P, n) == movelist_has(&M, n));
+        }
+        for (Piece p = PAWN; p <= KING; p++) {
+            move n = { p, m.from, m.to, m.flags };
+            assert(move_is_valid(P, n) == movelist_has(&M, n));
+        }
+        // The full exchange and the threshold test agree
+        int value = see(P, m);
+        for (int t = -1000; t <= 1000; t += 50) {
+            assert(see_ge(P, m, t) == (value >= t));
+        }
+        assert(see_ge(P, m, value) && !see_ge(P, m, value + 1));
+    }
+    for (int i = 0; parent != NULL && i < parent->size; i++) {
+        move m = parent->array[i];
+        assert(move_is_valid(P, m) == movelist_has(&M, m));
+    }
+
+    if (depth == 0) return;
+    for (int i = 0; i < M.size; i++) {
+        undo U;
+        position _P = *P;
+        move_make(&_P, M.array[i], &U);
+        position_rotate(&_P);
+        legal_walk(&_P, depth - 1, &M);
+    }
+}
+
+void legal_tests(void) {
+    /* Pins, checks, en passant discoveries, castling through attacks */
+    const char *fens[11] = {
+        "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+        "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+        "3k4/3p4/8/K1P4r/8/8/8/8 b - - 0 1",
+        "8/8/4k3/8/2p5/8/B2P2K1/8 w - - 0 1",
+        "8/8/1k6/2b5/2pP4/8/5K2/8 b - d3 0 1",
+        "r3k2r/8/3Q4/8/8/5q2/8/R3K2R b KQkq - 0 1",
+        "2K2r2/4P3/8/8/8/8/8/3k4 w - - 0 1",
+        "8/8/1P2K3/8/2n5/1q6/8/5k2 b - - 0 1",
+        "8/P1k5/K7/8/8/8/8/8 w - - 0 1",
+        "8/8/2k5/5q2/5n2/8/5K2/8 b - - 0 1",
+        // Black's en passant flag shares e1 with the rook, which isn't a pawn
+        "8/8/2pp4/KP5r/4Pp2/6k1/6P1/4R3 b - e3 0 3"
+    };
+
+    position *P = position_new();
+    for (int i = 0; i < 11; i++) {
+        board B;
+        position_from_fen(P, fens[i]);
+        legal_walk(P, 2, NULL);
+
+        // The board keeps en passant apart from its pieces, so it's a 
+        // reference for the position's en passant flags
+        board_from_position(&B, P);
+        assert(position_perft(P, 3) == board_perft(&B, 3));
+    }
+    position_free(P);
+
+    return;
+}
+
+void board_tests(void) {
+    /* Published perft counts, at depths that stay quick in debug builds */
+    const char *fens[6] = {
+        "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+        "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+        "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+        "r2q1rk1/pP1p2pp/Q4n2/bbp1p3/Np6/1B3NBn/pPPP1PPP/R3K2R b KQ - 0 1",
+        "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+        "K1k5/8/P7/8/8/8/8/8 w - - 0 1"
+    };
+    const int depths[6] = { 3, 2, 3, 3, 2, 6 };
+    const unsigned long counts[6] = { 8902, 2039, 2812, 9467, 1486, 2217 };
+
+    position *P = position_new();
+    for (int i = 0; i < 6; i++) {
+        board B;
+        position _P;
+        position_from_fen(P, fens[i]);
+        board_from_position(&B, P);
+        board_to_position(&_P, &B);
+        assert(position_equal(P, &_P));
+
+        assert(position_perft(P, depths[i]) == counts[i]);
+        assert(board_perft(&B, depths[i]) == counts[i]);
+    }
+    position_free(P);
+
+    return;
+}
+
+/** @brief Finds the legal move written in long algebraic notation */
+static move find_move(position *P, const char *str) {
+    movelist M;
+    movelist_clear(&M);
+    generate_moves(&M, P);
+    for (int i = 0; i < M.size; i++) {
+        char s[MOVE_STRING_SIZE];
+        if (strcmp(move_to_string(M.array[i], P->color, s), str) == 0)
+            return M.array[i];
+    }
+    assert(false);
+    return NULL_MOVE;
+}
+
+void see_tests(void) {
+    /* Exchanges, with x-rays, en passant, promotions and kings */
+    const char *fens[12] = {
+        "1k1r4/1pp4p/p7/4p3/8/P5P1/1PP4P/2K1R3 w - - 0 1",
+        "1k1r3q/1ppn3p/p4b2/4p3/8/P2N2P1/1PP1R1BP/2K1Q3 w - - 0 1",
+        "4k3/8/3p4/4p3/8/8/4Q3/4K3 w - - 0 1",
+        "4k3/4r3/8/4p3/8/8/4R3/4RK2 w - - 0 1",
+        "k3q3/4r3/8/4p3/8/8/4R3/4RK2 w - - 0 1",
+        "4k3/8/8/3pP3/8/8/8/4K3 w - d6 0 1",
+        "4k3/P7/8/8/8/8/8/4K3 w - - 0 1",
+        "1k6/P7/8/8/8/8/8/4K3 w - - 0 1",
+        "8/8/8/8/8/2k5/3r4/2Q1K3 w - - 0 1",
+        "4k3/8/8/3p4/8/8/1N6/4K3 w - - 0 1",
+        "4k3/8/8/3p4/8/8/1N6/4K3 w - - 0 1",
+        // PxQ, the bishop recaptures
+        "4k3/8/2b5/3q4/4P3/8/8/4K3 w - - 0 1"
+    };
+    const char *moves[12] = {
+        "e1e5", "d3e5", "e2e5", "e2e5", "e2e5", "e5d6", "a7a8q", "a7a8q", 
+        "c1d2", "b2c4", "b2d3", "e4d5"
+    };
+    const int values[12] = {
+        100, -220, -850, 100, -400, 100, 850, -100, 500, -320, 0, 850
+    };
+
+    position *P = position_new();
+    for (int i = 0; i < 12; i++) {
+        position_from_fen(P, fens[i]);
+        move m = find_move(P, moves[i]);
+        assert(see(P, m) == values[i]);
+        assert(see_ge(P, m, values[i]));
+        assert(!see_ge(P, m, values[i] + 1));
+        assert(see_ge(P, m, values[i] - 1));
+        assert(see_ge(P, m, 0) == (values[i] >= 0));
+    }
+
+    /* Black's exchanges, in the rotated position */
+    position_from_fen(P, "1k1r4/1pp4p/p7/4p3/4P3/P3R1P1/1PP4P/2K5 b - - 0 1");
+    assert(see(P, find_move(P, "d8d2")) == -500);
+    assert(see(P, find_move(P, "d8d4")) == 0);
+    position_free(P);
+
+    return;
+}
+
 void moves_tests(void) {
     char s[20];
     move m;
+    undo U;
     GameState G;
+    moves_init();
     position *P = position_new();
     position_clear(P);
     position_from_fen(P, "8/8/8/8/k7/4r3/2r5/K7 b - - 0 1");
@@ -61,14 +361,14 @@ void moves_tests(void) {
             m = M->array[atoi(s)];
             printf("%d: ", atoi(s));
             move_print(m, P->color);
-            move_make(P, m);
+            move_make(P, m, &U);
             position_rotate(P);
         } else if (strcmp(s, "random") == 0) {
             int k = randrange(0, M->size-1);
             m = M->array[k];
             printf("%d: ", k);
             move_print(m, P->color);
-            move_make(P, m);
+            move_make(P, m, &U);
             position_rotate(P);
         } else if (strcmp(s, "print") == 0) {
             movelist_print(M, P->color);
@@ -86,6 +386,11 @@ void moves_tests(void) {
 }
 
 int main(void) { 
+    moves_init();
+    make_unmake_tests();
+    legal_tests();
+    board_tests();
+    see_tests();
     moves_tests();
 
     printf("All tests passed!\n");
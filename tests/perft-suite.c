@@ -0,0 +1,144 @@
+/**
+ * @file perft-suite.c
+ * @brief Runs perft over an EPD file of positions with known counts.
+ * 
+ * Usage: perft-suite [-D max_depth] [-t threads] [-H megabytes] [epd]
+ *   -D    skip counts deeper than this
+ *   -t    split each tree across this many threads
+ *   -H    memoise subtree counts in a hash table of this size
+ *   epd   defaults to tests/perftsuite.epd
+ * 
+ * Each line is a FEN followed by the expected counts, e.g.
+ *   8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1 ;D1 14 ;D2 191
+ * 
+ * Prints every count with its nodes per second, and the totals. Exits with
+ * status 1 if any count is wrong. Build with `make RELEASE=1` for timings.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "../src/position.h"
+#include "../src/moves.h"
+#include "../src/perft.h"
+#include "../src/zobrist.h"
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define LINE_SIZE 512
+
+static void usage(const char *name) {
+    fprintf(stderr, "usage: %s [-D max_depth] [-t threads] [-H megabytes] "
+                    "[epd]\n", name);
+    exit(1);
+}
+
+/** @brief Parses a whole argument as a number no smaller than `min` */
+static int parse_int(const char *str, int min, const char *name) {
+    char *end;
+    long n = strtol(str, &end, 10);
+    if (*end != '\0' || n < min) usage(name);
+    return n;
+}
+
+/** @brief Seconds on a monotonic clock */
+static double seconds_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int main(int argc, char **argv) {
+    int max_depth = 64;
+    int threads = 1;
+    int megabytes = 0;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "D:t:H:")) != -1) {
+        switch (opt) {
+            case 'D': max_depth = parse_int(optarg, 1, argv[0]); break;
+            case 't': threads = parse_int(optarg, 1, argv[0]); break;
+            case 'H': megabytes = parse_int(optarg, 1, argv[0]); break;
+            default: usage(argv[0]);
+        }
+    }
+    if (optind + 1 < argc) usage(argv[0]);
+    const char *path = optind < argc ? argv[optind] : "tests/perftsuite.epd";
+
+    FILE *epd = fopen(path, "r");
+    if (epd == NULL) {
+        perror(path);
+        exit(1);
+    }
+
+    moves_init();
+    position *P = position_new();
+
+    char line[LINE_SIZE];
+    int num_positions = 0, num_counts = 0, failures = 0;
+    uint64_t total_nodes = 0;
+    double total_time = 0;
+
+    while (fgets(line, LINE_SIZE, epd) != NULL) {
+        // Split on ';' by hand, position_from_fen uses strtok itself
+        line[strcspn(line, "\r\n")] = '\0';
+        char *fen = line;
+        char *next = strchr(line, ';');
+        if (next != NULL) *next++ = '\0';
+        if (strspn(fen, " \t") == strlen(fen)) continue;
+        num_positions++;
+        printf("%d: %s\n", num_positions, fen);
+
+        while (next != NULL) {
+            char *field = next;
+            next = strchr(field, ';');
+            if (next != NULL) *next++ = '\0';
+
+            int depth;
+            uint64_t expected;
+            if (sscanf(field, " D%d %" SCNu64, &depth, &expected) != 2) {
+                fprintf(stderr, "%s: bad field \"%s\"\n", path, field);
+                exit(1);
+            }
+            if (depth > max_depth) continue;
+
+            // A fresh table per count, so every count is timed from cold
+            perft_table *T = megabytes > 0 ? perft_table_new(megabytes) : NULL;
+            position_from_fen(P, fen);
+            double start = seconds_now();
+            uint64_t nodes = threads > 1 
+                ? perft_parallel(P, depth, threads, 2, T)
+                : T != NULL ? perft_hashed(P, depth, T) : perft(P, depth);
+            double elapsed = seconds_now() - start;
+            if (T != NULL) perft_table_free(T);
+
+            num_counts++;
+            bool ok = nodes == expected;
+            if (!ok) failures++;
+            total_nodes += nodes;
+            total_time += elapsed;
+            printf("    D%-2d %12" PRIu64 " %8.3fs %12.0f nps  %s", depth, 
+                   nodes, elapsed, elapsed > 0 ? nodes / elapsed : 0.0, 
+                   ok ? "ok\n" : "FAIL");
+            if (!ok) printf(" (expected %" PRIu64 ")\n", expected);
+        }
+    }
+    fclose(epd);
+    position_free(P);
+
+    printf("\n%d positions, %" PRIu64 " nodes in %.3fs, %.0f nps\n", 
+           num_positions, total_nodes, total_time, 
+           total_time > 0 ? total_nodes / total_time : 0.0);
+    if (failures > 0) {
+        printf("%d of %d counts FAILED\n", failures, num_counts);
+        return 1;
+    }
+    printf("All counts passed!\n");
+
+    return 0;
+}
@@ -26,6 +26,14 @@ void position_tests(void) {
     position_set_castling(P, THEIRS, QUEENSIDE, false);
     position_print(P);
 
+    /* Non-pawn material, on both sides of a rotation */
+    position_from_fen(P, "4k3/pppp4/8/8/8/8/4PP2/3NK3 w - - 0 1");
+    assert(position_has_non_pawn_material(P, OURS));
+    assert(!position_has_non_pawn_material(P, THEIRS));
+    position_rotate(P);
+    assert(!position_has_non_pawn_material(P, OURS));
+    assert(position_has_non_pawn_material(P, THEIRS));
+
     position_free(P);
 
     return;
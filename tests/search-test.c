@@ -0,0 +1,193 @@
+/**
+ * @file search-test.c
+ * @brief Tests for the search interface.
+ */
+
+#define _POSIX_C_SOURCE 200809L     // nanosleep
+
+#include "../src/eval.h"
+#include "../src/moves.h"
+#include "../src/search.h"
+#include "../src/tt.h"
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+static bool move_is(position *P, move m, const char *str) {
+    char s[MOVE_STRING_SIZE];
+    return strcmp(move_to_string(m, P->color, s), str) == 0;
+}
+
+/** @brief Whether m is one of the legal moves of P */
+static bool move_is_legal(position *P, move m) {
+    movelist M;
+    movelist_clear(&M);
+    generate_moves(&M, P);
+    for (int i = 0; i < M.size; i++) {
+        move n = M.array[i];
+        if (n.piece == m.piece && n.from == m.from && n.to == m.to &&
+            n.flags == m.flags)
+            return true;
+    }
+    return false;
+}
+
+/** @brief Searches a FEN to a depth */
+static void search_fen(search *S, position *P, const char *fen, int depth,
+                       search_result *R) {
+    search_limits L;
+    memset(&L, 0, sizeof(L));
+    L.depth = depth;
+    position_from_fen(P, fen);
+    search_run(S, P, NULL, 0, &L, R);
+    return;
+}
+
+/** @brief Stops a search after a while */
+static void *stopper(void *arg) {
+    struct timespec wait = { 0, 100000000 };
+    nanosleep(&wait, NULL);
+    search_stop(arg);
+    return NULL;
+}
+
+void search_tests(void) {
+    tt *T = tt_new(16, 1);
+    search *S = search_new(T);
+    position *P = position_new();
+    search_result R;
+
+    /* Mates, by the shortest way */
+    search_fen(S, P, "6k1/5ppp/8/8/8/8/5PPP/3R2K1 w - - 0 1", 3, &R);
+    assert(move_is(P, R.best, "d1d8") && R.score == VALUE_MATE - 1);
+    search_fen(S, P, "r2qkb1r/pp2nppp/3p4/2pNN1B1/2BnP3/3P4/PPP2PPP/R2bK2R "
+                     "w KQkq - 1 1", 4, &R);
+    assert(move_is(P, R.best, "d5f6") && R.score == VALUE_MATE - 3);
+
+    /* Leaves are quiet: a defended pawn is no free capture at depth 1 */
+    search_fen(S, P, "4k3/8/3p4/4p3/8/8/4Q3/4K3 w - - 0 1", 1, &R);
+    assert(!move_is(P, R.best, "e2e5"));
+    assert(0 < R.qnodes && R.qnodes < R.nodes);
+    assert(0 < R.prefetches && R.prefetches < R.nodes);
+
+    /* Prefetching only changes the speed */
+    search_result with, without;
+    const char *middlegame = "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/"
+                             "PPPBBPPP/R3K2R w KQkq - 0 1";
+    tt_clear(T);
+    search_clear(S);
+    search_fen(S, P, middlegame, 5, &with);
+    tt_clear(T);
+    search_clear(S);
+    search_set_prefetch(S, false);
+    search_fen(S, P, middlegame, 5, &without);
+    search_set_prefetch(S, true);
+    assert(with.prefetches > 0 && without.prefetches == 0);
+    assert(without.nodes == with.nodes && without.score == with.score);
+    assert(without.best.from == with.best.from &&
+           without.best.to == with.best.to);
+
+    /* No moves, and the fifty-move rule */
+    search_fen(S, P, "6k1/5ppp/8/8/8/8/5PPP/3r2K1 w - - 0 1", 3, &R);
+    assert(R.best.from == R.best.to && R.score == -VALUE_MATE);
+    search_fen(S, P, "7k/5Q2/6K1/8/8/8/8/8 b - - 0 1", 3, &R);
+    assert(R.best.from == R.best.to && R.score == VALUE_DRAW);
+    search_fen(S, P, "8/8/8/8/8/2k5/8/K6Q w - - 99 80", 3, &R);
+    assert(R.score == VALUE_DRAW);
+    search_fen(S, P, "8/8/8/8/8/2k5/8/K6Q w - - 0 80", 3, &R);
+    assert(R.score > 800);
+
+    /* Repeating the game so far twice is a draw, even when behind */
+    const char *moves[4] = { "g1f3", "g8f6", "f3g1", "f6g8" };
+    zhash history[8];
+    position_from_fen(P, "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBN1 w Qkq "
+                         "- 0 1");
+    search_limits L;
+    memset(&L, 0, sizeof(L));
+    L.depth = 5;
+    int scores[3];
+    for (int i = 0; i <= 8; i++) {
+        if (i % 4 == 0) {
+            search_run(S, P, history, i, &L, &R);
+            scores[i / 4] = R.score;
+        }
+        if (i == 8) break;
+        movelist M;
+        movelist_clear(&M);
+        generate_moves(&M, P);
+        int j = 0;
+        while (!move_is(P, M.array[j], moves[i % 4])) j++;
+        history[i] = P->hash;
+        undo U;
+        move_make(P, M.array[j], &U);
+        position_rotate(P);
+    }
+    assert(scores[0] < -200 && scores[1] < -200 && scores[2] == VALUE_DRAW);
+
+    /* The move and the reply expected are legal */
+    const char *kiwipete = "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/"
+                           "R3K2R w KQkq - 0 1";
+    search_set_output(S, stdout);
+    search_fen(S, P, kiwipete, 6, &R);
+    search_set_output(S, NULL);
+    assert(R.depth == 6 && R.seldepth >= 6 && R.nodes > 0);
+    assert(move_is_legal(P, R.best));
+    undo U;
+    move_make(P, R.best, &U);
+    position_rotate(P);
+    assert(move_is_legal(P, R.ponder));
+    position_rotate(P);
+    move_unmake(P, R.best, &U);
+
+    /* Parameters clamp to their range, and the search still finds mates
+       with every selective step turned off: null moves need a depth no
+       search reaches, a divisor of 0 turns reductions off and both
+       futility prunings need a depth of 0 */
+    search_set_param(S, PARAM_RFP_MARGIN, 100000);
+    assert(search_get_param(S, PARAM_RFP_MARGIN)
+           == SEARCH_PARAMS[PARAM_RFP_MARGIN].max);
+    search_set_param(S, PARAM_NULL_MOVE_DEPTH, MAX_PLY);
+    assert(search_get_param(S, PARAM_NULL_MOVE_DEPTH) == MAX_PLY);
+    search_set_param(S, PARAM_LMR_BASE, SEARCH_PARAMS[PARAM_LMR_BASE].max);
+    search_set_param(S, PARAM_LMR_DIVISOR, 0);
+    assert(search_get_param(S, PARAM_LMR_DIVISOR) == 0);
+    search_set_param(S, PARAM_RFP_DEPTH, 0);
+    search_set_param(S, PARAM_FUTILITY_DEPTH, 0);
+    search_fen(S, P, "r2qkb1r/pp2nppp/3p4/2pNN1B1/2BnP3/3P4/PPP2PPP/R2bK2R "
+                     "w KQkq - 1 1", 4, &R);
+    assert(move_is(P, R.best, "d5f6") && R.score == VALUE_MATE - 3);
+    for (int p = 0; p < SEARCH_PARAM_COUNT; p++)
+        search_set_param(S, p, SEARCH_PARAMS[p].value);
+
+    /* Node limits, and stops from another thread */
+    memset(&L, 0, sizeof(L));
+    L.nodes = 20000;
+    search_run(S, P, NULL, 0, &L, &R);
+    assert(R.depth >= 1 && R.best.from != R.best.to && R.nodes <= 20000);
+
+    memset(&L, 0, sizeof(L));
+    L.infinite = true;
+    pthread_t id;
+    pthread_create(&id, NULL, stopper, S);
+    search_run(S, P, NULL, 0, &L, &R);
+    pthread_join(id, NULL);
+    assert(R.depth >= 1 && R.best.from != R.best.to);
+
+    position_free(P);
+    search_free(S);
+    tt_free(T);
+    return;
+}
+
+int main(int argc, char *argv[]) {
+    moves_init();
+    eval_init();
+    search_tests();
+
+    printf("All tests passed!\n");
+
+    return 0;
+}
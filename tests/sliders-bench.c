@@ -0,0 +1,95 @@
+/**
+ * @file sliders-bench.c
+ * @brief Micro-benchmark of the slider attack backends (rays, magics, PEXT).
+ *
+ * Build with `make RELEASE=1 PEXT=1` for meaningful numbers.
+ */
+
+#include "../src/position.h"
+#include "../src/moves.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define NUM_POSITIONS 6
+#define ITERATIONS 20000
+
+/** @brief A fixed set of positions with a spread of occupancies */
+static const char *BENCH_FENS[NUM_POSITIONS] = {
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+    "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+    "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+    "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+    "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10"
+};
+
+static const char *BACKEND_NAMES[3] = { "rays", "magic", "pext" };
+
+/** @brief Checks a backend against the rays on every lookup the bench makes */
+static void check_backend(SliderBackend backend, bitboard *occupancies) {
+    for (int p = 0; p < NUM_POSITIONS; p++) {
+        for (square s = 0; s < BITBOARD_SIZE; s++) {
+            for (Piece piece = BISHOP; piece <= ROOK; piece++) {
+                assert(slider_attacks(backend, piece, s, occupancies[p]) ==
+                       slider_attacks(SLIDER_RAYS, piece, s, occupancies[p]));
+            }
+        }
+    }
+    return;
+}
+
+/**
+ * @brief Looks up bishop and rook attacks from every square of every position
+ *
+ * @return a sum of the lookups, so they can't be optimised away
+ */
+static bitboard bench_backend(SliderBackend backend, bitboard *occupancies,
+                              double *seconds) {
+    bitboard checksum = BITBOARD_EMPTY;
+    clock_t start = clock();
+    for (int i = 0; i < ITERATIONS; i++) {
+        for (int p = 0; p < NUM_POSITIONS; p++) {
+            for (square s = 0; s < BITBOARD_SIZE; s++) {
+                checksum += slider_attacks(backend, BISHOP, s, occupancies[p]);
+                checksum += slider_attacks(backend, ROOK, s, occupancies[p]);
+            }
+        }
+    }
+    *seconds = (double) (clock() - start) / CLOCKS_PER_SEC;
+    return checksum;
+}
+
+int main(void) {
+    moves_init();
+
+    bitboard occupancies[NUM_POSITIONS];
+    position *P = position_new();
+    for (int p = 0; p < NUM_POSITIONS; p++) {
+        position_from_fen(P, BENCH_FENS[p]);
+        occupancies[p] = P->whose[OURS] | P->whose[THEIRS];
+    }
+    position_free(P);
+
+    double lookups = 2.0 * ITERATIONS * NUM_POSITIONS * BITBOARD_SIZE;
+    bitboard expected = BITBOARD_EMPTY;
+
+    printf("Move gen backend: %s\n", BACKEND_NAMES[slider_backend()]);
+    for (SliderBackend backend = SLIDER_RAYS; backend <= SLIDER_PEXT; backend++) {
+        if (!slider_backend_available(backend)) {
+            printf("%-6s unavailable\n", BACKEND_NAMES[backend]);
+            continue;
+        }
+        check_backend(backend, occupancies);
+        double seconds;
+        bitboard checksum = bench_backend(backend, occupancies, &seconds);
+        if (backend == SLIDER_RAYS) expected = checksum;
+        assert(checksum == expected);
+        printf("%-6s %8.3fs %8.2f ns/lookup\n", BACKEND_NAMES[backend],
+               seconds, seconds * 1e9 / lookups);
+    }
+
+    return 0;
+}
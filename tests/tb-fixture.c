@@ -0,0 +1,1536 @@
+/**
+ * @file tb-fixture.c
+ * @brief Writes small Syzygy tables for the tablebase tests.
+ */
+
+#include "tb-fixture.h"
+
+#include "../src/moves.h"
+#include "../src/position.h"
+#include "../src/tb.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define FX_NAME_SIZE 16
+#define FX_MAX_PIECES 5     // written
+#define FX_SOLVE_PIECES 3   // solved
+
+/** @brief Symbols of a compressed side to move, leaves included */
+#define FX_MAX_SYMBOLS 256
+#define FX_PAIR_PASSES 16
+#define FX_BLOCK_LOG 6         // 64 bytes, as small as real tables use
+#define FX_SPAN_LOG 8
+#define FX_BLOCK_VALUES 32768
+
+static const uint8_t FX_WDL_MAGIC[4] = { 0x71, 0xE8, 0x23, 0x5D };
+static const uint8_t FX_DTZ_MAGIC[4] = { 0xD7, 0x66, 0x0C, 0xA5 };
+
+/*
+ * ---------------------------------------------------------------------------
+ *                                 MATERIAL
+ * ---------------------------------------------------------------------------
+ */
+
+/**
+ * @brief Reads the pieces of a material name such as "KRvK"
+ *
+ * @param[in] name
+ * @param[out] sides pieces of each side, kings first
+ * @param[out] counts number of pieces of each side
+ *
+ * @return The number of pieces, or 0 if the name is malformed
+ */
+static int fx_parse(const char *name, Piece sides[2][FX_MAX_PIECES],
+                    int counts[2]) {
+    counts[WHITE] = counts[BLACK] = 0;
+    Color c = WHITE;
+    if (strlen(name) >= FX_NAME_SIZE) return 0;
+    for (const char *ch = name; *ch != '\0'; ch++) {
+        if (*ch == 'v') {
+            if (c == BLACK || counts[WHITE] == 0) return 0;
+            c = BLACK;
+            continue;
+        }
+        Piece p = PAWN;
+        while (p <= KING && PIECE_CHARS[WHITE][p] != *ch) p++;
+        if (p > KING || counts[WHITE] + counts[BLACK] == FX_MAX_PIECES)
+            return 0;
+        // The king first, then from the queen down to pawns
+        bool in_order = counts[c] == 0 ? p == KING
+                                       : p != KING && p <= sides[c][counts[c] - 1];
+        if (!in_order) return 0;
+        sides[c][counts[c]++] = p;
+    }
+    if (c == WHITE || counts[BLACK] == 0) return 0;
+    return counts[WHITE] + counts[BLACK];
+}
+
+/** @brief Writes the material name of a board, `first`'s pieces first */
+static void fx_name(board *B, Color first, char *name) {
+    for (int side = 0; side < 2; side++) {
+        Color c = first ^ side;
+        *name++ = PIECE_CHARS[WHITE][KING];
+        for (int p = QUEEN; p >= PAWN; p--) {
+            int n = bitboard_count_bits(B->colors[c] & B->pieces[p]);
+            for (int i = 0; i < n; i++) *name++ = PIECE_CHARS[WHITE][p];
+        }
+        if (side == 0) *name++ = 'v';
+    }
+    *name = '\0';
+    return;
+}
+
+/** @brief A bitboard upside down */
+static bitboard fx_flip_bitboard(bitboard b) {
+    bitboard flipped = BITBOARD_EMPTY;
+    while (b) flipped |= square_to_bitboard(bitboard_iter_first(&b) ^ 56);
+    return flipped;
+}
+
+/** @brief Swaps the colors of a board, flipping it upside down */
+static void fx_flip(board *B) {
+    board F = *B;
+    for (Color c = WHITE; c <= BLACK; c++) {
+        F.colors[c] = fx_flip_bitboard(B->colors[!c]);
+        F.king[c] = B->king[!c] ^ 56;
+    }
+    for (Piece p = PAWN; p < KING; p++) {
+        F.pieces[p] = fx_flip_bitboard(B->pieces[p]);
+    }
+    F.color = !B->color;
+    *B = F;
+    return;
+}
+
+/** @brief Whether a move resets the fifty-move counter */
+static bool fx_zeroing(move m) {
+    return m.piece == PAWN || (m.flags & M_FLAG_CAPTURE);
+}
+
+/*
+ * ---------------------------------------------------------------------------
+ *                                REFERENCES
+ * ---------------------------------------------------------------------------
+ *
+ * A reference of n pieces has 2 * 64^n entries, indexed as
+ *
+ *     to_move + 2 * (s_0 + 64 * (s_1 + 64 * (... + 64 * s_n-1)))
+ *
+ * with to_move 0 when white is to move and the squares of white's king and
+ * pieces, then black's, in the order of the name. Positions whose first
+ * side is black are looked up with the colors swapped and the board flipped.
+ *
+ * An entry v is 0 for draws (and impossible positions), v > 0 for a win with
+ * DTZ v, and v < 0 for a loss with DTZ -v - 1, 0 being mated.
+ */
+
+#define FX_MAGIC "monke-tb"
+#define FX_VERSION 1
+
+/** @brief Header at the start of every reference file */
+typedef struct fx_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t pieces;
+    char name[FX_NAME_SIZE];
+} fx_header;
+
+/** @brief A reference read by fx_load */
+typedef struct fx_reference {
+    char *file;
+    int8_t *values;
+} fx_reference;
+
+static fx_reference *REFERENCES = NULL;
+static int NUM_REFERENCES = 0;
+
+/** @brief Number of entries of a reference of `pieces` pieces */
+static size_t fx_entries(int pieces) {
+    return (size_t) 2 << (6 * pieces);
+}
+
+/** @brief The index of a board in the reference of its material */
+static size_t fx_index(board *B, Color first) {
+    square flip = first == WHITE ? 0 : 56;
+    size_t index = B->color != first;
+    size_t factor = 2;
+    for (int side = 0; side < 2; side++) {
+        Color c = first ^ side;
+        index += (B->king[c] ^ flip) * factor;
+        factor *= 64;
+        for (int p = QUEEN; p >= PAWN; p--) {
+            bitboard bb = B->colors[c] & B->pieces[p];
+            while (bb) {
+                index += (bitboard_iter_first(&bb) ^ flip) * factor;
+                factor *= 64;
+            }
+        }
+    }
+    return index;
+}
+
+/** @brief The values of a reference, read on first use */
+static const int8_t *fx_load(const char *path, const char *name) {
+    char *file = malloc(strlen(path) + strlen(name) + 6);
+    if (file == NULL) {
+        perror("malloc error");
+        exit(1);
+    }
+    sprintf(file, "%s/%s.mtb", path, name);
+    for (int i = 0; i < NUM_REFERENCES; i++) {
+        if (strcmp(REFERENCES[i].file, file) == 0) {
+            free(file);
+            return REFERENCES[i].values;
+        }
+    }
+
+    Piece sides[2][FX_MAX_PIECES];
+    int counts[2];
+    int pieces = fx_parse(name, sides, counts);
+    FILE *in = fopen(file, "rb");
+    if (pieces == 0 || pieces > FX_SOLVE_PIECES || in == NULL) {
+        if (in != NULL) fclose(in);
+        free(file);
+        return NULL;
+    }
+    fx_header H;
+    size_t entries = fx_entries(pieces);
+    int8_t *values = malloc(entries);
+    if (values == NULL) {
+        perror("malloc error");
+        exit(1);
+    }
+    bool ok = fread(&H, sizeof(H), 1, in) == 1 &&
+              memcmp(H.magic, FX_MAGIC, sizeof(H.magic)) == 0 &&
+              H.version == FX_VERSION && H.pieces == (uint32_t) pieces &&
+              fread(values, 1, entries, in) == entries;
+    fclose(in);
+    if (!ok) {
+        fprintf(stderr, "%s: not a reference file\n", file);
+        free(file);
+        free(values);
+        return NULL;
+    }
+
+    REFERENCES = realloc(REFERENCES, (NUM_REFERENCES + 1) * sizeof(fx_reference));
+    if (REFERENCES == NULL) {
+        perror("malloc error");
+        exit(1);
+    }
+    REFERENCES[NUM_REFERENCES].file = file;
+    REFERENCES[NUM_REFERENCES++].values = values;
+    return values;
+}
+
+void tb_fixture_free(void) {
+    for (int i = 0; i < NUM_REFERENCES; i++) {
+        free(REFERENCES[i].file);
+        free(REFERENCES[i].values);
+    }
+    free(REFERENCES);
+    REFERENCES = NULL;
+    NUM_REFERENCES = 0;
+    return;
+}
+
+/**
+ * @brief The entry of a board in the references of `path`
+ *
+ * Bare kings and a lone minor piece against a king are draws without one.
+ */
+static bool fx_lookup(const char *path, board *B, int8_t *v) {
+    int pieces = bitboard_count_bits(B->colors[WHITE] | B->colors[BLACK]);
+    if (pieces == 2 ||
+        (pieces == 3 && (B->pieces[KNIGHT] | B->pieces[BISHOP]) != 0)) {
+        *v = 0;
+        return true;
+    }
+    char name[FX_NAME_SIZE];
+    for (Color first = WHITE; first <= BLACK; first++) {
+        fx_name(B, first, name);
+        const int8_t *values = fx_load(path, name);
+        if (values != NULL) {
+            *v = values[fx_index(B, first)];
+            return true;
+        }
+    }
+    return false;
+}
+
+/** @brief The result of an entry */
+static int fx_wdl(int8_t v) {
+    return v > 0 ? TB_WIN : v < 0 ? TB_LOSS : TB_DRAW;
+}
+
+/** @brief The DTZ of an entry, as the files count it: mated is -1 */
+static int fx_dtz(int8_t v) {
+    return v >= 0 ? v : v < -1 ? v + 1 : -1;
+}
+
+bool tb_fixture_probe(const char *path, position *P, int *wdl, int *dtz) {
+    board B;
+    int8_t v;
+    board_from_position(&B, P);
+    if (!fx_lookup(path, &B, &v)) return false;
+    *wdl = fx_wdl(v);
+    *dtz = fx_dtz(v);
+    return true;
+}
+
+/* --- Retrograde analysis --- */
+
+/*
+ * Pawn moves are irreversible, so positions are split into slices by how far
+ * their pawns have advanced, and slices are solved from the most advanced:
+ * every pawn move leads into a slice solved already, as every capture leads
+ * into another reference. Within a slice, only the moves of pieces are left,
+ * and the n-th pass finds the positions with DTZ n from those found before.
+ */
+
+#define FX_NO_ZEROING -2
+
+/**
+ * @brief Places the pieces of an index on a board
+ *
+ * @return The slice of the position, or -1 if it is impossible
+ */
+static int fx_unindex(size_t index, Piece sides[2][FX_MAX_PIECES],
+                      int counts[2], board *B) {
+    memset(B, 0, sizeof(board));
+    B->color = index % 2 == 0 ? WHITE : BLACK;
+    B->en_passant = INVALID_SQUARE;
+    B->fullmoves = 1;
+    index /= 2;
+
+    int slice = 0;
+    for (Color c = WHITE; c <= BLACK; c++) {
+        for (int i = 0; i < counts[c]; i++) {
+            square s = index % 64;
+            index /= 64;
+            bitboard b = square_to_bitboard(s);
+            if ((B->colors[WHITE] | B->colors[BLACK]) & b) return -1;
+            B->colors[c] |= b;
+            if (sides[c][i] == KING) {
+                B->king[c] = s;
+                continue;
+            }
+            B->pieces[sides[c][i]] |= b;
+            if (sides[c][i] == PAWN) {
+                if (s / 8 == 0 || s / 8 == 7) return -1;
+                slice += c == WHITE ? s / 8 : 7 - s / 8;
+            }
+        }
+    }
+    return slice;
+}
+
+/** @brief Plies to zeroing of an entry, whatever its result */
+static int fx_distance(int8_t v) {
+    return v >= 0 ? v : -v - 1;
+}
+
+/**
+ * @brief Solves the positions of a slice, see tb_fixture_generate
+ *
+ * @param[in] path
+ * @param[in] name
+ * @param[in,out] values entries of the reference, final for the slices solved
+ * @param[in,out] solved whether each entry is final
+ * @param[in] positions indices of the possible positions of the slice
+ * @param[in] n number of positions
+ *
+ * @return false if a reference that captures or promotions lead to is missing
+ */
+static bool fx_solve_slice(const char *path, const char *name, int8_t *values,
+                           uint8_t *solved, const uint32_t *positions,
+                           size_t n) {
+    Piece sides[2][FX_MAX_PIECES];
+    int counts[2];
+    fx_parse(name, sides, counts);
+
+    // Best result over the zeroing moves, and the children of other moves
+    int8_t *zeroing = malloc(n);
+    uint32_t *first_child = malloc((n + 1) * sizeof(uint32_t));
+    size_t capacity = 16 * n + 1, size = 0;
+    uint32_t *children = malloc(capacity * sizeof(uint32_t));
+    if (zeroing == NULL || first_child == NULL || children == NULL) {
+        perror("malloc error");
+        exit(1);
+    }
+
+    bool ok = true;
+    for (size_t i = 0; i < n && ok; i++) {
+        board B;
+        position P;
+        fx_unindex(positions[i], sides, counts, &B);
+        board_to_position(&P, &B);
+
+        movelist M;
+        movelist_clear(&M);
+        generate_moves(&M, &P);
+        first_child[i] = size;
+        zeroing[i] = FX_NO_ZEROING;
+        for (int j = 0; j < M.size && ok; j++) {
+            undo U;
+            move_make(&P, M.array[j], &U);
+            position_rotate(&P);
+            board child;
+            board_from_position(&child, &P);
+
+            if (!fx_zeroing(M.array[j])) {
+                if (size == capacity) {
+                    capacity *= 2;
+                    children = realloc(children, capacity * sizeof(uint32_t));
+                    if (children == NULL) {
+                        perror("malloc error");
+                        exit(1);
+                    }
+                }
+                children[size++] = fx_index(&child, WHITE);
+            } else {
+                // Into a slice solved before, or into another reference
+                char child_name[FX_NAME_SIZE];
+                fx_name(&child, WHITE, child_name);
+                int8_t v = 0;
+                if (strcmp(child_name, name) == 0) {
+                    v = values[fx_index(&child, WHITE)];
+                } else if (!fx_lookup(path, &child, &v)) {
+                    fprintf(stderr, "%s: needs the reference of %s\n", name,
+                            child_name);
+                    ok = false;
+                }
+                if (-fx_wdl(v) > zeroing[i]) zeroing[i] = -fx_wdl(v);
+            }
+            position_rotate(&P);
+            move_unmake(&P, M.array[j], &U);
+        }
+
+        if (M.size == 0) {
+            values[positions[i]] = king_in_check(&P, OURS) ? -1 : 0;
+            solved[positions[i]] = true;
+        } else if (zeroing[i] == TB_WIN) {
+            values[positions[i]] = 1;
+            solved[positions[i]] = true;
+        }
+    }
+    first_child[n] = size;
+
+    /*
+     * Pass n finds DTZ n from the children found by earlier passes. Zeroing
+     * wins, found above with DTZ 1, only count from the second pass.
+     */
+    for (int pass = 1; ok; pass++) {
+        bool changed = false;
+        for (size_t i = 0; i < n; i++) {
+            if (solved[positions[i]]) continue;
+            bool win = false, loss = zeroing[i] <= TB_LOSS;
+            for (uint32_t j = first_child[i]; j < first_child[i + 1]; j++) {
+                uint32_t c = children[j];
+                if (!solved[c] || fx_distance(values[c]) >= pass) {
+                    loss = false;
+                    continue;
+                }
+                if (values[c] < 0) win = true;
+                if (values[c] <= 0) loss = false;
+            }
+            if (win || loss) {
+                values[positions[i]] = win ? pass : -pass - 1;
+                solved[positions[i]] = true;
+                changed = true;
+            }
+        }
+        if (!changed && pass >= 2) break;
+        if (pass == INT8_MAX - 1) {
+            fprintf(stderr, "%s: distance to zeroing overflows\n", name);
+            ok = false;
+        }
+    }
+
+    // Whatever neither side can force is a draw
+    for (size_t i = 0; i < n; i++) solved[positions[i]] = true;
+
+    free(zeroing);
+    free(first_child);
+    free(children);
+    return ok;
+}
+
+/** @brief Solves a material into the entries of its reference */
+static int8_t *fx_solve(const char *path, const char *name, int pieces) {
+    Piece sides[2][FX_MAX_PIECES];
+    int counts[2];
+    fx_parse(name, sides, counts);
+
+    size_t entries = fx_entries(pieces);
+    int8_t *values = calloc(entries, 1);
+    uint8_t *solved = calloc(entries, 1);
+    int8_t *slices = malloc(entries);
+    uint32_t *positions = malloc(entries * sizeof(uint32_t));
+    if (values == NULL || solved == NULL || slices == NULL ||
+        positions == NULL) {
+        perror("malloc error");
+        exit(1);
+    }
+
+    // Possible positions: nothing shares a square, and no king can be taken
+    int max_slice = 0;
+    for (size_t index = 0; index < entries; index++) {
+        board B;
+        position P;
+        slices[index] = fx_unindex(index, sides, counts, &B);
+        if (slices[index] < 0) continue;
+        board_to_position(&P, &B);
+        if (king_in_check(&P, THEIRS)) slices[index] = -1;
+        if (slices[index] > max_slice) max_slice = slices[index];
+    }
+
+    bool ok = true;
+    for (int slice = max_slice; slice >= 0 && ok; slice--) {
+        size_t n = 0;
+        for (size_t index = 0; index < entries; index++) {
+            if (slices[index] == slice) positions[n++] = index;
+        }
+        ok = fx_solve_slice(path, name, values, solved, positions, n);
+    }
+
+    free(solved);
+    free(slices);
+    free(positions);
+    if (!ok) {
+        free(values);
+        return NULL;
+    }
+    return values;
+}
+
+/*
+ * ---------------------------------------------------------------------------
+ *                                  INDEXING
+ * ---------------------------------------------------------------------------
+ *
+ * The index of a position in the files, worked out from the rules of the
+ * format rather than shared with tb.c: the reader's tables are rebuilt here
+ * from their definitions.
+ */
+
+/** @brief Ways to choose k of n */
+static uint64_t fx_binomial(int n, int k) {
+    if (k < 0 || n < k) return 0;
+    uint64_t r = 1;
+    for (int i = 0; i < k; i++) r = r * (n - i) / (i + 1);
+    return r;
+}
+
+/** @brief Pawn squares from 47 for a2, h2, a3, h3, ... down to 0 for e7 */
+static int fx_pawn_rank(square s) {
+    int f = s % 8, pair = f < 4 ? f : 7 - f;
+    return 47 - (12 * pair + 2 * (s / 8 - 1) + (f > 3));
+}
+
+/** @brief Slots of `lead` leading pawns with the first on a file, below rank */
+static uint64_t fx_lead_pawns(int lead, int f, int below) {
+    uint64_t n = 0;
+    for (int r = 1; r < below; r++) {
+        n += fx_binomial(fx_pawn_rank(8 * r + f), lead - 1);
+    }
+    return n;
+}
+
+/** @brief The a1-d1-d4 triangle: below the diagonal first, then on it */
+static const square FX_TRIANGLE[10] = { 1, 2, 3, 10, 11, 19, 0, 9, 18, 27 };
+
+static int fx_triangle(square s) {
+    for (int i = 0; i < 10; i++) {
+        if (FX_TRIANGLE[i] == s) return i;
+    }
+    return -1;
+}
+
+/** @brief Squares below the a1-h8 diagonal, counted from b1 */
+static int fx_below_diagonal(square s) {
+    int n = 0;
+    for (square t = 0; t < s; t++) n += t / 8 < t % 8;
+    return n;
+}
+
+static int fx_diagonal(square s) {
+    return (int) (s / 8) - (int) (s % 8);
+}
+
+/** @brief Two kings, the first in the triangle, both on the diagonal last */
+static int FX_KINGS[64][64];
+
+static void fx_init_kings(void) {
+    int code = 0;
+    for (int last = 0; last < 2; last++) {
+        for (int t = 0; t < 10; t++) {
+            square s1 = FX_TRIANGLE[t];
+            for (square s2 = 0; s2 < 64; s2++) {
+                int ranks = s1 / 8 - s2 / 8, files = s1 % 8 - s2 % 8;
+                if (ranks * ranks <= 1 && files * files <= 1) continue;
+                if (fx_diagonal(s1) == 0 && fx_diagonal(s2) > 0) continue;
+                bool both = fx_diagonal(s1) == 0 && fx_diagonal(s2) == 0;
+                if (both != (last == 1)) continue;
+                FX_KINGS[s1][s2] = code++;
+            }
+        }
+    }
+    return;
+}
+
+/** @brief How a side to move of a file lists and groups its pieces */
+typedef struct fx_layout {
+    int n;
+    uint8_t codes[FX_MAX_PIECES];
+    int groups;
+    int group_len[FX_MAX_PIECES];
+    uint64_t factor[FX_MAX_PIECES];
+    int order[2];           // slots of the leading group and other pawns
+    uint64_t size;
+} fx_layout;
+
+/** @brief A material being written */
+typedef struct fx_table {
+    char name[FX_NAME_SIZE];
+    int n;
+    uint8_t codes[FX_MAX_PIECES];   // in the order of the files
+    bool pawns, unique, symmetric;
+    int lead;                       // pieces in the leading group
+    int other_pawns;                // pawns of the other color
+    int files, sides;
+    fx_layout layouts[2][4];
+} fx_table;
+
+/** @brief Sets up the pieces of a material in the order they are written */
+static bool fx_table_init(fx_table *T, const char *name) {
+    Piece sides[2][FX_MAX_PIECES];
+    int counts[2];
+    T->n = fx_parse(name, sides, counts);
+    if (T->n == 0) return false;
+    strcpy(T->name, name);
+
+    int pieces[2][6] = { { 0 } };
+    for (Color c = WHITE; c <= BLACK; c++) {
+        for (int i = 0; i < counts[c]; i++) pieces[c][sides[c][i]]++;
+    }
+    T->pawns = pieces[WHITE][PAWN] + pieces[BLACK][PAWN] > 0;
+    T->unique = false;
+    T->symmetric = memcmp(pieces[WHITE], pieces[BLACK], sizeof(pieces[0])) == 0;
+    for (Color c = WHITE; c <= BLACK; c++) {
+        for (Piece p = PAWN; p < KING; p++) T->unique |= pieces[c][p] == 1;
+    }
+
+    // Leading pawns: the color with fewer, white if as many
+    int k = 0;
+    Color lead = pieces[BLACK][PAWN] > 0 &&
+                 (pieces[WHITE][PAWN] == 0 ||
+                  pieces[BLACK][PAWN] < pieces[WHITE][PAWN]) ? BLACK : WHITE;
+    T->other_pawns = 0;
+    if (T->pawns) {
+        for (int i = 0; i < pieces[lead][PAWN]; i++) {
+            T->codes[k++] = 1 | (lead == BLACK ? 8 : 0);
+        }
+        T->lead = k;
+        T->other_pawns = pieces[!lead][PAWN];
+        for (int i = 0; i < T->other_pawns; i++) {
+            T->codes[k++] = 1 | (lead == BLACK ? 0 : 8);
+        }
+    }
+    // Then the kings, and the rest from the fewest of a kind
+    T->codes[k++] = 6;
+    T->codes[k++] = 6 | 8;
+    for (int count = 1; count <= FX_MAX_PIECES; count++) {
+        for (Color c = WHITE; c <= BLACK; c++) {
+            for (Piece p = KNIGHT; p < KING; p++) {
+                if (pieces[c][p] != count) continue;
+                for (int i = 0; i < count; i++) {
+                    T->codes[k++] = (p + 1) | (c == BLACK ? 8 : 0);
+                }
+            }
+        }
+    }
+    if (!T->pawns) T->lead = T->unique ? 3 : 2;
+    T->files = T->pawns ? 4 : 1;
+    T->sides = T->symmetric ? 1 : 2;
+
+    // The first side lists the leading group first, the second last
+    for (int side = 0; side < 2; side++) {
+        for (int f = 0; f < T->files; f++) {
+            fx_layout *L = &T->layouts[side][f];
+            L->n = T->n;
+            memcpy(L->codes, T->codes, sizeof(T->codes));
+            L->groups = 0;
+            L->group_len[L->groups++] = T->lead;
+            for (int i = T->lead; i < T->n; i++) {
+                if (i > T->lead && T->codes[i] == T->codes[i - 1]) {
+                    L->group_len[L->groups - 1]++;
+                } else {
+                    L->group_len[L->groups++] = 1;
+                }
+            }
+            int fixed = T->other_pawns > 0 ? 2 : 1;
+            L->order[0] = side == 0 ? 0 : L->groups - 1;
+            L->order[1] = T->other_pawns == 0 ? 0xF
+                        : side == 0 ? 1 : L->groups - 2;
+
+            uint64_t sizes[FX_MAX_PIECES];
+            sizes[0] = T->pawns ? fx_lead_pawns(T->lead, f, 7)
+                     : T->unique ? 31332 : 462;
+            if (T->other_pawns > 0) {
+                sizes[1] = fx_binomial(48 - T->lead, L->group_len[1]);
+            }
+            int free_squares = 64 - T->lead - T->other_pawns;
+            for (int g = fixed; g < L->groups; g++) {
+                sizes[g] = fx_binomial(free_squares, L->group_len[g]);
+                free_squares -= L->group_len[g];
+            }
+            // Slots in order, the other groups filling those left
+            L->size = 1;
+            int g = fixed;
+            for (int slot = 0; slot < L->groups; slot++) {
+                int group = slot == L->order[0] ? 0
+                          : slot == L->order[1] ? 1 : g++;
+                L->factor[group] = L->size;
+                L->size *= sizes[group];
+            }
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief The file and index of a position
+ *
+ * @param[in] T
+ * @param[in] side side to move, in the colors of the files
+ * @param[in] codes pieces in the order of T->codes
+ * @param[in] placed their squares
+ * @param[out] f leading pawn file
+ */
+static uint64_t fx_encode(fx_table *T, int side, const square *placed, int *f) {
+    square sq[FX_MAX_PIECES];
+    memcpy(sq, placed, T->n * sizeof(square));
+
+    // The leading piece: the most advanced leading pawn, or the first
+    *f = 0;
+    if (T->pawns) {
+        for (int i = 1; i < T->lead; i++) {
+            if (fx_pawn_rank(sq[i]) > fx_pawn_rank(sq[0])) {
+                square s = sq[0];
+                sq[0] = sq[i];
+                sq[i] = s;
+            }
+        }
+        *f = sq[0] % 8 < 4 ? sq[0] % 8 : 7 - sq[0] % 8;
+    }
+    if (sq[0] % 8 > 3) {
+        for (int i = 0; i < T->n; i++) sq[i] = sq[i] ^ 7;
+    }
+    if (!T->pawns && sq[0] / 8 > 3) {
+        for (int i = 0; i < T->n; i++) sq[i] = sq[i] ^ 56;
+    }
+    if (!T->pawns) {
+        int i = 0;
+        while (i < T->lead && fx_diagonal(sq[i]) == 0) i++;
+        if (i < T->lead && fx_diagonal(sq[i]) > 0) {
+            for (int j = 0; j < T->n; j++) {
+                sq[j] = (square) (8 * (sq[j] % 8) + sq[j] / 8);
+            }
+        }
+    }
+
+    // Within each group, from the lowest square (or pawn rank) up
+    const fx_layout *L = &T->layouts[side][*f];
+    int start = T->pawns ? 1 : T->lead;
+    for (int g = 0, first = 0; g < L->groups; first += L->group_len[g++]) {
+        int from = g == 0 ? start : first, to = first + L->group_len[g];
+        for (int i = from; i < to; i++) {
+            for (int j = i + 1; j < to; j++) {
+                bool later = g == 0 ? fx_pawn_rank(sq[j]) < fx_pawn_rank(sq[i])
+                                    : sq[j] < sq[i];
+                if (later) {
+                    square s = sq[i];
+                    sq[i] = sq[j];
+                    sq[j] = s;
+                }
+            }
+        }
+    }
+
+    uint64_t lead;
+    if (T->pawns) {
+        lead = fx_lead_pawns(T->lead, *f, sq[0] / 8);
+        for (int i = 1; i < T->lead; i++) {
+            lead += fx_binomial(fx_pawn_rank(sq[i]), i);
+        }
+    } else if (!T->unique) {
+        lead = FX_KINGS[sq[0]][sq[1]];
+    } else {
+        // The first of the three off the diagonal picks the formula
+        int r0 = sq[0] / 8, r1 = sq[1] / 8 - (sq[1] > sq[0]);
+        int s1 = sq[1] - (sq[1] > sq[0]);
+        int s2 = sq[2] - (sq[2] > sq[0]) - (sq[2] > sq[1]);
+        int r2 = sq[2] / 8 - (sq[2] > sq[0]) - (sq[2] > sq[1]);
+        if (fx_diagonal(sq[0]) != 0) {
+            lead = (uint64_t) (fx_triangle(sq[0]) * 63 + s1) * 62 + s2;
+        } else if (fx_diagonal(sq[1]) != 0) {
+            lead = (uint64_t) (6 * 63 + r0 * 28 + fx_below_diagonal(sq[1])) *
+                   62 + s2;
+        } else if (fx_diagonal(sq[2]) != 0) {
+            lead = 6 * 63 * 62 + 4 * 28 * 62 + r0 * 7 * 28 + r1 * 28 +
+                   fx_below_diagonal(sq[2]);
+        } else {
+            lead = 6 * 63 * 62 + 4 * 28 * 62 + 4 * 7 * 28 + r0 * 7 * 6 +
+                   r1 * 6 + r2;
+        }
+    }
+
+    uint64_t idx = lead * L->factor[0];
+    for (int g = 1, first = L->group_len[0]; g < L->groups;
+         first += L->group_len[g++]) {
+        bool pawns = g == 1 && T->other_pawns > 0;
+        uint64_t n = 0;
+        for (int i = 0; i < L->group_len[g]; i++) {
+            int s = sq[first + i] - (pawns ? 8 : 0);
+            for (int k = 0; k < first; k++) s -= sq[k] < sq[first + i];
+            n += fx_binomial(s, i + 1);
+        }
+        idx += n * L->factor[g];
+    }
+    return idx;
+}
+
+/*
+ * ---------------------------------------------------------------------------
+ *                                COMPRESSION
+ * ---------------------------------------------------------------------------
+ *
+ * Values are paired greedily, the most frequent adjacent pair of symbols
+ * becoming a new symbol a number of times, then coded with Huffman codes,
+ * canonical in the way the files order them: longer codes first.
+ */
+
+/** @brief A growing byte buffer */
+typedef struct fx_buffer {
+    uint8_t *bytes;
+    size_t size, capacity;
+} fx_buffer;
+
+static void fx_put(fx_buffer *F, const void *bytes, size_t n) {
+    if (F->size + n > F->capacity) {
+        F->capacity = 2 * (F->size + n) + 64;
+        F->bytes = realloc(F->bytes, F->capacity);
+        if (F->bytes == NULL) {
+            perror("malloc error");
+            exit(1);
+        }
+    }
+    if (bytes != NULL) {
+        memcpy(F->bytes + F->size, bytes, n);
+    } else {
+        memset(F->bytes + F->size, 0, n);
+    }
+    F->size += n;
+    return;
+}
+
+static void fx_put8(fx_buffer *F, unsigned v) {
+    uint8_t b = (uint8_t) v;
+    fx_put(F, &b, 1);
+    return;
+}
+
+static void fx_put16(fx_buffer *F, unsigned v) {
+    fx_put8(F, v & 0xFF);
+    fx_put8(F, (v >> 8) & 0xFF);
+    return;
+}
+
+static void fx_put32(fx_buffer *F, uint32_t v) {
+    fx_put16(F, v & 0xFFFF);
+    fx_put16(F, v >> 16);
+    return;
+}
+
+/** @brief Pads with zeros to a multiple of `n` bytes */
+static void fx_align(fx_buffer *F, size_t n) {
+    fx_put(F, NULL, (n - F->size % n) % n);
+    return;
+}
+
+/** @brief The sections of a compressed side to move */
+typedef struct fx_pairs {
+    fx_buffer sizes, sparse, lengths, data;
+} fx_pairs;
+
+static void fx_pairs_free(fx_pairs *C) {
+    free(C->sizes.bytes);
+    free(C->sparse.bytes);
+    free(C->lengths.bytes);
+    free(C->data.bytes);
+    memset(C, 0, sizeof(fx_pairs));
+    return;
+}
+
+/** @brief Code lengths of symbols of given frequencies */
+static void fx_huffman(const uint64_t *frequency, int n, int *length) {
+    uint64_t weight[2 * FX_MAX_SYMBOLS];
+    int parent[2 * FX_MAX_SYMBOLS];
+    bool merged[2 * FX_MAX_SYMBOLS] = { false };
+    memcpy(weight, frequency, n * sizeof(uint64_t));
+    for (int node = n; node < 2 * n - 1; node++) {
+        int a = -1, b = -1;
+        for (int i = 0; i < node; i++) {
+            if (merged[i]) continue;
+            if (a < 0 || weight[i] < weight[a]) {
+                b = a;
+                a = i;
+            } else if (b < 0 || weight[i] < weight[b]) {
+                b = i;
+            }
+        }
+        merged[a] = merged[b] = true;
+        weight[node] = weight[a] + weight[b];
+        parent[a] = parent[b] = node;
+    }
+    for (int i = 0; i < n; i++) {
+        length[i] = 0;
+        for (int node = i; node != 2 * n - 2; node = parent[node]) length[i]++;
+    }
+    return;
+}
+
+/** @brief Compresses the values of a side to move, flags included */
+static void fx_compress(const uint16_t *values, uint64_t n, uint8_t flags,
+                        fx_pairs *C) {
+    memset(C, 0, sizeof(fx_pairs));
+    bool single = true;
+    for (uint64_t i = 1; i < n && single; i++) single = values[i] == values[0];
+    if (single && values[0] < 256) {
+        fx_put8(&C->sizes, flags | 128);
+        fx_put8(&C->sizes, values[0]);
+        return;
+    }
+
+    // A leaf for each value, then pairs
+    int symbols = 0;
+    int left[FX_MAX_SYMBOLS], right[FX_MAX_SYMBOLS], span[FX_MAX_SYMBOLS];
+    int leaf[4096];
+    for (int v = 0; v < 4096; v++) leaf[v] = -1;
+    uint16_t *seq = malloc(n * sizeof(uint16_t));
+    uint32_t *pairs = malloc(FX_MAX_SYMBOLS * FX_MAX_SYMBOLS * sizeof(uint32_t));
+    if (seq == NULL || pairs == NULL) {
+        perror("malloc error");
+        exit(1);
+    }
+    for (uint64_t i = 0; i < n; i++) {
+        if (leaf[values[i]] < 0) {
+            left[symbols] = values[i];
+            right[symbols] = -1;
+            span[symbols] = 0;
+            leaf[values[i]] = symbols++;
+        }
+        seq[i] = leaf[values[i]];
+    }
+    uint64_t m = n;
+    for (int pass = 0; pass < FX_PAIR_PASSES && symbols < FX_MAX_SYMBOLS;
+         pass++) {
+        memset(pairs, 0, FX_MAX_SYMBOLS * FX_MAX_SYMBOLS * sizeof(uint32_t));
+        for (uint64_t i = 0; i + 1 < m; i++) {
+            pairs[seq[i] * FX_MAX_SYMBOLS + seq[i + 1]]++;
+        }
+        int best = -1;
+        for (int a = 0; a < symbols; a++) {
+            for (int b = 0; b < symbols; b++) {
+                int p = a * FX_MAX_SYMBOLS + b;
+                if (span[a] + span[b] + 1 > 255) continue;
+                if (pairs[p] >= 16 && (best < 0 || pairs[p] > pairs[best]))
+                    best = p;
+            }
+        }
+        if (best < 0) break;
+        int a = best / FX_MAX_SYMBOLS, b = best % FX_MAX_SYMBOLS;
+        left[symbols] = a;
+        right[symbols] = b;
+        span[symbols] = span[a] + span[b] + 1;
+        uint64_t j = 0;
+        for (uint64_t i = 0; i < m; j++) {
+            if (i + 1 < m && seq[i] == a && seq[i + 1] == b) {
+                seq[j] = symbols;
+                i += 2;
+            } else {
+                seq[j] = seq[i++];
+            }
+        }
+        m = j;
+        symbols++;
+    }
+    free(pairs);
+
+    // Code lengths, flattened until they fit in 32 bits
+    uint64_t frequency[FX_MAX_SYMBOLS] = { 0 };
+    int length[FX_MAX_SYMBOLS];
+    for (uint64_t i = 0; i < m; i++) frequency[seq[i]]++;
+    for (int s = 0; s < symbols; s++) frequency[s]++;
+    while (true) {
+        fx_huffman(frequency, symbols, length);
+        int longest = 0;
+        for (int s = 0; s < symbols; s++) {
+            if (length[s] > longest) longest = length[s];
+        }
+        if (longest <= 32) break;
+        for (int s = 0; s < symbols; s++) frequency[s] = frequency[s] / 2 + 1;
+    }
+    int min_len = 64, max_len = 0;
+    for (int s = 0; s < symbols; s++) {
+        if (length[s] < min_len) min_len = length[s];
+        if (length[s] > max_len) max_len = length[s];
+    }
+
+    // Ids from the longest codes down, codes from the longest up
+    int id[FX_MAX_SYMBOLS], next = 0;
+    int lowest[33], count[34] = { 0 };
+    uint64_t base[34];
+    for (int len = max_len; len >= min_len; len--) {
+        lowest[len] = next;
+        for (int s = 0; s < symbols; s++) {
+            if (length[s] == len) id[s] = next++;
+        }
+        count[len] = next - lowest[len];
+    }
+    base[max_len] = 0;
+    for (int len = max_len - 1; len >= min_len; len--) {
+        base[len] = (base[len + 1] + count[len + 1]) / 2;
+    }
+
+    // Blocks of whole symbols
+    size_t block_size = (size_t) 1 << FX_BLOCK_LOG;
+    uint64_t span_values = (uint64_t) 1 << FX_SPAN_LOG;
+    uint64_t *starts = malloc((m + 1) * sizeof(uint64_t));
+    if (starts == NULL) {
+        perror("malloc error");
+        exit(1);
+    }
+    uint32_t blocks = 0;
+    uint64_t value = 0, bits = 0, in_block = 0;
+    uint8_t *block = calloc(block_size, 1);
+    for (uint64_t i = 0; i <= m; i++) {
+        int s = i < m ? seq[i] : 0;
+        bool full = i == m || bits + length[s] > 8 * block_size ||
+                    in_block + span[s] + 1 > FX_BLOCK_VALUES;
+        if (full && in_block > 0) {
+            fx_put(&C->data, block, block_size);
+            fx_put16(&C->lengths, (unsigned) (in_block - 1));
+            memset(block, 0, block_size);
+            bits = in_block = 0;
+        }
+        if (i == m) break;
+        if (in_block == 0) starts[blocks++] = value;
+        uint64_t code = base[length[s]] + (id[s] - lowest[length[s]]);
+        for (int b = length[s] - 1; b >= 0; b--, bits++) {
+            if ((code >> b) & 1) block[bits / 8] |= 0x80 >> (bits % 8);
+        }
+        in_block += span[s] + 1;
+        value += span[s] + 1;
+    }
+    free(block);
+
+    // Every span values, the block and offset of the middle one
+    for (uint64_t k = 0; k * span_values < n; k++) {
+        uint64_t t = k * span_values + span_values / 2;
+        uint32_t b = 0;
+        while (b + 1 < blocks && starts[b + 1] <= t) b++;
+        fx_put32(&C->sparse, b);
+        fx_put16(&C->sparse, (unsigned) (t - starts[b]));
+    }
+    free(starts);
+    free(seq);
+
+    fx_put8(&C->sizes, flags);
+    fx_put8(&C->sizes, FX_BLOCK_LOG);
+    fx_put8(&C->sizes, FX_SPAN_LOG);
+    fx_put8(&C->sizes, 0);
+    fx_put32(&C->sizes, blocks);
+    fx_put8(&C->sizes, max_len);
+    fx_put8(&C->sizes, min_len);
+    for (int len = min_len; len <= max_len; len++) fx_put16(&C->sizes, lowest[len]);
+    fx_put16(&C->sizes, symbols);
+    int by_id[FX_MAX_SYMBOLS];
+    for (int s = 0; s < symbols; s++) by_id[id[s]] = s;
+    for (int i = 0; i < symbols; i++) {
+        int s = by_id[i];
+        int l = right[s] < 0 ? left[s] : id[left[s]];
+        int r = right[s] < 0 ? 0xFFF : id[right[s]];
+        fx_put8(&C->sizes, l & 0xFF);
+        fx_put8(&C->sizes, (l >> 8) | ((r & 0xF) << 4));
+        fx_put8(&C->sizes, r >> 4);
+    }
+    if (symbols & 1) fx_put8(&C->sizes, 0);
+    return;
+}
+
+/*
+ * ---------------------------------------------------------------------------
+ *                                  WRITING
+ * ---------------------------------------------------------------------------
+ */
+
+/** @brief Gives the result (and DTZ) of a position, see fx_write */
+typedef bool (*fx_source)(const char *path, board *B, int *wdl, int *dtz);
+
+/** @brief Values of every index of a material, by side to move and file */
+typedef struct fx_values {
+    int8_t *wdl[2][4];      // INT8_MIN where no position lands
+    int16_t *dtz[2][4];
+} fx_values;
+
+/** @brief State of the walk over the positions of a material */
+typedef struct fx_walk {
+    const char *path;
+    fx_table *T;
+    fx_source source;
+    fx_values *V;
+    bool ok;
+} fx_walk;
+
+/** @brief Stores the values of a placement of the pieces, if legal */
+static void fx_visit(fx_walk *W, const square *sq) {
+    fx_table *T = W->T;
+    board B;
+    memset(&B, 0, sizeof(board));
+    B.en_passant = INVALID_SQUARE;
+    B.fullmoves = 1;
+    for (int i = 0; i < T->n; i++) {
+        Color c = T->codes[i] & 8 ? BLACK : WHITE;
+        Piece p = (T->codes[i] & 7) - 1;
+        B.colors[c] |= square_to_bitboard(sq[i]);
+        if (p == KING) {
+            B.king[c] = sq[i];
+        } else {
+            B.pieces[p] |= square_to_bitboard(sq[i]);
+        }
+    }
+
+    // With white to move, black's king mustn't be in check, and the other way
+    position P;
+    B.color = WHITE;
+    board_to_position(&P, &B);
+    bool legal[2] = { !king_in_check(&P, THEIRS), !king_in_check(&P, OURS) };
+
+    for (int side = 0; side < T->sides && W->ok; side++) {
+        if (!legal[side]) continue;
+        B.color = side == 0 ? WHITE : BLACK;
+        int wdl, dtz, f;
+        if (!W->source(W->path, &B, &wdl, &dtz)) {
+            W->ok = false;
+            return;
+        }
+        uint64_t idx = fx_encode(T, side, sq, &f);
+        int8_t *stored = &W->V->wdl[side][f][idx];
+        int16_t *stored_dtz = &W->V->dtz[side][f][idx];
+        if ((*stored != INT8_MIN && *stored != wdl) ||
+            (*stored_dtz != INT16_MIN && *stored_dtz != dtz)) {
+            fprintf(stderr, "%s: positions of different values at %d/%d/%lu\n",
+                    T->name, side, f, (unsigned long) idx);
+            W->ok = false;
+            return;
+        }
+        *stored = wdl;
+        *stored_dtz = dtz;
+    }
+    return;
+}
+
+/**
+ * @brief Walks over the placements of the pieces into fx_visit
+ *
+ * Identical pieces are placed in increasing order, the leading piece without
+ * pawns in the triangle and the leading pawn on files a-d, as every index is
+ * reached that way.
+ */
+static void fx_place(fx_walk *W, square *sq, int i, bitboard occupied) {
+    fx_table *T = W->T;
+    if (!W->ok) return;
+    if (T->pawns && i == T->lead) {
+        // Files e-h of the leading pawn mirror a-d
+        int most = 0;
+        for (int j = 1; j < T->lead; j++) {
+            if (fx_pawn_rank(sq[j]) > fx_pawn_rank(sq[most])) most = j;
+        }
+        if (sq[most] % 8 > 3) return;
+    }
+    if (i == T->n) {
+        fx_visit(W, sq);
+        return;
+    }
+    bitboard squares = ~occupied;
+    if ((T->codes[i] & 7) == 1) squares &= 0x00FFFFFFFFFFFF00ull;
+    if (!T->pawns && i == 0) squares &= 0x00000000080C0E0Full;
+    while (squares) {
+        square s = bitboard_iter_first(&squares);
+        if (i > 0 && T->codes[i] == T->codes[i - 1] && s <= sq[i - 1]) continue;
+        sq[i] = s;
+        fx_place(W, sq, i + 1, occupied | square_to_bitboard(s));
+    }
+    return;
+}
+
+/** @brief The stored DTZ of a value, in the units and map of its result */
+static int fx_stored_dtz(int dtz, bool plies, const int *map, int map_len) {
+    int value = plies ? abs(dtz) - 1 : (abs(dtz) - 1) / 2;
+    if (map == NULL) return value;
+    for (int i = 0; i < map_len; i++) {
+        if (map[i] == value) return i;
+    }
+    return -1;
+}
+
+/**
+ * @brief Compresses the DTZ of a side to move of a file
+ *
+ * Results are stored in plies only when some DTZ of theirs is even, and
+ * through maps when their values leave gaps, so that both ways get written.
+ *
+ * @param[out] maps the map of wins and losses, lengths first
+ */
+static void fx_compress_dtz(const int16_t *dtz, uint64_t n, int side,
+                            fx_pairs *C, int maps[2][256]) {
+    bool plies[2] = { false, false };
+    int most[2] = { -1, -1 };
+    bool seen[2][4096] = { { false } };
+    for (uint64_t i = 0; i < n; i++) {
+        if (dtz[i] == 0 || dtz[i] == INT16_MIN) continue;
+        plies[dtz[i] < 0] |= dtz[i] % 2 == 0;
+    }
+    for (uint64_t i = 0; i < n; i++) {
+        if (dtz[i] == 0 || dtz[i] == INT16_MIN) continue;
+        int r = dtz[i] < 0;
+        int value = fx_stored_dtz(dtz[i], plies[r], NULL, 0);
+        seen[r][value] = true;
+        if (value > most[r]) most[r] = value;
+    }
+    bool mapped = false;
+    for (int r = 0; r < 2; r++) {
+        maps[r][0] = 0;
+        for (int v = 0; v <= most[r]; v++) {
+            if (seen[r][v]) maps[r][1 + maps[r][0]++] = v;
+        }
+        mapped |= maps[r][0] < most[r] + 1;
+    }
+
+    uint16_t *values = malloc(n * sizeof(uint16_t));
+    if (values == NULL) {
+        perror("malloc error");
+        exit(1);
+    }
+    uint16_t last = 0;
+    for (uint64_t i = 0; i < n; i++) {
+        if (dtz[i] != 0 && dtz[i] != INT16_MIN) {
+            int r = dtz[i] < 0;
+            last = fx_stored_dtz(dtz[i], plies[r], mapped ? maps[r] + 1 : NULL,
+                                 maps[r][0]);
+        }
+        values[i] = last;
+    }
+    uint8_t flags = side | (mapped ? 2 : 0) | (plies[0] ? 4 : 0) |
+                    (plies[1] ? 8 : 0);
+    fx_compress(values, n, flags, C);
+    if (!mapped) maps[0][0] = maps[1][0] = -1;
+    free(values);
+    return;
+}
+
+/** @brief Writes a buffer to `path`/`name``extension` */
+static bool fx_save(const char *path, const char *name, const char *extension,
+                    fx_buffer *F) {
+    char *file = malloc(strlen(path) + strlen(name) + strlen(extension) + 2);
+    if (file == NULL) {
+        perror("malloc error");
+        exit(1);
+    }
+    sprintf(file, "%s/%s%s", path, name, extension);
+    FILE *out = fopen(file, "wb");
+    bool ok = out != NULL && fwrite(F->bytes, 1, F->size, out) == F->size;
+    if (out != NULL) ok &= fclose(out) == 0;
+    if (!ok) perror(file);
+    free(file);
+    return ok;
+}
+
+/** @brief Writes the header of a file: flags, then the layouts of its files */
+static void fx_put_header(fx_buffer *F, fx_table *T, bool dtz, int *stored) {
+    fx_put(F, dtz ? FX_DTZ_MAGIC : FX_WDL_MAGIC, 4);
+    fx_put8(F, (T->symmetric ? 0 : 1) | (T->pawns ? 2 : 0));
+    for (int f = 0; f < T->files; f++) {
+        const fx_layout *L0 = &T->layouts[dtz ? stored[f] : 0][f];
+        const fx_layout *L1 = &T->layouts[dtz ? stored[f] : 1][f];
+        bool second = !dtz && T->sides == 2;
+        fx_put8(F, L0->order[0] | (second ? L1->order[0] : 0) << 4);
+        if (T->other_pawns > 0) {
+            fx_put8(F, L0->order[1] | (second ? L1->order[1] : 0) << 4);
+        }
+        for (int k = 0; k < T->n; k++) {
+            fx_put8(F, L0->codes[k] | (second ? L1->codes[k] : 0) << 4);
+        }
+    }
+    fx_align(F, 2);
+    return;
+}
+
+/** @brief Writes the sections of the compressed sides after the header */
+static void fx_put_pairs(fx_buffer *F, fx_pairs C[2][4], int files, int sides,
+                         fx_buffer *maps) {
+    for (int f = 0; f < files; f++) {
+        for (int s = 0; s < sides; s++) {
+            fx_put(F, C[s][f].sizes.bytes, C[s][f].sizes.size);
+        }
+    }
+    if (maps != NULL) {
+        fx_put(F, maps->bytes, maps->size);
+        fx_align(F, 2);
+    }
+    for (int f = 0; f < files; f++) {
+        for (int s = 0; s < sides; s++) {
+            fx_put(F, C[s][f].sparse.bytes, C[s][f].sparse.size);
+        }
+    }
+    for (int f = 0; f < files; f++) {
+        for (int s = 0; s < sides; s++) {
+            fx_put(F, C[s][f].lengths.bytes, C[s][f].lengths.size);
+        }
+    }
+    for (int f = 0; f < files; f++) {
+        for (int s = 0; s < sides; s++) {
+            fx_align(F, 64);
+            fx_put(F, C[s][f].data.bytes, C[s][f].data.size);
+        }
+    }
+    // The files end in a 16-byte checksum, which isn't checked
+    fx_align(F, 64);
+    fx_put(F, NULL, 16);
+    return;
+}
+
+/**
+ * @brief Writes the tables of a material from the values a source gives
+ *
+ * Indices no legal position lands on repeat the value before them.
+ */
+static bool fx_write(const char *path, const char *name, fx_source source,
+                     bool with_dtz) {
+    fx_table *T = malloc(sizeof(fx_table));
+    fx_values V;
+    memset(&V, 0, sizeof(V));
+    if (T == NULL) {
+        perror("malloc error");
+        exit(1);
+    }
+    if (!fx_table_init(T, name)) {
+        free(T);
+        return false;
+    }
+    for (int s = 0; s < T->sides; s++) {
+        for (int f = 0; f < T->files; f++) {
+            uint64_t size = T->layouts[s][f].size;
+            V.wdl[s][f] = malloc(size);
+            V.dtz[s][f] = malloc(size * sizeof(int16_t));
+            if (V.wdl[s][f] == NULL || V.dtz[s][f] == NULL) {
+                perror("malloc error");
+                exit(1);
+            }
+            memset(V.wdl[s][f], INT8_MIN, size);
+            for (uint64_t i = 0; i < size; i++) V.dtz[s][f][i] = INT16_MIN;
+        }
+    }
+
+    fx_init_kings();
+    fx_walk W = { path, T, source, &V, true };
+    square sq[FX_MAX_PIECES];
+    fx_place(&W, sq, 0, BITBOARD_EMPTY);
+
+    fx_pairs C[2][4];
+    memset(C, 0, sizeof(C));
+    if (W.ok) {
+        for (int s = 0; s < T->sides; s++) {
+            for (int f = 0; f < T->files; f++) {
+                uint64_t size = T->layouts[s][f].size;
+                uint16_t *values = malloc(size * sizeof(uint16_t));
+                if (values == NULL) {
+                    perror("malloc error");
+                    exit(1);
+                }
+                int8_t last = TB_DRAW;
+                for (uint64_t i = 0; i < size; i++) {
+                    if (V.wdl[s][f][i] != INT8_MIN) last = V.wdl[s][f][i];
+                    values[i] = last - TB_LOSS;
+                }
+                fx_compress(values, size, 0, &C[s][f]);
+                free(values);
+            }
+        }
+        fx_buffer F = { NULL, 0, 0 };
+        fx_put_header(&F, T, false, NULL);
+        fx_put_pairs(&F, C, T->files, T->sides, NULL);
+        W.ok = fx_save(path, name, ".rtbw", &F);
+        free(F.bytes);
+    }
+
+    // DTZ of one side to move a file, the one that compresses better
+    if (W.ok && with_dtz) {
+        int stored[4];
+        fx_pairs D[2][4];
+        fx_buffer maps = { NULL, 0, 0 };
+        memset(D, 0, sizeof(D));
+        for (int f = 0; f < T->files; f++) {
+            int side_maps[2][2][256];
+            fx_pairs candidates[2];
+            for (int s = 0; s < T->sides; s++) {
+                fx_compress_dtz(V.dtz[s][f], T->layouts[s][f].size, s,
+                                &candidates[s], side_maps[s]);
+            }
+            int s = T->sides == 2 && candidates[1].data.size <
+                    candidates[0].data.size ? 1 : 0;
+            stored[f] = s;
+            D[0][f] = candidates[s];
+            if (T->sides == 2) fx_pairs_free(&candidates[!s]);
+            if (side_maps[s][0][0] >= 0) {
+                // Wins, losses, then no cursed wins or blessed losses
+                for (int r = 0; r < 2; r++) {
+                    fx_put8(&maps, side_maps[s][r][0]);
+                    for (int i = 0; i < side_maps[s][r][0]; i++) {
+                        fx_put8(&maps, side_maps[s][r][1 + i]);
+                    }
+                }
+                fx_put8(&maps, 0);
+                fx_put8(&maps, 0);
+            }
+        }
+        fx_buffer F = { NULL, 0, 0 };
+        fx_put_header(&F, T, true, stored);
+        fx_put_pairs(&F, D, T->files, 1, &maps);
+        W.ok = fx_save(path, name, ".rtbz", &F);
+        free(F.bytes);
+        free(maps.bytes);
+        for (int f = 0; f < T->files; f++) fx_pairs_free(&D[0][f]);
+    }
+
+    for (int s = 0; s < T->sides; s++) {
+        for (int f = 0; f < T->files; f++) {
+            free(V.wdl[s][f]);
+            free(V.dtz[s][f]);
+            fx_pairs_free(&C[s][f]);
+        }
+    }
+    free(T);
+    return W.ok;
+}
+
+/* --- Sources --- */
+
+static bool fx_reference_source(const char *path, board *B, int *wdl,
+                                int *dtz) {
+    int8_t v;
+    if (!fx_lookup(path, B, &v)) return false;
+    *wdl = fx_wdl(v);
+    *dtz = fx_dtz(v);
+    return true;
+}
+
+static bool fx_draw_source(const char *path, board *B, int *wdl, int *dtz) {
+    *wdl = TB_DRAW;
+    *dtz = 0;
+    return true;
+}
+
+/** @brief A hash of a piece on a square */
+static uint64_t fx_mix(uint64_t x) {
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    return x ^ (x >> 31);
+}
+
+/**
+ * @brief The noise of a board in the colors of its files
+ *
+ * The lowest hash of the board over the symmetries the files use: mirrors
+ * of files, and without pawns of ranks and of the diagonal.
+ */
+static int fx_noise(board *B) {
+    bool pawns = B->pieces[PAWN] != 0;
+    uint64_t lowest = UINT64_MAX;
+    for (int t = 0; t < (pawns ? 2 : 8); t++) {
+        uint64_t hash = B->color == BLACK ? 0x9E3779B97F4A7C15ull : 0;
+        bitboard b = B->colors[WHITE] | B->colors[BLACK];
+        while (b) {
+            square s = bitboard_iter_first(&b);
+            Color c = B->colors[BLACK] & square_to_bitboard(s) ? BLACK : WHITE;
+            Piece p = PAWN;
+            while (p < KING && !(B->pieces[p] & square_to_bitboard(s))) p++;
+            square u = s ^ (t & 1 ? 7 : 0) ^ (t & 2 ? 56 : 0);
+            if (t & 4) u = (square) (8 * (u % 8) + u / 8);
+            hash += fx_mix(64 * (8 * c + p) + u + 1);
+        }
+        if (hash < lowest) lowest = hash;
+    }
+    return (int) ((lowest >> 40) % 5) + TB_LOSS;
+}
+
+static bool fx_noise_source(const char *path, board *B, int *wdl, int *dtz) {
+    *wdl = fx_noise(B);
+    *dtz = 0;
+    return true;
+}
+
+bool tb_fixture_noise_wdl(const char *name, position *P, int *wdl) {
+    board B;
+    char first[FX_NAME_SIZE], second[FX_NAME_SIZE];
+    board_from_position(&B, P);
+    fx_name(&B, WHITE, first);
+    fx_name(&B, BLACK, second);
+    bool symmetric = strcmp(first, second) == 0;
+    if (strcmp(first, name) != 0 && strcmp(second, name) != 0) return false;
+    // Into the colors of the files, as the reader does
+    if (strcmp(first, name) != 0 || (symmetric && B.color == BLACK)) {
+        fx_flip(&B);
+    }
+    *wdl = fx_noise(&B);
+    return true;
+}
+
+bool tb_fixture_generate(const char *path, const char *name) {
+    Piece sides[2][FX_MAX_PIECES];
+    int counts[2];
+    int pieces = fx_parse(name, sides, counts);
+    if (pieces == 0 || pieces > FX_SOLVE_PIECES) return false;
+
+    // References written before may have changed
+    tb_fixture_free();
+    int8_t *values = fx_solve(path, name, pieces);
+    if (values == NULL) return false;
+
+    fx_header H;
+    memset(&H, 0, sizeof(H));
+    memcpy(H.magic, FX_MAGIC, sizeof(H.magic));
+    H.version = FX_VERSION;
+    H.pieces = pieces;
+    strcpy(H.name, name);
+    fx_buffer F = { NULL, 0, 0 };
+    fx_put(&F, &H, sizeof(H));
+    fx_put(&F, values, fx_entries(pieces));
+    bool ok = fx_save(path, name, ".mtb", &F);
+    free(F.bytes);
+    free(values);
+
+    return ok && fx_write(path, name, fx_reference_source, true);
+}
+
+bool tb_fixture_draws(const char *path, const char *name) {
+    return fx_write(path, name, fx_draw_source, true);
+}
+
+bool tb_fixture_noise(const char *path, const char *name) {
+    return fx_write(path, name, fx_noise_source, false);
+}
@@ -0,0 +1,67 @@
+/**
+ * @file tb-fixture.h
+ * @brief Writes small Syzygy tables for the tablebase tests.
+ *
+ * Real tables are far too big to ship with the tests, so the tests probe
+ * tables written here instead: materials of three pieces solved by
+ * retrograde analysis, whose results are also kept in a plain `.mtb`
+ * reference file (one signed byte per position), tables of bare draws, and
+ * larger materials filled with noise, which only exercise the indexing. The
+ * writer encodes positions and compresses values on its own, so that a
+ * mistake in the reader of tb.c shows up as a mismatch rather than cancels.
+ */
+
+#ifndef _TB_FIXTURE_H_
+#define _TB_FIXTURE_H_
+
+#include "../src/position.h"
+
+#include <stdbool.h>
+
+/**
+ * @brief Solves a material of up to three pieces and writes its tables
+ *
+ * Writes `name`.mtb, `name`.rtbw and `name`.rtbz. The references of the
+ * materials that captures and promotions lead to must be in `path` already,
+ * except those of bare kings and a lone minor piece.
+ *
+ * @param[in] path directory to write to
+ * @param[in] name material such as "KRvK", the stronger side first
+ * @pre path != NULL && name != NULL
+ *
+ * @return false for malformed names, missing references or write errors
+ */
+bool tb_fixture_generate(const char *path, const char *name);
+
+/** @brief Writes the tables of a material where every position is a draw */
+bool tb_fixture_draws(const char *path, const char *name);
+
+/**
+ * @brief Writes a result table of up to five pieces filled with noise
+ *
+ * Each position gets a result from a hash of its pieces that the symmetries
+ * the files use keep, see tb_fixture_noise_wdl.
+ */
+bool tb_fixture_noise(const char *path, const char *name);
+
+/**
+ * @brief The result and DTZ of a position in the references of `path`
+ *
+ * @param[out] wdl TB_LOSS, TB_DRAW or TB_WIN
+ * @param[out] dtz as tb_probe_dtz gives it
+ *
+ * @return false if there is no reference for the material
+ */
+bool tb_fixture_probe(const char *path, position *P, int *wdl, int *dtz);
+
+/**
+ * @brief The result tb_fixture_noise gave a position of a material
+ *
+ * @return false if the position isn't of that material
+ */
+bool tb_fixture_noise_wdl(const char *name, position *P, int *wdl);
+
+/** @brief Forgets the references loaded so far */
+void tb_fixture_free(void);
+
+#endif
@@ -0,0 +1,39 @@
+/**
+ * @file tb-gen.c
+ * @brief Command-line generator of small test tablebases.
+ *
+ * Usage: tb-gen <directory> <material>...
+ *   material   such as KQvK, of up to three pieces, in an order where the
+ *              tables that captures and promotions lead to come first, e.g.
+ *              KQvK KRvK KPvK
+ *
+ * Writes the Syzygy files of each material, as tb-fixture.c solves them.
+ * These are only good for testing: the engine plays with the real tables,
+ * downloaded from the Syzygy sites (the 3-4-5 piece set is under 1 GB).
+ *
+ * Build with `make RELEASE=1` to generate in seconds.
+ */
+
+#include "../src/moves.h"
+#include "tb-fixture.h"
+
+#include <stdio.h>
+
+int main(int argc, char **argv) {
+    if (argc < 3) {
+        fprintf(stderr, "usage: %s <directory> <material>...\n", argv[0]);
+        return 1;
+    }
+
+    moves_init();
+    for (int i = 2; i < argc; i++) {
+        if (!tb_fixture_generate(argv[1], argv[i])) {
+            fprintf(stderr, "%s: could not generate %s\n", argv[0], argv[i]);
+            return 1;
+        }
+        printf("%s/%s.rtbw\n%s/%s.rtbz\n", argv[1], argv[i], argv[1], argv[i]);
+    }
+    tb_fixture_free();
+
+    return 0;
+}
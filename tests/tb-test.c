@@ -0,0 +1,327 @@
+/**
+ * @file tb-test.c
+ * @brief Tests for the tablebase interface.
+ *
+ * Writes the Syzygy tables it probes into ./build/tb-test.tables, see
+ * tb-fixture.h, and checks every probe against the fixture's references.
+ */
+
+#include "../src/bitbase.h"
+#include "../src/moves.h"
+#include "../src/tb.h"
+#include "tb-fixture.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define TB_TEST_DIR "./build/tb-test.tables"
+
+/** @brief Solved positions probed, one in so many, and for DTZ in fewer */
+#define WDL_STRIDE 2
+#define DTZ_STRIDE 16
+
+/** @brief Plies of the game before the root, in the repetition checks */
+#define GAME_SIZE 40
+
+/** @brief Random positions probed in each table of noise */
+#define NOISE_POSITIONS 20000
+
+/** @brief Probes the result and DTZ of a FEN */
+static int probe_fen(position *P, const char *fen, int *dtz) {
+    int wdl;
+    position_from_fen(P, fen);
+    assert(tb_probe_wdl(P, &wdl));
+    assert(tb_probe_dtz(P, dtz));
+    assert(wdl == TB_WIN ? *dtz > 0 : wdl == TB_DRAW ? *dtz == 0 : *dtz < 0);
+    return wdl;
+}
+
+/** @brief Puts pieces on an empty board */
+static bool place(board *B, Color c, Piece p, square s) {
+    bitboard b = square_to_bitboard(s);
+    if ((B->colors[WHITE] | B->colors[BLACK]) & b) return false;
+    if (p == PAWN && (s / 8 == 0 || s / 8 == 7)) return false;
+    B->colors[c] |= b;
+    if (p == KING) {
+        B->king[c] = s;
+    } else {
+        B->pieces[p] |= b;
+    }
+    return true;
+}
+
+/** @brief Whether a board is legal, and turns it into a position */
+static bool legal(position *P, board *B) {
+    B->en_passant = INVALID_SQUARE;
+    B->halfmoves = 0;
+    B->fullmoves = 1;
+    B->castling = 0;
+    board_to_position(P, B);
+    return !king_in_check(P, THEIRS);
+}
+
+/**
+ * @brief Compares the positions of a solved material to the references
+ *
+ * With the piece on either side and either side to move.
+ */
+static void check_solved(position *P, Piece piece) {
+    int n = 0;
+    for (square k1 = 0; k1 < 64; k1++) {
+        for (square k2 = 0; k2 < 64; k2++) {
+            for (square s = 0; s < 64; s++) {
+                for (int i = 0; i < 4; i++) {
+                    board B;
+                    memset(&B, 0, sizeof(board));
+                    Color strong = i & 1 ? BLACK : WHITE;
+                    B.color = i & 2 ? BLACK : WHITE;
+                    if (!place(&B, strong, KING, k1) ||
+                        !place(&B, !strong, KING, k2) ||
+                        !place(&B, strong, piece, s) || !legal(P, &B))
+                        continue;
+                    if (n++ % WDL_STRIDE != 0) continue;
+                    int wdl, dtz, expected_wdl, expected_dtz;
+                    assert(tb_fixture_probe(TB_TEST_DIR, P, &expected_wdl,
+                                            &expected_dtz));
+                    assert(tb_probe_wdl(P, &wdl) && wdl == expected_wdl);
+                    if (n % DTZ_STRIDE != 1) continue;
+                    assert(tb_probe_dtz(P, &dtz) && dtz == expected_dtz);
+                }
+            }
+        }
+    }
+    return;
+}
+
+/** @brief Probes random positions without captures of a table of noise */
+static void check_noise(position *P, const char *name) {
+    Piece pieces[2][4];
+    int counts[2] = { 0, 0 };
+    int side = 0;
+    for (const char *ch = name; *ch != '\0'; ch++) {
+        if (*ch == 'v') {
+            side = 1;
+            continue;
+        }
+        Piece p = PAWN;
+        while (PIECE_CHARS[WHITE][p] != *ch) p++;
+        pieces[side][counts[side]++] = p;
+    }
+
+    srand(1);
+    for (int probed = 0; probed < NOISE_POSITIONS;) {
+        board B;
+        memset(&B, 0, sizeof(board));
+        Color first = rand() % 2 == 0 ? WHITE : BLACK;
+        B.color = rand() % 2 == 0 ? WHITE : BLACK;
+        bool placed = true;
+        for (int c = 0; c < 2; c++) {
+            for (int i = 0; i < counts[c] && placed; i++) {
+                placed = place(&B, first ^ c, pieces[c][i], rand() % 64);
+            }
+        }
+        if (!placed || !legal(P, &B)) continue;
+
+        movelist M;
+        movelist_clear(&M);
+        generate_moves(&M, P);
+        bool captures = false;
+        for (int i = 0; i < M.size; i++) {
+            captures |= (M.array[i].flags & M_FLAG_CAPTURE) != 0;
+        }
+        if (captures) continue;
+
+        int wdl, expected;
+        assert(tb_fixture_noise_wdl(name, P, &expected));
+        assert(tb_probe_wdl(P, &wdl) && wdl == expected);
+        probed++;
+    }
+    return;
+}
+
+/** @brief Root moves of a KQvK win, 20 plies after the last zeroing move */
+static int filter_game(position *P, const zhash *history, movelist_t M) {
+    int wdl;
+    position_from_fen(P, "8/8/8/3k4/8/8/8/4KQ2 w - - 20 40");
+    movelist_clear(M);
+    generate_moves(M, P);
+    assert(tb_root_filter(P, history, history == NULL ? 0 : GAME_SIZE, M,
+                          &wdl));
+    return wdl;
+}
+
+/**
+ * @brief The game since the last zeroing move changes the root moves kept
+ *
+ * The game is made of fillers, but for the positions after the best moves,
+ * put where playing them again would repeat them.
+ */
+static void check_repetitions(position *P) {
+    movelist best, M;
+    zhash after[MAX_MOVES], history[GAME_SIZE];
+    assert(filter_game(P, NULL, &best) == TB_WIN && best.size <= 8);
+    for (int i = 0; i < best.size; i++) {
+        undo U;
+        move_make(P, best.array[i], &U);
+        position_rotate(P);
+        after[i] = P->hash;
+        position_rotate(P);
+        move_unmake(P, best.array[i], &U);
+    }
+
+    // The best moves now draw, and the win goes another way
+    for (int i = 0; i < GAME_SIZE; i++) history[i] = i + 1;
+    for (int i = 0; i < best.size; i++) {
+        history[GAME_SIZE - 3 - 2 * i] = after[i];
+    }
+    assert(filter_game(P, history, &M) == TB_WIN && M.size > 0);
+    for (int i = 0; i < M.size; i++) {
+        for (int j = 0; j < best.size; j++) {
+            assert(M.array[i].from != best.array[j].from ||
+                   M.array[i].to != best.array[j].to);
+        }
+    }
+
+    // Unless the positions came before the last zeroing move
+    for (int i = 0; i < GAME_SIZE; i++) history[i] = i + 1;
+    for (int i = 0; i < best.size; i++) history[2 * i] = after[i];
+    assert(filter_game(P, history, &M) == TB_WIN && M.size == best.size);
+
+    // A repetition leaves no win certain, but the same moves
+    for (int i = 0; i < GAME_SIZE; i++) history[i] = i + 1;
+    history[GAME_SIZE - 5] = history[GAME_SIZE - 1];
+    assert(filter_game(P, history, &M) == TB_CURSED_WIN);
+    assert(M.size == best.size);
+    return;
+}
+
+void tb_tests(void) {
+    position *P = position_new();
+    int dtz;
+
+    /* Writing */
+    assert(mkdir(TB_TEST_DIR, 0755) == 0 || errno == EEXIST);
+    unlink(TB_TEST_DIR "/KQvK.mtb");
+    assert(!tb_fixture_generate(TB_TEST_DIR, "KRK"));
+    assert(!tb_fixture_generate(TB_TEST_DIR, "KPRvK"));
+    assert(!tb_fixture_generate(TB_TEST_DIR, "KQRvK"));
+    assert(!tb_fixture_generate(TB_TEST_DIR, "KPvK"));  // promotes into KQvK
+    assert(tb_fixture_generate(TB_TEST_DIR, "KQvK"));
+    assert(tb_fixture_generate(TB_TEST_DIR, "KRvK"));
+    assert(tb_fixture_generate(TB_TEST_DIR, "KPvK"));
+    assert(tb_fixture_draws(TB_TEST_DIR, "KNvK"));
+    assert(tb_fixture_draws(TB_TEST_DIR, "KBvK"));
+    assert(tb_fixture_noise(TB_TEST_DIR, "KRvKN"));     // three leading pieces
+    assert(tb_fixture_noise(TB_TEST_DIR, "KNNvK"));     // two leading kings
+    assert(tb_fixture_noise(TB_TEST_DIR, "KPvKP"));     // pawns of both colors
+    assert(tb_fixture_noise(TB_TEST_DIR, "KPPvK"));     // two leading pawns
+
+    assert(tb_init("/nonexistent:" TB_TEST_DIR) == 9);
+    assert(tb_dtz_tables() == 5);
+    assert(tb_max_pieces() == 4);
+
+    /* Known results, with either color stronger */
+    assert(probe_fen(P, "8/8/8/3k4/8/8/8/4KQ2 w - - 0 1", &dtz) == TB_WIN);
+    assert(probe_fen(P, "8/8/8/3k4/8/8/8/4KQ2 b - - 0 1", &dtz) == TB_LOSS);
+    assert(probe_fen(P, "k7/8/1K6/8/8/8/8/2Q5 w - - 0 1", &dtz) == TB_WIN);
+    assert(dtz == 1);                                           // mate in one
+    assert(probe_fen(P, "k7/1Q6/1K6/8/8/8/8/8 b - - 0 1", &dtz) == TB_LOSS);
+    assert(dtz == -1);                                          // mated
+    assert(probe_fen(P, "k7/2Q5/1K6/8/8/8/8/8 b - - 0 1", &dtz) == TB_DRAW);
+    assert(probe_fen(P, "8/8/8/8/8/8/6k1/4Kr2 w - - 0 1", &dtz) == TB_LOSS);
+    assert(probe_fen(P, "8/8/8/8/8/3k4/8/4Kr2 w - - 0 1", &dtz) == TB_DRAW);
+    assert(probe_fen(P, "8/8/8/8/k7/8/6P1/4K3 w - - 0 1", &dtz) == TB_WIN);
+    assert(probe_fen(P, "k7/8/K7/P7/8/8/8/8 w - - 0 1", &dtz) == TB_DRAW);
+    assert(probe_fen(P, "8/8/8/8/8/4k3/4p3/2K5 w - - 0 1", &dtz) == TB_LOSS);
+    assert(probe_fen(P, "8/8/8/3k4/8/8/2B5/4K3 w - - 0 1", &dtz) == TB_DRAW);
+    assert(probe_fen(P, "8/8/8/3k4/8/8/8/4K3 w - - 0 1", &dtz) == TB_DRAW);
+
+    /* Castling rights, and material without a table */
+    int wdl;
+    position_from_fen(P, "4k3/8/8/8/8/8/8/R3K3 w Q - 0 1");
+    assert(!tb_probe_wdl(P, &wdl));
+    position_from_fen(P, "4k3/8/8/8/8/8/8/RR2K3 w - - 0 1");
+    assert(!tb_probe_wdl(P, &wdl));
+    assert(!tb_probe_dtz(P, &dtz));
+    position_from_fen(P, "4k3/8/8/8/8/8/8/RRR1K3 w - - 0 1");
+    assert(!tb_probe_wdl(P, &wdl));
+
+    /* Every solved position agrees with the references */
+    check_solved(P, QUEEN);
+    check_solved(P, ROOK);
+    check_solved(P, PAWN);
+
+    /* Every KPvK result agrees with the bitbase */
+    for (square pawn = 8; pawn < 56; pawn++) {
+        for (square ours = 0; ours < 64; ours++) {
+            for (square theirs = 0; theirs < 64; theirs++) {
+                int ranks = ours / 8 - theirs / 8, files = ours % 8 - theirs % 8;
+                if (ours == pawn || theirs == pawn ||
+                    (-1 <= ranks && ranks <= 1 && -1 <= files && files <= 1))
+                    continue;
+                position_clear(P);
+                P->pieces[PAWN] = square_to_bitboard(pawn);
+                P->whose[OURS] = square_to_bitboard(pawn) | square_to_bitboard(ours);
+                P->whose[THEIRS] = square_to_bitboard(theirs);
+                P->king[OURS] = ours;
+                P->king[THEIRS] = theirs;
+                if (king_in_check(P, THEIRS)) continue;
+                assert(tb_probe_wdl(P, &wdl));
+                assert((wdl == TB_WIN) == bitbase_kpk(ours, pawn, theirs, true));
+            }
+        }
+    }
+
+    /* Indexing of four pieces, through tables of noise */
+    check_noise(P, "KRvKN");
+    check_noise(P, "KNNvK");
+    check_noise(P, "KPvKP");
+    check_noise(P, "KPPvK");
+
+    /* Root moves keep the win, by the shortest way */
+    movelist M;
+    position_from_fen(P, "8/8/8/3k4/8/8/8/4KQ2 w - - 0 1");
+    movelist_clear(&M);
+    generate_moves(&M, P);
+    int before = M.size;
+    assert(tb_root_filter(P, NULL, 0, &M, &wdl) && wdl == TB_WIN);
+    assert(0 < M.size && M.size < before);
+    for (int i = 0; i < M.size; i++) {
+        undo U;
+        move_make(P, M.array[i], &U);
+        position_rotate(P);
+        assert(tb_probe_wdl(P, &wdl) && wdl == TB_LOSS);
+        position_rotate(P);
+        move_unmake(P, M.array[i], &U);
+    }
+
+    position_from_fen(P, "8/8/8/8/8/3k4/8/4Kr2 w - - 0 1");
+    movelist_clear(&M);
+    generate_moves(&M, P);
+    assert(tb_root_filter(P, NULL, 0, &M, &wdl) && wdl == TB_DRAW &&
+           M.size == 1);
+
+    /* Moves back to a position of the game are draws */
+    check_repetitions(P);
+
+    tb_free();
+    tb_fixture_free();
+    assert(tb_max_pieces() == 0 && tb_dtz_tables() == 0);
+    position_free(P);
+    return;
+}
+
+int main(int argc, char *argv[]) {
+    moves_init();
+    bitbase_init();
+    tb_tests();
+
+    printf("All tests passed!\n");
+
+    return 0;
+}
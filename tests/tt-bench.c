@@ -0,0 +1,86 @@
+/**
+ * @file tt-bench.c
+ * @brief Benchmark of transposition table allocation: clearing and probing a
+ * table on small pages, transparent huge pages and MAP_HUGETLB pages.
+ *
+ * Usage: tt-bench [megabytes] [threads]
+ *
+ * Build with `make RELEASE=1` for meaningful numbers. MAP_HUGETLB needs pages
+ * reserved first, e.g. `sysctl vm.nr_hugepages=<megabytes / 2>`.
+ */
+
+#define _POSIX_C_SOURCE 200809L     // clock_gettime
+
+#include "../src/moves.h"
+#include "../src/tt.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define PROBES 20000000
+
+static const char *PAGES_NAMES[3] = { "small", "transparent", "hugetlb" };
+
+static double seconds_since(struct timespec *start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+/** @brief Probes keys spread over the whole table, one in sixteen hits */
+static double bench_probes(tt *T, uint64_t *hits) {
+    uint64_t x = 0x9e3779b97f4a7c15;
+    move m = { KNIGHT, G1, F3, M_FLAG_QUIET };
+    for (int i = 0; i < PROBES / 4; i++) {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        tt_store(T, x, m, 0, i % 32, BOUND_EXACT);
+    }
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    x = 0x9e3779b97f4a7c15;
+    *hits = 0;
+    tt_entry E;
+    for (int i = 0; i < PROBES; i++) {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        *hits += tt_probe(T, i % 4 == 0 ? x : x ^ 1, &E);
+    }
+    return seconds_since(&start);
+}
+
+int main(int argc, char *argv[]) {
+    size_t megabytes = argc > 1 ? strtoul(argv[1], NULL, 10) : 1024;
+    int threads = argc > 2 ? atoi(argv[2]) : 1;
+    if (megabytes < 1 || threads < 1) {
+        fprintf(stderr, "usage: %s [megabytes] [threads]\n", argv[0]);
+        return 1;
+    }
+
+    printf("%zu MB, %d clearing threads, %d probes\n", megabytes, threads,
+           PROBES);
+    for (TTPages pages = TT_PAGES_SMALL; pages <= TT_PAGES_HUGETLB; pages++) {
+        struct timespec start;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        tt *T = tt_new_paged(megabytes, threads, pages);
+        double clear = seconds_since(&start);
+        if (tt_pages(T) != pages) {
+            printf("%-11s unavailable\n", PAGES_NAMES[pages]);
+            tt_free(T);
+            continue;
+        }
+
+        uint64_t hits;
+        double probing = bench_probes(T, &hits);
+        printf("%-11s %6zu KiB pages  new %7.3fs  %6.2f M probes/s  "
+               "(%.1f%% hits)\n", PAGES_NAMES[pages], tt_page_size(T) >> 10,
+               clear, PROBES / probing / 1e6, 100.0 * hits / PROBES);
+        tt_free(T);
+    }
+
+    return 0;
+}
@@ -0,0 +1,180 @@
+/**
+ * @file tt-test.c
+ * @brief Tests for the transposition table interface.
+ */
+
+#include "../src/moves.h"
+#include "../src/tt.h"
+#include "../src/zobrist.h"
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+
+#define STRESS_THREADS 4
+#define STRESS_STORES 200000
+
+/** @brief A key that lands in the same bucket as `key` in any table */
+static zhash same_bucket(zhash key, int i) {
+    return key ^ ((zhash) (i + 1) << 48);
+}
+
+static bool move_equal(move a, move b) {
+    return a.piece == b.piece && a.from == b.from && a.to == b.to &&
+           a.flags == b.flags;
+}
+
+/** @brief Stores and probes entries whose fields are all derived from the key */
+static void *stress_worker(void *arg) {
+    tt *T = arg;
+    uint64_t x = (uint64_t) pthread_self() | 1;
+    for (int i = 0; i < STRESS_STORES; i++) {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        zhash key = x & 0xFFFFF;    // few keys, so threads collide
+        move m = { KNIGHT, key & 63, (key & 63) ^ 32, M_FLAG_QUIET };
+        tt_store(T, key, m, (int) (key % 2001) - 1000, key % 64, BOUND_EXACT);
+
+        tt_entry E;
+        if (tt_probe(T, key, &E)) {
+            assert(move_equal(E.move, m));
+            assert(E.score == (int) (key % 2001) - 1000);
+            assert(E.depth == (int) (key % 64));
+            assert(E.bound == BOUND_EXACT);
+        }
+    }
+    return NULL;
+}
+
+void tt_tests(void) {
+    tt *T = tt_new(1, 1);
+    assert(tt_size(T) == 1 << 20);
+    assert(tt_hashfull(T) == 0);
+
+    /* Round trip of every field, negative scores and depths included */
+    tt_entry E;
+    zhash key = 0x0123456789abcdef;
+    move m = { QUEEN, D1, H5, M_FLAG_CAPTURE };
+    assert(!tt_probe(T, key, &E));
+    tt_prefetch(T, key);
+    tt_store(T, key, m, -TT_MAX_SCORE, 12, BOUND_UPPER);
+    assert(tt_probe(T, key, &E));
+    assert(move_equal(E.move, m));
+    assert(E.score == -TT_MAX_SCORE && E.depth == 12 && E.bound == BOUND_UPPER);
+    tt_store(T, key, m, 345, -2, BOUND_LOWER);
+    assert(tt_probe(T, key, &E));
+    assert(E.score == 345 && E.depth == -2 && E.bound == BOUND_LOWER);
+    assert(!tt_probe(T, key ^ 1, &E));
+
+    /* Storing without a move keeps the one already there */
+    tt_store(T, key, NULL_MOVE, 10, 3, BOUND_EXACT);
+    assert(tt_probe(T, key, &E));
+    assert(move_equal(E.move, m) && E.score == 10);
+
+    /* A full bucket gives up its shallowest entry */
+    tt_clear(T);
+    for (int i = 0; i < 4; i++) {
+        tt_store(T, same_bucket(key, i), m, 0, 10 + i, BOUND_EXACT);
+    }
+    tt_store(T, same_bucket(key, 4), m, 0, 1, BOUND_EXACT);
+    assert(!tt_probe(T, same_bucket(key, 0), &E));
+    for (int i = 1; i <= 4; i++) assert(tt_probe(T, same_bucket(key, i), &E));
+
+    /* ... but prefers entries of old searches to deep ones */
+    tt_new_search(T);
+    tt_new_search(T);
+    tt_store(T, same_bucket(key, 5), m, 0, 1, BOUND_EXACT);
+    assert(!tt_probe(T, same_bucket(key, 4), &E));  // old and shallowest
+    tt_store(T, same_bucket(key, 6), m, 0, 1, BOUND_EXACT);
+    assert(!tt_probe(T, same_bucket(key, 1), &E));  // old, depth 11
+    assert(tt_probe(T, same_bucket(key, 5), &E));   // depth 1, this search
+    assert(tt_probe(T, same_bucket(key, 6), &E));
+
+    /* hashfull counts the current search's entries only */
+    tt_clear(T);
+    for (zhash k = 0; k < 1 << 16; k++) {
+        tt_store(T, k * 0x9e3779b97f4a7c15, m, 0, 1, BOUND_EXACT);
+    }
+    int full = tt_hashfull(T);
+    assert(full > 500 && full <= 1000);
+    tt_new_search(T);
+    assert(tt_hashfull(T) == 0);
+
+    /* Concurrent stores never let a torn entry through */
+    tt_clear(T);
+    pthread_t threads[STRESS_THREADS];
+    for (int t = 0; t < STRESS_THREADS; t++) {
+        pthread_create(&threads[t], NULL, stress_worker, T);
+    }
+    for (int t = 0; t < STRESS_THREADS; t++) pthread_join(threads[t], NULL);
+
+    tt_free(T);
+
+    /* Every allocation path gives a working table, cleared by all threads */
+    for (TTPages pages = TT_PAGES_SMALL; pages <= TT_PAGES_HUGETLB; pages++) {
+        T = tt_new_paged(8, 3, pages);
+        assert(tt_size(T) == 8 << 20);
+        assert(tt_pages(T) <= pages);
+        assert(tt_page_size(T) >= 4096);
+        if (tt_pages(T) == TT_PAGES_SMALL) assert(tt_page_size(T) < 2 << 20);
+        for (zhash k = 0; k < 1 << 16; k++) {
+            tt_store(T, k * 0x9e3779b97f4a7c15, m, 0, 1, BOUND_EXACT);
+        }
+        tt_clear(T);
+        for (zhash k = 0; k < 1 << 16; k++) {
+            assert(!tt_probe(T, k * 0x9e3779b97f4a7c15, &E));
+        }
+        tt_free(T);
+    }
+
+    /* A table file resumes warm only under the same size */
+    const char *path = "./build/tt-test.tt";
+    remove(path);
+    bool warm;
+    T = tt_open(path, 2, 2, &warm);
+    assert(T != NULL && !warm);
+    assert(!tt_probe(T, key, &E));
+    tt_new_search(T);
+    tt_store(T, key, m, 123, 9, BOUND_LOWER);
+    tt_store(T, 0xabcdef0000000000, m, 0, 1, BOUND_EXACT);     // bucket 0
+    tt_free(T);
+
+    T = tt_open(path, 2, 2, &warm);
+    assert(T != NULL && warm);
+    assert(tt_probe(T, key, &E));
+    assert(move_equal(E.move, m));
+    assert(E.score == 123 && E.depth == 9 && E.bound == BOUND_LOWER);
+    assert(tt_hashfull(T) > 0);     // bucket 0 is sampled, the age was kept
+    tt_free(T);
+
+    T = tt_open(path, 4, 2, &warm);
+    assert(T != NULL && !warm);
+    assert(tt_size(T) == 4 << 20);
+    assert(!tt_probe(T, key, &E));
+    tt_free(T);
+    remove(path);
+
+    /* Files that aren't tables are refused and left alone */
+    FILE *f = fopen(path, "w");
+    fputs("not a table", f);
+    fclose(f);
+    assert(tt_open(path, 2, 1, &warm) == NULL);
+    f = fopen(path, "r");
+    char text[16] = {0};
+    assert(fgets(text, sizeof(text), f) != NULL);
+    assert(strcmp(text, "not a table") == 0);
+    fclose(f);
+    remove(path);
+
+    return;
+}
+
+int main(int argc, char *argv[]) {
+    tt_tests();
+
+    printf("All tests passed!\n");
+
+    return 0;
+}
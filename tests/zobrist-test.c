@@ -14,7 +14,7 @@ void zobrist_tests(void) {
     
     position *P = position_new();
     position_clear(P);
-    hash_init();
+    moves_init();
     position_print(P);
     assert(hash_position(P) == hash_position(P));
     printf("Zobrist hash: %lu\n", hash_position(P));
@@ -24,8 +24,9 @@ void zobrist_tests(void) {
     assert(hash_position(P) == hash_position(P));
     printf("Zobrist hash: %lu\n", hash_position(P));
 
+    undo U;
     move m0 = {PAWN, E2, E3, M_FLAG_QUIET};
-    move_make(P, m0);
+    move_make(P, m0, &U);
     position_print(P);
     assert(hash_position(P) == hash_position(P));
     printf("Zobrist hash: %lu\n", hash_position(P));
@@ -35,22 +36,74 @@ void zobrist_tests(void) {
     printf("Zobrist hash: %lu\n", hash_position(P));
 
     move m1 = {PAWN, d7, d5, M_FLAG_DPP};
-    move_make(P, m1);
+    move_make(P, m1, &U);
     position_print(P);
     assert(hash_position(P) == hash_position(P));
     printf("Zobrist hash: %lu\n", hash_position(P));
     position_set_castling(P, OURS, KINGSIDE, false);
+    P->hash = hash_position(P);     // setters don't keep the hash
     position_print(P);
     assert(hash_position(P) == hash_position(P));
     printf("Zobrist hash: %lu\n", hash_position(P));
 
     position_rotate(P);
     move m2 = {KING, E1, E2, M_FLAG_QUIET};
-    move_make(P, m2);
+    move_make(P, m2, &U);
+    assert(P->hash == hash_position(P));
     position_print(P);
     assert(hash_position(P) == hash_position(P));
     printf("Zobrist hash: %lu\n", hash_position(P));
-    
+
+    // Kings and en passant rights are part of the hash
+    position_from_fen(P, "4k3/8/8/8/8/8/8/4K3 w - - 0 1");
+    zhash before = hash_position(P);
+    position_from_fen(P, "4k3/8/8/8/8/8/8/3K4 w - - 0 1");
+    assert(hash_position(P) != before);
+
+    position_from_fen(P, "4k3/8/8/3pP3/8/8/8/4K3 w - - 0 1");
+    before = hash_position(P);
+    position_from_fen(P, "4k3/8/8/3pP3/8/8/8/4K3 w - d6 0 1");
+    assert(hash_position(P) != before);
+    position_from_fen(P, "4k3/8/8/8/3Pp3/8/8/4K3 b - d3 0 1");
+    before = hash_position(P);
+    position_from_fen(P, "4k3/8/8/8/3Pp3/8/8/4K3 b - - 0 1");
+    assert(hash_position(P) != before);
+
+    // Side to move and the en passant file are keyed separately
+    position_from_fen(P, "4k3/8/8/8/8/8/8/4K3 b - - 0 1");
+    assert(hash_position(P) ==
+           (hash_position(P) ^ COLOR_PRN ^ COLOR_PRN));
+    before = hash_position(P);
+    position_from_fen(P, "4k3/8/8/8/8/8/8/4K3 w - - 0 1");
+    assert((hash_position(P) ^ COLOR_PRN) == before);
+    position_from_fen(P, "4k3/8/8/3pP3/8/8/8/4K3 w - - 0 1");
+    before = hash_position(P);
+    position_from_fen(P, "4k3/8/8/3pP3/8/8/8/4K3 w - d6 0 1");
+    assert((hash_position(P) ^ EN_PASSANT_PRN[3]) == before);
+
+    // Keys are fixed at compile time, so hashes are stable across runs
+    position_init(P);
+    assert(hash_position(P) == 0xd582a73c187f5680);
+    position_from_fen(P,
+        "rnbqkbnr/pppppppp/8/8/4P3/8/PPPP1PPP/RNBQKBNR b KQkq e3 0 1");
+    assert(hash_position(P) == 0x7c171e27e0a5de0a);
+    assert(P->hash == 0x7c171e27e0a5de0a);
+
+    // The pawn hash follows pawn moves and captures only
+    position_init(P);
+    zhash pawns = P->pawn_hash;
+    assert(pawns == hash_pawns(P));
+    move m3 = {KNIGHT, G1, F3, M_FLAG_QUIET};
+    move_make(P, m3, &U);
+    assert(P->pawn_hash == pawns);
+    position_rotate(P);
+    assert(P->pawn_hash == pawns && P->pawn_hash == hash_pawns(P));
+    move m4 = {PAWN, e7, e5, M_FLAG_DPP};
+    move_make(P, m4, &U);
+    assert(P->pawn_hash != pawns && P->pawn_hash == hash_pawns(P));
+    move_unmake(P, m4, &U);
+    assert(P->pawn_hash == pawns);
+
     position_free(P);
 
     return;